@@ -5,9 +5,22 @@ layout(location = 2) uniform float time;
 layout(location = 3) uniform int num_bones = 0;
 layout(location = 4) uniform int Mode = 0;
 layout(location = 5) uniform int debug_id = 0;
+//Instanced: model matrix and bone palette of each instance come from the ring below
+layout(location = 8) uniform int instanced = 0;
+layout(location = 9) uniform int instance_base = 0;//slot of the draw's first instance record
+//Packed vertices: positions relative to the submesh bounds, optionally octahedral normals
+layout(location = 10) uniform vec3 pos_scale = vec3(1.0);
+layout(location = 11) uniform vec3 pos_offset = vec3(0.0);
+layout(location = 12) uniform int oct_normals = 0;
 #define MAX_BONES 100
 layout(location = 20) uniform mat4 bone_xform[MAX_BONES];
 
+//Affine 3x4 matrices (3 rows) and instance records (model matrix rows, palette offset, bone count)
+layout(std430, binding = 1) readonly restrict buffer BONE_RING
+{
+    vec4 ring[];
+};
+
 
 layout (location = 0) in vec3 pos_attrib;
 layout (location = 1) in vec2 tex_coord_attrib;
@@ -23,11 +36,42 @@ out VertexData
     float w_debug;
 } outData;
 
+vec3 oct_decode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+    {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+mat4 ring_matrix(int slot)
+{
+    return transpose(mat4(ring[slot], ring[slot + 1], ring[slot + 2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
 void main(void)
 {
     mat4 Skinning = mat4(1.0);
+    mat4 Model = M;
 
-    if (num_bones > 0)
+    if (instanced != 0)
+    {
+        int record = instance_base + 4 * gl_InstanceID;
+        Model = ring_matrix(record);
+        ivec2 palette = floatBitsToInt(ring[record + 3].xy);//offset, bone count
+
+        if (palette.y > 0)
+        {
+            //Linear blend skinning
+            Skinning = ring_matrix(palette.x + 3 * bone_id_attrib[0]) * weight_attrib[0];
+            Skinning += ring_matrix(palette.x + 3 * bone_id_attrib[1]) * weight_attrib[1];
+            Skinning += ring_matrix(palette.x + 3 * bone_id_attrib[2]) * weight_attrib[2];
+            Skinning += ring_matrix(palette.x + 3 * bone_id_attrib[3]) * weight_attrib[3];
+        }
+    }
+    else if (num_bones > 0)
     {
         //Linear blend skinning
         Skinning = bone_xform[bone_id_attrib[0]] * weight_attrib[0];
@@ -46,21 +90,24 @@ void main(void)
         }
     }
 
-    vec4 anim_pos = Skinning * vec4(pos_attrib, 1.0);
+    vec3 pos = pos_offset + pos_scale * pos_attrib;
+    vec3 normal = oct_normals != 0 ? oct_decode(normal_attrib.xy) : normal_attrib;
+
+    vec4 anim_pos = Skinning * vec4(pos, 1.0);
 
     if (Mode > 0)
     {
-        gl_Position  = PV*M * anim_pos;
-        outData.pw = vec3(M*anim_pos);
+        gl_Position  = PV*Model * anim_pos;
+        outData.pw = vec3(Model*anim_pos);
 
-        vec4 anim_normal = Skinning * vec4(normal_attrib, 0.0);
-        outData.nw = vec3(M * anim_normal);
+        vec4 anim_normal = Skinning * vec4(normal, 0.0);
+        outData.nw = vec3(Model * anim_normal);
     }
     else //show mesh in rest pose
     {
-        gl_Position = PV*M * vec4(pos_attrib, 1.0);
-        outData.pw  = vec3(M*vec4(pos_attrib, 1.0));
-        outData.nw  = vec3(M * vec4(normal_attrib, 0.0));
+        gl_Position = PV*Model * vec4(pos, 1.0);
+        outData.pw  = vec3(Model*vec4(pos, 1.0));
+        outData.nw  = vec3(Model * vec4(normal, 0.0));
     }
 
     outData.tex_coord = vec2(tex_coord_attrib.s, 1.0-tex_coord_attrib.t);//tex coords flipped in the dae file
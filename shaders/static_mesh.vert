@@ -3,9 +3,22 @@
 layout(location = 0) uniform mat4 PV;
 layout(location = 1) uniform mat4 M;
 
+//Packed vertices: positions relative to the submesh bounds, optionally octahedral normals
+layout(location = 10) uniform vec3 pos_scale = vec3(1.0);
+layout(location = 11) uniform vec3 pos_offset = vec3(0.0);
+layout(location = 12) uniform int oct_normals = 0;
+
+//Multi-draw-indirect: scale and offset per draw, indexed by the BaseInstance of the draw
+layout(location = 4) uniform int per_draw_dequant = 0;
+layout(std430, binding = 0) readonly restrict buffer DRAW_DATA
+{
+    vec4 draw_dequant[];//scale, offset per draw
+};
+
 layout(location = 0) in vec3 pos_attrib;
 layout(location = 1) in vec2 tex_coord_attrib;
 layout(location = 2) in vec3 normal_attrib;
+layout(location = 3) in uint draw_id_attrib;//instanced, divisor 1
 
 out VertexData
 {
@@ -14,11 +27,32 @@ out VertexData
     vec3 nw;//world-space normal vector
 } outData;
 
+vec3 oct_decode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+    {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
 void main(void)
 {
-    gl_Position = PV * M * vec4(pos_attrib, 1.0);
-    outData.pw  = vec3(M * vec4(pos_attrib, 1.0));
-    outData.nw  = vec3(M * vec4(normal_attrib, 0.0));
+    vec3 scale = pos_scale;
+    vec3 offset = pos_offset;
+    if (per_draw_dequant != 0)
+    {
+        scale = draw_dequant[2 * draw_id_attrib].xyz;
+        offset = draw_dequant[2 * draw_id_attrib + 1].xyz;
+    }
+
+    vec3 pos = offset + scale * pos_attrib;
+    vec3 normal = oct_normals != 0 ? oct_decode(normal_attrib.xy) : normal_attrib;
+
+    gl_Position = PV * M * vec4(pos, 1.0);
+    outData.pw  = vec3(M * vec4(pos, 1.0));
+    outData.nw  = vec3(M * vec4(normal, 0.0));
 
     outData.tex_coord = vec2(tex_coord_attrib.s, 1.0-tex_coord_attrib.t);//tex coords flipped in the dae file
 }
\ No newline at end of file
@@ -3,9 +3,13 @@
 layout(location = 0) uniform mat4 PV;
 layout(location = 1) uniform mat4 M;
 
+//Packed positions, relative to the submesh bounds
+layout(location = 10) uniform vec3 pos_scale = vec3(1.0);
+layout(location = 11) uniform vec3 pos_offset = vec3(0.0);
+
 layout(location = 0) in vec3 pos_attrib;
 
 void main(void)
 {
-    gl_Position = PV * M * vec4(pos_attrib, 1.0);
+    gl_Position = PV * M * vec4(pos_offset + pos_scale * pos_attrib, 1.0);
 }
\ No newline at end of file
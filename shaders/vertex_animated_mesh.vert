@@ -0,0 +1,77 @@
+#version 450
+layout(location = 0) uniform mat4 PV;
+layout(location = 1) uniform mat4 M;
+layout(location = 2) uniform float time;
+layout(location = 4) uniform int Mode = 0;
+//Packed vertices: positions relative to the submesh bounds, optionally octahedral normals
+layout(location = 10) uniform vec3 pos_scale = vec3(1.0);
+layout(location = 11) uniform vec3 pos_offset = vec3(0.0);
+layout(location = 12) uniform int oct_normals = 0;
+
+//Vertex animation texture: one texel per vertex and frame, see VertexAnimation.h
+layout(binding = 1) uniform usampler2D vat_tex;
+layout(location = 13) uniform float vat_frame = 0.0;//fractional frame to draw
+layout(location = 14) uniform int vat_num_frames = 1;
+layout(location = 15) uniform ivec2 vat_layout = ivec2(1);//width, rows per frame
+layout(location = 16) uniform vec3 vat_bb_min = vec3(0.0);
+layout(location = 17) uniform vec3 vat_bb_extent = vec3(0.0);
+
+layout (location = 0) in vec3 pos_attrib;
+layout (location = 1) in vec2 tex_coord_attrib;
+layout (location = 2) in vec3 normal_attrib;
+
+out VertexData
+{
+    vec2 tex_coord;
+    vec3 pw;//world-space vertex position
+    vec3 nw;//world-space normal vector
+    float w_debug;
+} outData;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+    {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+//Texel of the vertex drawn (gl_VertexID includes the base vertex) in a frame
+uvec4 vat_fetch(int frame)
+{
+    ivec2 coord = ivec2(gl_VertexID % vat_layout.x, frame * vat_layout.y + gl_VertexID / vat_layout.x);
+    return texelFetch(vat_tex, coord, 0);
+}
+
+void main(void)
+{
+    vec3 pos = pos_offset + pos_scale * pos_attrib;
+    vec3 normal = oct_normals != 0 ? oct_decode(normal_attrib.xy) : normal_attrib;
+
+    if (Mode > 0)
+    {
+        //Blend the two baked frames around vat_frame
+        int frame0 = min(int(vat_frame), vat_num_frames - 1);
+        int frame1 = min(frame0 + 1, vat_num_frames - 1);
+        float t = vat_frame - float(frame0);
+        uvec4 texel0 = vat_fetch(frame0);
+        uvec4 texel1 = vat_fetch(frame1);
+
+        pos = vat_bb_min + vat_bb_extent * mix(vec3(texel0.xyz), vec3(texel1.xyz), t) / 65535.0;
+
+        //Octahedral normal, x in the low byte
+        vec2 oct0 = vec2(texel0.w & 0xFFu, texel0.w >> 8) / 255.0 * 2.0 - 1.0;
+        vec2 oct1 = vec2(texel1.w & 0xFFu, texel1.w >> 8) / 255.0 * 2.0 - 1.0;
+        normal = normalize(mix(oct_decode(oct0), oct_decode(oct1), t));
+    }
+    //else show mesh in rest pose
+
+    gl_Position = PV*M * vec4(pos, 1.0);
+    outData.pw  = vec3(M*vec4(pos, 1.0));
+    outData.nw  = vec3(M * vec4(normal, 0.0));
+    outData.w_debug = 0.0;
+
+    outData.tex_coord = vec2(tex_coord_attrib.s, 1.0-tex_coord_attrib.t);//tex coords flipped in the dae file
+}
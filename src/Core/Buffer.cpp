@@ -2,6 +2,7 @@
 #include <cassert>
 #include <vector>
 #include <GL/glew.h>
+#include "MemoryBudget.h"
 
 Buffer::Buffer(GLuint target, GLuint binding): mTarget(target), mBinding(binding)
 {
@@ -12,6 +13,7 @@ void Buffer::Free()
 {
    if (mBuffer != -1)
    {
+      MemoryBudget::UntrackGlObject(GL_BUFFER, mBuffer);
       glDeleteBuffers(1, &mBuffer);
    }
    mBuffer = -1;
@@ -29,12 +31,14 @@ void Buffer::Init(int size, void* data, GLuint flags)
    
    if(mBuffer != -1)
    {
+      MemoryBudget::UntrackGlObject(GL_BUFFER, mBuffer);
       glDeleteBuffers(1, &mBuffer);
    }
 
    glGenBuffers(1, &mBuffer);
    glBindBuffer(mTarget, mBuffer);
    glNamedBufferStorage(mBuffer, size, data, mFlags);
+   MemoryBudget::TrackGlObject(GL_BUFFER, mBuffer, size, "Buffers");
 }
 
 void Buffer::ClearToInt(int i)
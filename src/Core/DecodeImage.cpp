@@ -0,0 +1,197 @@
+#include "LoadTexture.h"
+#include "FreeImage.h"
+#include "StagingPool.h"
+#include <glm/glm.hpp>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define LOADTEXTURE_SSE 1
+#include <emmintrin.h>
+#endif
+
+unsigned int GetMipLevels(unsigned int w, unsigned int h)
+{
+   unsigned int levels = 1;
+   while ((w | h) > 1)
+   {
+      w >>= 1;
+      h >>= 1;
+      levels++;
+   }
+   return levels;
+}
+
+size_t GetMipOffset(unsigned int w, unsigned int h, unsigned int level)
+{
+   size_t offset = 0;
+   for (unsigned int i = 0; i < level; i++)
+   {
+      offset += size_t(glm::max(w >> i, 1u))*glm::max(h >> i, 1u)*4;
+   }
+   return offset;
+}
+
+size_t GetLevelSize(const ImageData& image, unsigned int level)
+{
+   const unsigned int w = glm::max(image.Width >> level, 1u);
+   const unsigned int h = glm::max(image.Height >> level, 1u);
+   if (image.CompressedFormat == 0)
+   {
+      return size_t(w)*h*4;
+   }
+
+   //4x4 blocks, 8 bytes for BC1 and 16 for the others
+   const size_t blockBytes = (image.CompressedFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || image.CompressedFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+   return size_t((w + 3)/4)*((h + 3)/4)*blockBytes;
+}
+
+size_t GetLevelOffset(const ImageData& image, unsigned int level)
+{
+   size_t offset = 0;
+   for (unsigned int i = 0; i < level; i++)
+   {
+      offset += GetLevelSize(image, i);
+   }
+   return offset;
+}
+
+bool DecodeImage(const std::string& fname, ImageData& image, bool mips)
+{
+   ReleaseImage(image);
+
+   FIBITMAP* img = FreeImage_Load(FreeImage_GetFileType(fname.c_str(), 0), fname.c_str());
+   if (img != nullptr && (FreeImage_GetImageType(img) != FIT_BITMAP || FreeImage_GetBPP(img) != 32))
+   {
+      FIBITMAP* tempImg = img;
+      img = FreeImage_ConvertTo32Bits(tempImg);
+      FreeImage_Unload(tempImg);
+   }
+
+   if (img == nullptr)
+   {
+      std::cout << "FreeImage can't load image "<<fname<<std::endl;
+      return false;
+   }
+
+   const unsigned int w = FreeImage_GetWidth(img);
+   const unsigned int h = FreeImage_GetHeight(img);
+   const unsigned int levels = mips ? GetMipLevels(w, h) : 1;
+
+   image.Width = w;
+   image.Height = h;
+   image.Pitch = w*4;
+   image.Levels = 1;
+
+   //Room for the whole chain up front so BuildMipChain never reallocates
+   image.Pixels = StagingPool::Get().Acquire(GetMipOffset(w, h, levels));
+
+   //32 bit FreeImage bitmaps are BGRA in memory on little endian machines, which is what
+   //GL_BGRA uploads, so the swizzle ConvertToRawBits used to do is a plain row copy
+   for (unsigned int y = 0; y < h; y++)
+   {
+      memcpy(image.Pixels.data() + size_t(y)*image.Pitch, FreeImage_GetScanLine(img, y), image.Pitch);
+   }
+   FreeImage_Unload(img);
+
+   if (mips)
+   {
+      BuildMipChain(image);
+   }
+
+   return true;
+}
+
+//Average 2x2 blocks of two source rows into one destination row, rounding to nearest.
+//Columns past the edge of a 1 pixel wide source are clamped.
+static void DownsampleRow(const unsigned char* row0, const unsigned char* row1, unsigned int sw, unsigned char* dst, unsigned int dw)
+{
+   unsigned int x = 0;
+
+#if LOADTEXTURE_SSE
+   if (sw >= 2)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i round = _mm_set1_epi16(2);
+
+      //8 source pixels of each row -> 4 destination pixels
+      for (; x + 4 <= dw; x += 4)
+      {
+         const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8*x));
+         const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8*x + 16));
+         const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8*x));
+         const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8*x + 16));
+
+         //Vertical sums with 16 bits per channel, two pixels per register
+         __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+         __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+         __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+         __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+         //Horizontal sums end up in the low pixel of each register
+         s01 = _mm_add_epi16(s01, _mm_srli_si128(s01, 8));
+         s23 = _mm_add_epi16(s23, _mm_srli_si128(s23, 8));
+         s45 = _mm_add_epi16(s45, _mm_srli_si128(s45, 8));
+         s67 = _mm_add_epi16(s67, _mm_srli_si128(s67, 8));
+
+         __m128i lo = _mm_unpacklo_epi64(s01, s23);
+         __m128i hi = _mm_unpacklo_epi64(s45, s67);
+         lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+         hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4*x), _mm_packus_epi16(lo, hi));
+      }
+   }
+#endif
+
+   for (; x < dw; x++)
+   {
+      const unsigned int x0 = 4*glm::min(2*x, sw - 1);
+      const unsigned int x1 = 4*glm::min(2*x + 1, sw - 1);
+      for (unsigned int c = 0; c < 4; c++)
+      {
+         dst[4*x + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+      }
+   }
+}
+
+void BuildMipChain(ImageData& image)
+{
+   if (!image.Valid() || image.CompressedFormat != 0)
+   {
+      return;
+   }
+
+   const unsigned int levels = GetMipLevels(image.Width, image.Height);
+   const size_t bytes = GetMipOffset(image.Width, image.Height, levels);
+   if (image.Pixels.size() < bytes)
+   {
+      image.Pixels.resize(bytes);
+   }
+
+   for (unsigned int level = 1; level < levels; level++)
+   {
+      const unsigned int sw = glm::max(image.Width >> (level - 1), 1u);
+      const unsigned int sh = glm::max(image.Height >> (level - 1), 1u);
+      const unsigned int dw = glm::max(image.Width >> level, 1u);
+      const unsigned int dh = glm::max(image.Height >> level, 1u);
+
+      const unsigned char* src = image.Pixels.data() + GetMipOffset(image.Width, image.Height, level - 1);
+      unsigned char* dst = image.Pixels.data() + GetMipOffset(image.Width, image.Height, level);
+
+      for (unsigned int y = 0; y < dh; y++)
+      {
+         const unsigned int y0 = glm::min(2*y, sh - 1);
+         const unsigned int y1 = glm::min(2*y + 1, sh - 1);
+         DownsampleRow(src + size_t(y0)*sw*4, src + size_t(y1)*sw*4, sw, dst + size_t(y)*dw*4, dw);
+      }
+   }
+
+   image.Levels = levels;
+}
+
+void ReleaseImage(ImageData& image)
+{
+   StagingPool::Get().Release(std::move(image.Pixels));
+   image = ImageData();
+}
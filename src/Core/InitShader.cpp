@@ -1,10 +1,12 @@
 #include <GL/glew.h>
 #include "InitShader.h"
 #include "ShaderInclude.hpp"
+#include "ProgramCache.h"
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 //Adapted from Edward Angel's InitShader code
@@ -87,7 +89,8 @@ namespace
       delete[] logMsg;
    }
 
-   int loadShaderFile(Shader& s)
+   //Reads the stage and resolves includes and the code injection: exactly what gets compiled
+   bool preprocessShaderFile(Shader& s)
    {
       s.filename = ShaderDir+s.filename;
       s.source = ShaderInclude::load(s.filename);
@@ -95,14 +98,16 @@ namespace
       if (s.source.length() == 0)
       {
          std::cerr << "Failed to read " << s.filename << std::endl;
-         return -1;
+         return false;
       }
 
       //insert the code injection after #version and #extension
       injectCode(s.source);
+      return true;
+   }
 
-      
-
+   int compileShader(Shader& s)
+   {
       s.shader_id = glCreateShader(s.type);
       const char* c_str = s.source.c_str();
       glShaderSource(s.shader_id, 1, (const GLchar**)&c_str, NULL);
@@ -115,6 +120,7 @@ namespace
          std::cerr << s.filename << " failed to compile:" << std::endl;
          printShaderCompileError(s.shader_id);
          glDeleteShader(s.shader_id);
+         s.shader_id = (GLuint)-1;
          return -1;
       }
 
@@ -136,6 +142,169 @@ namespace
       }
       return true;
    }
+
+   //Program binaries on disk, see ProgramCache.h
+   const uint64_t ProgramCacheBytes = 64ull*1024*1024;
+   static bool ProgramCacheEnabled = true;
+   //Relative to the working directory (the binary's output directory), not ShaderDir: the
+   //shader directory is usually a link back into the source tree
+   static string ProgramCacheDir = "shader_cache/";
+   static ProgramCache::Cache BinaryCache;
+
+   //nullptr if disabled or the driver can't hand out binaries
+   ProgramCache::Cache* getBinaryCache()
+   {
+      if (!ProgramCacheEnabled) return nullptr;
+
+      if (ProgramCacheDir.length() == 0) return nullptr;
+
+      string dir = ProgramCacheDir;
+      if (dir.back() != '/' && dir.back() != '\\') dir += '/';
+      if (BinaryCache.IsOpen() && BinaryCache.GetDir() == dir) return &BinaryCache;
+
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      if (formats < 1 || BinaryCache.Open(dir, ProgramCacheBytes) == false)
+      {
+         ProgramCacheEnabled = false;
+         return nullptr;
+      }
+      return &BinaryCache;
+   }
+
+   //Binaries are only valid for the driver that made them
+   const string& getDriverIdentity()
+   {
+      static string identity;
+      if (identity.length() == 0)
+      {
+         for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+         {
+            const GLubyte* s = glGetString(name);
+            identity += s != nullptr ? (const char*)s : "";
+            identity += "\n";
+         }
+      }
+      return identity;
+   }
+
+   uint64_t getProgramKey(const Shader* shaders, int count)
+   {
+      ProgramCache::Hasher hasher;
+      hasher.Add(getDriverIdentity());
+      for (int i = 0; i < count; i++)
+      {
+         if (shaders[i].filename != "")
+         {
+            hasher.Add(uint32_t(shaders[i].type));
+            hasher.Add(shaders[i].source);
+         }
+      }
+      return hasher.Value;
+   }
+
+   //Program from a cached binary, 0 on a miss or if the driver rejects the binary
+   GLuint loadProgramBinary(ProgramCache::Cache& cache, uint64_t key)
+   {
+      uint32_t format;
+      std::vector<char> binary;
+      if (cache.Load(key, format, binary) == false) return 0;
+
+      GLuint program = glCreateProgram();
+      glProgramBinary(program, format, binary.data(), GLsizei(binary.size()));
+
+      GLint linked;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (!linked)
+      {
+         //driver update or a different GPU: rebuild from source
+         glDeleteProgram(program);
+         cache.Remove(key);
+         return 0;
+      }
+      return program;
+   }
+
+   void storeProgramBinary(ProgramCache::Cache& cache, uint64_t key, GLuint program)
+   {
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0) return;
+
+      std::vector<char> binary(length);
+      GLsizei written = 0;
+      GLenum format = 0;
+      glGetProgramBinary(program, length, &written, &format, binary.data());
+      binary.resize(written);
+      cache.Store(key, format, binary);
+   }
+
+   //Links the stages with a filename into a new program. The binary cache is tried first, the
+   //stages are compiled only when it has nothing for these exact sources. Returns -1 on failure.
+   GLuint buildProgram(Shader* shaders, int count)
+   {
+      bool shader_success = true;
+      for (int i = 0; i < count; ++i)
+      {
+         if (shaders[i].filename != "" && preprocessShaderFile(shaders[i]) == false)
+         {
+            shader_success = false;
+         }
+      }
+      if (shader_success == false) return -1;
+
+      ProgramCache::Cache* cache = getBinaryCache();
+      uint64_t key = 0;
+      if (cache != nullptr)
+      {
+         key = getProgramKey(shaders, count);
+         GLuint program = loadProgramBinary(*cache, key);
+         if (program != 0) return program;
+      }
+
+      GLuint program = glCreateProgram();
+      if (cache != nullptr)
+      {
+         glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
+
+      for (int i = 0; i < count; ++i)
+      {
+         if (shaders[i].filename != "")
+         {
+            GLuint shader_id = compileShader(shaders[i]);
+            if (shader_id == -1)
+            {
+               shader_success = false;
+            }
+            else
+            {
+               glAttachShader(program, shader_id);
+            }
+         }
+      }
+
+      bool linked = linkProgram(program);
+      for (int i = 0; i < count; i++)
+      {
+         if (shaders[i].shader_id != -1)
+         {
+            glDeleteShader(shaders[i].shader_id);
+         }
+      }
+
+      if (linked == false || shader_success == false)
+      {
+         glDeleteProgram(program);
+         return -1;
+      }
+
+      if (cache != nullptr)
+      {
+         storeProgramBinary(*cache, key, program);
+      }
+      return program;
+   }
 };
 
 void SetShaderDir(const std::string& dir)
@@ -160,30 +329,31 @@ void ClearCodeInjection()
    CodeInjection = "";
 }
 
+void SetProgramCacheDir(const std::string& dir)
+{
+   ProgramCacheDir = dir;
+}
+
+void SetProgramCacheEnabled(bool enabled)
+{
+   ProgramCacheEnabled = enabled;
+}
+
+void FlushProgramCache()
+{
+   BinaryCache.Flush();
+}
+
 GLuint InitShader(const std::string& computeShaderFile)
 {
    Shader shaders = { computeShaderFile, GL_COMPUTE_SHADER, "", (GLuint)-1 };
-   
-   GLuint program = glCreateProgram();
 
-   GLuint shader_id = loadShaderFile(shaders);
-   if (shader_id != -1)
-   {
-      glAttachShader(program, shader_id);
-   }
-   
-   bool linked = linkProgram(program);
-   if (linked == false)
+   GLuint program = buildProgram(&shaders, 1);
+   if (program == -1)
    {
-      glDeleteProgram(program);
       return -1;
    }
 
-   if(shader_id != 0)
-   {
-      glDeleteShader(shader_id);
-   }
-   
    /* use program object */
    glUseProgram(program);
    return program;
@@ -218,36 +388,9 @@ GLuint InitShader(const std::string& vertexShaderFile, const std::string& tessCo
       { fragmentShaderFile, GL_FRAGMENT_SHADER, "", (GLuint)-1}
    };
 
-   GLuint program = glCreateProgram();
-   bool shader_success = true;
-   for (int i = 0; i < NUM_FILES; ++i)
+   GLuint program = buildProgram(shaders, NUM_FILES);
+   if (program == -1)
    {
-      if(shaders[i].filename != "")
-      {
-         GLuint shader_id = loadShaderFile(shaders[i]);
-         if (shader_id == -1)
-         {
-            shader_success = false;
-         }
-         else
-         {
-            glAttachShader(program, shader_id);
-         }
-      }
-   }
-
-   bool linked = linkProgram(program);
-   for (int i = 0; i < NUM_FILES; i++)
-   {
-      if (shaders[i].shader_id != -1)
-      {
-         glDeleteShader(shaders[i].shader_id);
-      }
-   }
-
-   if (linked == false || shader_success == false)
-   {
-      glDeleteProgram(program);
       return -1;
    }
 
@@ -255,4 +398,3 @@ GLuint InitShader(const std::string& vertexShaderFile, const std::string& tessCo
    glUseProgram(program);
    return program;
 }
-
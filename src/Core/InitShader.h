@@ -18,4 +18,12 @@ void SetCodeInjection(const std::string& inj);
 void ClearCodeInjection();
 const std::string GetCodeInjection();
 
+//Linked programs are cached on disk, keyed by their preprocessed sources and the driver, and
+//loaded with glProgramBinary when nothing changed. The default dir is "shader_cache/" in the
+//working directory.
+void SetProgramCacheDir(const std::string& dir);
+void SetProgramCacheEnabled(bool enabled);
+//Writes the last-use index after a batch of loads (it is also written at exit)
+void FlushProgramCache();
+
 #endif
\ No newline at end of file
@@ -2,11 +2,11 @@
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
+#include <cstring>
 
 #include <GL/glew.h>
-
-// Create an instance of the Importer class
-Assimp::Importer gImporter;
+#include "MeshImporter.h"
+#include "MeshInstances.h"
 
 namespace fs = std::filesystem;
 
@@ -27,16 +27,14 @@ bool ValidMeshFilename(const std::string& fname0)
 {
    std::string fname = MeshDir + fname0;
    std::string ext = fs::path(fname).extension().string();
-   return gImporter.IsExtensionSupported(ext);
+   return MeshImporter::Get().IsExtensionSupported(ext);
 }
 
 void MeshData::FreeMeshData()
 {
-   if (mScene != nullptr)
-   {
-      gImporter.FreeScene();
-      mScene = nullptr;
-   }
+   //Only drops this mesh's snapshot, other meshes keep their scenes
+   mSceneSnapshot.reset();
+   mScene = nullptr;
    if (mVao != -1)
    {
       glDeleteVertexArrays(1, &mVao);
@@ -51,16 +49,6 @@ void MeshData::FreeMeshData()
    {
       glDeleteBuffers(1, &mVboVerts);
    }
-
-   if (mVboTexCoords != -1)
-   {
-      glDeleteBuffers(1, &mVboTexCoords);
-   }
-
-   if (mVboNormals != -1)
-   {
-      glDeleteBuffers(1, &mVboNormals);
-   }
 }
 
 MeshData::~MeshData()
@@ -68,39 +56,37 @@ MeshData::~MeshData()
    //FreeMeshData();
 }
 
-MeshData LoadMesh(const std::string& filename)
+static MeshData BeginLoadMesh(const std::string& filename)
 {
    MeshData mesh;
    mesh.mFilename = MeshDir + filename;
+   return mesh;
+}
 
-   //check if file exists
-   std::ifstream fin(mesh.mFilename.c_str());
-   if (!fin.fail())
-   {
-      fin.close();
-   }
-   else
-   {
-      printf("Couldn't open file: %s\n", mesh.mFilename.c_str());
-      printf("%s\n", gImporter.GetErrorString());
-      return mesh;
-   }
-
-   if (mesh.mScene != nullptr)
+static bool FileExists(const std::string& filename)
+{
+   std::ifstream fin(filename.c_str());
+   if (fin.fail())
    {
-      delete mesh.mScene;
-      mesh.mScene = nullptr;
+      printf("Couldn't open file: %s\n", filename.c_str());
+      return false;
    }
+   return true;
+}
 
-   mesh.mScene = gImporter.ReadFile(mesh.mFilename, mesh.mImportFlags); //PreTransformVertices makes multiple submeshes work
-
+//Buffers the imported scene, on the thread owning the GL context
+static void FinishLoadMesh(MeshData& mesh, const MeshImporter::Result& imported)
+{
    // If the import failed, report it
-   if (mesh.mScene == nullptr)
+   if (!imported.Valid())
    {
-      printf("%s\n", gImporter.GetErrorString());
-      return mesh;
+      printf("%s\n", imported.mError.c_str());
+      return;
    }
 
+   mesh.mSceneSnapshot = imported.mScene;
+   mesh.mScene = mesh.mSceneSnapshot.get();
+
    // Now we can access the file's contents.
    printf("Import of scene %s succeeded.\n", mesh.mFilename.c_str());
 
@@ -112,9 +98,52 @@ MeshData LoadMesh(const std::string& filename)
 
    BufferIndexedVerts(mesh);
 
+   if (mesh.mNumVerts < mesh.mNumFlatVerts)
+   {
+      printf("%d meshes share geometry: %zu of %zu vertices buffered\n", mesh.mScene->mNumMeshes, mesh.mNumVerts, mesh.mNumFlatVerts);
+   }
+}
+
+MeshData LoadMesh(const std::string& filename)
+{
+   MeshData mesh = BeginLoadMesh(filename);
+   if (!FileExists(mesh.mFilename))
+   {
+      return mesh;
+   }
+
+   //PreTransformVertices makes multiple submeshes work
+   FinishLoadMesh(mesh, MeshImporter::Get().Import(mesh.mFilename, mesh.mImportFlags));
    return mesh;
 }
 
+std::vector<MeshData> LoadMeshes(const std::vector<std::string>& filenames)
+{
+   std::vector<MeshData> meshes;
+   std::vector<MeshImporter::Result> imported(filenames.size());
+   TaskGroup group;
+
+   for (size_t i = 0; i < filenames.size(); i++)
+   {
+      meshes.push_back(BeginLoadMesh(filenames[i]));
+      if (FileExists(meshes[i].mFilename))
+      {
+         MeshImporter::Get().ImportAsync(meshes[i].mFilename, meshes[i].mImportFlags, &imported[i], group);
+      }
+   }
+   ThreadPool::Get().Wait(group);
+
+   for (size_t i = 0; i < meshes.size(); i++)
+   {
+      //Missing files were reported above and never imported
+      if (imported[i].Valid() || !imported[i].mError.empty())
+      {
+         FinishLoadMesh(meshes[i], imported[i]);
+      }
+   }
+   return meshes;
+}
+
 void GetBoundingBox(const aiMesh* mesh, aiVector3D* min, aiVector3D* max)
 {
    min->x = min->y = min->z = 1e10f;
@@ -189,16 +218,6 @@ void BufferIndexedVerts(MeshData& meshdata)
       glDeleteBuffers(1, &meshdata.mVboVerts);
    }
 
-   if (meshdata.mVboTexCoords != -1)
-   {
-      glDeleteBuffers(1, &meshdata.mVboTexCoords);
-   }
-
-   if (meshdata.mVboNormals != -1)
-   {
-      glDeleteBuffers(1, &meshdata.mVboNormals);
-   }
-
    GLint program = -1;
    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
 
@@ -214,31 +233,48 @@ void BufferIndexedVerts(MeshData& meshdata)
    glGenVertexArrays(1, &meshdata.mVao);
    glBindVertexArray(meshdata.mVao);
 
-   const int numSubmeshes = meshdata.mScene->mNumMeshes;
+   //Submesh m draws scene mesh m, from the range of the first mesh with the same contents
+   const int numSubmeshes = int(meshdata.mScene->mNumMeshes);
+   const std::vector<unsigned int> firstCopy = MeshInstances::FindDuplicates(meshdata.mScene->mMeshes, numSubmeshes);
+   std::vector<unsigned int> sourceMeshes;
    meshdata.mSubmesh.resize(numSubmeshes);
 
    int totalNumVerts = 0;
    int totalNumIndices = 0;
+   meshdata.mNumFlatVerts = 0;
+   meshdata.mNumFlatIndices = 0;
 
    for (int m = 0; m < numSubmeshes; m++)
    {
-      meshdata.mSubmesh[m].mNumIndices = meshdata.mScene->mMeshes[m]->mNumFaces * 3;
+      const aiMesh* mesh = meshdata.mScene->mMeshes[m];
+      meshdata.mNumFlatVerts += mesh->mNumVertices;
+      meshdata.mNumFlatIndices += size_t(mesh->mNumFaces) * 3;
+      if (firstCopy[m] != unsigned(m))
+      {
+         continue;
+      }
+
+      meshdata.mSubmesh[m].mNumIndices = mesh->mNumFaces * 3;
       meshdata.mSubmesh[m].mBaseIndex = totalNumIndices;
       meshdata.mSubmesh[m].mBaseVertex = totalNumVerts;
+      sourceMeshes.push_back(m);
 
-      totalNumVerts += meshdata.mScene->mMeshes[m]->mNumVertices;
+      totalNumVerts += mesh->mNumVertices;
       totalNumIndices += meshdata.mSubmesh[m].mNumIndices;
    }
+   meshdata.mNumVerts = totalNumVerts;
+   meshdata.mNumIndices = totalNumIndices;
 
    std::vector<unsigned int> indices(totalNumIndices);
 
    unsigned int faceIndex = 0;
-   for (int m = 0; m<numSubmeshes; m++)
+   for (unsigned int m : sourceMeshes)
    {
-      int meshFaces = meshdata.mScene->mMeshes[m]->mNumFaces;
+      const aiMesh* mesh = meshdata.mScene->mMeshes[m];
+      int meshFaces = mesh->mNumFaces;
       for (unsigned int f = 0; f < meshFaces; ++f)
       {
-         const aiFace* face = &meshdata.mScene->mMeshes[m]->mFaces[f];
+         const aiFace* face = &mesh->mFaces[f];
 
          memcpy(&indices[faceIndex], face->mIndices, 3 * sizeof(unsigned int));
          faceIndex += 3;
@@ -251,87 +287,59 @@ void BufferIndexedVerts(MeshData& meshdata)
    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * totalNumIndices, indices.data(), GL_STATIC_DRAW);
 
 
-   //Buffer vertices
+   //Gather the submeshes into flat streams and pack them into one interleaved buffer
+   std::vector<aiVector3D> positions(totalNumVerts);
+   std::vector<aiVector3D> normals(totalNumVerts);
+   std::vector<aiVector2D> tex_coords(totalNumVerts);
+   std::vector<VertexPacking::Submesh> ranges(sourceMeshes.size());
+
+   for (size_t s = 0; s < sourceMeshes.size(); s++)
    {
-      glGenBuffers(1, &meshdata.mVboVerts);
-      glBindBuffer(GL_ARRAY_BUFFER, meshdata.mVboVerts);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * totalNumVerts, 0, GL_STATIC_DRAW);
+      const aiMesh* mesh = meshdata.mScene->mMeshes[sourceMeshes[s]];
+      const unsigned int base = meshdata.mSubmesh[sourceMeshes[s]].mBaseVertex;
+      ranges[s] = {base, mesh->mNumVertices};
 
-      int offset = 0;
-      for (int m = 0; m<numSubmeshes; m++)
+      //TODO for animated meshes: inline aiNode* FindNode(const aiString& name), and compute transformation
+      //aiNode* node = FindNode(mesh->mName);
+      if (mesh->HasPositions())
       {
-         aiMesh* mesh = meshdata.mScene->mMeshes[m];
-         if (mesh->HasPositions())
-         {
-            //TODO for animated meshes: inline aiNode* FindNode(const aiString& name), and compute transformation
-            //aiNode* node = FindNode(mesh->mName);
-
-            const int size = 3 * sizeof(float)*mesh->mNumVertices;
-            const void* data = mesh->mVertices;
-            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-            offset += size;
-         }
+         std::copy(mesh->mVertices, mesh->mVertices + mesh->mNumVertices, positions.begin() + base);
       }
-      glEnableVertexAttribArray(pos_loc);
-      glVertexAttribPointer(pos_loc, 3, GL_FLOAT, 0, 0, 0);
-   }
-
-   // buffer texture coordinates
-   {
-      glGenBuffers(1, &meshdata.mVboTexCoords);
-      glBindBuffer(GL_ARRAY_BUFFER, meshdata.mVboTexCoords);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 2 * totalNumVerts, 0, GL_STATIC_DRAW);
-
-      int offset = 0;
-      for (int m = 0; m<numSubmeshes; m++)
+      if (mesh->HasNormals())
+      {
+         std::copy(mesh->mNormals, mesh->mNormals + mesh->mNumVertices, normals.begin() + base);
+      }
+      if (mesh->HasTextureCoords(0))
       {
-         aiMesh* mesh = meshdata.mScene->mMeshes[m];
-         std::vector<float> tex_coords(2 * mesh->mNumVertices);
-         if (mesh->HasTextureCoords(0))
+         for (unsigned int k = 0; k < mesh->mNumVertices; ++k)
          {
-            for (unsigned int k = 0; k < mesh->mNumVertices; ++k)
-            {
-               tex_coords[k * 2] = mesh->mTextureCoords[0][k].x;
-               tex_coords[k * 2 + 1] = mesh->mTextureCoords[0][k].y;
-            }
-            const int size = 2 * sizeof(float)*mesh->mNumVertices;
-            const void* data = tex_coords.data();
-            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-            offset += size;
+            tex_coords[base + k] = aiVector2D(mesh->mTextureCoords[0][k].x, mesh->mTextureCoords[0][k].y);
          }
       }
-      glEnableVertexAttribArray(tex_coord_loc);
-      glVertexAttribPointer(tex_coord_loc, 2, GL_FLOAT, 0, 0, 0);
    }
 
-   //buffer normals
-   {
-      glGenBuffers(1, &meshdata.mVboNormals);
-      glBindBuffer(GL_ARRAY_BUFFER, meshdata.mVboNormals);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * totalNumVerts, 0, GL_STATIC_DRAW);
+   VertexPacking::Streams streams;
+   streams.Positions = {positions.data(), sizeof(aiVector3D)};
+   streams.Normals = {normals.data(), sizeof(aiVector3D)};
+   streams.TexCoords = {tex_coords.data(), sizeof(aiVector2D)};
 
-      int offset = 0;
-      for (int m = 0; m<numSubmeshes; m++)
-      {
-         aiMesh* mesh = meshdata.mScene->mMeshes[m];
-         std::vector<float> normals(3 * mesh->mNumVertices);
-         if (mesh->HasNormals())
-         {
-            for (unsigned int k = 0; k < mesh->mNumVertices; ++k)
-            {
-               normals[k * 3] = mesh->mNormals[k].x;
-               normals[k * 3 + 1] = mesh->mNormals[k].y;
-               normals[k * 3 + 2] = mesh->mNormals[k].z;
-            }
-         }
-         const int size = 3 * sizeof(float)*mesh->mNumVertices;
-         const void* data = normals.data();
-         glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-         offset += size;
-      }
-      glEnableVertexAttribArray(normal_loc);
-      glVertexAttribPointer(normal_loc, 3, GL_FLOAT, 0, 0, 0);
+   VertexPacking::PackedVertices packed;
+   VertexPacking::Pack(streams, totalNumVerts, ranges, meshdata.mVertexLayout, packed);
+   meshdata.mVertexLayout = packed.Format;
+   for (size_t s = 0; s < sourceMeshes.size(); s++)
+   {
+      meshdata.mSubmesh[sourceMeshes[s]].mDequant = packed.Submeshes[s];
    }
+   for (int m = 0; m < numSubmeshes; m++)
+   {
+      meshdata.mSubmesh[m] = meshdata.mSubmesh[firstCopy[m]];
+   }
+
+   //Buffer vertices
+   glGenBuffers(1, &meshdata.mVboVerts);
+   glBindBuffer(GL_ARRAY_BUFFER, meshdata.mVboVerts);
+   glBufferData(GL_ARRAY_BUFFER, packed.Data.size(), packed.Data.data(), GL_STATIC_DRAW);
+   VertexPacking::SetupAttributes(packed.Format, pos_loc, tex_coord_loc, normal_loc);
 
    glBindVertexArray(0);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -8,11 +8,14 @@
 #include "assimp/Scene.h"
 #include "assimp/PostProcess.h"
 #include "assimp/Importer.hpp"
+#include "MeshImporter.h"
+#include "VertexPacking.h"
 
 struct SubMeshData {
    unsigned int mNumIndices;
    unsigned int mBaseIndex;
    unsigned int mBaseVertex;
+   VertexPacking::Dequant mDequant; //identity unless mVertexLayout has half positions
 
    SubMeshData() : mNumIndices(0), mBaseIndex(0), mBaseVertex(0) {}
    void DrawSubmesh();
@@ -21,21 +24,26 @@ struct SubMeshData {
 struct MeshData
 {
    unsigned int mVao;
-   unsigned int mVboVerts;
-   unsigned int mVboNormals;
-   unsigned int mVboTexCoords;
+   unsigned int mVboVerts; //interleaved, in mVertexLayout
    unsigned int mIndexBuffer;
    float mScaleFactor; //TODO replace with bounding box
 
    unsigned int mImportFlags = aiProcessPreset_TargetRealtime_Quality | aiProcess_PreTransformVertices;
+   VertexPacking::Layout mVertexLayout = VertexPacking::GetCompatibleLayout();
 
-   const aiScene* mScene;
+   const aiScene* mScene; //points into mSceneSnapshot
+   MeshImporter::Scene mSceneSnapshot;
    aiVector3D mBbMin, mBbMax;
 
+   //One per scene mesh. Meshes with the same contents (see MeshInstances) share one buffered range.
    std::vector<SubMeshData> mSubmesh;
    std::string mFilename;
 
-   MeshData() : mVao(-1), mVboVerts(-1), mVboNormals(-1), mVboTexCoords(-1), mIndexBuffer(-1), mScaleFactor(0.0f), mScene(nullptr) {}
+   //Vertices and indices as buffered, and as they would be without sharing
+   size_t mNumVerts = 0, mNumIndices = 0;
+   size_t mNumFlatVerts = 0, mNumFlatIndices = 0;
+
+   MeshData() : mVao(-1), mVboVerts(-1), mIndexBuffer(-1), mScaleFactor(0.0f), mScene(nullptr) {}
    void FreeMeshData();
    ~MeshData();
 
@@ -44,6 +52,8 @@ struct MeshData
 };
 
 MeshData LoadMesh(const std::string& pFile);
+//Imports the files in parallel through MeshImporter, then buffers them on the calling thread
+std::vector<MeshData> LoadMeshes(const std::vector<std::string>& files);
 bool ValidMeshFilename(const std::string& fname);
 void SetMeshDir(std::string dir);
 std::string GetMeshDir();
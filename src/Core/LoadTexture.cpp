@@ -1,6 +1,10 @@
 #include "LoadTexture.h"
 #include "FreeImage.h"
+#include "StagingPool.h"
+#include "TextureCache.h"
+#include "MemoryBudget.h"
 #include <glm/glm.hpp>
+#include <cstring>
 #include <iostream>
 
 //static std::string TextureDir = "";
@@ -22,43 +26,74 @@ bool ValidTextureFilename(const std::string& fname0)
    return true;
 }
 
-GLuint LoadTexture(const std::string& fname0)
+GLuint CreateTexture2D(const ImageData& image)
 {
-   std::string fname = fname0;
-
    GLuint tex_id=-1;
-
-   FIBITMAP* tempImg = FreeImage_Load(FreeImage_GetFileType(fname.c_str(), 0), fname.c_str());
-   FIBITMAP* img = FreeImage_ConvertTo32Bits(tempImg);
-
-   FreeImage_Unload(tempImg);
-   if (tempImg == nullptr || img == nullptr)
+   if (!image.Valid())
    {
-      FreeImage_Unload(img);
-      std::cout << "FreeImage can't load image "<<fname<<std::endl;
       return tex_id;
    }
 
-   GLuint w = FreeImage_GetWidth(img);
-   GLuint h = FreeImage_GetHeight(img);
-   GLuint scanW = FreeImage_GetPitch(img);
+   const GLuint w = image.Width;
+   const GLuint h = image.Height;
+   const bool cpuMips = image.Levels > 1;
 
-   GLubyte* byteImg = new GLubyte[h*scanW];
-   FreeImage_ConvertToRawBits(byteImg, img, scanW, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, FALSE);
-   FreeImage_Unload(img);
-   
    glCreateTextures(GL_TEXTURE_2D, 1, &tex_id);
-   int levels = 1 + floor(log2(glm::max(w,h)));
-   glTextureStorage2D(tex_id, levels, GL_RGBA8, w, h);
-   glTextureSubImage2D(tex_id, 0, 0, 0, w, h, GL_BGRA, GL_UNSIGNED_BYTE, byteImg);
+   if (image.CompressedFormat != 0)
+   {
+      //Baked blocks always come with their whole mip chain
+      glTextureStorage2D(tex_id, image.Levels, image.CompressedFormat, w, h);
+      for (GLuint level = 0; level < image.Levels; level++)
+      {
+         glCompressedTextureSubImage2D(tex_id, level, 0, 0, glm::max(w >> level, 1u), glm::max(h >> level, 1u), image.CompressedFormat,
+            static_cast<GLsizei>(GetLevelSize(image, level)), image.Pixels.data() + GetLevelOffset(image, level));
+      }
+   }
+   else
+   {
+      const GLuint levels = GetMipLevels(w, h);
+      glTextureStorage2D(tex_id, levels, GL_RGBA8, w, h);
+      for (GLuint level = 0; level < (cpuMips ? image.Levels : 1); level++)
+      {
+         glTextureSubImage2D(tex_id, level, 0, 0, glm::max(w >> level, 1u), glm::max(h >> level, 1u), GL_BGRA, GL_UNSIGNED_BYTE,
+            image.Pixels.data() + GetMipOffset(w, h, level));
+      }
+   }
+   //Storage of the whole chain, whether the levels came from the CPU or not
+   const size_t bytes = image.CompressedFormat != 0 ? GetLevelOffset(image, image.Levels) : GetMipOffset(w, h, GetMipLevels(w, h));
+   MemoryBudget::TrackGlObject(GL_TEXTURE, tex_id, int64_t(bytes), "Textures");
+
    glTextureParameterf(tex_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
    glTextureParameterf(tex_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
    glTextureParameterf(tex_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
    glTextureParameterf(tex_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-   glGenerateTextureMipmap(tex_id);
+   if (!cpuMips && image.CompressedFormat == 0)
+   {
+      glGenerateTextureMipmap(tex_id);
+   }
 
-   delete [] byteImg;
+   return tex_id;
+}
 
+void DeleteTexture(GLuint& tex)
+{
+   if (tex != 0 && tex != GLuint(-1))
+   {
+      MemoryBudget::UntrackGlObject(GL_TEXTURE, tex);
+      glDeleteTextures(1, &tex);
+   }
+   tex = 0;
+}
+
+GLuint LoadTexture(const std::string& fname0)
+{
+   ImageData image;
+   if (!TextureCache::Load(fname0, image) && !DecodeImage(fname0, image))
+   {
+      return -1;
+   }
+   GLuint tex_id = CreateTexture2D(image);
+   ReleaseImage(image);
    return tex_id;
 }
 
@@ -73,14 +108,14 @@ GLuint LoadSkybox(const std::string& fname0)
    std::string fname = fname0;
    GLuint tex_id;
 
-   FIBITMAP* tempImg = FreeImage_Load(FreeImage_GetFileType(fname.c_str(), 0), fname.c_str());
-   FIBITMAP* img = FreeImage_ConvertTo32Bits(tempImg);
-
-   FreeImage_Unload(tempImg);
+   ImageData img;
+   if (!DecodeImage(fname, img, false))
+   {
+      return -1;
+   }
 
-   GLuint w = FreeImage_GetWidth(img);
-   GLuint h = FreeImage_GetHeight(img);
-   GLuint scanW = FreeImage_GetPitch(img);
+   GLuint w = img.Width;
+   GLuint h = img.Height;
 
    //TODO: handle case where h > w (vertical cross format)
 
@@ -90,8 +125,6 @@ GLuint LoadSkybox(const std::string& fname0)
    //+x, -x, +y, -y, +z, -z
    int left[6] =     {2*face_w,  0,          face_w,     face_w,     face_w,     3*face_w};
    int top[6] =      {face_h,    face_h,     0,          2*face_h,   face_h,     face_h};
-   int right[6] =    {3*face_w,  face_w,     2*face_w,   2*face_w,   2*face_w,   4*face_w};
-   int bottom[6] =   {2*face_h,  2*face_h,   face_h,     3*face_h,   2*face_h,   2*face_h};
 
    glGenTextures(1, &tex_id);
    glBindTexture(GL_TEXTURE_CUBE_MAP, tex_id);
@@ -100,24 +133,34 @@ GLuint LoadSkybox(const std::string& fname0)
    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+   //One staging buffer reused for every face and its mip chain
+   ImageData face;
+   face.Width = face_w;
+   face.Height = face_h;
+   face.Pitch = face_w*4;
+   face.Pixels = StagingPool::Get().Acquire(GetMipOffset(face_w, face_h, GetMipLevels(face_w, face_h)));
+
    for (int i = 0; i<6; i++)
    {
-      FIBITMAP* faceimg = FreeImage_Copy(img, left[i], top[i], right[i], bottom[i]);
-
-      GLuint face_scanW = FreeImage_GetPitch(faceimg);
-
-      GLubyte* byteImg = new GLubyte[face_h*face_scanW];
-      FreeImage_ConvertToRawBits(byteImg, faceimg, face_scanW, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE); //last arg FALSE set origin of the texture to the lower left
-      FreeImage_Unload(faceimg);
-
-      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, face_w, face_h, 0, GL_BGRA, GL_UNSIGNED_BYTE, byteImg);
-
-      delete [] byteImg;
+      //Faces are uploaded top-down, the decoded image is bottom-up
+      for (int y = 0; y < face_h; y++)
+      {
+         const unsigned char* src = img.Pixels.data() + size_t(h - 1 - (top[i] + y))*img.Pitch + size_t(left[i])*4;
+         memcpy(face.Pixels.data() + size_t(y)*face.Pitch, src, face.Pitch);
+      }
+      BuildMipChain(face);
+
+      for (unsigned int level = 0; level < face.Levels; level++)
+      {
+         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGBA, glm::max(face_w >> level, 1), glm::max(face_h >> level, 1), 0,
+            GL_BGRA, GL_UNSIGNED_BYTE, face.Pixels.data() + GetMipOffset(face_w, face_h, level));
+      }
    }
-   FreeImage_Unload(img);
+   MemoryBudget::TrackGlObject(GL_TEXTURE, tex_id, 6 * int64_t(GetMipOffset(face_w, face_h, face.Levels)), "Textures");
+   ReleaseImage(face);
+   ReleaseImage(img);
 
    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
-   glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
    return tex_id;
 }
 
@@ -2,10 +2,52 @@
 #define __LOADTEXTURE_H__
 
 #include <string>
+#include <vector>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "GL/glew.h"
 #include "GL/gl.h"
 
+//Decoded 32 bit BGRA image, rows bottom-up as FreeImage stores them.
+//Levels are tightly packed one after the other, each half the size of the previous one
+//(rounded down, at least 1). Produced without a GL context, so decoding can run on worker threads.
+struct ImageData
+{
+   unsigned int Width = 0;
+   unsigned int Height = 0;
+   unsigned int Pitch = 0; //bytes per row of level 0, always Width*4
+   unsigned int Levels = 0;
+   GLenum CompressedFormat = 0; //0: BGRA8 pixels, else the GL format of the blocks in Pixels
+   std::vector<unsigned char> Pixels; //from StagingPool::Get(), hand back with ReleaseImage()
+
+   bool Valid() const { return !Pixels.empty(); }
+};
+
+//Decode stage, DecodeImage.cpp: no GL calls, so it runs on loader threads and in tools without a context
+
+//Number of levels of a full mip chain
+unsigned int GetMipLevels(unsigned int w, unsigned int h);
+//Byte offset of a level inside the Pixels of an uncompressed image
+size_t GetMipOffset(unsigned int w, unsigned int h, unsigned int level);
+//Byte size and offset of a level inside ImageData::Pixels, for pixels and blocks alike
+size_t GetLevelSize(const ImageData& image, unsigned int level);
+size_t GetLevelOffset(const ImageData& image, unsigned int level);
+
+//Decode with FreeImage into pooled staging memory. With mips the full chain is built on the CPU.
+bool DecodeImage(const std::string& fname, ImageData& image, bool mips = true);
+//Fill levels 1.. of an image from level 0 with a 2x2 box filter (SSE2 where available)
+void BuildMipChain(ImageData& image);
+//Return the pixels of an image to the staging pool
+void ReleaseImage(ImageData& image);
+
+//Repeating texture from a decoded image: RGBA8, mipmapped on the GPU if the image has no
+//CPU mip chain, or the compressed blocks of a TextureCache as they are. Returns -1 for an invalid image.
+GLuint CreateTexture2D(const ImageData& image);
+//Delete a texture made by CreateTexture2D or LoadTexture and drop it from the MemoryBudget, tex becomes 0
+void DeleteTexture(GLuint& tex);
+
+//Prefers a current TextureCache of fname over decoding it
 GLuint LoadTexture(const std::string& fname);
 bool SaveTexture(const std::string& fname, GLuint tex);
 GLuint LoadSkybox(const std::string& fname);
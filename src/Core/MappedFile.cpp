@@ -0,0 +1,142 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+   Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+   *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+   if (this != &other)
+   {
+      Close();
+      std::swap(mData, other.mData);
+      std::swap(mSize, other.mSize);
+#ifdef _WIN32
+      std::swap(mFile, other.mFile);
+      std::swap(mMapping, other.mMapping);
+#else
+      std::swap(mFd, other.mFd);
+#endif
+   }
+   return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filename)
+{
+   Close();
+
+   HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (file == INVALID_HANDLE_VALUE) return false;
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+   {
+      CloseHandle(file);
+      return false;
+   }
+
+   HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (mapping == nullptr)
+   {
+      CloseHandle(file);
+      return false;
+   }
+
+   void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (data == nullptr)
+   {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+
+   mFile = file;
+   mMapping = mapping;
+   mData = data;
+   mSize = static_cast<size_t>(size.QuadPart);
+   return true;
+}
+
+void MappedFile::Close()
+{
+   if (mData != nullptr)
+   {
+      UnmapViewOfFile(mData);
+      mData = nullptr;
+   }
+   if (mMapping != nullptr)
+   {
+      CloseHandle(mMapping);
+      mMapping = nullptr;
+   }
+   if (mFile != nullptr)
+   {
+      CloseHandle(mFile);
+      mFile = nullptr;
+   }
+   mSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename)
+{
+   Close();
+
+   int fd = open(filename.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size == 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (data == MAP_FAILED)
+   {
+      close(fd);
+      return false;
+   }
+
+   mFd = fd;
+   mData = data;
+   mSize = static_cast<size_t>(st.st_size);
+   return true;
+}
+
+void MappedFile::Close()
+{
+   if (mData != nullptr)
+   {
+      munmap(mData, mSize);
+      mData = nullptr;
+   }
+   if (mFd >= 0)
+   {
+      close(mFd);
+      mFd = -1;
+   }
+   mSize = 0;
+}
+
+#endif
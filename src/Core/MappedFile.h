@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//Read-only memory mapping of a whole file.
+//The mapping stays valid until Close() is called or the object is destroyed.
+class MappedFile
+{
+   public:
+      MappedFile() = default;
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+      MappedFile(MappedFile&& other) noexcept;
+      MappedFile& operator=(MappedFile&& other) noexcept;
+
+      bool Open(const std::string& filename);
+      void Close();
+
+      bool IsOpen() const { return mData != nullptr; }
+      const unsigned char* Data() const { return static_cast<const unsigned char*>(mData); }
+      size_t Size() const { return mSize; }
+
+   private:
+      void* mData = nullptr;
+      size_t mSize = 0;
+
+#ifdef _WIN32
+      void* mFile = nullptr;     //HANDLE
+      void* mMapping = nullptr;  //HANDLE
+#else
+      int mFd = -1;
+#endif
+};
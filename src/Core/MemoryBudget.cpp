@@ -0,0 +1,132 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "imgui.h"
+
+namespace MemoryBudget
+{
+   namespace
+   {
+      struct GlObject
+      {
+         std::string Subsystem;
+         int64_t Bytes = 0;
+      };
+
+      std::mutex mutex;
+      std::map<std::string, Subsystem> subsystems;
+      Usage totals[NumPools];
+      std::map<std::pair<GLenum, GLuint>, GlObject> gl_objects;
+
+      //Caller holds the mutex
+      void AddLocked(const std::string& subsystem, Pool pool, int64_t bytes)
+      {
+         Subsystem& s = subsystems[subsystem];
+         s.Name = subsystem;
+
+         Usage& usage = s.Pools[pool];
+         usage.Current += bytes;
+         usage.Peak = std::max(usage.Peak, usage.Current);
+
+         totals[pool].Current += bytes;
+         totals[pool].Peak = std::max(totals[pool].Peak, totals[pool].Current);
+      }
+   }
+}
+
+void MemoryBudget::Add(const std::string& subsystem, Pool pool, int64_t bytes)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   AddLocked(subsystem, pool, bytes);
+}
+
+void MemoryBudget::TrackGlObject(GLenum type, GLuint name, int64_t bytes, const std::string& subsystem)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   GlObject& object = gl_objects[{type, name}];
+   if (object.Bytes != 0)
+   {
+      AddLocked(object.Subsystem, Gpu, -object.Bytes);
+   }
+   object.Subsystem = subsystem;
+   object.Bytes = bytes;
+   AddLocked(subsystem, Gpu, bytes);
+}
+
+void MemoryBudget::UntrackGlObject(GLenum type, GLuint name)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   auto iter = gl_objects.find({type, name});
+   if (iter == gl_objects.end())
+   {
+      return;
+   }
+   AddLocked(iter->second.Subsystem, Gpu, -iter->second.Bytes);
+   gl_objects.erase(iter);
+}
+
+MemoryBudget::Usage MemoryBudget::GetTotal(Pool pool)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   return totals[pool];
+}
+
+MemoryBudget::Usage MemoryBudget::GetUsage(const std::string& subsystem, Pool pool)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   auto iter = subsystems.find(subsystem);
+   return iter != subsystems.end() ? iter->second.Pools[pool] : Usage();
+}
+
+std::vector<MemoryBudget::Subsystem> MemoryBudget::GetSubsystems()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   std::vector<Subsystem> result;
+   for (const auto& s : subsystems)
+   {
+      result.push_back(s.second);
+   }
+   return result;
+}
+
+void MemoryBudget::DrawGui()
+{
+   const std::vector<Subsystem> list = GetSubsystems();
+   const Usage total[NumPools] = {GetTotal(Cpu), GetTotal(Gpu)};
+   const double MB = 1.0 / (1024.0 * 1024.0);
+
+   const ImGuiTableFlags flags = ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_RowBg;
+   if (ImGui::BeginTable("Memory Table", 5, flags))
+   {
+      ImGui::TableSetupColumn("Subsystem", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("CPU (MB)", ImGuiTableColumnFlags_None);
+      ImGui::TableSetupColumn("CPU peak", ImGuiTableColumnFlags_None);
+      ImGui::TableSetupColumn("GPU (MB)", ImGuiTableColumnFlags_None);
+      ImGui::TableSetupColumn("GPU peak", ImGuiTableColumnFlags_None);
+      ImGui::TableHeadersRow();
+
+      auto row = [MB](const char* name, const Usage* pools)
+      {
+         ImGui::TableNextRow();
+         ImGui::TableSetColumnIndex(0);
+         ImGui::Text("%s", name);
+         for (int pool = 0; pool < NumPools; pool++)
+         {
+            ImGui::TableSetColumnIndex(1 + 2 * pool);
+            ImGui::Text("%.2f", pools[pool].Current * MB);
+            ImGui::TableSetColumnIndex(2 + 2 * pool);
+            ImGui::Text("%.2f", pools[pool].Peak * MB);
+         }
+      };
+
+      for (const Subsystem& s : list)
+      {
+         row(s.Name.c_str(), s.Pools);
+      }
+      row("Total", total);
+      ImGui::EndTable();
+   }
+}
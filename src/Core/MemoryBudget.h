@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+//Memory accounting by subsystem ("Meshes", "Textures", "Animation", ...).
+//CPU bytes are reported by the code owning them. GPU bytes are counted per GL object: Buffer::Init
+//and CreateTexture2D track what they create, and the size is remembered by object name so
+//whoever deletes it only has to untrack the name. Every counter keeps its live value and its
+//high-water mark. Thread safe, loads report from worker threads.
+namespace MemoryBudget
+{
+   enum Pool
+   {
+      Cpu,
+      Gpu,
+      NumPools
+   };
+
+   struct Usage
+   {
+      int64_t Current = 0;
+      int64_t Peak = 0;
+   };
+
+   struct Subsystem
+   {
+      std::string Name;
+      Usage Pools[NumPools];
+   };
+
+   //Negative bytes release
+   void Add(const std::string& subsystem, Pool pool, int64_t bytes);
+
+   template <typename T>
+   int64_t GetBytes(const std::vector<T>& v)
+   {
+      return int64_t(v.capacity() * sizeof(T));
+   }
+
+   //type is GL_BUFFER or GL_TEXTURE. Tracking a name again replaces its previous size.
+   void TrackGlObject(GLenum type, GLuint name, int64_t bytes, const std::string& subsystem);
+   void UntrackGlObject(GLenum type, GLuint name);
+
+   Usage GetTotal(Pool pool);
+   Usage GetUsage(const std::string& subsystem, Pool pool);
+   std::vector<Subsystem> GetSubsystems(); //sorted by name
+
+   //Table of the subsystems and totals, inside the caller's ImGui window
+   void DrawGui();
+}
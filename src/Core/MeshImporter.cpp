@@ -0,0 +1,78 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+MeshImporter::MeshImporter(unsigned int maxConcurrent) :
+   mMaxConcurrent(maxConcurrent != 0 ? maxConcurrent : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+std::unique_ptr<Assimp::Importer> MeshImporter::Acquire()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   mReleased.wait(lock, [this]() { return !mFree.empty() || mNumCreated < mMaxConcurrent; });
+
+   if (!mFree.empty())
+   {
+      std::unique_ptr<Assimp::Importer> importer = std::move(mFree.back());
+      mFree.pop_back();
+      return importer;
+   }
+
+   //Importers are created lazily, so the pool only grows as wide as the imports actually overlap
+   mNumCreated++;
+   lock.unlock();
+   return std::make_unique<Assimp::Importer>();
+}
+
+void MeshImporter::Release(std::unique_ptr<Assimp::Importer> importer)
+{
+   {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFree.push_back(std::move(importer));
+   }
+   mReleased.notify_one();
+}
+
+MeshImporter::Result MeshImporter::Import(const std::string& filename, unsigned int flags)
+{
+   Result result;
+   std::unique_ptr<Assimp::Importer> importer = Acquire();
+
+   if (importer->ReadFile(filename, flags) != nullptr)
+   {
+      //The importer gives up the scene, it is freed when the last snapshot goes away
+      result.mScene = Scene(importer->GetOrphanedScene());
+   }
+   else
+   {
+      result.mError = importer->GetErrorString();
+   }
+
+   Release(std::move(importer));
+   return result;
+}
+
+void MeshImporter::ImportAsync(const std::string& filename, unsigned int flags, Result* pResult, TaskGroup& group, ThreadPool& pool)
+{
+   pool.Submit([this, filename, flags, pResult]()
+   {
+      *pResult = Import(filename, flags);
+   }, &group);
+}
+
+bool MeshImporter::IsExtensionSupported(const std::string& ext)
+{
+   std::unique_ptr<Assimp::Importer> importer = Acquire();
+   const bool supported = importer->IsExtensionSupported(ext);
+   Release(std::move(importer));
+   return supported;
+}
+
+MeshImporter& MeshImporter::Get()
+{
+   static MeshImporter* importer = new MeshImporter();
+   return *importer;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "assimp/Importer.hpp"
+#include "assimp/Scene.h"
+#include "ThreadPool.h"
+
+//Assimp import service, safe to call from any thread.
+//An Assimp::Importer can run one import at a time and owns the scene it returns, so every import
+//borrows an importer from a pool and takes the scene away from it. Results are immutable scene
+//snapshots owned by shared_ptr: freeing one never touches another import. At most maxConcurrent
+//imports run at once, further callers block until an importer is returned.
+class MeshImporter
+{
+   public:
+      using Scene = std::shared_ptr<const aiScene>;
+
+      struct Result
+      {
+         Scene mScene;
+         std::string mError; //Assimp's message when mScene is null
+
+         bool Valid() const { return mScene != nullptr; }
+      };
+
+      //maxConcurrent == 0 allows one import per hardware thread
+      explicit MeshImporter(unsigned int maxConcurrent = 0);
+
+      MeshImporter(const MeshImporter&) = delete;
+      MeshImporter& operator=(const MeshImporter&) = delete;
+
+      //Blocking import on the calling thread
+      Result Import(const std::string& filename, unsigned int flags);
+
+      //Imports on a pool worker. *pResult must stay alive until group is done.
+      void ImportAsync(const std::string& filename, unsigned int flags, Result* pResult, TaskGroup& group,
+         ThreadPool& pool = ThreadPool::Get());
+
+      bool IsExtensionSupported(const std::string& ext);
+
+      unsigned int GetMaxConcurrent() const { return mMaxConcurrent; }
+
+      //Shared service, never destroyed like ThreadPool::Get()
+      static MeshImporter& Get();
+
+   private:
+      std::unique_ptr<Assimp::Importer> Acquire();
+      void Release(std::unique_ptr<Assimp::Importer> importer);
+
+      const unsigned int mMaxConcurrent;
+
+      std::mutex mMutex;
+      std::condition_variable mReleased;
+      std::vector<std::unique_ptr<Assimp::Importer>> mFree;
+      unsigned int mNumCreated = 0;
+};
@@ -0,0 +1,162 @@
+#include "MeshInstances.h"
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+   //FNV-1a over everything a submesh buffers
+   uint64_t HashBytes(uint64_t h, const void* data, size_t size)
+   {
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; i++)
+      {
+         h = (h ^ p[i]) * 1099511628211ull;
+      }
+      return h;
+   }
+
+   uint64_t HashMesh(const aiMesh* mesh)
+   {
+      uint64_t h = 14695981039346656037ull;
+      h = HashBytes(h, &mesh->mMaterialIndex, sizeof(mesh->mMaterialIndex));
+      h = HashBytes(h, &mesh->mNumVertices, sizeof(mesh->mNumVertices));
+      h = HashBytes(h, &mesh->mNumFaces, sizeof(mesh->mNumFaces));
+      if (mesh->HasPositions())
+      {
+         h = HashBytes(h, mesh->mVertices, sizeof(aiVector3D) * mesh->mNumVertices);
+      }
+      if (mesh->HasNormals())
+      {
+         h = HashBytes(h, mesh->mNormals, sizeof(aiVector3D) * mesh->mNumVertices);
+      }
+      if (mesh->HasTextureCoords(0))
+      {
+         h = HashBytes(h, mesh->mTextureCoords[0], sizeof(aiVector3D) * mesh->mNumVertices);
+      }
+      for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+      {
+         h = HashBytes(h, mesh->mFaces[f].mIndices, sizeof(unsigned int) * mesh->mFaces[f].mNumIndices);
+      }
+      return h;
+   }
+
+   //Same hash is not enough: compare the contents
+   bool SameMesh(const aiMesh* a, const aiMesh* b)
+   {
+      if (a->mMaterialIndex != b->mMaterialIndex || a->mNumVertices != b->mNumVertices || a->mNumFaces != b->mNumFaces ||
+         a->HasPositions() != b->HasPositions() || a->HasNormals() != b->HasNormals() || a->HasTextureCoords(0) != b->HasTextureCoords(0))
+      {
+         return false;
+      }
+
+      const size_t bytes = sizeof(aiVector3D) * a->mNumVertices;
+      if ((a->HasPositions() && memcmp(a->mVertices, b->mVertices, bytes) != 0) ||
+         (a->HasNormals() && memcmp(a->mNormals, b->mNormals, bytes) != 0) ||
+         (a->HasTextureCoords(0) && memcmp(a->mTextureCoords[0], b->mTextureCoords[0], bytes) != 0))
+      {
+         return false;
+      }
+
+      for (unsigned int f = 0; f < a->mNumFaces; f++)
+      {
+         const aiFace& fa = a->mFaces[f];
+         const aiFace& fb = b->mFaces[f];
+         if (fa.mNumIndices != fb.mNumIndices || memcmp(fa.mIndices, fb.mIndices, sizeof(unsigned int) * fa.mNumIndices) != 0)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   //aiMatrix4x4 is row-major, glm column-major
+   glm::mat4 ToGlm(const aiMatrix4x4& m)
+   {
+      return glm::transpose(glm::mat4(m.a1, m.a2, m.a3, m.a4,
+         m.b1, m.b2, m.b3, m.b4,
+         m.c1, m.c2, m.c3, m.c4,
+         m.d1, m.d2, m.d3, m.d4));
+   }
+
+   void GatherNode(const aiNode* node, const glm::mat4& parent, std::vector<MeshInstances::Reference>& refs)
+   {
+      const glm::mat4 global = parent * ToGlm(node->mTransformation);
+      for (unsigned int n = 0; n < node->mNumMeshes; n++)
+      {
+         refs.push_back({node->mMeshes[n], global});
+      }
+      for (unsigned int c = 0; c < node->mNumChildren; c++)
+      {
+         GatherNode(node->mChildren[c], global, refs);
+      }
+   }
+}
+
+namespace MeshInstances
+{
+   std::vector<unsigned int> FindDuplicates(const aiMesh* const* meshes, unsigned int numMeshes)
+   {
+      std::unordered_multimap<uint64_t, unsigned int> byHash;
+      std::vector<unsigned int> first(numMeshes);
+      for (unsigned int m = 0; m < numMeshes; m++)
+      {
+         const uint64_t hash = HashMesh(meshes[m]);
+         first[m] = m;
+         auto range = byHash.equal_range(hash);
+         for (auto it = range.first; it != range.second; ++it)
+         {
+            if (SameMesh(meshes[it->second], meshes[m]))
+            {
+               first[m] = it->second;
+               break;
+            }
+         }
+         if (first[m] == m)
+         {
+            byHash.emplace(hash, m);
+         }
+      }
+      return first;
+   }
+
+   void GatherReferences(const aiNode* node, std::vector<Reference>& refs)
+   {
+      if (node != nullptr)
+      {
+         GatherNode(node, glm::mat4(1.0f), refs);
+      }
+   }
+
+   void Gather(const aiMesh* const* meshes, unsigned int numMeshes, const std::vector<Reference>& refs, Instances& out)
+   {
+      out = Instances();
+      const std::vector<unsigned int> first = FindDuplicates(meshes, numMeshes);
+
+      //Source mesh -> its slot in out, in order of first reference
+      std::vector<int> slot(numMeshes, -1);
+      std::vector<std::vector<glm::mat4>> xforms;
+      for (const Reference& ref : refs)
+      {
+         const aiMesh* mesh = meshes[ref.Mesh];
+         out.NumFlatVerts += mesh->mNumVertices;
+         out.NumFlatIndices += size_t(mesh->mNumFaces) * 3;
+
+         const unsigned int source = first[ref.Mesh];
+         if (slot[source] == -1)
+         {
+            slot[source] = int(out.SourceMeshes.size());
+            out.SourceMeshes.push_back(source);
+            xforms.emplace_back();
+         }
+         xforms[slot[source]].push_back(ref.Xform);
+      }
+
+      for (const std::vector<glm::mat4>& group : xforms)
+      {
+         out.FirstXform.push_back(unsigned(out.Xforms.size()));
+         out.NumXforms.push_back(unsigned(group.size()));
+         out.Xforms.insert(out.Xforms.end(), group.begin(), group.end());
+      }
+   }
+}
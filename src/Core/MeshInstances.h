@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "assimp/mesh.h"
+#include "assimp/scene.h"
+
+//Repeated geometry in imported scenes.
+//
+//Meshes are content hashed (FNV-1a) and compared byte for byte on a match, so copies Assimp split
+//into separate aiMeshes are found as well as meshes the node hierarchy references several times.
+//FindDuplicates() maps every mesh to the first one with the same contents; Gather() groups the
+//node references of a scene by that mesh, one transform per instance. Needs no GL context.
+namespace MeshInstances
+{
+   //A node's use of a scene mesh, with the node's transform to model space
+   struct Reference
+   {
+      unsigned int Mesh = 0;
+      glm::mat4 Xform = glm::mat4(1.0f);
+   };
+
+   struct Instances
+   {
+      std::vector<unsigned int> SourceMeshes; //first mesh of every group of identical ones
+      std::vector<unsigned int> FirstXform;   //per source mesh, into Xforms
+      std::vector<unsigned int> NumXforms;
+      std::vector<glm::mat4> Xforms;          //grouped by source mesh
+
+      //Vertices and indices with every reference flattened into its own copy
+      size_t NumFlatVerts = 0;
+      size_t NumFlatIndices = 0;
+   };
+
+   //For every mesh, the index of the first mesh with the same contents (its own if there is none)
+   std::vector<unsigned int> FindDuplicates(const aiMesh* const* meshes, unsigned int numMeshes);
+
+   //Every mesh reference of the hierarchy below node, depth first, with parent * node transforms
+   void GatherReferences(const aiNode* node, std::vector<Reference>& refs);
+
+   //Group references by source mesh, in the order the source meshes are first referenced
+   void Gather(const aiMesh* const* meshes, unsigned int numMeshes, const std::vector<Reference>& refs, Instances& out);
+}
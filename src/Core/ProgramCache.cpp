@@ -0,0 +1,296 @@
+#include "ProgramCache.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+   //Keys are file names: 16 hex digits
+   bool ParseKey(const std::string& s, uint64_t& key)
+   {
+      if (s.length() != 16)
+      {
+         return false;
+      }
+      char* end = nullptr;
+      key = std::strtoull(s.c_str(), &end, 16);
+      return end == s.c_str() + s.length();
+   }
+
+   //Write to a temporary file first so a crash never leaves a truncated file behind
+   bool WriteAtomic(const std::string& path, const void* a, size_t aBytes, const void* b, size_t bBytes)
+   {
+      const std::string tmpPath = path + ".tmp";
+      {
+         std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+         out.write(static_cast<const char*>(a), static_cast<std::streamsize>(aBytes));
+         if (bBytes > 0)
+         {
+            out.write(static_cast<const char*>(b), static_cast<std::streamsize>(bBytes));
+         }
+         if (!out)
+         {
+            std::cout << "Couldn't write program cache " << tmpPath << std::endl;
+            return false;
+         }
+      }
+
+      std::error_code ec;
+      fs::rename(tmpPath, path, ec);
+      if (ec)
+      {
+         fs::remove(tmpPath, ec);
+         return false;
+      }
+      return true;
+   }
+}
+
+namespace ProgramCache
+{
+   void Hasher::Add(const void* data, size_t bytes)
+   {
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < bytes; i++)
+      {
+         Value ^= p[i];
+         Value *= 0x100000001b3ull;
+      }
+   }
+
+   void Hasher::Add(uint32_t value)
+   {
+      Add(&value, sizeof(value));
+   }
+
+   void Hasher::Add(const std::string& s)
+   {
+      const uint64_t length = s.length();
+      Add(&length, sizeof(length));
+      Add(s.data(), s.length());
+   }
+
+   bool Cache::Open(const std::string& dir, uint64_t maxBytes)
+   {
+      Flush();
+      mDir.clear();
+      mEntries.clear();
+      mTotalBytes = 0;
+      mClock = 0;
+      mIndexDirty = false;
+      mMaxBytes = maxBytes;
+
+      std::error_code ec;
+      fs::create_directories(dir, ec);
+      if (!fs::is_directory(dir, ec))
+      {
+         std::cout << "Program cache disabled, can't create " << dir << std::endl;
+         return false;
+      }
+      mDir = dir;
+      if (mDir.back() != '/' && mDir.back() != '\\')
+      {
+         mDir += '/';
+      }
+
+      //Last uses from the index. The directory is the truth: entries without a file are
+      //forgotten, files missing from the index are the first to go.
+      std::unordered_map<uint64_t, uint64_t> lastUse;
+      std::ifstream index(mDir + IndexFilename);
+      std::string line;
+      if (std::getline(index, line))
+      {
+         std::istringstream header(line);
+         std::string magic;
+         uint32_t version = 0;
+         if (header >> magic >> version >> mClock && magic == "FNPB" && version == Version)
+         {
+            while (std::getline(index, line))
+            {
+               std::istringstream fields(line);
+               std::string name;
+               uint64_t key, use;
+               if (fields >> name >> use && ParseKey(name, key))
+               {
+                  lastUse[key] = use;
+               }
+            }
+         }
+         else
+         {
+            mClock = 0;
+         }
+      }
+
+      for (const fs::directory_entry& file : fs::directory_iterator(mDir, ec))
+      {
+         uint64_t key;
+         if (!file.is_regular_file(ec) || file.path().extension() != Extension || !ParseKey(file.path().stem().string(), key))
+         {
+            continue;
+         }
+         Entry& entry = mEntries[key];
+         entry.Bytes = file.file_size(ec);
+         auto use = lastUse.find(key);
+         entry.LastUse = use != lastUse.end() ? use->second : 0;
+         mClock = std::max(mClock, entry.LastUse);
+         mTotalBytes += entry.Bytes;
+      }
+
+      //The budget may have shrunk since the last run
+      Evict(0);
+      Flush();
+      return true;
+   }
+
+   std::string Cache::GetPath(uint64_t key) const
+   {
+      char name[17];
+      snprintf(name, sizeof(name), "%016" PRIx64, key);
+      return mDir + name + Extension;
+   }
+
+   bool Cache::Load(uint64_t key, uint32_t& format, std::vector<char>& binary)
+   {
+      auto entry = mEntries.find(key);
+      if (entry == mEntries.end())
+      {
+         return false;
+      }
+
+      std::ifstream in(GetPath(key), std::ios::in | std::ios::binary);
+      Header header {};
+      bool ok = bool(in.read(reinterpret_cast<char*>(&header), sizeof(Header)));
+      ok = ok && header.Magic == Magic && header.Version == Version && header.Key == key && header.Size > 0
+         && header.Size == entry->second.Bytes - sizeof(Header);
+      if (ok)
+      {
+         binary.resize(header.Size);
+         ok = bool(in.read(binary.data(), static_cast<std::streamsize>(header.Size)));
+      }
+      in.close();
+
+      if (!ok)
+      {
+         std::cout << "Dropping damaged program cache " << GetPath(key) << std::endl;
+         binary.clear();
+         Erase(key);
+         return false;
+      }
+
+      //Every program of a launch hits at startup, the index is written once later on
+      format = header.Format;
+      entry->second.LastUse = ++mClock;
+      mIndexDirty = true;
+      return true;
+   }
+
+   bool Cache::Store(uint64_t key, uint32_t format, const std::vector<char>& binary)
+   {
+      if (!IsOpen() || binary.empty())
+      {
+         return false;
+      }
+
+      Header header {};
+      header.Magic = Magic;
+      header.Version = Version;
+      header.Key = key;
+      header.Format = format;
+      header.Size = binary.size();
+      if (!WriteAtomic(GetPath(key), &header, sizeof(Header), binary.data(), binary.size()))
+      {
+         return false;
+      }
+
+      Entry& entry = mEntries[key];
+      mTotalBytes -= entry.Bytes;
+      entry.Bytes = sizeof(Header) + binary.size();
+      entry.LastUse = ++mClock;
+      mTotalBytes += entry.Bytes;
+      mIndexDirty = true;
+
+      Evict(key);
+      Flush();
+      return true;
+   }
+
+   void Cache::Remove(uint64_t key)
+   {
+      if (mEntries.count(key) != 0)
+      {
+         Erase(key);
+         Flush();
+      }
+   }
+
+   bool Cache::Flush()
+   {
+      if (!mIndexDirty || !SaveIndex())
+      {
+         return false;
+      }
+      mIndexDirty = false;
+      return true;
+   }
+
+   void Cache::Evict(uint64_t keep)
+   {
+      while (mTotalBytes > mMaxBytes)
+      {
+         auto oldest = mEntries.end();
+         for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+         {
+            if (it->first != keep && (oldest == mEntries.end() || it->second.LastUse < oldest->second.LastUse))
+            {
+               oldest = it;
+            }
+         }
+         if (oldest == mEntries.end())
+         {
+            break; //only keep is left, a single binary may exceed the budget
+         }
+         Erase(oldest->first);
+      }
+   }
+
+   void Cache::Erase(uint64_t key)
+   {
+      auto entry = mEntries.find(key);
+      if (entry == mEntries.end())
+      {
+         return;
+      }
+      std::error_code ec;
+      fs::remove(GetPath(key), ec);
+      mTotalBytes -= entry->second.Bytes;
+      mEntries.erase(entry);
+      mIndexDirty = true;
+   }
+
+   bool Cache::SaveIndex() const
+   {
+      if (!IsOpen())
+      {
+         return false;
+      }
+
+      std::ostringstream index;
+      index << "FNPB " << Version << " " << mClock << "\n";
+      for (const auto& [key, entry] : mEntries)
+      {
+         char name[17];
+         snprintf(name, sizeof(name), "%016" PRIx64, key);
+         index << name << " " << entry.LastUse << "\n";
+      }
+      const std::string text = index.str();
+      return WriteAtomic(mDir + IndexFilename, text.data(), text.length(), nullptr, 0);
+   }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Disk cache of linked program binaries.
+//
+//A program is keyed by a hash of everything the driver compiles it from: the driver identity and,
+//per stage, the stage type and the fully preprocessed source (includes resolved, code injected).
+//Each binary is its own file, "<key>.progbin", and an index next to them remembers when every
+//entry was last used so the least recently used ones are evicted once the cache outgrows its
+//budget. Hits only touch the index in memory, it is written when binaries are added or dropped,
+//by Flush() and on destruction. No GL calls here: InitShader fetches and uploads the binaries.
+namespace ProgramCache
+{
+   constexpr uint32_t Magic = 0x42504E46; //"FNPB"
+   constexpr uint32_t Version = 1;
+
+   const std::string Extension = ".progbin";
+   const std::string IndexFilename = "index.txt";
+
+   struct Header
+   {
+      uint32_t Magic;
+      uint32_t Version;
+      uint64_t Key;
+      uint32_t Format; //binary format reported by glGetProgramBinary
+      uint32_t Reserved;
+      uint64_t Size; //binary follows the header
+   };
+
+   //64 bit FNV-1a
+   struct Hasher
+   {
+      uint64_t Value = 0xcbf29ce484222325ull;
+
+      void Add(const void* data, size_t bytes);
+      void Add(uint32_t value);
+      //Length first, so ("ab", "c") and ("a", "bc") hash differently
+      void Add(const std::string& s);
+   };
+
+   class Cache
+   {
+   public:
+      Cache() = default;
+      ~Cache() { Flush(); }
+
+      Cache(const Cache&) = delete;
+      Cache& operator=(const Cache&) = delete;
+
+      //Creates dir if needed and indexes the binaries already in it. Returns false if dir can't be used.
+      bool Open(const std::string& dir, uint64_t maxBytes);
+      [[nodiscard]] bool IsOpen() const { return !mDir.empty(); }
+      [[nodiscard]] const std::string& GetDir() const { return mDir; }
+
+      //Binary stored under key, marked as used. False on a miss or a damaged file (which is deleted).
+      bool Load(uint64_t key, uint32_t& format, std::vector<char>& binary);
+      //Replaces any binary under key, then evicts until the cache fits its budget again
+      bool Store(uint64_t key, uint32_t format, const std::vector<char>& binary);
+      //Drops a binary the driver refused
+      void Remove(uint64_t key);
+      //Writes the index if it changed since it was last written
+      bool Flush();
+
+      [[nodiscard]] std::string GetPath(uint64_t key) const;
+      [[nodiscard]] size_t GetNumEntries() const { return mEntries.size(); }
+      [[nodiscard]] uint64_t GetTotalBytes() const { return mTotalBytes; }
+      [[nodiscard]] bool IsIndexDirty() const { return mIndexDirty; }
+
+   private:
+      struct Entry
+      {
+         uint64_t Bytes = 0; //file size, header included
+         uint64_t LastUse = 0; //mClock value, higher is more recent
+      };
+
+      void Evict(uint64_t keep);
+      void Erase(uint64_t key);
+      bool SaveIndex() const;
+
+      std::string mDir;
+      uint64_t mMaxBytes = 0;
+      uint64_t mTotalBytes = 0;
+      uint64_t mClock = 0;
+      bool mIndexDirty = false;
+      std::unordered_map<uint64_t, Entry> mEntries;
+   };
+};
@@ -0,0 +1,60 @@
+#include "StagingPool.h"
+
+StagingPool::StagingPool(size_t maxPooledBytes) : mMaxPooledBytes(maxPooledBytes)
+{
+
+}
+
+StagingPool::Buffer StagingPool::Acquire(size_t bytes)
+{
+   Buffer buffer;
+   {
+      std::lock_guard<std::mutex> lock(mMutex);
+      auto iter = mFree.lower_bound(bytes);
+      if (iter != mFree.end())
+      {
+         buffer = std::move(iter->second);
+         mPooledBytes -= iter->first;
+         mFree.erase(iter);
+      }
+   }
+
+   buffer.resize(bytes);
+   return buffer;
+}
+
+void StagingPool::Release(Buffer&& buffer)
+{
+   const size_t capacity = buffer.capacity();
+   if (capacity == 0)
+   {
+      return;
+   }
+
+   buffer.clear();
+   {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mPooledBytes + capacity <= mMaxPooledBytes)
+      {
+         mPooledBytes += capacity;
+         mFree.emplace(capacity, std::move(buffer));
+         return;
+      }
+   }
+
+   //Pool is full: free it here rather than leaving the memory with the caller
+   Buffer().swap(buffer);
+}
+
+size_t StagingPool::GetPooledBytes() const
+{
+   std::lock_guard<std::mutex> lock(mMutex);
+   return mPooledBytes;
+}
+
+StagingPool& StagingPool::Get()
+{
+   //Enough for a handful of 2k textures with their mip chains
+   static StagingPool* sPool = new StagingPool(size_t(96) << 20);
+   return *sPool;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+//Recycles the large CPU buffers that decoded images pass through on their way to GL.
+//A load touches dozens of multi-megabyte images; handing the same few buffers around
+//avoids a fresh allocation (and page faults) per image. Thread safe.
+class StagingPool
+{
+   public:
+      using Buffer = std::vector<unsigned char>;
+
+      //Buffers beyond maxPooledBytes are freed on Release instead of being kept
+      explicit StagingPool(size_t maxPooledBytes);
+
+      StagingPool(const StagingPool&) = delete;
+      StagingPool& operator=(const StagingPool&) = delete;
+
+      //Buffer of exactly bytes size, from the smallest pooled buffer that fits if any
+      Buffer Acquire(size_t bytes);
+      void Release(Buffer&& buffer);
+
+      size_t GetPooledBytes() const;
+
+      //Shared pool for texture staging. Never destroyed, like ThreadPool::Get().
+      static StagingPool& Get();
+
+   private:
+      const size_t mMaxPooledBytes;
+      mutable std::mutex mMutex;
+      std::multimap<size_t, Buffer> mFree; //capacity -> buffer
+      size_t mPooledBytes = 0;
+};
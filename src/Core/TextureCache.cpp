@@ -0,0 +1,579 @@
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "StagingPool.h"
+#include "ThreadPool.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+   bool SourceStamp(const std::string& sourceFilename, uint64_t& size, int64_t& time)
+   {
+      std::error_code ec;
+      size = fs::file_size(sourceFilename, ec);
+      if (ec)
+      {
+         return false;
+      }
+      time = static_cast<int64_t>(fs::last_write_time(sourceFilename, ec).time_since_epoch().count());
+      return !ec;
+   }
+
+   //Packs fields little endian into a 64 or 128 bit block
+   struct BitWriter
+   {
+      uint64_t Bits[2] = {0, 0};
+      unsigned int Pos = 0;
+
+      void Put(uint64_t value, unsigned int count)
+      {
+         for (unsigned int i = 0; i < count; i++, Pos++)
+         {
+            Bits[Pos >> 6] |= ((value >> i) & 1ull) << (Pos & 63);
+         }
+      }
+   };
+
+   //16 texels of a 4x4 block as RGBA, edge texels repeated for partial blocks
+   void GatherBlock(const unsigned char* bgra, unsigned int w, unsigned int h, unsigned int bx, unsigned int by, glm::vec4 texels[16])
+   {
+      for (unsigned int j = 0; j < 4; j++)
+      {
+         const unsigned int y = glm::min(4*by + j, h - 1);
+         for (unsigned int i = 0; i < 4; i++)
+         {
+            const unsigned int x = glm::min(4*bx + i, w - 1);
+            const unsigned char* p = bgra + (size_t(y)*w + x)*4;
+            texels[4*j + i] = glm::vec4(p[2], p[1], p[0], p[3]);
+         }
+      }
+   }
+
+   //Principal axis of the block colors (power iteration on the covariance), used to pick endpoints
+   void FitEndpoints(const glm::vec4 texels[16], int channels, glm::vec4& lo, glm::vec4& hi)
+   {
+      const glm::vec4 mask = channels == 3 ? glm::vec4(1.0f, 1.0f, 1.0f, 0.0f) : glm::vec4(1.0f);
+
+      glm::vec4 mean(0.0f);
+      for (int i = 0; i < 16; i++)
+      {
+         mean += texels[i]*mask;
+      }
+      mean /= 16.0f;
+
+      glm::mat4 cov(0.0f);
+      for (int i = 0; i < 16; i++)
+      {
+         const glm::vec4 d = (texels[i] - mean)*mask;
+         cov += glm::outerProduct(d, d);
+      }
+
+      glm::vec4 axis = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)*mask;
+      for (int iter = 0; iter < 8; iter++)
+      {
+         axis = cov*axis;
+         const float len = glm::length(axis);
+         if (len < 1e-6f)
+         {
+            axis = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)*mask;
+            break;
+         }
+         axis /= len;
+      }
+
+      float tmin = FLT_MAX;
+      float tmax = -FLT_MAX;
+      for (int i = 0; i < 16; i++)
+      {
+         const float t = glm::dot((texels[i] - mean)*mask, axis);
+         tmin = glm::min(tmin, t);
+         tmax = glm::max(tmax, t);
+      }
+
+      lo = glm::clamp(mean + axis*tmin, 0.0f, 255.0f);
+      hi = glm::clamp(mean + axis*tmax, 0.0f, 255.0f);
+   }
+
+   uint16_t Pack565(const glm::vec4& c)
+   {
+      const int r = int(c.r*31.0f/255.0f + 0.5f);
+      const int g = int(c.g*63.0f/255.0f + 0.5f);
+      const int b = int(c.b*31.0f/255.0f + 0.5f);
+      return uint16_t((glm::clamp(r, 0, 31) << 11) | (glm::clamp(g, 0, 63) << 5) | glm::clamp(b, 0, 31));
+   }
+
+   glm::vec4 Unpack565(uint16_t c)
+   {
+      const int r = (c >> 11) & 31;
+      const int g = (c >> 5) & 63;
+      const int b = c & 31;
+      return glm::vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255.0f);
+   }
+
+   float ColorError(const glm::vec4& a, const glm::vec4& b)
+   {
+      const glm::vec3 d = glm::vec3(a) - glm::vec3(b);
+      return glm::dot(d, d);
+   }
+
+   //Nearest palette entry of every texel in 4 color mode, returns the total error
+   float MatchColors(const glm::vec4 texels[16], uint16_t c0, uint16_t c1, uint32_t& indices)
+   {
+      glm::vec4 palette[4];
+      palette[0] = Unpack565(c0);
+      palette[1] = Unpack565(c1);
+      palette[2] = (2.0f*palette[0] + palette[1])/3.0f;
+      palette[3] = (palette[0] + 2.0f*palette[1])/3.0f;
+
+      float total = 0.0f;
+      indices = 0;
+      for (int i = 0; i < 16; i++)
+      {
+         int best = 0;
+         float bestError = ColorError(texels[i], palette[0]);
+         for (int k = 1; k < 4; k++)
+         {
+            const float e = ColorError(texels[i], palette[k]);
+            if (e < bestError)
+            {
+               bestError = e;
+               best = k;
+            }
+         }
+         indices |= uint32_t(best) << (2*i);
+         total += bestError;
+      }
+      return total;
+   }
+
+   //BC1 color block, always in 4 color mode so it is also valid as the color half of BC3
+   void EncodeColorBlock(const glm::vec4 texels[16], unsigned char* out)
+   {
+      glm::vec4 lo, hi;
+      FitEndpoints(texels, 3, lo, hi);
+
+      uint16_t c0 = Pack565(hi);
+      uint16_t c1 = Pack565(lo);
+      uint32_t indices = 0;
+      float error = FLT_MAX;
+
+      if (c0 != c1)
+      {
+         if (c0 < c1)
+         {
+            std::swap(c0, c1);
+         }
+         error = MatchColors(texels, c0, c1, indices);
+
+         //One least squares refit of the endpoints to the chosen indices
+         static const float weights[4] = {1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f};
+         float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+         glm::vec4 ax(0.0f), bx(0.0f);
+         for (int i = 0; i < 16; i++)
+         {
+            const float a = weights[(indices >> (2*i)) & 3];
+            const float b = 1.0f - a;
+            aa += a*a;
+            ab += a*b;
+            bb += b*b;
+            ax += a*texels[i];
+            bx += b*texels[i];
+         }
+         const float det = aa*bb - ab*ab;
+         if (std::abs(det) > 1e-6f)
+         {
+            const glm::vec4 e0 = glm::clamp((ax*bb - bx*ab)/det, 0.0f, 255.0f);
+            const glm::vec4 e1 = glm::clamp((bx*aa - ax*ab)/det, 0.0f, 255.0f);
+            uint16_t r0 = Pack565(e0);
+            uint16_t r1 = Pack565(e1);
+            if (r0 < r1)
+            {
+               std::swap(r0, r1);
+            }
+            uint32_t refitIndices = 0;
+            if (r0 != r1)
+            {
+               const float refitError = MatchColors(texels, r0, r1, refitIndices);
+               if (refitError < error)
+               {
+                  c0 = r0;
+                  c1 = r1;
+                  indices = refitIndices;
+               }
+            }
+         }
+      }
+
+      out[0] = c0 & 0xFF;
+      out[1] = c0 >> 8;
+      out[2] = c1 & 0xFF;
+      out[3] = c1 >> 8;
+      memcpy(out + 4, &indices, 4);
+   }
+
+   //BC4 style alpha block of BC3, 8 value mode
+   void EncodeAlphaBlock(const glm::vec4 texels[16], unsigned char* out)
+   {
+      float amin = 255.0f;
+      float amax = 0.0f;
+      for (int i = 0; i < 16; i++)
+      {
+         amin = glm::min(amin, texels[i].a);
+         amax = glm::max(amax, texels[i].a);
+      }
+
+      const int a0 = int(amax + 0.5f);
+      const int a1 = int(amin + 0.5f);
+
+      float palette[8];
+      palette[0] = float(a0);
+      palette[1] = float(a1);
+      for (int k = 1; k < 7; k++)
+      {
+         palette[k + 1] = float((7 - k)*a0 + k*a1)/7.0f;
+      }
+
+      BitWriter bits;
+      bits.Put(a0, 8);
+      bits.Put(a1, 8);
+      for (int i = 0; i < 16; i++)
+      {
+         int best = 0;
+         if (a0 != a1)
+         {
+            float bestError = FLT_MAX;
+            for (int k = 0; k < 8; k++)
+            {
+               const float e = std::abs(texels[i].a - palette[k]);
+               if (e < bestError)
+               {
+                  bestError = e;
+                  best = k;
+               }
+            }
+         }
+         bits.Put(best, 3);
+      }
+      memcpy(out, bits.Bits, 8);
+   }
+
+   //BC7 mode 6: one subset, 7 bit RGBA endpoints with a p-bit each, 4 bit indices
+   void EncodeBC7Block(const glm::vec4 texels[16], unsigned char* out)
+   {
+      static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+      glm::vec4 ends[2];
+      FitEndpoints(texels, 4, ends[0], ends[1]);
+
+      //Quantize each endpoint with whichever p-bit reconstructs it best
+      glm::ivec4 q[2];
+      int p[2];
+      glm::vec4 e[2];
+      for (int n = 0; n < 2; n++)
+      {
+         float bestError = FLT_MAX;
+         for (int pbit = 0; pbit < 2; pbit++)
+         {
+            const glm::ivec4 qi = glm::clamp(glm::ivec4(glm::round((ends[n] - float(pbit))/2.0f)), 0, 127);
+            const glm::vec4 rec = glm::vec4(qi*2 + pbit);
+            const glm::vec4 d = rec - ends[n];
+            const float err = glm::dot(d, d);
+            if (err < bestError)
+            {
+               bestError = err;
+               q[n] = qi;
+               p[n] = pbit;
+               e[n] = rec;
+            }
+         }
+      }
+
+      int indices[16];
+      for (int i = 0; i < 16; i++)
+      {
+         int best = 0;
+         float bestError = FLT_MAX;
+         for (int k = 0; k < 16; k++)
+         {
+            const glm::vec4 c = glm::floor((e[0]*float(64 - weights[k]) + e[1]*float(weights[k]) + 32.0f)/64.0f);
+            const glm::vec4 d = c - texels[i];
+            const float err = glm::dot(d, d);
+            if (err < bestError)
+            {
+               bestError = err;
+               best = k;
+            }
+         }
+         indices[i] = best;
+      }
+
+      //The anchor index is stored without its top bit, so it must be below 8
+      if (indices[0] & 8)
+      {
+         std::swap(q[0], q[1]);
+         std::swap(p[0], p[1]);
+         for (int i = 0; i < 16; i++)
+         {
+            indices[i] = 15 - indices[i];
+         }
+      }
+
+      BitWriter bits;
+      bits.Put(1u << 6, 7); //mode 6
+      for (int c = 0; c < 4; c++)
+      {
+         bits.Put(q[0][c], 7);
+         bits.Put(q[1][c], 7);
+      }
+      bits.Put(p[0], 1);
+      bits.Put(p[1], 1);
+      bits.Put(indices[0], 3);
+      for (int i = 1; i < 16; i++)
+      {
+         bits.Put(indices[i], 4);
+      }
+      memcpy(out, bits.Bits, 16);
+   }
+
+   bool IsOpaque(const ImageData& image)
+   {
+      const size_t count = size_t(image.Width)*image.Height;
+      for (size_t i = 0; i < count; i++)
+      {
+         if (image.Pixels[4*i + 3] != 255)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   bool IsImageExtension(const fs::path& path)
+   {
+      std::string ext = path.extension().string();
+      std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+      return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp" || ext == ".dds" || ext == ".tif" || ext == ".tiff";
+   }
+}
+
+namespace TextureCache
+{
+   std::string CachePath(const std::string& sourceFilename)
+   {
+      return sourceFilename + Extension;
+   }
+
+   GLenum GetGlFormat(Format format)
+   {
+      switch (format)
+      {
+         case Format::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+         case Format::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+         case Format::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+         default: return 0;
+      }
+   }
+
+   bool Encode(const ImageData& image, Format format, ImageData& out)
+   {
+      if (!image.Valid() || image.CompressedFormat != 0)
+      {
+         return false;
+      }
+
+      if (format == Format::Auto)
+      {
+         format = IsOpaque(image) ? Format::BC1 : Format::BC3;
+      }
+
+      ReleaseImage(out);
+      out.Width = image.Width;
+      out.Height = image.Height;
+      out.Levels = GetMipLevels(image.Width, image.Height);
+      out.CompressedFormat = GetGlFormat(format);
+      out.Pitch = 0;
+      out.Pixels = StagingPool::Get().Acquire(GetLevelOffset(out, out.Levels));
+
+      const size_t blockBytes = format == Format::BC1 ? 8 : 16;
+
+      //Images decoded without their CPU mip chain get one here
+      ImageData chain;
+      const std::vector<unsigned char>* pixels = &image.Pixels;
+      if (image.Levels < out.Levels)
+      {
+         chain.Width = image.Width;
+         chain.Height = image.Height;
+         chain.Pitch = image.Pitch;
+         chain.Pixels = StagingPool::Get().Acquire(GetMipOffset(image.Width, image.Height, out.Levels));
+         memcpy(chain.Pixels.data(), image.Pixels.data(), size_t(image.Width)*image.Height*4);
+         BuildMipChain(chain);
+         pixels = &chain.Pixels;
+      }
+
+      for (unsigned int level = 0; level < out.Levels; level++)
+      {
+         const unsigned int w = glm::max(image.Width >> level, 1u);
+         const unsigned int h = glm::max(image.Height >> level, 1u);
+         const unsigned int bw = (w + 3)/4;
+         const unsigned int bh = (h + 3)/4;
+
+         const unsigned char* src = pixels->data() + GetMipOffset(image.Width, image.Height, level);
+         unsigned char* dst = out.Pixels.data() + GetLevelOffset(out, level);
+
+         ThreadPool::Get().ParallelFor(0, bh, 4, [&](unsigned int by)
+         {
+            glm::vec4 texels[16];
+            for (unsigned int bx = 0; bx < bw; bx++)
+            {
+               GatherBlock(src, w, h, bx, by, texels);
+               unsigned char* block = dst + (size_t(by)*bw + bx)*blockBytes;
+               switch (format)
+               {
+                  case Format::BC1:
+                     EncodeColorBlock(texels, block);
+                     break;
+                  case Format::BC3:
+                     EncodeAlphaBlock(texels, block);
+                     EncodeColorBlock(texels, block + 8);
+                     break;
+                  default:
+                     EncodeBC7Block(texels, block);
+                     break;
+               }
+            }
+         });
+      }
+
+      ReleaseImage(chain);
+      return true;
+   }
+
+   bool Write(const std::string& sourceFilename, const ImageData& compressed)
+   {
+      Header header {};
+      header.Magic = Magic;
+      header.Version = Version;
+      switch (compressed.CompressedFormat)
+      {
+         case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: header.Format = uint32_t(Format::BC1); break;
+         case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: header.Format = uint32_t(Format::BC3); break;
+         case GL_COMPRESSED_RGBA_BPTC_UNORM: header.Format = uint32_t(Format::BC7); break;
+         default: return false;
+      }
+      header.Width = compressed.Width;
+      header.Height = compressed.Height;
+      header.Levels = compressed.Levels;
+      header.DataSize = GetLevelOffset(compressed, compressed.Levels);
+      if (!SourceStamp(sourceFilename, header.SourceSize, header.SourceTime))
+      {
+         return false;
+      }
+
+      //Write to a temporary file first so a crash never leaves a truncated cache behind
+      const std::string path = CachePath(sourceFilename);
+      const std::string tmpPath = path + ".tmp";
+      {
+         std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+         out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+         out.write(reinterpret_cast<const char*>(compressed.Pixels.data()), static_cast<std::streamsize>(header.DataSize));
+         if (!out)
+         {
+            std::cout << "Couldn't write texture cache " << tmpPath << std::endl;
+            return false;
+         }
+      }
+
+      std::error_code ec;
+      fs::rename(tmpPath, path, ec);
+      if (ec)
+      {
+         fs::remove(tmpPath, ec);
+         return false;
+      }
+      return true;
+   }
+
+   bool Load(const std::string& sourceFilename, ImageData& image)
+   {
+      uint64_t sourceSize;
+      int64_t sourceTime;
+      if (!SourceStamp(sourceFilename, sourceSize, sourceTime))
+      {
+         return false;
+      }
+
+      MappedFile file;
+      if (!file.Open(CachePath(sourceFilename)) || file.Size() < sizeof(Header))
+      {
+         return false;
+      }
+
+      const Header* header = reinterpret_cast<const Header*>(file.Data());
+      const GLenum glFormat = GetGlFormat(Format(header->Format));
+      if (header->Magic != Magic || header->Version != Version || glFormat == 0
+         || header->SourceSize != sourceSize || header->SourceTime != sourceTime)
+      {
+         return false;
+      }
+
+      ImageData loaded;
+      loaded.Width = header->Width;
+      loaded.Height = header->Height;
+      loaded.Levels = header->Levels;
+      loaded.CompressedFormat = glFormat;
+      if (loaded.Width == 0 || loaded.Height == 0 || loaded.Levels != GetMipLevels(loaded.Width, loaded.Height)
+         || header->DataSize != GetLevelOffset(loaded, loaded.Levels) || file.Size() < sizeof(Header) + header->DataSize)
+      {
+         std::cout << "Corrupt texture cache " << CachePath(sourceFilename) << std::endl;
+         return false;
+      }
+
+      //Copied out of the mapping so the image owns its memory like a decoded one
+      ReleaseImage(image);
+      image = std::move(loaded);
+      image.Pixels = StagingPool::Get().Acquire(header->DataSize);
+      memcpy(image.Pixels.data(), file.Data() + sizeof(Header), header->DataSize);
+      return true;
+   }
+
+   bool Bake(const std::string& sourceFilename, Format format)
+   {
+      ImageData image;
+      if (!DecodeImage(sourceFilename, image))
+      {
+         return false;
+      }
+
+      ImageData compressed;
+      const bool ok = Encode(image, format, compressed) && Write(sourceFilename, compressed);
+      ReleaseImage(image);
+      ReleaseImage(compressed);
+
+      if (ok)
+      {
+         std::cout << "Baked texture " << CachePath(sourceFilename) << std::endl;
+      }
+      return ok;
+   }
+
+   int BakeDirectory(const std::string& dir, Format format)
+   {
+      int baked = 0;
+      std::error_code ec;
+      for (const fs::directory_entry& entry : fs::recursive_directory_iterator(dir, ec))
+      {
+         if (entry.is_regular_file() && IsImageExtension(entry.path()) && Bake(entry.path().string(), format))
+         {
+            baked++;
+         }
+      }
+      return baked;
+   }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "LoadTexture.h"
+
+//Baked GPU texture cache.
+//
+//Block compressed copy of a source image with its whole mip chain, in a small container next
+//to the source ("Wall.png" -> "Wall.png.texcache"). The blocks are encoded on the CPU by
+//Bake(), so build machines need no GPU. At load time Load() reads the blocks back and
+//CreateTexture2D() uploads them as they are: no decode, no mip generation, and 4 or 8 bits
+//per texel of VRAM instead of 32. A cache is ignored once its source size or timestamp changes.
+namespace TextureCache
+{
+   constexpr uint32_t Magic = 0x58544E46; //"FNTX"
+   constexpr uint32_t Version = 1;
+
+   const std::string Extension = ".texcache";
+
+   enum class Format : uint32_t
+   {
+      Auto = 0, //BC1 for opaque images, BC3 otherwise
+      BC1 = 1,  //RGB, 4 bits per texel
+      BC3 = 2,  //RGBA, 8 bits per texel
+      BC7 = 3,  //RGBA, 8 bits per texel, best quality (mode 6 only)
+   };
+
+   struct Header
+   {
+      uint32_t Magic;
+      uint32_t Version;
+      uint32_t Format;
+      uint32_t Width;
+      uint32_t Height;
+      uint32_t Levels;
+      uint64_t SourceSize;
+      int64_t SourceTime;
+      uint64_t DataSize; //levels follow the header back to back, largest first
+   };
+
+   std::string CachePath(const std::string& sourceFilename);
+   GLenum GetGlFormat(Format format);
+
+   //Compress every level of an uncompressed image with a mip chain. Auto is resolved from the alpha of level 0.
+   bool Encode(const ImageData& image, Format format, ImageData& out);
+   bool Write(const std::string& sourceFilename, const ImageData& compressed);
+
+   //Blocks of a current cache into pooled staging memory. Returns false if there is none.
+   bool Load(const std::string& sourceFilename, ImageData& image);
+
+   //Offline bake of one source image
+   bool Bake(const std::string& sourceFilename, Format format = Format::Auto);
+   //Offline bake of every image with a known extension under a directory, recursively.
+   //Returns the number of caches written.
+   int BakeDirectory(const std::string& dir, Format format = Format::Auto);
+};
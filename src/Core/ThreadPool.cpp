@@ -0,0 +1,161 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+   //Index of the pool queue owned by the current thread, or -1 for non-worker threads
+   thread_local int sWorkerIndex = -1;
+   thread_local const ThreadPool* sWorkerPool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+   if (numThreads == 0)
+   {
+      const unsigned int hw = std::thread::hardware_concurrency();
+      numThreads = hw > 1 ? hw - 1 : 1;
+   }
+
+   //One extra queue for jobs submitted from outside the pool
+   for (unsigned int i = 0; i < numThreads + 1; i++)
+   {
+      mQueues.push_back(std::make_unique<Worker>());
+   }
+
+   for (unsigned int i = 0; i < numThreads; i++)
+   {
+      mWorkers.emplace_back(&ThreadPool::WorkerMain, this, i);
+   }
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(mSleepMutex);
+      mStop = true;
+   }
+   mWake.notify_all();
+
+   for (std::thread& t : mWorkers)
+   {
+      t.join();
+   }
+}
+
+ThreadPool& ThreadPool::Get()
+{
+   static ThreadPool* sPool = new ThreadPool();
+   return *sPool;
+}
+
+void ThreadPool::Submit(Job job, TaskGroup* group)
+{
+   if (group != nullptr)
+   {
+      group->Pending.fetch_add(1, std::memory_order_relaxed);
+      job = [inner = std::move(job), group]()
+      {
+         inner();
+         group->Pending.fetch_sub(1, std::memory_order_release);
+      };
+   }
+
+   //Workers push onto their own queue, everyone else spreads jobs round-robin
+   unsigned int index;
+   if (sWorkerPool == this && sWorkerIndex >= 0)
+   {
+      index = static_cast<unsigned int>(sWorkerIndex);
+   }
+   else
+   {
+      index = mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mQueues[index]->Mutex);
+      mQueues[index]->Jobs.push_back(std::move(job));
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mSleepMutex);
+      mQueued.fetch_add(1, std::memory_order_relaxed);
+   }
+   mWake.notify_one();
+}
+
+void ThreadPool::Wait(TaskGroup& group)
+{
+   const unsigned int first = (sWorkerPool == this && sWorkerIndex >= 0) ? static_cast<unsigned int>(sWorkerIndex) : GetNumThreads();
+   while (!group.Done())
+   {
+      if (!TryRunOne(first))
+      {
+         std::this_thread::yield();
+      }
+   }
+}
+
+bool ThreadPool::PopLocal(unsigned int index, Job& job)
+{
+   Worker& w = *mQueues[index];
+   std::lock_guard<std::mutex> lock(w.Mutex);
+   if (w.Jobs.empty())
+   {
+      return false;
+   }
+   job = std::move(w.Jobs.back());
+   w.Jobs.pop_back();
+   return true;
+}
+
+bool ThreadPool::Steal(unsigned int thief, Job& job)
+{
+   const unsigned int count = static_cast<unsigned int>(mQueues.size());
+   for (unsigned int i = 1; i < count; i++)
+   {
+      Worker& w = *mQueues[(thief + i) % count];
+      std::lock_guard<std::mutex> lock(w.Mutex);
+      if (!w.Jobs.empty())
+      {
+         job = std::move(w.Jobs.front());
+         w.Jobs.pop_front();
+         return true;
+      }
+   }
+   return false;
+}
+
+bool ThreadPool::TryRunOne(unsigned int first)
+{
+   Job job;
+   if (!PopLocal(first, job) && !Steal(first, job))
+   {
+      return false;
+   }
+
+   mQueued.fetch_sub(1, std::memory_order_relaxed);
+   job();
+   return true;
+}
+
+void ThreadPool::WorkerMain(unsigned int index)
+{
+   sWorkerIndex = static_cast<int>(index);
+   sWorkerPool = this;
+
+   for (;;)
+   {
+      if (TryRunOne(index))
+      {
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mSleepMutex);
+      mWake.wait(lock, [this]() { return mStop || mQueued.load(std::memory_order_relaxed) > 0; });
+      if (mStop && mQueued.load(std::memory_order_relaxed) == 0)
+      {
+         return;
+      }
+   }
+}
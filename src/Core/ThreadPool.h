@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Counts the outstanding jobs of one batch so the submitter can wait for exactly that batch.
+struct TaskGroup
+{
+   std::atomic<int> Pending = 0;
+
+   bool Done() const { return Pending.load(std::memory_order_acquire) == 0; }
+};
+
+//Work-stealing thread pool.
+//Every worker owns a job deque: it pops its own jobs LIFO (cache-warm) and steals
+//FIFO from the other workers when it runs dry. Threads that wait on a TaskGroup
+//run queued jobs instead of sleeping, so waiting never deadlocks and the main
+//thread contributes to the batch it is waiting on.
+class ThreadPool
+{
+   public:
+      using Job = std::function<void()>;
+
+      //numThreads == 0 uses one worker per hardware thread, minus the calling thread
+      explicit ThreadPool(unsigned int numThreads = 0);
+      ~ThreadPool();
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      void Submit(Job job, TaskGroup* group = nullptr);
+      //Runs pending jobs on the calling thread until every job of the group has finished
+      void Wait(TaskGroup& group);
+
+      //Calls func(i) for i in [begin, end), split into chunks of at most grain indices
+      template <typename Func>
+      void ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, Func&& func);
+
+      unsigned int GetNumThreads() const { return static_cast<unsigned int>(mWorkers.size()); }
+
+      //Shared pool for engine subsystems (animation, asset loading, ...).
+      //Intentionally never destroyed so jobs can still be waited on during static destruction.
+      static ThreadPool& Get();
+
+   private:
+      struct Worker
+      {
+         std::mutex Mutex;
+         std::deque<Job> Jobs;
+      };
+
+      void WorkerMain(unsigned int index);
+      bool TryRunOne(unsigned int first);
+      bool PopLocal(unsigned int index, Job& job);
+      bool Steal(unsigned int thief, Job& job);
+
+      std::vector<std::unique_ptr<Worker>> mQueues;
+      std::vector<std::thread> mWorkers;
+
+      std::mutex mSleepMutex;
+      std::condition_variable mWake;
+      std::atomic<int> mQueued = 0;
+      std::atomic<unsigned int> mNextQueue = 0;
+      bool mStop = false;
+};
+
+template <typename Func>
+void ThreadPool::ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, Func&& func)
+{
+   if (begin >= end)
+   {
+      return;
+   }
+   if (grain == 0)
+   {
+      grain = 1;
+   }
+
+   TaskGroup group;
+   for (unsigned int first = begin; first < end; first += grain)
+   {
+      const unsigned int last = (end - first > grain) ? first + grain : end;
+      Submit([&func, first, last]()
+      {
+         for (unsigned int i = first; i < last; i++)
+         {
+            func(i);
+         }
+      }, &group);
+   }
+   Wait(group);
+}
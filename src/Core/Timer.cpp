@@ -1,6 +1,7 @@
 #include "Timer.h"
 #include <iostream>
 #include <cassert>
+#include <cmath>
 
 typedef std::chrono::high_resolution_clock Clock;
 using std::chrono::nanoseconds;
@@ -283,6 +284,7 @@ struct RollingBuffer
 };
 
 #include <deque>
+#include <map>
 #include <vector>
 
 namespace TimerGui
@@ -290,6 +292,12 @@ namespace TimerGui
    bool show_timers_plot = false;
    std::deque<bool> plot; //std::vector<bool> is broken
    std::vector<ScrollingBuffer> timer_data;
+   std::map<std::string, double> counters;
+}
+
+void TimerGui::SetCounter(const std::string& name, double value)
+{
+   counters[name] = value;
 }
 
 
@@ -392,6 +400,22 @@ void TimerGui::DrawGui()
             }
             ImGui::EndTable();
          }
+
+         if (!counters.empty() && ImGui::BeginTable("Counter Table", 2, flags))
+         {
+            ImGui::TableSetupColumn("Counter", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Value", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableHeadersRow();
+            for (const auto& counter : counters)
+            {
+               ImGui::TableNextRow();
+               ImGui::TableSetColumnIndex(0);
+               ImGui::Text("%s", counter.first.c_str());
+               ImGui::TableSetColumnIndex(1);
+               ImGui::Text("%g", counter.second);
+            }
+            ImGui::EndTable();
+         }
          static float history = 500.0f;
          static float frame = 0.0;
          frame += 1.0;
@@ -7,6 +7,8 @@ namespace TimerGui
 {
    void Menu();
    void DrawGui();
+   //Named per-frame statistics (culling, draw counts, ...) listed below the timers
+   void SetCounter(const std::string& name, double value);
 }
 
 class Timer
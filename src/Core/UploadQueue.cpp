@@ -0,0 +1,67 @@
+#include "UploadQueue.h"
+
+UploadQueue::UploadQueue(size_t capacityBytes) : mCapacity(capacityBytes)
+{
+
+}
+
+void UploadQueue::Push(size_t bytes, Upload upload)
+{
+   {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mSpace.wait(lock, [this, bytes]() { return mItems.empty() || mQueuedBytes + bytes <= mCapacity; });
+
+      mItems.push_back({bytes, std::move(upload)});
+      mQueuedBytes += bytes;
+   }
+   mQueued.notify_all();
+}
+
+size_t UploadQueue::Drain(size_t budgetBytes)
+{
+   size_t uploaded = 0;
+
+   for (;;)
+   {
+      Item item;
+      {
+         std::lock_guard<std::mutex> lock(mMutex);
+         if (mItems.empty())
+         {
+            break;
+         }
+         if (uploaded > 0 && uploaded + mItems.front().Bytes > budgetBytes)
+         {
+            break;
+         }
+         item = std::move(mItems.front());
+         mItems.pop_front();
+         mQueuedBytes -= item.Bytes;
+      }
+      mSpace.notify_all();
+
+      //Run outside the lock so producers can keep queueing
+      item.Func();
+      uploaded += item.Bytes;
+   }
+
+   return uploaded;
+}
+
+void UploadQueue::WaitForUploads()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   mQueued.wait(lock, [this]() { return !mItems.empty(); });
+}
+
+size_t UploadQueue::GetQueuedBytes() const
+{
+   std::lock_guard<std::mutex> lock(mMutex);
+   return mQueuedBytes;
+}
+
+size_t UploadQueue::GetQueuedCount() const
+{
+   std::lock_guard<std::mutex> lock(mMutex);
+   return mItems.size();
+}
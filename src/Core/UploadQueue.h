@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+//Bounded queue of GL uploads prepared on worker threads.
+//Producers block while the queued payloads exceed the capacity, which bounds the CPU-side
+//staging memory. The GL thread calls Drain() once per frame with a byte budget so a burst
+//of finished loads is spread over several frames instead of stalling one.
+class UploadQueue
+{
+   public:
+      using Upload = std::function<void()>;
+
+      explicit UploadQueue(size_t capacityBytes);
+
+      //bytes is the payload size the upload will transfer. Blocks while the queue is full;
+      //an upload larger than the capacity is accepted once the queue is empty.
+      void Push(size_t bytes, Upload upload);
+
+      //GL thread: run queued uploads in order until budgetBytes is spent. At least one upload
+      //runs if any is queued, so oversized payloads still make progress. Returns bytes uploaded.
+      size_t Drain(size_t budgetBytes);
+
+      //GL thread: sleep until at least one upload is queued
+      void WaitForUploads();
+
+      size_t GetQueuedBytes() const;
+      size_t GetQueuedCount() const;
+      size_t GetCapacity() const { return mCapacity; }
+
+   private:
+      struct Item
+      {
+         size_t Bytes;
+         Upload Func;
+      };
+
+      const size_t mCapacity;
+      mutable std::mutex mMutex;
+      std::condition_variable mSpace;
+      std::condition_variable mQueued;
+      std::deque<Item> mItems;
+      size_t mQueuedBytes = 0;
+};
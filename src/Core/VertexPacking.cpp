@@ -0,0 +1,637 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+
+namespace VertexPacking
+{
+   namespace
+   {
+      unsigned int PositionSize(PositionFormat f)
+      {
+         return f == PositionFormat::Half4 ? 8 : 12;
+      }
+
+      unsigned int NormalSize(NormalFormat f)
+      {
+         switch (f)
+         {
+            case NormalFormat::Float3: return 12;
+            case NormalFormat::Snorm10: return 4;
+            case NormalFormat::Oct16: return 4;
+            default: return 0;
+         }
+      }
+
+      unsigned int TexCoordSize(TexCoordFormat f)
+      {
+         switch (f)
+         {
+            case TexCoordFormat::Float2: return 8;
+            case TexCoordFormat::Half2: return 4;
+            case TexCoordFormat::Unorm16: return 4;
+            default: return 0;
+         }
+      }
+
+      unsigned int WeightSize(WeightFormat f)
+      {
+         switch (f)
+         {
+            case WeightFormat::Float4: return 16;
+            case WeightFormat::Unorm8: return 4;
+            default: return 0;
+         }
+      }
+
+      template<typename T>
+      T Read(const Stream& s, size_t i)
+      {
+         T value;
+         std::memcpy(&value, static_cast<const unsigned char*>(s.Data) + i*s.Stride, sizeof(T));
+         return value;
+      }
+
+      float FromSnorm16(int16_t v)
+      {
+         return std::max(float(v)/32767.0f, -1.0f);
+      }
+
+      uint32_t ToSnorm10(float v)
+      {
+         return uint32_t(std::lround(glm::clamp(v, -1.0f, 1.0f)*511.0f)) & 0x3FF;
+      }
+
+      float FromSnorm10(uint32_t bits)
+      {
+         const int v = int(bits << 22) >> 22; //sign extend
+         return std::max(float(v)/511.0f, -1.0f);
+      }
+
+      //Octahedral encoding rounded to the snorm16 grid point whose decode is closest to n
+      void EncodeOct16(const glm::vec3& n, int16_t out[2])
+      {
+         const glm::vec2 e = OctEncode(n);
+         const glm::vec2 f = glm::floor(glm::clamp(e, -1.0f, 1.0f)*32767.0f);
+         float best = -2.0f;
+         for (int c = 0; c < 4; c++)
+         {
+            const glm::vec2 q = glm::clamp(f + glm::vec2(float(c & 1), float(c >> 1)), -32767.0f, 32767.0f);
+            const float d = glm::dot(OctDecode(q/32767.0f), n);
+            if (d > best)
+            {
+               best = d;
+               out[0] = int16_t(q.x);
+               out[1] = int16_t(q.y);
+            }
+         }
+      }
+
+      //Unorm8 weights that sum to exactly 255: floor everything, then hand out the remainder
+      //to the largest fractions, so no weight is off by a full step
+      void EncodeWeights(const glm::vec4& w, uint8_t out[4])
+      {
+         const float sum = w.x + w.y + w.z + w.w;
+         if (sum <= 0.0f)
+         {
+            std::memset(out, 0, 4);
+            return;
+         }
+
+         float frac[4];
+         int total = 0;
+         for (int i = 0; i < 4; i++)
+         {
+            const float v = glm::clamp(w[i]/sum, 0.0f, 1.0f)*255.0f;
+            const float f = std::floor(v);
+            out[i] = uint8_t(f);
+            frac[i] = v - f;
+            total += out[i];
+         }
+
+         for (; total < 255; total++)
+         {
+            const int i = int(std::max_element(frac, frac + 4) - frac);
+            out[i]++;
+            frac[i] = -1.0f;
+         }
+      }
+   };
+
+   void Layout::Finalize()
+   {
+      PosOffset = 0;
+      NormalOffset = PosOffset + PositionSize(Position);
+      TexCoordOffset = NormalOffset + NormalSize(Normal);
+      BoneIdOffset = TexCoordOffset + TexCoordSize(TexCoord);
+      WeightOffset = BoneIdOffset + (Weights != WeightFormat::None ? 4 : 0);
+      Stride = WeightOffset + WeightSize(Weights);
+   }
+
+   Layout GetCompatibleLayout()
+   {
+      Layout layout;
+      layout.Position = PositionFormat::Float3;
+      layout.Normal = NormalFormat::Snorm10;
+      layout.TexCoord = TexCoordFormat::Half2;
+      layout.Finalize();
+      return layout;
+   }
+
+   void Pack(const Streams& in, size_t numVertices, const std::vector<Submesh>& submeshes, Layout layout, PackedVertices& out)
+   {
+      std::vector<Submesh> ranges = submeshes;
+      if (ranges.empty())
+      {
+         ranges.push_back({0, static_cast<unsigned int>(numVertices)});
+      }
+
+      if (in.TexCoords.Data != nullptr && (layout.TexCoord == TexCoordFormat::Unorm16 || layout.TexCoord == TexCoordFormat::Half2))
+      {
+         bool unitRange = true;
+         float maxTexCoord = 0.0f;
+         for (size_t i = 0; i < numVertices; i++)
+         {
+            const glm::vec2 uv = Read<glm::vec2>(in.TexCoords, i);
+            unitRange = unitRange && uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+            maxTexCoord = std::max(maxTexCoord, std::max(std::abs(uv.x), std::abs(uv.y)));
+         }
+
+         if (layout.TexCoord == TexCoordFormat::Unorm16 && !unitRange)
+         {
+            layout.TexCoord = TexCoordFormat::Half2;
+         }
+         //Half steps grow with |uv|: tiled coordinates would drift across texels
+         if (layout.TexCoord == TexCoordFormat::Half2 && GetErrorBounds(layout, glm::vec3(0.0f), maxTexCoord).TexCoord > layout.MaxTexCoordError)
+         {
+            layout.TexCoord = TexCoordFormat::Float2;
+         }
+      }
+
+      //Submesh bounds, for the Half4 dequantization
+      std::vector<glm::vec3> bbMins(ranges.size(), glm::vec3(0.0f));
+      std::vector<glm::vec3> bbMaxs(ranges.size(), glm::vec3(0.0f));
+      if (layout.Position == PositionFormat::Half4)
+      {
+         for (size_t s = 0; s < ranges.size(); s++)
+         {
+            const size_t begin = ranges[s].BaseVertex;
+            const size_t end = std::min(begin + ranges[s].NumVertices, numVertices);
+            if (begin >= end)
+            {
+               continue;
+            }
+
+            bbMins[s] = bbMaxs[s] = Read<glm::vec3>(in.Positions, begin);
+            for (size_t i = begin + 1; i < end; i++)
+            {
+               const glm::vec3 p = Read<glm::vec3>(in.Positions, i);
+               bbMins[s] = glm::min(bbMins[s], p);
+               bbMaxs[s] = glm::max(bbMaxs[s], p);
+            }
+
+            //The format is per buffer: one submesh too large for half precision takes all to Float3
+            if (GetErrorBounds(layout, 0.5f*(bbMaxs[s] - bbMins[s]), 0.0f).Position > layout.MaxPositionError)
+            {
+               layout.Position = PositionFormat::Float3;
+               break;
+            }
+         }
+      }
+      layout.Finalize();
+
+      out.Format = layout;
+      out.Data.assign(layout.Stride*numVertices, 0);
+      out.Submeshes.assign(ranges.size(), Dequant());
+
+      for (size_t s = 0; s < ranges.size(); s++)
+      {
+         const size_t begin = ranges[s].BaseVertex;
+         const size_t end = std::min(begin + ranges[s].NumVertices, numVertices);
+         if (begin >= end)
+         {
+            continue;
+         }
+
+         Dequant& dequant = out.Submeshes[s];
+         if (layout.Position == PositionFormat::Half4)
+         {
+            dequant.Offset = 0.5f*(bbMins[s] + bbMaxs[s]);
+            dequant.Scale = 0.5f*(bbMaxs[s] - bbMins[s]);
+            //Flat axes: any scale works, keep it invertible
+            dequant.Scale = glm::mix(dequant.Scale, glm::vec3(1.0f), glm::equal(dequant.Scale, glm::vec3(0.0f)));
+         }
+
+         for (size_t i = begin; i < end; i++)
+         {
+            unsigned char* v = out.Data.data() + i*layout.Stride;
+
+            const glm::vec3 p = Read<glm::vec3>(in.Positions, i);
+            if (layout.Position == PositionFormat::Half4)
+            {
+               const glm::vec3 q = glm::clamp((p - dequant.Offset)/dequant.Scale, -1.0f, 1.0f);
+               const uint16_t h[4] = {FloatToHalf(q.x), FloatToHalf(q.y), FloatToHalf(q.z), FloatToHalf(1.0f)};
+               std::memcpy(v + layout.PosOffset, h, sizeof(h));
+            }
+            else
+            {
+               std::memcpy(v + layout.PosOffset, &p, sizeof(p));
+            }
+
+            if (layout.Normal != NormalFormat::None)
+            {
+               const glm::vec3 n = in.Normals.Data ? Read<glm::vec3>(in.Normals, i) : glm::vec3(0.0f);
+               if (layout.Normal == NormalFormat::Float3)
+               {
+                  std::memcpy(v + layout.NormalOffset, &n, sizeof(n));
+               }
+               else if (layout.Normal == NormalFormat::Snorm10)
+               {
+                  const uint32_t bits = ToSnorm10(n.x) | (ToSnorm10(n.y) << 10) | (ToSnorm10(n.z) << 20);
+                  std::memcpy(v + layout.NormalOffset, &bits, sizeof(bits));
+               }
+               else
+               {
+                  int16_t e[2];
+                  EncodeOct16(n, e);
+                  std::memcpy(v + layout.NormalOffset, e, sizeof(e));
+               }
+            }
+
+            if (layout.TexCoord != TexCoordFormat::None)
+            {
+               const glm::vec2 uv = in.TexCoords.Data ? Read<glm::vec2>(in.TexCoords, i) : glm::vec2(0.0f);
+               if (layout.TexCoord == TexCoordFormat::Float2)
+               {
+                  std::memcpy(v + layout.TexCoordOffset, &uv, sizeof(uv));
+               }
+               else if (layout.TexCoord == TexCoordFormat::Half2)
+               {
+                  const uint16_t h[2] = {FloatToHalf(uv.x), FloatToHalf(uv.y)};
+                  std::memcpy(v + layout.TexCoordOffset, h, sizeof(h));
+               }
+               else
+               {
+                  const uint16_t u[2] = {uint16_t(std::lround(uv.x*65535.0f)), uint16_t(std::lround(uv.y*65535.0f))};
+                  std::memcpy(v + layout.TexCoordOffset, u, sizeof(u));
+               }
+            }
+
+            if (layout.Weights != WeightFormat::None)
+            {
+               if (in.BoneIds.Data)
+               {
+                  std::memcpy(v + layout.BoneIdOffset, static_cast<const unsigned char*>(in.BoneIds.Data) + i*in.BoneIds.Stride, 4);
+               }
+               const glm::vec4 w = in.Weights.Data ? Read<glm::vec4>(in.Weights, i) : glm::vec4(0.0f);
+               if (layout.Weights == WeightFormat::Float4)
+               {
+                  std::memcpy(v + layout.WeightOffset, &w, sizeof(w));
+               }
+               else
+               {
+                  EncodeWeights(w, v + layout.WeightOffset);
+               }
+            }
+         }
+      }
+   }
+
+   void Unpack(const PackedVertices& packed, size_t vertex, unsigned int submesh,
+      glm::vec3* pos, glm::vec3* normal, glm::vec2* texCoord, glm::vec4* weights)
+   {
+      const Layout& layout = packed.Format;
+      const unsigned char* v = packed.Data.data() + vertex*layout.Stride;
+
+      if (pos)
+      {
+         if (layout.Position == PositionFormat::Half4)
+         {
+            uint16_t h[4];
+            std::memcpy(h, v + layout.PosOffset, sizeof(h));
+            const Dequant& dequant = packed.Submeshes[submesh];
+            *pos = dequant.Offset + dequant.Scale*glm::vec3(HalfToFloat(h[0]), HalfToFloat(h[1]), HalfToFloat(h[2]));
+         }
+         else
+         {
+            std::memcpy(pos, v + layout.PosOffset, sizeof(glm::vec3));
+         }
+      }
+
+      if (normal)
+      {
+         if (layout.Normal == NormalFormat::Float3)
+         {
+            std::memcpy(normal, v + layout.NormalOffset, sizeof(glm::vec3));
+         }
+         else if (layout.Normal == NormalFormat::Snorm10)
+         {
+            uint32_t bits;
+            std::memcpy(&bits, v + layout.NormalOffset, sizeof(bits));
+            *normal = glm::vec3(FromSnorm10(bits), FromSnorm10(bits >> 10), FromSnorm10(bits >> 20));
+         }
+         else if (layout.Normal == NormalFormat::Oct16)
+         {
+            int16_t e[2];
+            std::memcpy(e, v + layout.NormalOffset, sizeof(e));
+            *normal = OctDecode(glm::vec2(FromSnorm16(e[0]), FromSnorm16(e[1])));
+         }
+         else
+         {
+            *normal = glm::vec3(0.0f);
+         }
+      }
+
+      if (texCoord)
+      {
+         uint16_t h[2] = {0, 0};
+         if (layout.TexCoord == TexCoordFormat::Half2 || layout.TexCoord == TexCoordFormat::Unorm16)
+         {
+            std::memcpy(h, v + layout.TexCoordOffset, sizeof(h));
+         }
+
+         if (layout.TexCoord == TexCoordFormat::Float2)
+         {
+            std::memcpy(texCoord, v + layout.TexCoordOffset, sizeof(glm::vec2));
+         }
+         else if (layout.TexCoord == TexCoordFormat::Half2)
+         {
+            *texCoord = glm::vec2(HalfToFloat(h[0]), HalfToFloat(h[1]));
+         }
+         else
+         {
+            *texCoord = glm::vec2(h[0], h[1])/65535.0f;
+         }
+      }
+
+      if (weights)
+      {
+         if (layout.Weights == WeightFormat::Float4)
+         {
+            std::memcpy(weights, v + layout.WeightOffset, sizeof(glm::vec4));
+         }
+         else if (layout.Weights == WeightFormat::Unorm8)
+         {
+            const unsigned char* w = v + layout.WeightOffset;
+            *weights = glm::vec4(w[0], w[1], w[2], w[3])/255.0f;
+         }
+         else
+         {
+            *weights = glm::vec4(0.0f);
+         }
+      }
+   }
+
+   ErrorBounds GetErrorBounds(const Layout& layout, const glm::vec3& halfExtent, float maxTexCoord)
+   {
+      ErrorBounds bounds;
+
+      //Half positions lie in [-1, 1]: a rounding error of at most half an ulp of [0.5, 1)
+      if (layout.Position == PositionFormat::Half4)
+      {
+         const float extent = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+         bounds.Position = extent*(1.0f/4096.0f + 1e-6f);
+      }
+
+      //Half a step per component for snorm10, octahedral decoding stretches its grid up to about 4x
+      if (layout.Normal == NormalFormat::Snorm10)
+      {
+         bounds.NormalDegrees = glm::degrees(std::sqrt(3.0f)*0.5f/511.0f);
+      }
+      else if (layout.Normal == NormalFormat::Oct16)
+      {
+         bounds.NormalDegrees = glm::degrees(2.0f*std::sqrt(6.0f)/32767.0f);
+      }
+
+      if (layout.TexCoord == TexCoordFormat::Half2)
+      {
+         bounds.TexCoord = std::max(maxTexCoord, 1.0f/16384.0f)/2048.0f;
+      }
+      else if (layout.TexCoord == TexCoordFormat::Unorm16)
+      {
+         bounds.TexCoord = 0.5f/65535.0f + 1e-7f; //and the float rounding of the decode
+      }
+
+      if (layout.Weights == WeightFormat::Unorm8)
+      {
+         bounds.Weight = 1.0f/255.0f;
+      }
+
+      return bounds;
+   }
+
+   ErrorBounds MeasureError(const Streams& in, const std::vector<Submesh>& submeshes, const PackedVertices& packed)
+   {
+      ErrorBounds error;
+      const Layout& layout = packed.Format;
+      std::vector<Submesh> ranges = submeshes;
+      if (ranges.empty())
+      {
+         ranges.push_back({0, static_cast<unsigned int>(packed.Data.size()/layout.Stride)});
+      }
+
+      for (unsigned int s = 0; s < ranges.size(); s++)
+      {
+         for (size_t i = ranges[s].BaseVertex; i < ranges[s].BaseVertex + ranges[s].NumVertices; i++)
+         {
+            glm::vec3 pos, normal;
+            glm::vec2 texCoord;
+            glm::vec4 weights;
+            Unpack(packed, i, s, &pos, &normal, &texCoord, &weights);
+
+            const glm::vec3 dp = glm::abs(pos - Read<glm::vec3>(in.Positions, i));
+            error.Position = std::max(error.Position, std::max(dp.x, std::max(dp.y, dp.z)));
+
+            if (layout.Normal != NormalFormat::None && in.Normals.Data)
+            {
+               const glm::vec3 n = Read<glm::vec3>(in.Normals, i);
+               const float len = glm::length(n);
+               if (len > 0.0f)
+               {
+                  //atan2 rather than acos, which cannot resolve angles this small, and in double
+                  //so exactly stored normals measure 0
+                  const glm::dvec3 a = glm::normalize(glm::dvec3(n));
+                  const glm::dvec3 b = glm::normalize(glm::dvec3(normal));
+                  const double angle = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+                  error.NormalDegrees = std::max(error.NormalDegrees, float(glm::degrees(angle)));
+               }
+            }
+
+            if (layout.TexCoord != TexCoordFormat::None && in.TexCoords.Data)
+            {
+               const glm::vec2 duv = glm::abs(texCoord - Read<glm::vec2>(in.TexCoords, i));
+               error.TexCoord = std::max(error.TexCoord, std::max(duv.x, duv.y));
+            }
+
+            if (layout.Weights != WeightFormat::None && in.Weights.Data)
+            {
+               glm::vec4 w = Read<glm::vec4>(in.Weights, i);
+               const float sum = w.x + w.y + w.z + w.w;
+               if (sum > 0.0f)
+               {
+                  w /= sum;
+               }
+               const glm::vec4 dw = glm::abs(weights - w);
+               error.Weight = std::max(error.Weight, std::max(std::max(dw.x, dw.y), std::max(dw.z, dw.w)));
+            }
+         }
+      }
+
+      return error;
+   }
+
+   void SetupAttributes(const Layout& layout, GLuint posLoc, GLuint texCoordLoc, GLuint normalLoc, GLuint boneIdLoc, GLuint weightLoc)
+   {
+      const GLsizei stride = layout.Stride;
+      auto enable = [](GLuint loc, bool present)
+      {
+         if (loc == NoAttrib)
+         {
+            return false;
+         }
+         if (present)
+         {
+            glEnableVertexAttribArray(loc);
+         }
+         else
+         {
+            glDisableVertexAttribArray(loc);
+         }
+         return present;
+      };
+
+      if (enable(posLoc, true))
+      {
+         const GLenum type = layout.Position == PositionFormat::Half4 ? GL_HALF_FLOAT : GL_FLOAT;
+         glVertexAttribPointer(posLoc, 3, type, GL_FALSE, stride, (const GLvoid*)size_t(layout.PosOffset));
+      }
+
+      if (enable(normalLoc, layout.Normal != NormalFormat::None))
+      {
+         const GLvoid* offset = (const GLvoid*)size_t(layout.NormalOffset);
+         if (layout.Normal == NormalFormat::Float3)
+         {
+            glVertexAttribPointer(normalLoc, 3, GL_FLOAT, GL_FALSE, stride, offset);
+         }
+         else if (layout.Normal == NormalFormat::Snorm10)
+         {
+            glVertexAttribPointer(normalLoc, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offset);
+         }
+         else
+         {
+            glVertexAttribPointer(normalLoc, 2, GL_SHORT, GL_TRUE, stride, offset);
+         }
+      }
+
+      if (enable(texCoordLoc, layout.TexCoord != TexCoordFormat::None))
+      {
+         const GLvoid* offset = (const GLvoid*)size_t(layout.TexCoordOffset);
+         if (layout.TexCoord == TexCoordFormat::Float2)
+         {
+            glVertexAttribPointer(texCoordLoc, 2, GL_FLOAT, GL_FALSE, stride, offset);
+         }
+         else if (layout.TexCoord == TexCoordFormat::Half2)
+         {
+            glVertexAttribPointer(texCoordLoc, 2, GL_HALF_FLOAT, GL_FALSE, stride, offset);
+         }
+         else
+         {
+            glVertexAttribPointer(texCoordLoc, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, offset);
+         }
+      }
+
+      const bool skinned = layout.Weights != WeightFormat::None;
+      if (enable(boneIdLoc, skinned))
+      {
+         glVertexAttribIPointer(boneIdLoc, 4, GL_UNSIGNED_BYTE, stride, (const GLvoid*)size_t(layout.BoneIdOffset));
+      }
+      if (enable(weightLoc, skinned))
+      {
+         const GLvoid* offset = (const GLvoid*)size_t(layout.WeightOffset);
+         if (layout.Weights == WeightFormat::Float4)
+         {
+            glVertexAttribPointer(weightLoc, 4, GL_FLOAT, GL_FALSE, stride, offset);
+         }
+         else
+         {
+            glVertexAttribPointer(weightLoc, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, offset);
+         }
+      }
+   }
+
+   uint16_t FloatToHalf(float f)
+   {
+      uint32_t x;
+      std::memcpy(&x, &f, sizeof(x));
+      const uint16_t sign = uint16_t((x >> 16) & 0x8000);
+      x &= 0x7FFFFFFF;
+
+      if (x >= 0x7F800000) //inf, nan
+      {
+         return sign | 0x7C00 | (x > 0x7F800000 ? 0x200 : 0);
+      }
+      if (x >= 0x477FF000) //rounds past 65504
+      {
+         return sign | 0x7C00;
+      }
+      if (x < 0x38800000) //half subnormal: the fpu does the rounding
+      {
+         float a;
+         std::memcpy(&a, &x, sizeof(a));
+         return sign | uint16_t(std::lrint(a*16777216.0f));
+      }
+
+      //Rebias the exponent and round the mantissa to nearest even
+      x += 0xC8000FFF + ((x >> 13) & 1);
+      return sign | uint16_t(x >> 13);
+   }
+
+   float HalfToFloat(uint16_t h)
+   {
+      const uint32_t sign = uint32_t(h & 0x8000) << 16;
+      const uint32_t exponent = (h >> 10) & 0x1F;
+      const uint32_t mantissa = h & 0x3FF;
+
+      if (exponent == 0)
+      {
+         const float f = std::ldexp(float(mantissa), -24);
+         return sign ? -f : f;
+      }
+
+      const uint32_t x = sign | (exponent == 31 ? 0x7F800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+      float f;
+      std::memcpy(&f, &x, sizeof(f));
+      return f;
+   }
+
+   glm::vec2 OctEncode(const glm::vec3& n)
+   {
+      const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+      if (l1 <= 0.0f)
+      {
+         return glm::vec2(0.0f);
+      }
+
+      glm::vec2 p = glm::vec2(n.x, n.y)/l1;
+      if (n.z < 0.0f)
+      {
+         const glm::vec2 s(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+         p = (1.0f - glm::abs(glm::vec2(p.y, p.x)))*s;
+      }
+      return p;
+   }
+
+   glm::vec3 OctDecode(const glm::vec2& e)
+   {
+      glm::vec3 v(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+      if (v.z < 0.0f)
+      {
+         const glm::vec2 s(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+         const glm::vec2 folded = (1.0f - glm::abs(glm::vec2(v.y, v.x)))*s;
+         v.x = folded.x;
+         v.y = folded.y;
+      }
+      return glm::normalize(v);
+   }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+//Interleaved, quantized vertex streams.
+//
+//A Layout picks an encoding per attribute; Pack() turns float streams into one interleaved
+//buffer and SetupAttributes() describes it to GL. The compact formats need a little help
+//from the vertex shader:
+// - Half4 positions are stored relative to the submesh bounds: pos = offset + scale*stored,
+//   with the per-submesh Dequant passed as uniforms
+// - Oct16 normals are octahedral encoded in two snorm16 and decoded with oct_decode()
+//Float3, Snorm10, Half2 and Unorm16 read as plain vec3/vec2 and work with any shader.
+//
+//Default mesh layout: 8 (pos) + 4 (normal) + 4 (uv) = 16 bytes instead of 32,
+//skinned meshes add 4 (bone ids) + 4 (unorm8 weights) = 24 bytes instead of 52.
+namespace VertexPacking
+{
+   enum class PositionFormat : uint32_t { Float3, Half4 };
+   enum class NormalFormat : uint32_t { None, Float3, Snorm10, Oct16 };
+   enum class TexCoordFormat : uint32_t { None, Float2, Half2, Unorm16 };
+   enum class WeightFormat : uint32_t { None, Float4, Unorm8 }; //None: no bone ids and weights either
+
+   struct Layout
+   {
+      PositionFormat Position = PositionFormat::Half4;
+      NormalFormat Normal = NormalFormat::Oct16;
+      TexCoordFormat TexCoord = TexCoordFormat::Half2;
+      WeightFormat Weights = WeightFormat::None;
+
+      //Largest worst case error (see GetErrorBounds) Pack() accepts before it falls back to Float3
+      //positions or Float2 tex coords. Half2 stays within a 2048 texel texture up to |uv| = 1.
+      float MaxPositionError = 1.0f/1024.0f; //mesh units
+      float MaxTexCoordError = 1.0f/2048.0f;
+
+      //Byte offsets inside a vertex, set by Finalize()
+      unsigned int PosOffset = 0;
+      unsigned int NormalOffset = 0;
+      unsigned int TexCoordOffset = 0;
+      unsigned int BoneIdOffset = 0;
+      unsigned int WeightOffset = 0;
+      unsigned int Stride = 0;
+
+      void Finalize();
+   };
+
+   //Layout that any shader with vec3 pos/normal and vec2 tex coord attributes can read
+   Layout GetCompatibleLayout();
+
+   //Per submesh position dequantization, identity unless positions are Half4
+   struct Dequant
+   {
+      glm::vec3 Scale = glm::vec3(1.0f);
+      glm::vec3 Offset = glm::vec3(0.0f);
+   };
+
+   //Vertex range of a submesh, as addressed with BaseVertex
+   struct Submesh
+   {
+      unsigned int BaseVertex = 0;
+      unsigned int NumVertices = 0;
+   };
+
+   //A float source stream, Data == nullptr if the mesh has no such attribute (zeros are packed)
+   struct Stream
+   {
+      const void* Data = nullptr;
+      size_t Stride = 0;
+   };
+
+   struct Streams
+   {
+      Stream Positions; //float3
+      Stream Normals;   //float3
+      Stream TexCoords; //float2
+      Stream BoneIds;   //uint8 x4
+      Stream Weights;   //float4, summing to 1
+   };
+
+   struct PackedVertices
+   {
+      Layout Format;
+      std::vector<unsigned char> Data;
+      std::vector<Dequant> Submeshes;
+   };
+
+   //Encode numVertices vertices, with one Dequant per submesh (the whole buffer if submeshes is empty).
+   //Vertices outside every submesh are left zero. Formats fall back to wider ones where the data
+   //doesn't fit, so check out.Format rather than the requested layout:
+   // - Unorm16 tex coords become Half2 when some are outside [0, 1]
+   // - Half2 tex coords become Float2 when |uv| is large enough to exceed layout.MaxTexCoordError
+   // - Half4 positions become Float3 when a submesh is large enough to exceed layout.MaxPositionError
+   void Pack(const Streams& in, size_t numVertices, const std::vector<Submesh>& submeshes, Layout layout, PackedVertices& out);
+
+   //Decode one vertex of a submesh back to floats. Any output pointer may be nullptr.
+   void Unpack(const PackedVertices& packed, size_t vertex, unsigned int submesh,
+      glm::vec3* pos, glm::vec3* normal, glm::vec2* texCoord, glm::vec4* weights);
+
+   struct ErrorBounds
+   {
+      float Position = 0.0f;      //per component, in mesh units
+      float NormalDegrees = 0.0f;
+      float TexCoord = 0.0f;      //per component
+      float Weight = 0.0f;        //per weight
+   };
+
+   //Worst case error of a layout for a submesh with the given half extent and largest |uv|
+   ErrorBounds GetErrorBounds(const Layout& layout, const glm::vec3& halfExtent, float maxTexCoord);
+   //Largest error actually made by Pack()
+   ErrorBounds MeasureError(const Streams& in, const std::vector<Submesh>& submeshes, const PackedVertices& packed);
+
+   constexpr GLuint NoAttrib = 0xFFFFFFFF;
+
+   //Attribute pointers for the bound VAO and GL_ARRAY_BUFFER. Attributes the layout lacks are disabled.
+   void SetupAttributes(const Layout& layout, GLuint posLoc, GLuint texCoordLoc = NoAttrib, GLuint normalLoc = NoAttrib,
+      GLuint boneIdLoc = NoAttrib, GLuint weightLoc = NoAttrib);
+
+   uint16_t FloatToHalf(float f);
+   float HalfToFloat(uint16_t h);
+   glm::vec2 OctEncode(const glm::vec3& n);
+   glm::vec3 OctDecode(const glm::vec2& e);
+};
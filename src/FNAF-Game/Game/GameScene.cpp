@@ -4,29 +4,27 @@
 #include <GL/glew.h>
 #include <InitShader.h>
 #include <Shader.h>
+#include <ThreadPool.h>
 
 #include "GameScene.h"
 #include "GlobalObjects.h"
 #include "Game.h"
+#include "Objects/AnimationLod.h"
+#include "Objects/AnimationSystem.h"
+#include "Objects/AssetLoader.h"
+#include "Objects/FrustumCulling.h"
 #include "Objects/LightManager.h"
+#include "Objects/MeshLod.h"
+#include "Objects/SkinnedBatch.h"
 #include "Objects/TitleMesh.h"
 
 using namespace Scene;
 
 void GameScene::ModelInit()
 {
-    gStartMesh = std::make_unique<TitleMesh>();
-    gStartMesh->LoadMesh(start_title_name);
-
-    gEndMesh = std::make_unique<TitleMesh>();
-    gEndMesh->LoadMesh(end_title_name);
-
-    gWinMesh = std::make_unique<TitleMesh>();
-    gWinMesh->LoadMesh(win_title_name);
-
     // initialize map
     gMapMesh = std::make_shared<StaticMesh>();
-    gMapMesh->LoadMesh(map_name);
+    gMapMesh->LoadMeshAsync(map_name);
 
     gMapMesh->mTranslation = map_position;
     gMapMesh->mScale = glm::vec3(1.f, 1.f, 1.f);
@@ -34,7 +32,7 @@ void GameScene::ModelInit()
 
     // initialize freddy
     gFreddy.mMesh = std::make_unique<SkinnedMesh>();
-    gFreddy.mMesh->LoadMesh(freddy_model);
+    gFreddy.mMesh->LoadMeshAsync(freddy_model);
 
     gFreddy.mMesh->mTranslation = freddy_position;
     gFreddy.mMesh->mRotation = glm::vec3(180.f, 0.f, 0.f);
@@ -42,11 +40,28 @@ void GameScene::ModelInit()
 
     // initialize bunny
     gBunny.mMesh = std::make_unique<SkinnedMesh>();
-    gBunny.mMesh->LoadMesh(bunny_model);
+    gBunny.mMesh->LoadMeshAsync(bunny_model);
 
     gBunny.mMesh->mTranslation = bunny_position;
     gBunny.mMesh->mRotation = glm::vec3(-5.f, -100.f, -5.f);
     gBunny.mMesh->mScale = glm::vec3(0.016f, -0.016f, -0.016f);
+
+    // Titles are shown first and must be ready when this returns. They are imported in parallel
+    // while the rest streams in through AssetLoader, and uploaded here on the GL thread.
+    const std::string TitleNames[] = { start_title_name, end_title_name, win_title_name };
+    std::unique_ptr<TitleMesh>* Titles[] = { &gStartMesh, &gEndMesh, &gWinMesh };
+    TitleMesh::ImportedMesh Imported[3];
+
+    TaskGroup Group;
+    for (int i = 0; i < 3; i++) {
+        ThreadPool::Get().Submit([&TitleNames, &Imported, i]() { TitleMesh::Import(TitleNames[i], Imported[i]); }, &Group);
+    }
+    ThreadPool::Get().Wait(Group);
+
+    for (int i = 0; i < 3; i++) {
+        *Titles[i] = std::make_unique<TitleMesh>();
+        (*Titles[i])->LoadImported(TitleNames[i], Imported[i]);
+    }
 }
 
 void GameScene::Init()
@@ -80,6 +95,8 @@ void GameScene::Init()
     LightManager::InitLight();
 
     ModelInit();
+    // Every mesh class has built its shader by now
+    FlushProgramCache();
 
     // DebugDraw::Init();
 
@@ -121,6 +138,15 @@ void GameScene::Render()
         }
     }
 
+    // LOD levels are picked from the size of each mesh on screen: the eye render target in VR,
+    // the window when no loop set the viewport
+    const int ViewportHeight = SceneData.Viewport[3] > 0 ? SceneData.Viewport[3] : GlfwWindow::Size[1];
+    MeshLod::SetCamera(SceneData.P, glm::vec3(SceneData.eye_w), ViewportHeight);
+    // Entries are culled against this view, or against both eyes when the VR loop set them
+    if (!FrustumCulling::IsStereo()) {
+        FrustumCulling::SetView(SceneData.PV);
+    }
+
     // render Scene
     pShader = StaticMesh::sShader();
     pShader->UseProgram();
@@ -133,6 +159,7 @@ void GameScene::Render()
 
     pShader->setUniform("M", gMapMesh->GetModelMatrix());
     pShader->setUniform("Mode", 0);
+    gMapMesh->SetWorldMatrix(gMapMesh->GetModelMatrix());
     gMapMesh->Render();
 
     // render Anime Mesh
@@ -148,13 +175,18 @@ void GameScene::Render()
     // Freddy
     pShader->setUniform("M", gFreddy.GetModelMatrix());
     pShader->setUniform("Mode", 1);
+    gFreddy.mMesh->SetWorldMatrix(gFreddy.GetModelMatrix());
     gFreddy.mMesh->Render();
 
     // Bunny
     pShader->setUniform("M", gBunny.GetModelMatrix());
     pShader->setUniform("Mode", 1);
+    gBunny.mMesh->SetWorldMatrix(gBunny.GetModelMatrix());
     gBunny.mMesh->Render();
 
+    // Animatronics sharing a mesh are drawn together here
+    SkinnedBatch::Flush();
+
     //    DebugDraw::DrawAxis();
 }
 
@@ -167,6 +199,11 @@ void GameScene::Idle()
     constexpr float fixed_time_step = 1.0f / 60.0f;
     static float time_passed = 0.0f; // update fixed step every 1/60 sec
 
+    // Finish a frame's worth of background loads before anything reads the meshes
+    AssetLoader::Update();
+    FrustumCulling::BeginFrame();
+    AnimationLod::BeginFrame();
+
     static float prev_time_sec = 0.0f;
     float time_sec = static_cast<float>(glfwGetTime());
     const float dt = time_sec - prev_time_sec;
@@ -205,6 +242,9 @@ void GameScene::Idle()
         gBunny.mMesh->Update(mesh_time_sec);
     }
 
+    // Evaluate all skinned meshes in parallel, Render() draws last frame's poses meanwhile
+    AnimationSystem::Dispatch();
+
     //StaticMesh::sShader()->setUniform("time", time_sec);
 
     // Pawn
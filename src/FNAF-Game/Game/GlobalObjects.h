@@ -27,6 +27,7 @@ struct SceneUniforms {
     glm::mat4 V = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     glm::mat4 PV {}; // camera projection * view matrix
     glm::vec4 eye_w = glm::vec4(0.0f, 0.0f, 3.0f, 1.0f); // world-space eye position
+    glm::ivec4 Viewport = glm::ivec4(0); // x, y, width, height of the view being rendered, 0 until a loop sets it
 };
 inline SceneUniforms SceneData;
 
@@ -0,0 +1,121 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define ANIMATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace Animation {
+
+void LoadClips(const MeshCache::View& View, std::vector<AnimationClip>& Clips)
+{
+    const size_t First = Clips.size();
+    Clips.resize(First + View.Animations.Size);
+
+    for (unsigned int a = 0; a < View.Animations.Size; a++) {
+        const MeshCache::Animation& src = View.Animations[a];
+        AnimationClip& clip = Clips[First + a];
+        clip.Name = View.String(src.Name);
+        clip.Duration = src.Duration;
+        clip.TicksPerSecond = src.TicksPerSecond;
+        clip.ChannelNames.resize(src.NumChannels);
+        clip.NodeChannels.clear();
+        clip.ChannelNodes.clear();
+
+        for (unsigned int c = 0; c < src.NumChannels; c++) {
+            clip.ChannelNames[c] = View.String(View.Channels[src.FirstChannel + c].NodeName);
+        }
+        ClipCompression::Load(View, a, clip.Tracks);
+    }
+}
+
+void SampleChannel(const AnimationClip& Clip, unsigned int Channel, float AnimationTime, KeyCursor& Cursor,
+    aiVector3D& Translation, aiQuaternion& Rotation, aiVector3D& Scaling)
+{
+    ClipCompression::SampleTranslation(Clip.Tracks, Channel, AnimationTime, Cursor.Position, Translation);
+    ClipCompression::SampleRotation(Clip.Tracks, Channel, AnimationTime, Cursor.Rotation, Rotation);
+    ClipCompression::SampleScaling(Clip.Tracks, Channel, AnimationTime, Cursor.Scaling, Scaling);
+}
+
+void Nlerp(aiQuaternion& Out, const aiQuaternion& A, const aiQuaternion& B, float Factor)
+{
+#if ANIMATION_SSE
+    static_assert(sizeof(aiQuaternion) == 4 * sizeof(float), "aiQuaternion must be 4 packed floats");
+
+    const __m128 a = _mm_loadu_ps(&A.w);
+    __m128 b = _mm_loadu_ps(&B.w);
+
+    // Horizontal dot product, result in every lane
+    __m128 dot = _mm_mul_ps(a, b);
+    dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2, 3, 0, 1)));
+    dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    // Flip B onto the same hemisphere as A: copy the sign bit of the dot product into B
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    b = _mm_xor_ps(b, _mm_and_ps(dot, signMask));
+
+    __m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(Factor)));
+
+    __m128 len = _mm_mul_ps(r, r);
+    len = _mm_add_ps(len, _mm_shuffle_ps(len, len, _MM_SHUFFLE(2, 3, 0, 1)));
+    len = _mm_add_ps(len, _mm_shuffle_ps(len, len, _MM_SHUFFLE(1, 0, 3, 2)));
+    r = _mm_div_ps(r, _mm_sqrt_ps(len));
+
+    _mm_storeu_ps(&Out.w, r);
+#else
+    NlerpScalar(Out, A, B, Factor);
+#endif
+}
+
+void NlerpScalar(aiQuaternion& Out, const aiQuaternion& A, const aiQuaternion& B, float Factor)
+{
+    const float Dot = A.w * B.w + A.x * B.x + A.y * B.y + A.z * B.z;
+    const float Sign = Dot < 0.0f ? -1.0f : 1.0f;
+    Out.w = A.w + (Sign * B.w - A.w) * Factor;
+    Out.x = A.x + (Sign * B.x - A.x) * Factor;
+    Out.y = A.y + (Sign * B.y - A.y) * Factor;
+    Out.z = A.z + (Sign * B.z - A.z) * Factor;
+    Out.Normalize();
+}
+
+void BlendOverride(LocalPose& Pose, unsigned int Node, const aiVector3D& Translation, const aiQuaternion& Rotation,
+    const aiVector3D& Scaling, float Weight)
+{
+    if (Weight >= 1.0f) {
+        Pose.Translations[Node] = Translation;
+        Pose.Rotations[Node] = Rotation;
+        Pose.Scalings[Node] = Scaling;
+        return;
+    }
+
+    Pose.Translations[Node] += (Translation - Pose.Translations[Node]) * Weight;
+    Pose.Scalings[Node] += (Scaling - Pose.Scalings[Node]) * Weight;
+    Nlerp(Pose.Rotations[Node], Pose.Rotations[Node], Rotation, Weight);
+}
+
+void BlendAdditive(LocalPose& Pose, unsigned int Node, const aiVector3D& Translation, const aiQuaternion& Rotation,
+    const aiVector3D& Scaling, const aiVector3D& RefTranslation, const aiQuaternion& RefRotation,
+    const aiVector3D& RefScaling, float Weight)
+{
+    Pose.Translations[Node] += (Translation - RefTranslation) * Weight;
+
+    aiVector3D& S = Pose.Scalings[Node];
+    S.x *= 1.0f + (RefScaling.x != 0.0f ? Scaling.x / RefScaling.x - 1.0f : 0.0f) * Weight;
+    S.y *= 1.0f + (RefScaling.y != 0.0f ? Scaling.y / RefScaling.y - 1.0f : 0.0f) * Weight;
+    S.z *= 1.0f + (RefScaling.z != 0.0f ? Scaling.z / RefScaling.z - 1.0f : 0.0f) * Weight;
+
+    // Delta = Ref^-1 * Sample, faded in from identity
+    aiQuaternion InvRef = RefRotation;
+    InvRef.Conjugate();
+    aiQuaternion Delta = InvRef * Rotation;
+    if (Weight < 1.0f) {
+        Nlerp(Delta, aiQuaternion(), Delta, Weight);
+    }
+    Pose.Rotations[Node] = Pose.Rotations[Node] * Delta;
+}
+
+}
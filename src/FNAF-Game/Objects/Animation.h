@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <assimp/vector3.h>
+#include <assimp/quaternion.h>
+
+#include "ClipCompression.h"
+#include "MeshCache.h"
+
+// Last key segment used by each track of a channel. Playback is almost always monotonic,
+// so the next lookup is usually the same or the following segment: O(1) instead of a scan.
+// Cursors are per-instance playback state, clips stay read-only.
+struct KeyCursor {
+    unsigned int Position = 0;
+    unsigned int Rotation = 0;
+    unsigned int Scaling = 0;
+};
+
+struct AnimationClip {
+    std::string Name;
+    float Duration = 0.0f;
+    float TicksPerSecond = 0.0f;
+    std::vector<std::string> ChannelNames; // node each channel drives
+    ClipCompression::Clip Tracks;
+
+    // Channel index driving each skeleton node, -1 if the node keeps its bind transform,
+    // and the skeleton node driven by each channel (-1 if the skeleton has no such node).
+    // Filled by Skeleton::BindClip so evaluation never looks anything up by name.
+    std::vector<int> NodeChannels;
+    std::vector<int> ChannelNodes;
+
+    [[nodiscard]] unsigned int GetNumChannels() const { return static_cast<unsigned int>(ChannelNames.size()); }
+    [[nodiscard]] float GetTicksPerSecond() const { return TicksPerSecond != 0.0f ? TicksPerSecond : 25.0f; }
+};
+
+// Local-space (parent relative) transform of every skeleton node, stored as separate
+// streams so blending touches only the components it needs
+struct LocalPose {
+    std::vector<aiVector3D> Translations;
+    std::vector<aiQuaternion> Rotations;
+    std::vector<aiVector3D> Scalings;
+
+    void Resize(unsigned int NumNodes)
+    {
+        Translations.resize(NumNodes);
+        Rotations.resize(NumNodes);
+        Scalings.resize(NumNodes);
+    }
+};
+
+namespace Animation {
+
+// Append every clip of a mesh cache view, as compressed when the cache was baked
+void LoadClips(const MeshCache::View& View, std::vector<AnimationClip>& Clips);
+
+// Sample the local transform a channel drives at AnimationTime (ticks). Parts of the transform
+// the clip has no keys for are left as passed in, callers start from the bind pose.
+void SampleChannel(const AnimationClip& Clip, unsigned int Channel, float AnimationTime, KeyCursor& Cursor,
+    aiVector3D& Translation, aiQuaternion& Rotation, aiVector3D& Scaling);
+
+// Normalized lerp along the shortest arc, SSE when available
+void Nlerp(aiQuaternion& Out, const aiQuaternion& A, const aiQuaternion& B, float Factor);
+// Same, one component at a time: what Nlerp() does without SSE, and the reference for it
+void NlerpScalar(aiQuaternion& Out, const aiQuaternion& A, const aiQuaternion& B, float Factor);
+
+// Blend a sampled local transform into node Node of Pose with weight Weight (1 overwrites)
+void BlendOverride(LocalPose& Pose, unsigned int Node, const aiVector3D& Translation, const aiQuaternion& Rotation,
+    const aiVector3D& Scaling, float Weight);
+
+// Apply the difference between a sampled and a reference transform on top of node Node, scaled by Weight
+void BlendAdditive(LocalPose& Pose, unsigned int Node, const aiVector3D& Translation, const aiQuaternion& Rotation,
+    const aiVector3D& Scaling, const aiVector3D& RefTranslation, const aiQuaternion& RefRotation,
+    const aiVector3D& RefScaling, float Weight);
+
+}
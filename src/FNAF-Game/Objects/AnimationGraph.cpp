@@ -0,0 +1,192 @@
+#include "AnimationGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "Skeleton.h"
+
+void AnimationGraph::Init(const Skeleton* pSkeleton, const std::vector<AnimationClip>* pClips)
+{
+    mSkeleton = pSkeleton;
+    mClips = pClips;
+
+    // Base layer, plays the first clip like the single-clip player used to
+    mLayers.clear();
+    AddLayer(BlendMode::Override);
+    if (!mClips->empty()) {
+        Play(0, 0, 0.0f);
+    }
+}
+
+int AnimationGraph::FindClip(const std::string& Name) const
+{
+    for (unsigned int i = 0; i < mClips->size(); i++) {
+        if ((*mClips)[i].Name == Name) {
+            return static_cast<int>(i);
+        }
+    }
+    return InvalidClip;
+}
+
+unsigned int AnimationGraph::AddLayer(BlendMode Mode, float Weight)
+{
+    Layer L;
+    L.Mode = Mode;
+    L.Weight = Weight;
+    mLayers.push_back(std::move(L));
+    return static_cast<unsigned int>(mLayers.size() - 1);
+}
+
+void AnimationGraph::SetLayerWeight(unsigned int Layer, float Weight)
+{
+    assert(Layer < mLayers.size());
+    mLayers[Layer].Weight = Weight;
+}
+
+void AnimationGraph::StartClip(ClipState& State, int Clip, float Time, float Speed, bool Loop) const
+{
+    State.Clip = Clip;
+    State.StartTime = Time;
+    State.Speed = Speed;
+    State.Loop = Loop;
+    State.Cursors.assign(Clip != InvalidClip ? (*mClips)[Clip].GetNumChannels() : 0, KeyCursor());
+}
+
+void AnimationGraph::Play(unsigned int Layer, int Clip, float Time, float FadeSeconds, float Speed, bool Loop)
+{
+    assert(Layer < mLayers.size());
+    assert(Clip >= 0 && Clip < static_cast<int>(mClips->size()));
+
+    auto& L = mLayers[Layer];
+
+    if (L.Mode == BlendMode::Override) {
+        // Keep the outgoing clip running while the new one fades in
+        std::swap(L.Previous, L.Current);
+        if (FadeSeconds <= 0.0f) {
+            L.Previous.Clip = InvalidClip;
+        }
+    } else {
+        // Additive layers fade the new clip in from no motion
+        L.Previous.Clip = InvalidClip;
+    }
+
+    StartClip(L.Current, Clip, Time, Speed, Loop);
+    L.FadeStart = Time;
+    L.FadeDuration = FadeSeconds;
+
+    if (L.Mode == BlendMode::Additive) {
+        SampleReference(L);
+    }
+}
+
+void AnimationGraph::Stop(unsigned int Layer, float Time, float FadeSeconds)
+{
+    assert(Layer < mLayers.size());
+
+    auto& L = mLayers[Layer];
+    std::swap(L.Previous, L.Current);
+    L.Current.Clip = InvalidClip;
+    if (FadeSeconds <= 0.0f) {
+        L.Previous.Clip = InvalidClip;
+    }
+    L.FadeStart = Time;
+    L.FadeDuration = FadeSeconds;
+}
+
+float AnimationGraph::ClipTime(const ClipState& State, float Time) const
+{
+    const AnimationClip& Clip = (*mClips)[State.Clip];
+    const float Ticks = (Time - State.StartTime) * State.Speed * Clip.GetTicksPerSecond();
+
+    if (Clip.Duration <= 0.0f) {
+        return 0.0f;
+    }
+    if (State.Loop) {
+        const float t = std::fmod(Ticks, Clip.Duration);
+        return t < 0.0f ? t + Clip.Duration : t;
+    }
+    return std::clamp(Ticks, 0.0f, Clip.Duration);
+}
+
+void AnimationGraph::SampleReference(Layer& L) const
+{
+    const AnimationClip& Clip = (*mClips)[L.Current.Clip];
+    const auto NumChannels = Clip.GetNumChannels();
+    const LocalPose& Bind = mSkeleton->GetBindPose();
+
+    L.Reference.Resize(NumChannels);
+    for (unsigned int c = 0; c < NumChannels; c++) {
+        const int Node = Clip.ChannelNodes[c];
+        if (Node >= 0) {
+            L.Reference.Translations[c] = Bind.Translations[Node];
+            L.Reference.Rotations[c] = Bind.Rotations[Node];
+            L.Reference.Scalings[c] = Bind.Scalings[Node];
+        }
+        KeyCursor Cursor;
+        Animation::SampleChannel(Clip, c, 0.0f, Cursor, L.Reference.Translations[c], L.Reference.Rotations[c], L.Reference.Scalings[c]);
+    }
+}
+
+void AnimationGraph::BlendClip(const Layer& L, ClipState& State, float Time, float Weight, LocalPose& Pose) const
+{
+    if (State.Clip == InvalidClip || Weight <= 0.0f) {
+        return;
+    }
+
+    const AnimationClip& Clip = (*mClips)[State.Clip];
+    const float AnimationTime = ClipTime(State, Time);
+    const auto NumChannels = Clip.GetNumChannels();
+    const LocalPose& Bind = mSkeleton->GetBindPose();
+
+    for (unsigned int c = 0; c < NumChannels; c++) {
+        const int Node = Clip.ChannelNodes[c];
+        if (Node < 0) {
+            continue;
+        }
+
+        aiVector3D Translation = Bind.Translations[Node];
+        aiQuaternion Rotation = Bind.Rotations[Node];
+        aiVector3D Scaling = Bind.Scalings[Node];
+        Animation::SampleChannel(Clip, c, AnimationTime, State.Cursors[c], Translation, Rotation, Scaling);
+
+        if (L.Mode == BlendMode::Override) {
+            Animation::BlendOverride(Pose, Node, Translation, Rotation, Scaling, Weight);
+        } else {
+            Animation::BlendAdditive(Pose, Node, Translation, Rotation, Scaling,
+                L.Reference.Translations[c], L.Reference.Rotations[c], L.Reference.Scalings[c], Weight);
+        }
+    }
+}
+
+void AnimationGraph::Evaluate(float Time, LocalPose& Pose)
+{
+    assert(mSkeleton != nullptr);
+
+    Pose = mSkeleton->GetBindPose();
+
+    for (auto& L : mLayers) {
+        if (L.Weight <= 0.0f) {
+            continue;
+        }
+
+        float Fade = 1.0f;
+        if (L.FadeDuration > 0.0f) {
+            Fade = std::clamp((Time - L.FadeStart) / L.FadeDuration, 0.0f, 1.0f);
+        }
+        if (Fade >= 1.0f) {
+            L.Previous.Clip = InvalidClip;
+        }
+
+        if (L.Current.Clip == InvalidClip) {
+            // Stopped, fading out
+            BlendClip(L, L.Previous, Time, L.Weight * (1.0f - Fade), Pose);
+        } else if (L.Mode == BlendMode::Override) {
+            // Cross-fade: outgoing clip first, incoming clip over it. Exact for full-weight layers.
+            BlendClip(L, L.Previous, Time, L.Weight, Pose);
+            BlendClip(L, L.Current, Time, L.Previous.Clip != InvalidClip ? L.Weight * Fade : L.Weight, Pose);
+        } else {
+            BlendClip(L, L.Current, Time, L.Weight * Fade, Pose);
+        }
+    }
+}
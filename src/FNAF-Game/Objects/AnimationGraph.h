@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+
+class Skeleton;
+
+// Layered clip blending in local space.
+//
+// Layer 0 is the base layer. Every layer plays one clip and can cross-fade from the clip it
+// played before; override layers blend over the layers below them with their weight,
+// additive layers add their clip's motion relative to the clip's first frame. Evaluation
+// starts from the bind pose and only visits the channels of the clips that are actually
+// playing, so the cost follows active channels, not the number of loaded clips.
+//
+// Times are absolute seconds as passed to SkinnedMesh::Update.
+class AnimationGraph {
+public:
+    enum class BlendMode {
+        Override,
+        Additive,
+    };
+
+    static const int InvalidClip = -1;
+
+    // The clips must already be bound to the skeleton
+    void Init(const Skeleton* pSkeleton, const std::vector<AnimationClip>* pClips);
+
+    [[nodiscard]] int FindClip(const std::string& Name) const;
+
+    unsigned int AddLayer(BlendMode Mode, float Weight = 1.0f);
+    void SetLayerWeight(unsigned int Layer, float Weight);
+    [[nodiscard]] unsigned int GetNumLayers() const { return static_cast<unsigned int>(mLayers.size()); }
+
+    // Start Clip on Layer at Time, cross-fading from the layer's current clip over FadeSeconds
+    void Play(unsigned int Layer, int Clip, float Time, float FadeSeconds = 0.0f, float Speed = 1.0f, bool Loop = true);
+    // Fade the layer out over FadeSeconds
+    void Stop(unsigned int Layer, float Time, float FadeSeconds = 0.0f);
+
+    void Evaluate(float Time, LocalPose& Pose);
+
+private:
+    struct ClipState {
+        int Clip = InvalidClip;
+        float StartTime = 0.0f;
+        float Speed = 1.0f;
+        bool Loop = true;
+        std::vector<KeyCursor> Cursors;
+    };
+
+    struct Layer {
+        BlendMode Mode = BlendMode::Override;
+        float Weight = 1.0f;
+
+        ClipState Current;
+        ClipState Previous; // fading out
+        float FadeStart = 0.0f;
+        float FadeDuration = 0.0f;
+
+        // Additive layers: first frame of the current clip per channel
+        LocalPose Reference;
+    };
+
+    [[nodiscard]] float ClipTime(const ClipState& State, float Time) const;
+    void StartClip(ClipState& State, int Clip, float Time, float Speed, bool Loop) const;
+    void SampleReference(Layer& L) const;
+    void BlendClip(const Layer& L, ClipState& State, float Time, float Weight, LocalPose& Pose) const;
+
+    const Skeleton* mSkeleton = nullptr;
+    const std::vector<AnimationClip>* mClips = nullptr;
+    std::vector<Layer> mLayers;
+};
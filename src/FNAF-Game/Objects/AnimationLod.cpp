@@ -0,0 +1,67 @@
+#include "AnimationLod.h"
+
+#include <algorithm>
+
+#include "Timer.h"
+
+#include "FrustumCulling.h"
+#include "MeshLod.h"
+
+namespace AnimationLod {
+
+namespace {
+
+    struct Stats {
+        size_t Evaluated = 0;
+        size_t Blended = 0;
+        size_t Skipped = 0;
+    } sStats;
+
+}
+
+unsigned int SelectInterval(const glm::vec3& BbMin, const glm::vec3& BbMax, const glm::mat4& M)
+{
+    if (!sEnabled) {
+        return 1;
+    }
+
+    const glm::vec3 Center = glm::vec3(M * glm::vec4(0.5f * (BbMin + BbMax), 1.0f));
+    const float Scale = std::max(glm::length(glm::vec3(M[0])), std::max(glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))));
+    const float Radius = 0.5f * glm::length(BbMax - BbMin) * Scale;
+
+    if (!FrustumCulling::GetFrustum().IntersectsSphere(Center, Radius * sBoundsMargin)) {
+        return 0;
+    }
+
+    // No camera yet: full rate
+    const float Pixels = MeshLod::ProjectedRadius(Center, Radius);
+    if (Pixels <= 0.0f || Pixels >= sFullRatePixels) {
+        return 1;
+    }
+    return std::max(Pixels >= sReducedRatePixels ? sReducedInterval : sFarInterval, 1u);
+}
+
+void Count(Step S)
+{
+    switch (S) {
+    case Step::Skip:
+        sStats.Skipped++;
+        break;
+    case Step::Blend:
+        sStats.Blended++;
+        break;
+    default:
+        sStats.Evaluated++;
+        break;
+    }
+}
+
+void BeginFrame()
+{
+    TimerGui::SetCounter("Anim: poses evaluated", static_cast<double>(sStats.Evaluated));
+    TimerGui::SetCounter("Anim: poses blended", static_cast<double>(sStats.Blended));
+    TimerGui::SetCounter("Anim: evaluations skipped", static_cast<double>(sStats.Skipped + sStats.Blended));
+    sStats = Stats();
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Animation update LOD: how often a skinned mesh's pose is evaluated.
+//
+// Meshes in view whose bounding sphere covers at least sFullRatePixels on screen are evaluated
+// every frame. Smaller ones are evaluated every sReducedInterval or sFarInterval frames, each time
+// for where their clock will be at the end of the interval, and blend their palettes towards that
+// pose on the frames in between. Meshes out of view, or whose clock and animation graph didn't
+// change, aren't evaluated at all. Their clock keeps running, so the next evaluation lands on the
+// right pose.
+namespace AnimationLod {
+
+// How a mesh's pose is made this frame
+enum class Step {
+    Skip, // keep the current palette
+    Evaluate, // evaluate at the current time
+    EvaluateAhead, // evaluate at the end of a reduced rate interval, then blend
+    Blend, // blend towards the pose evaluated ahead
+};
+
+inline bool sEnabled = true;
+inline float sFullRatePixels = 100.0f; // projected radius of the bounding sphere
+inline float sReducedRatePixels = 30.0f;
+inline unsigned int sReducedInterval = 2; // frames between evaluations
+inline unsigned int sFarInterval = 4;
+// Scale of the bind pose bounding sphere for the visibility test: out of view meshes keep their
+// palette, so the sphere must also hold limbs that animate out of the bind pose
+inline float sBoundsMargin = 1.5f;
+
+// Frames between evaluations of a mesh with this model space box and model matrix, 0 if it is
+// out of the frame's view
+[[nodiscard]] unsigned int SelectInterval(const glm::vec3& BbMin, const glm::vec3& BbMax, const glm::mat4& M);
+
+// Statistics, main thread. BeginFrame() publishes the last frame's counts to the timer UI.
+void Count(Step S);
+void BeginFrame();
+
+}
@@ -0,0 +1,80 @@
+#include "AnimationSystem.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "SkinnedMesh.h"
+
+namespace AnimationSystem {
+
+namespace {
+
+    struct State {
+        std::vector<SkinnedMesh*> Meshes;
+        TaskGroup InFlight;
+        bool Pending = false;
+    };
+
+    // Never destroyed: meshes living in globals unregister during static destruction
+    State& GetState()
+    {
+        static State* sState = new State();
+        return *sState;
+    }
+
+    void Publish(State& state)
+    {
+        ThreadPool::Get().Wait(state.InFlight);
+
+        if (state.Pending) {
+            for (SkinnedMesh* mesh : state.Meshes) {
+                mesh->SwapPalettes();
+            }
+            state.Pending = false;
+        }
+    }
+}
+
+void Register(SkinnedMesh* mesh)
+{
+    State& state = GetState();
+    Publish(state);
+
+    if (std::find(state.Meshes.begin(), state.Meshes.end(), mesh) == state.Meshes.end()) {
+        state.Meshes.push_back(mesh);
+    }
+}
+
+void Unregister(SkinnedMesh* mesh)
+{
+    State& state = GetState();
+    Publish(state);
+
+    state.Meshes.erase(std::remove(state.Meshes.begin(), state.Meshes.end(), mesh), state.Meshes.end());
+}
+
+void Dispatch()
+{
+    State& state = GetState();
+    Publish(state);
+
+    if (state.Meshes.empty()) {
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::Get();
+    for (SkinnedMesh* mesh : state.Meshes) {
+        if (mesh->PreparePose()) {
+            pool.Submit([mesh]() { mesh->EvaluatePose(); }, &state.InFlight);
+        }
+    }
+    state.Pending = true;
+}
+
+void Sync()
+{
+    Publish(GetState());
+}
+
+}
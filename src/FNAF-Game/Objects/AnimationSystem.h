@@ -0,0 +1,22 @@
+#pragma once
+
+class SkinnedMesh;
+
+// Evaluates the poses of every registered SkinnedMesh in parallel on the shared ThreadPool.
+//
+// Each frame SkinnedMesh::Update only records the animation time. Dispatch() then waits
+// for the previous batch (normally long finished), publishes its palettes and starts
+// evaluating the new times into each mesh's back palette, for the meshes AnimationLod doesn't
+// skip. Rendering reads the front palette, i.e. last frame's pose, and never waits on the workers.
+namespace AnimationSystem {
+
+void Register(SkinnedMesh* mesh);
+// Waits for in-flight jobs first, so the mesh can be destroyed right after
+void Unregister(SkinnedMesh* mesh);
+
+// Publish the previous batch and start evaluating the current one. Call once per frame after all Update()s.
+void Dispatch();
+// Block until the in-flight batch is finished and publish it
+void Sync();
+
+}
@@ -0,0 +1,98 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
+
+namespace AssetLoader {
+
+namespace {
+
+    // Decoded payloads waiting for the render thread are capped here; loader threads block
+    // once it is reached, which bounds staging memory during a big load
+    constexpr size_t UploadQueueCapacity = 256u << 20;
+
+    std::atomic<int> sPendingJobs = 0;
+}
+
+ThreadPool& GetPool()
+{
+    // Separate from ThreadPool::Get(): loader jobs block on I/O and on a full upload queue and
+    // must never be picked up by a frame-critical thread helping out in ThreadPool::Wait().
+    // Never destroyed, like the shared pool.
+    static ThreadPool* sPool = new ThreadPool(std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
+    return *sPool;
+}
+
+ThreadPool& GetCpuStagePool(bool Async)
+{
+    return Async ? GetPool() : ThreadPool::Get();
+}
+
+UploadQueue& GetUploadQueue()
+{
+    static UploadQueue* sQueue = new UploadQueue(UploadQueueCapacity);
+    return *sQueue;
+}
+
+void Submit(std::function<void()> job)
+{
+    sPendingJobs.fetch_add(1, std::memory_order_relaxed);
+    GetPool().Submit([job = std::move(job)]() {
+        job();
+        sPendingJobs.fetch_sub(1, std::memory_order_release);
+    });
+}
+
+void Update()
+{
+    GetUploadQueue().Drain(UploadBudgetBytes);
+}
+
+bool IsIdle()
+{
+    return sPendingJobs.load(std::memory_order_acquire) == 0 && GetUploadQueue().GetQueuedCount() == 0;
+}
+
+bool DecodeMaterialTextures(const MeshCache::View& View, const std::string& Filename, const char* Separator,
+    std::vector<ImageData>& Images, ThreadPool& Pool)
+{
+    // Extract the directory part from the file name
+    std::string::size_type SlashIndex = Filename.find_last_of('\\');
+    std::string Dir;
+
+    if (SlashIndex == std::string::npos) {
+        Dir = ".";
+    } else if (SlashIndex == 0) {
+        Dir = "\\";
+    } else {
+        Dir = Filename.substr(0, SlashIndex);
+    }
+
+    for (ImageData& Image : Images) {
+        ReleaseImage(Image);
+    }
+    Images.resize(View.Materials.Size);
+
+    // Decode and mip generation dominate the load time of texture heavy meshes, spread the
+    // textures over the pool. The calling thread helps out while it waits.
+    std::atomic<bool> Ret = true;
+    Pool.ParallelFor(0, View.Materials.Size, 1, [&](unsigned int i) {
+        if (View.Materials[i].DiffusePath != MeshCache::InvalidIndex) {
+            std::string FullPath = Dir + Separator + View.String(View.Materials[i].DiffusePath);
+
+            // Baked blocks skip both the decode and the mip chain
+            if (!TextureCache::Load(FullPath, Images[i]) && !DecodeImage(FullPath, Images[i])) {
+                Ret = false;
+            }
+        }
+    });
+
+    return Ret;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "LoadTexture.h"
+#include "MeshCache.h"
+
+class ThreadPool;
+class UploadQueue;
+
+// Background asset loading.
+//
+// Loads are split in two stages. The CPU stage (file I/O, cache mapping or Assimp import,
+// image decode) runs on a dedicated loader pool and never touches GL. It hands its results
+// to a bounded UploadQueue as small GL jobs (one per buffer set / texture), which Update()
+// drains on the render thread within a per-frame byte budget. Rendering keeps going while
+// assets stream in; meshes simply draw nothing until their last upload ran.
+namespace AssetLoader {
+
+// Bytes uploaded per frame at most (one oversized upload still goes through)
+inline size_t UploadBudgetBytes = 16u << 20;
+
+ThreadPool& GetPool();
+UploadQueue& GetUploadQueue();
+
+// Run a CPU stage job on the loader pool
+void Submit(std::function<void()> job);
+
+// Render thread, once per frame: run queued uploads within UploadBudgetBytes
+void Update();
+
+// No CPU stage running and no upload queued
+[[nodiscard]] bool IsIdle();
+
+// Pool for the fan-out of a CPU stage: the loader pool for loader jobs, the shared pool for
+// synchronous loads. The render thread must never wait on the loader pool: it would help out by
+// running a queued load, which can block on the full upload queue only the render thread drains.
+ThreadPool& GetCpuStagePool(bool Async);
+
+// CPU stage helper: read the diffuse texture of every material of a mesh, in parallel on Pool
+// (see GetCpuStagePool). Baked TextureCache blocks are preferred, otherwise the image is decoded
+// with its mip chain. Images[i] stays empty for materials without a texture.
+// Returns false if a texture failed to decode.
+// Separator joins the mesh directory and the texture path, as the mesh classes always did.
+bool DecodeMaterialTextures(const MeshCache::View& View, const std::string& Filename, const char* Separator,
+    std::vector<ImageData>& Images, ThreadPool& Pool);
+
+[[nodiscard]] inline size_t GetImageBytes(const ImageData& Image) { return Image.Pixels.size(); }
+
+}
@@ -0,0 +1,94 @@
+#include "BonePalette.h"
+
+#include <cstring>
+
+namespace BonePalette {
+
+void Pack(const aiMatrix4x4* pPalette, unsigned int Count, Mat3x4* pOut)
+{
+    // aiMatrix4x4 is row major, so its first 12 floats are the rows we keep
+    static_assert(sizeof(aiMatrix4x4) == 16 * sizeof(float), "aiMatrix4x4 of floats");
+    for (unsigned int i = 0; i < Count; i++) {
+        std::memcpy(pOut[i].Rows, &pPalette[i].a1, sizeof(Mat3x4));
+    }
+}
+
+void Pack(const glm::mat4& M, Mat3x4& Out)
+{
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            Out.Rows[r][c] = M[c][r];
+        }
+    }
+}
+
+void RingAllocator::Init(uint32_t Capacity)
+{
+    mCapacity = Capacity;
+    mHead = 0;
+    mTail = 0;
+    mUsed = 0;
+    mOpenUsed = 0;
+    mFrames.clear();
+}
+
+uint32_t RingAllocator::Allocate(uint32_t Count)
+{
+    if (Count == 0 || Count > mCapacity) {
+        return InvalidOffset;
+    }
+
+    if (mUsed == 0) {
+        // Nothing in flight: start over at the front, the longest run there is
+        mHead = 0;
+        mTail = 0;
+    }
+
+    uint32_t Padding = 0;
+    if (mUsed == 0 || mHead > mTail) {
+        // Free space is [mHead, mCapacity) then [0, mTail)
+        if (mCapacity - mHead < Count) {
+            if (mTail < Count) {
+                return InvalidOffset;
+            }
+            Padding = mCapacity - mHead;
+        }
+    }
+    else if (mTail - mHead < Count) {
+        // Wrapped, or full when mHead == mTail: free space is [mHead, mTail)
+        return InvalidOffset;
+    }
+
+    const uint32_t Offset = Padding > 0 ? 0 : mHead;
+    mHead = Offset + Count;
+    if (mHead == mCapacity) {
+        mHead = 0;
+    }
+
+    mUsed += Padding + Count;
+    mOpenUsed += Padding + Count;
+    return Offset;
+}
+
+void RingAllocator::EndFrame()
+{
+    mFrames.push_back({ mHead, mOpenUsed });
+    mOpenUsed = 0;
+}
+
+bool RingAllocator::Retire()
+{
+    if (mFrames.empty()) {
+        return false;
+    }
+
+    const Frame& Oldest = mFrames.front();
+    mUsed -= Oldest.Used;
+    if (Oldest.Used > 0) {
+        mTail = Oldest.End;
+    }
+    mFrames.pop_front();
+    return true;
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <assimp/matrix4x4.h>
+#include <glm/glm.hpp>
+
+// Bone palettes and per-instance data for instanced skinned draws, built on the CPU.
+//
+// Palettes are stored as affine 3x4 matrices (the three top rows of the 4x4, row major): 48 bytes
+// instead of 64, read in the shader as three vec4s of a std430 vec4 array. Every instance drawn in
+// a frame gets its palette and an instance record written to one shared ring, and the draws find
+// them by offset. RingAllocator hands out those offsets; the ring memory itself and the GPU fences
+// that say when a frame's range may be reused belong to the caller. No GL calls here.
+namespace BonePalette {
+
+// Ring offsets and sizes are counted in slots of one vec4
+struct Slot {
+    float Value[4];
+};
+constexpr size_t SlotBytes = sizeof(Slot);
+
+struct Mat3x4 {
+    float Rows[3][4];
+};
+static_assert(sizeof(Mat3x4) == 3 * SlotBytes, "three vec4 slots per matrix");
+
+// What the shader reads per drawn instance, 4 slots
+struct InstanceRecord {
+    Mat3x4 Model;
+    uint32_t PaletteOffset; // first slot of the instance's palette
+    uint32_t NumBones;
+    uint32_t Pad[2];
+};
+static_assert(sizeof(InstanceRecord) == 4 * SlotBytes, "tightly packed instance record");
+
+constexpr uint32_t SlotsPerBone = sizeof(Mat3x4) / SlotBytes;
+constexpr uint32_t SlotsPerInstance = sizeof(InstanceRecord) / SlotBytes;
+
+// Top three rows of each matrix. The bottom row of a skinning matrix is (0, 0, 0, 1).
+void Pack(const aiMatrix4x4* pPalette, unsigned int Count, Mat3x4* pOut);
+// Same for a column major glm model matrix
+void Pack(const glm::mat4& M, Mat3x4& Out);
+
+// First-in first-out allocator over a ring of Capacity slots.
+//
+// Allocations are contiguous: one that doesn't fit before the end of the ring skips the rest of it
+// and starts over at slot 0. Allocations belong to the open frame until EndFrame(); Retire() frees
+// the oldest ended frame, once the caller knows the GPU is done with it.
+class RingAllocator {
+public:
+    static constexpr uint32_t InvalidOffset = 0xFFFFFFFF;
+
+    void Init(uint32_t Capacity);
+
+    // Offset of Count contiguous slots, InvalidOffset if they don't fit until frames are retired
+    uint32_t Allocate(uint32_t Count);
+
+    // Close the open frame. Empty frames are recorded too, so every EndFrame has its Retire.
+    void EndFrame();
+    // Free the oldest ended frame. Returns false if there was none.
+    bool Retire();
+
+    [[nodiscard]] uint32_t GetCapacity() const { return mCapacity; }
+    // Slots held by unretired frames, the open one included, wrap padding included
+    [[nodiscard]] uint32_t GetUsed() const { return mUsed; }
+    [[nodiscard]] size_t GetNumFramesInFlight() const { return mFrames.size(); }
+
+private:
+    struct Frame {
+        uint32_t End; // head when the frame ended
+        uint32_t Used; // slots it took, padding included
+    };
+
+    uint32_t mCapacity = 0;
+    uint32_t mHead = 0; // next free slot
+    uint32_t mTail = 0; // first slot of the oldest frame
+    uint32_t mUsed = 0;
+    uint32_t mOpenUsed = 0; // part of mUsed in the open frame
+    std::deque<Frame> mFrames;
+};
+
+}
@@ -0,0 +1,403 @@
+#include "ClipCompression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+
+#include "Animation.h"
+
+namespace ClipCompression {
+
+namespace {
+
+    constexpr float MaxKeyValue = 65535.0f;
+    constexpr float MaxComponentValue = 32767.0f;
+    // The three smallest components of a unit quaternion are within +-1/sqrt(2)
+    constexpr float SmallestThreeRange = 0.70710678f;
+
+    uint16_t Quantize(float Value, float Min, float InvStep)
+    {
+        return static_cast<uint16_t>(std::clamp(std::lround((Value - Min) * InvStep), 0L, 65535L));
+    }
+
+    aiVector3D InvStep(const aiVector3D& Step)
+    {
+        return aiVector3D(Step.x > 0.0f ? 1.0f / Step.x : 0.0f, Step.y > 0.0f ? 1.0f / Step.y : 0.0f,
+            Step.z > 0.0f ? 1.0f / Step.z : 0.0f);
+    }
+
+    aiVector3D DecodeVector(const Key& K, const aiVector3D& Min, const aiVector3D& Step)
+    {
+        return aiVector3D(Min.x + K.Value[0] * Step.x, Min.y + K.Value[1] * Step.y, Min.z + K.Value[2] * Step.z);
+    }
+
+    aiVector3D LerpVector(const aiVector3D& A, const aiVector3D& B, float Factor)
+    {
+        return A + (B - A) * Factor;
+    }
+
+    float VectorError(const aiVector3D& A, const aiVector3D& B)
+    {
+        return (A - B).Length();
+    }
+
+    aiQuaternion LerpRotation(const aiQuaternion& A, const aiQuaternion& B, float Factor)
+    {
+        aiQuaternion Out;
+        Animation::Nlerp(Out, A, B, Factor);
+        return Out;
+    }
+
+    // Angle between two rotations, from the relative rotation conj(A) * B. The acos of their dot
+    // product can't resolve less than about 7e-4 radians in float, coarser than the tolerances.
+    float RotationError(const aiQuaternion& A, const aiQuaternion& B)
+    {
+        const float w = A.w * B.w + A.x * B.x + A.y * B.y + A.z * B.z;
+        const float x = A.w * B.x - B.w * A.x - (A.y * B.z - A.z * B.y);
+        const float y = A.w * B.y - B.w * A.y - (A.z * B.x - A.x * B.z);
+        const float z = A.w * B.z - B.w * A.z - (A.x * B.y - A.y * B.x);
+        return 2.0f * std::atan2(std::sqrt(x * x + y * y + z * z), std::abs(w));
+    }
+
+    // Indices of the keys to keep: the first one, then greedily the farthest key that still
+    // reproduces every key in between within Tolerance. A single key if the track never leaves
+    // Tolerance around its first key.
+    template <typename SourceKey, typename Lerp, typename Error>
+    void ReduceKeys(const SourceKey* pKeys, unsigned int NumKeys, float Tolerance, Lerp&& Interpolate, Error&& Err,
+        std::vector<unsigned int>& Kept)
+    {
+        Kept.clear();
+        if (NumKeys == 0) {
+            return;
+        }
+        Kept.push_back(0);
+
+        bool Constant = true;
+        for (unsigned int k = 1; k < NumKeys && Constant; k++) {
+            Constant = Err(pKeys[k].Value, pKeys[0].Value) <= Tolerance;
+        }
+        if (Constant) {
+            return;
+        }
+
+        auto Fits = [&](unsigned int First, unsigned int Last) {
+            const float Span = pKeys[Last].Time - pKeys[First].Time;
+            if (Span <= 0.0f) {
+                return false;
+            }
+            for (unsigned int k = First + 1; k < Last; k++) {
+                const float Factor = (pKeys[k].Time - pKeys[First].Time) / Span;
+                if (Err(Interpolate(pKeys[First].Value, pKeys[Last].Value, Factor), pKeys[k].Value) > Tolerance) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        unsigned int Anchor = 0;
+        while (Anchor + 1 < NumKeys) {
+            unsigned int Next = Anchor + 1;
+            while (Next + 1 < NumKeys && Fits(Anchor, Next + 1)) {
+                Next++;
+            }
+            Kept.push_back(Next);
+            Anchor = Next;
+        }
+    }
+
+    void CalcInvSpans(Clip& C)
+    {
+        C.InvSpans.assign(C.Keys.size(), 0.0f);
+        for (const Track& T : C.Tracks) {
+            for (unsigned int k = T.FirstKey; k + 1 < T.FirstKey + T.NumKeys; k++) {
+                const float Span = float(C.Keys[k + 1].Time) - float(C.Keys[k].Time);
+                C.InvSpans[k] = Span > 0.0f ? 1.0f / Span : 0.0f;
+            }
+        }
+    }
+
+    // Bind pose distance from every node to its farthest descendant, along the hierarchy
+    std::vector<float> CalcReach(const MeshCache::View& View)
+    {
+        std::vector<aiMatrix4x4> Globals(View.Nodes.Size);
+        std::vector<float> Reach(View.Nodes.Size, 0.0f);
+        for (size_t i = 0; i < View.Nodes.Size; i++) {
+            const MeshCache::Node& Node = View.Nodes[i];
+            Globals[i] = Node.Parent >= 0 ? Globals[Node.Parent] * Node.Transformation : Node.Transformation;
+        }
+        // Children come after their parents, so walking backwards finishes every subtree first
+        for (size_t i = View.Nodes.Size; i-- > 0;) {
+            const int32_t Parent = View.Nodes[i].Parent;
+            if (Parent >= 0) {
+                const aiVector3D Bone(Globals[i].a4 - Globals[Parent].a4, Globals[i].b4 - Globals[Parent].b4,
+                    Globals[i].c4 - Globals[Parent].c4);
+                Reach[Parent] = std::max(Reach[Parent], Bone.Length() + Reach[i]);
+            }
+        }
+        return Reach;
+    }
+
+    // Segment i of [Keys[i].Time, Keys[i + 1].Time) containing Time, clamped to the first/last
+    // segment, as Animation's raw key search did. NumKeys must be at least 2.
+    unsigned int FindSegment(const Key* pKeys, unsigned int NumKeys, float Time, unsigned int& Cursor)
+    {
+        assert(NumKeys > 1);
+
+        const unsigned int LastSegment = NumKeys - 2;
+
+        // Monotonic playback: still in the cached segment, or just moved into the next one
+        unsigned int i = Cursor;
+        if (i <= LastSegment && pKeys[i].Time <= Time) {
+            if (Time < pKeys[i + 1].Time || i == LastSegment) {
+                return i;
+            }
+            if (i + 1 == LastSegment || Time < pKeys[i + 2].Time) {
+                Cursor = i + 1;
+                return Cursor;
+            }
+        }
+
+        // Seek or loop: binary search for the first key after Time
+        const Key* pNext = std::upper_bound(pKeys, pKeys + NumKeys, Time, [](float t, const Key& k) { return t < k.Time; });
+        const auto Next = static_cast<unsigned int>(pNext - pKeys);
+        Cursor = std::min(Next > 0 ? Next - 1 : 0u, LastSegment);
+        return Cursor;
+    }
+
+    // First of the two keys around AnimationTime and the blend factor towards the second.
+    // Single key tracks return their key with factor 0.
+    const Key* Locate(const Clip& C, const Track& T, float AnimationTime, unsigned int& Cursor, float& Factor)
+    {
+        const Key* pKeys = C.Keys.data() + T.FirstKey;
+        Factor = 0.0f;
+        if (T.NumKeys == 1) {
+            return pKeys;
+        }
+
+        const float Time = AnimationTime * C.TimeToKey;
+        const unsigned int i = FindSegment(pKeys, T.NumKeys, Time, Cursor);
+        Factor = std::clamp((Time - pKeys[i].Time) * C.InvSpans[T.FirstKey + i], 0.0f, 1.0f);
+        return pKeys + i;
+    }
+
+    void SampleVector(const Clip& C, const Track& T, const aiVector3D& Min, const aiVector3D& Step, float AnimationTime,
+        unsigned int& Cursor, aiVector3D& Out)
+    {
+        if (T.NumKeys == 0) {
+            return;
+        }
+        float Factor;
+        const Key* pKey = Locate(C, T, AnimationTime, Cursor, Factor);
+        Out = DecodeVector(pKey[0], Min, Step);
+        if (Factor > 0.0f) {
+            Out = LerpVector(Out, DecodeVector(pKey[1], Min, Step), Factor);
+        }
+    }
+}
+
+void EncodeRotation(const aiQuaternion& Q, uint16_t Out[3])
+{
+    float C[4] = { Q.x, Q.y, Q.z, Q.w };
+    const float Length = std::sqrt(C[0] * C[0] + C[1] * C[1] + C[2] * C[2] + C[3] * C[3]);
+    unsigned int Largest = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        C[i] = Length > 0.0f ? C[i] / Length : (i == 3 ? 1.0f : 0.0f);
+        if (std::abs(C[i]) > std::abs(C[Largest])) {
+            Largest = i;
+        }
+    }
+
+    // q and -q are the same rotation: flip so the dropped component is positive
+    const float Sign = C[Largest] < 0.0f ? -1.0f : 1.0f;
+    uint16_t Small[3];
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        if (i != Largest) {
+            const float Unit = (C[i] * Sign / SmallestThreeRange) * 0.5f + 0.5f;
+            Small[k++] = static_cast<uint16_t>(std::clamp(std::lround(Unit * MaxComponentValue), 0L, 32767L));
+        }
+    }
+
+    Out[0] = static_cast<uint16_t>(Small[0] | ((Largest >> 1) << 15));
+    Out[1] = static_cast<uint16_t>(Small[1] | ((Largest & 1) << 15));
+    Out[2] = Small[2];
+}
+
+aiQuaternion DecodeRotation(const uint16_t In[3])
+{
+    const unsigned int Largest = ((In[0] >> 15) << 1) | (In[1] >> 15);
+    float C[4];
+    float Sum = 0.0f;
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        if (i != Largest) {
+            C[i] = ((In[k++] & 0x7FFF) / MaxComponentValue * 2.0f - 1.0f) * SmallestThreeRange;
+            Sum += C[i] * C[i];
+        }
+    }
+    C[Largest] = std::sqrt(std::max(0.0f, 1.0f - Sum));
+    return aiQuaternion(C[3], C[0], C[1], C[2]);
+}
+
+void Compress(const MeshCache::View& View, const MeshCache::Animation& Animation, const Settings& Options, Clip& Out, Stats* pStats)
+{
+    Out = Clip();
+    const MeshCache::Channel* pChannels = View.Channels.Data + Animation.FirstChannel;
+
+    // Clip wide ranges: key times, translations and scalings
+    float MaxTime = Animation.Duration;
+    aiVector3D TranslationMin(1e30f), TranslationMax(-1e30f);
+    aiVector3D ScalingMin(1e30f), ScalingMax(-1e30f);
+    auto Extend = [](aiVector3D& Min, aiVector3D& Max, const aiVector3D& v) {
+        Min = aiVector3D(std::min(Min.x, v.x), std::min(Min.y, v.y), std::min(Min.z, v.z));
+        Max = aiVector3D(std::max(Max.x, v.x), std::max(Max.y, v.y), std::max(Max.z, v.z));
+    };
+    for (unsigned int c = 0; c < Animation.NumChannels; c++) {
+        const MeshCache::Channel& Channel = pChannels[c];
+        for (unsigned int k = 0; k < Channel.NumPositions; k++) {
+            const MeshCache::VectorKey& Key = View.PositionKeys[Channel.FirstPosition + k];
+            MaxTime = std::max(MaxTime, Key.Time);
+            Extend(TranslationMin, TranslationMax, Key.Value);
+        }
+        for (unsigned int k = 0; k < Channel.NumRotations; k++) {
+            MaxTime = std::max(MaxTime, View.RotationKeys[Channel.FirstRotation + k].Time);
+        }
+        for (unsigned int k = 0; k < Channel.NumScalings; k++) {
+            const MeshCache::VectorKey& Key = View.ScalingKeys[Channel.FirstScaling + k];
+            MaxTime = std::max(MaxTime, Key.Time);
+            Extend(ScalingMin, ScalingMax, Key.Value);
+        }
+    }
+    if (TranslationMin.x > TranslationMax.x) {
+        TranslationMin = TranslationMax = aiVector3D(0.0f);
+    }
+    if (ScalingMin.x > ScalingMax.x) {
+        ScalingMin = ScalingMax = aiVector3D(1.0f);
+    }
+
+    Out.TimeToKey = MaxTime > 0.0f ? MaxKeyValue / MaxTime : 0.0f;
+    Out.TranslationMin = TranslationMin;
+    Out.TranslationStep = (TranslationMax - TranslationMin) / MaxKeyValue;
+    Out.ScalingMin = ScalingMin;
+    Out.ScalingStep = (ScalingMax - ScalingMin) / MaxKeyValue;
+    const aiVector3D TranslationInvStep = InvStep(Out.TranslationStep);
+    const aiVector3D ScalingInvStep = InvStep(Out.ScalingStep);
+
+    const aiVector3D Extent = TranslationMax - TranslationMin;
+    const float TranslationTolerance = Options.MaxTranslationError * std::max(Extent.x, std::max(Extent.y, Extent.z));
+
+    // Per bone rotation and scaling tolerances: an error of e moves a joint Reach away by about e * Reach
+    const std::vector<float> Reach = CalcReach(View);
+    std::unordered_map<std::string, float> NodeReach;
+    float SkeletonSize = 0.0f;
+    for (size_t i = 0; i < View.Nodes.Size; i++) {
+        NodeReach.emplace(View.String(View.Nodes[i].Name), Reach[i]);
+        SkeletonSize = std::max(SkeletonSize, Reach[i]);
+    }
+    const float JointTolerance = Options.MaxJointError * SkeletonSize;
+    auto BoneTolerance = [JointTolerance](float MaxError, float BoneReach) {
+        return BoneReach > 0.0f ? std::min(MaxError, JointTolerance / BoneReach) : MaxError;
+    };
+
+    auto KeyTime = [&Out](float Time) {
+        return static_cast<uint16_t>(std::clamp(std::lround(Time * Out.TimeToKey), 0L, 65535L));
+    };
+
+    Out.Tracks.resize(Animation.NumChannels * NumTrackTypes);
+    std::vector<unsigned int> Kept;
+    for (unsigned int c = 0; c < Animation.NumChannels; c++) {
+        const MeshCache::Channel& Channel = pChannels[c];
+        Track* pTracks = Out.Tracks.data() + c * NumTrackTypes;
+        const auto Node = NodeReach.find(View.String(Channel.NodeName));
+        const float BoneReach = Node != NodeReach.end() ? Node->second : 0.0f;
+
+        const MeshCache::VectorKey* pPositions = View.PositionKeys.Data + Channel.FirstPosition;
+        ReduceKeys(pPositions, Channel.NumPositions, TranslationTolerance, LerpVector, VectorError, Kept);
+        pTracks[Translation] = { static_cast<uint32_t>(Out.Keys.size()), static_cast<uint32_t>(Kept.size()) };
+        for (unsigned int k : Kept) {
+            const aiVector3D& v = pPositions[k].Value;
+            Out.Keys.push_back({ KeyTime(pPositions[k].Time),
+                { Quantize(v.x, TranslationMin.x, TranslationInvStep.x), Quantize(v.y, TranslationMin.y, TranslationInvStep.y),
+                    Quantize(v.z, TranslationMin.z, TranslationInvStep.z) } });
+        }
+
+        const MeshCache::QuatKey* pRotations = View.RotationKeys.Data + Channel.FirstRotation;
+        ReduceKeys(pRotations, Channel.NumRotations, BoneTolerance(Options.MaxRotationError, BoneReach), LerpRotation,
+            RotationError, Kept);
+        pTracks[Rotation] = { static_cast<uint32_t>(Out.Keys.size()), static_cast<uint32_t>(Kept.size()) };
+        for (unsigned int k : Kept) {
+            Key Packed { KeyTime(pRotations[k].Time), {} };
+            EncodeRotation(pRotations[k].Value, Packed.Value);
+            Out.Keys.push_back(Packed);
+        }
+
+        const MeshCache::VectorKey* pScalings = View.ScalingKeys.Data + Channel.FirstScaling;
+        ReduceKeys(pScalings, Channel.NumScalings, BoneTolerance(Options.MaxScalingError, BoneReach), LerpVector, VectorError,
+            Kept);
+        pTracks[Scaling] = { static_cast<uint32_t>(Out.Keys.size()), static_cast<uint32_t>(Kept.size()) };
+        for (unsigned int k : Kept) {
+            const aiVector3D& v = pScalings[k].Value;
+            Out.Keys.push_back({ KeyTime(pScalings[k].Time),
+                { Quantize(v.x, ScalingMin.x, ScalingInvStep.x), Quantize(v.y, ScalingMin.y, ScalingInvStep.y),
+                    Quantize(v.z, ScalingMin.z, ScalingInvStep.z) } });
+        }
+
+        if (pStats != nullptr) {
+            pStats->SourceKeys += Channel.NumPositions + Channel.NumRotations + Channel.NumScalings;
+            pStats->SourceBytes += (Channel.NumPositions + Channel.NumScalings) * sizeof(MeshCache::VectorKey)
+                + Channel.NumRotations * sizeof(MeshCache::QuatKey);
+        }
+    }
+    Out.Keys.shrink_to_fit();
+    CalcInvSpans(Out);
+
+    if (pStats != nullptr) {
+        pStats->Keys += Out.Keys.size();
+        pStats->Bytes += Out.GetMemoryBytes();
+    }
+}
+
+void Load(const MeshCache::View& View, unsigned int Index, Clip& Out)
+{
+    const MeshCache::Clip& Baked = View.Clips[Index];
+    const MeshCache::ClipTrack* pTracks = View.ClipTracks.Data + Baked.FirstTrack;
+    const MeshCache::ClipKey* pKeys = View.ClipKeys.Data + Baked.FirstKey;
+
+    Out.TimeToKey = Baked.TimeToKey;
+    Out.TranslationMin = Baked.TranslationMin;
+    Out.TranslationStep = Baked.TranslationStep;
+    Out.ScalingMin = Baked.ScalingMin;
+    Out.ScalingStep = Baked.ScalingStep;
+    Out.Tracks.assign(pTracks, pTracks + View.Animations[Index].NumChannels * NumTrackTypes);
+    Out.Keys.assign(pKeys, pKeys + Baked.NumKeys);
+    CalcInvSpans(Out);
+}
+
+void SampleTranslation(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiVector3D& Out)
+{
+    SampleVector(Clip, Clip.Tracks[Channel * NumTrackTypes + Translation], Clip.TranslationMin, Clip.TranslationStep, AnimationTime,
+        Cursor, Out);
+}
+
+void SampleScaling(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiVector3D& Out)
+{
+    SampleVector(Clip, Clip.Tracks[Channel * NumTrackTypes + Scaling], Clip.ScalingMin, Clip.ScalingStep, AnimationTime, Cursor, Out);
+}
+
+void SampleRotation(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiQuaternion& Out)
+{
+    const Track& T = Clip.Tracks[Channel * NumTrackTypes + Rotation];
+    if (T.NumKeys == 0) {
+        return;
+    }
+    float Factor;
+    const Key* pKey = Locate(Clip, T, AnimationTime, Cursor, Factor);
+    Out = DecodeRotation(pKey[0].Value);
+    if (Factor > 0.0f) {
+        Animation::Nlerp(Out, Out, DecodeRotation(pKey[1].Value), Factor);
+    }
+}
+
+}
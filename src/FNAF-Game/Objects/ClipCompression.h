@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <assimp/quaternion.h>
+#include <assimp/vector3.h>
+
+#include "MeshCache.h"
+
+// Animation clip compression.
+//
+// Every channel has a translation, a rotation and a scaling track. A key is dropped when the
+// linear interpolation (nlerp for rotations) of the keys kept around it stays within the
+// tolerance of its bone. This is decided per track, so every bone keeps only the keys its own
+// motion needs, and tracks that never move keep one key. Rotation and scaling errors move every
+// joint below the bone, so their tolerance shrinks with the bind pose distance to its farthest
+// descendant: hips keep more keys than fingertips. The remaining keys are 8 bytes each:
+//  - time: 16 bits over the clip's key time range
+//  - rotation: smallest-three, the largest component dropped and the others stored in 15 bits
+//    each, the dropped index in the two spare top bits (48 bits)
+//  - translation and scaling: 16 bits per component over the clip's range of that track type
+// All keys of a channel are stored back to back (translation, rotation, then scaling keys),
+// channel after channel, so sampling a clip streams through one array. Clips are compressed
+// when the mesh cache is baked and stored in it, Load only copies them out.
+namespace ClipCompression {
+
+enum TrackType : unsigned int {
+    Translation,
+    Rotation,
+    Scaling,
+    NumTrackTypes
+};
+
+struct Settings {
+    float MaxTranslationError = 1e-4f; // fraction of the clip's largest translation extent
+    float MaxRotationError = 2e-3f; // radians, for bones with no descendants
+    float MaxScalingError = 1e-3f; // for bones with no descendants
+    float MaxJointError = 5e-4f; // fraction of the skeleton's size a descendant joint may move by
+};
+
+using Key = MeshCache::ClipKey;
+using Track = MeshCache::ClipTrack;
+
+struct Clip {
+    float TimeToKey = 0.0f; // ticks to quantized key time
+    aiVector3D TranslationMin, TranslationStep;
+    aiVector3D ScalingMin, ScalingStep;
+    std::vector<Track> Tracks; // NumTrackTypes per channel
+    std::vector<Key> Keys;
+    std::vector<float> InvSpans; // per key, 1 / ticks to the next key of its track, 0 for the last one
+
+    [[nodiscard]] unsigned int GetNumChannels() const { return static_cast<unsigned int>(Tracks.size() / NumTrackTypes); }
+    [[nodiscard]] size_t GetMemoryBytes() const
+    {
+        return Tracks.capacity() * sizeof(Track) + Keys.capacity() * sizeof(Key) + InvSpans.capacity() * sizeof(float);
+    }
+};
+
+struct Stats {
+    size_t SourceKeys = 0;
+    size_t Keys = 0;
+    size_t SourceBytes = 0; // as MeshCache keys
+    size_t Bytes = 0;
+};
+
+// Compress one animation of a mesh cache view. Stats, if given, are accumulated.
+void Compress(const MeshCache::View& View, const MeshCache::Animation& Animation, const Settings& Options, Clip& Out,
+    Stats* pStats = nullptr);
+
+// Copy the baked clip of animation Index out of a view
+void Load(const MeshCache::View& View, unsigned int Index, Clip& Out);
+
+// Sample a track at AnimationTime (ticks). Cursor is the last key segment used, so monotonic
+// playback finds its keys in O(1). Tracks without keys leave Out untouched.
+void SampleTranslation(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiVector3D& Out);
+void SampleRotation(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiQuaternion& Out);
+void SampleScaling(const Clip& Clip, unsigned int Channel, float AnimationTime, unsigned int& Cursor, aiVector3D& Out);
+
+// Key encodings, exposed for tools and tests
+void EncodeRotation(const aiQuaternion& Q, uint16_t Out[3]);
+[[nodiscard]] aiQuaternion DecodeRotation(const uint16_t In[3]);
+
+}
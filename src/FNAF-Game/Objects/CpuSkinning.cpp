@@ -0,0 +1,320 @@
+#include "CpuSkinning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CPU_SKINNING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function, GCC/Clang need them enabled per function
+#if defined(CPU_SKINNING_X86) && (defined(__GNUC__) || defined(__clang__))
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define AVX2_TARGET
+#endif
+
+namespace CpuSkinning {
+
+namespace {
+
+    using Vertex = MeshCache::Vertex;
+    using VertexBoneData = MeshCache::VertexBoneData;
+
+    void SkinScalar(const Vertex* pVertices, const VertexBoneData* pBones, unsigned int Begin, unsigned int End,
+        const aiMatrix4x4* pPalette, glm::vec3* pOutPositions, glm::vec3* pOutNormals)
+    {
+        for (unsigned int v = Begin; v < End; v++) {
+            // Only the top three rows matter, the palette is affine
+            float m[12] = { 0.0f };
+            for (unsigned int i = 0; i < VertexBoneData::NUM_BONES_PER_VERTEX; i++) {
+                const float w = pBones[v].Weights[i];
+                const float* pBone = &pPalette[pBones[v].IDs[i]].a1;
+                for (unsigned int e = 0; e < 12; e++) {
+                    m[e] += w * pBone[e];
+                }
+            }
+
+            const aiVector3D& p = pVertices[v].Pos;
+            pOutPositions[v] = glm::vec3(m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3],
+                m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7],
+                m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+
+            if (pOutNormals) {
+                const aiVector3D& n = pVertices[v].Normal;
+                pOutNormals[v] = glm::vec3(m[0] * n.x + m[1] * n.y + m[2] * n.z,
+                    m[4] * n.x + m[5] * n.y + m[6] * n.z,
+                    m[8] * n.x + m[9] * n.y + m[10] * n.z);
+            }
+        }
+    }
+
+#ifdef CPU_SKINNING_X86
+    // One vertex per iteration: blend three matrix rows, transpose to columns, then
+    // position = c0 * x + c1 * y + c2 * z + c3
+    void SkinSSE(const Vertex* pVertices, const VertexBoneData* pBones, unsigned int Begin, unsigned int End,
+        const aiMatrix4x4* pPalette, glm::vec3* pOutPositions, glm::vec3* pOutNormals)
+    {
+        alignas(16) float Out[4];
+
+        for (unsigned int v = Begin; v < End; v++) {
+            __m128 r0 = _mm_setzero_ps();
+            __m128 r1 = _mm_setzero_ps();
+            __m128 r2 = _mm_setzero_ps();
+            for (unsigned int i = 0; i < VertexBoneData::NUM_BONES_PER_VERTEX; i++) {
+                const __m128 w = _mm_set1_ps(pBones[v].Weights[i]);
+                const aiMatrix4x4& Bone = pPalette[pBones[v].IDs[i]];
+                r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(&Bone.a1)));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(&Bone.b1)));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(&Bone.c1)));
+            }
+
+            __m128 r3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            const aiVector3D& p = pVertices[v].Pos;
+            __m128 pos = _mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(p.x)), r3);
+            pos = _mm_add_ps(pos, _mm_mul_ps(r1, _mm_set1_ps(p.y)));
+            pos = _mm_add_ps(pos, _mm_mul_ps(r2, _mm_set1_ps(p.z)));
+            _mm_store_ps(Out, pos);
+            pOutPositions[v] = glm::vec3(Out[0], Out[1], Out[2]);
+
+            if (pOutNormals) {
+                const aiVector3D& n = pVertices[v].Normal;
+                __m128 nrm = _mm_mul_ps(r0, _mm_set1_ps(n.x));
+                nrm = _mm_add_ps(nrm, _mm_mul_ps(r1, _mm_set1_ps(n.y)));
+                nrm = _mm_add_ps(nrm, _mm_mul_ps(r2, _mm_set1_ps(n.z)));
+                _mm_store_ps(Out, nrm);
+                pOutNormals[v] = glm::vec3(Out[0], Out[1], Out[2]);
+            }
+        }
+    }
+
+    // Eight vertices per iteration in SoA form, all inputs fetched with gathers
+    AVX2_TARGET void SkinAVX2(const Vertex* pVertices, const VertexBoneData* pBones, unsigned int Begin, unsigned int End,
+        const aiMatrix4x4* pPalette, glm::vec3* pOutPositions, glm::vec3* pOutNormals)
+    {
+        constexpr int VertexFloats = sizeof(Vertex) / sizeof(float);
+        constexpr int PosOffset = offsetof(Vertex, Pos) / sizeof(float);
+        constexpr int NormalOffset = offsetof(Vertex, Normal) / sizeof(float);
+        constexpr int BoneStride = sizeof(VertexBoneData);
+        static_assert(sizeof(Vertex) % sizeof(float) == 0, "Vertex must be a whole number of floats");
+
+        const char* pBoneBytes = reinterpret_cast<const char*>(pBones);
+        const float* pVertexFloats = reinterpret_cast<const float*>(pVertices);
+        const float* pPaletteFloats = &pPalette[0].a1;
+
+        const __m256i Lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i ByteMask = _mm256_set1_epi32(0xFF);
+
+        alignas(32) float Px[8], Py[8], Pz[8], Nx[8], Ny[8], Nz[8];
+
+        unsigned int v = Begin;
+        for (; v + 8 <= End; v += 8) {
+            const __m256i Index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(v)), Lane);
+            const __m256i BoneOffset = _mm256_mullo_epi32(Index, _mm256_set1_epi32(BoneStride));
+            const __m256i Ids = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pBoneBytes + offsetof(VertexBoneData, IDs)), BoneOffset, 1);
+
+            __m256 m[12];
+            for (__m256& e : m) {
+                e = _mm256_setzero_ps();
+            }
+
+            for (int i = 0; i < static_cast<int>(VertexBoneData::NUM_BONES_PER_VERTEX); i++) {
+                const __m256 w = _mm256_i32gather_ps(reinterpret_cast<const float*>(pBoneBytes + offsetof(VertexBoneData, Weights) + i * sizeof(float)), BoneOffset, 1);
+                const __m256i Id = _mm256_and_si256(_mm256_srli_epi32(Ids, 8 * i), ByteMask);
+                const __m256i First = _mm256_slli_epi32(Id, 4); // 16 floats per matrix
+
+                for (int e = 0; e < 12; e++) {
+                    const __m256 b = _mm256_i32gather_ps(pPaletteFloats + e, First, 4);
+                    m[e] = _mm256_fmadd_ps(w, b, m[e]);
+                }
+            }
+
+            const __m256i VertexFirst = _mm256_mullo_epi32(Index, _mm256_set1_epi32(VertexFloats));
+            const __m256 px = _mm256_i32gather_ps(pVertexFloats + PosOffset + 0, VertexFirst, 4);
+            const __m256 py = _mm256_i32gather_ps(pVertexFloats + PosOffset + 1, VertexFirst, 4);
+            const __m256 pz = _mm256_i32gather_ps(pVertexFloats + PosOffset + 2, VertexFirst, 4);
+
+            _mm256_store_ps(Px, _mm256_fmadd_ps(m[0], px, _mm256_fmadd_ps(m[1], py, _mm256_fmadd_ps(m[2], pz, m[3]))));
+            _mm256_store_ps(Py, _mm256_fmadd_ps(m[4], px, _mm256_fmadd_ps(m[5], py, _mm256_fmadd_ps(m[6], pz, m[7]))));
+            _mm256_store_ps(Pz, _mm256_fmadd_ps(m[8], px, _mm256_fmadd_ps(m[9], py, _mm256_fmadd_ps(m[10], pz, m[11]))));
+            for (int k = 0; k < 8; k++) {
+                pOutPositions[v + k] = glm::vec3(Px[k], Py[k], Pz[k]);
+            }
+
+            if (pOutNormals) {
+                const __m256 nx = _mm256_i32gather_ps(pVertexFloats + NormalOffset + 0, VertexFirst, 4);
+                const __m256 ny = _mm256_i32gather_ps(pVertexFloats + NormalOffset + 1, VertexFirst, 4);
+                const __m256 nz = _mm256_i32gather_ps(pVertexFloats + NormalOffset + 2, VertexFirst, 4);
+
+                _mm256_store_ps(Nx, _mm256_fmadd_ps(m[0], nx, _mm256_fmadd_ps(m[1], ny, _mm256_mul_ps(m[2], nz))));
+                _mm256_store_ps(Ny, _mm256_fmadd_ps(m[4], nx, _mm256_fmadd_ps(m[5], ny, _mm256_mul_ps(m[6], nz))));
+                _mm256_store_ps(Nz, _mm256_fmadd_ps(m[8], nx, _mm256_fmadd_ps(m[9], ny, _mm256_mul_ps(m[10], nz))));
+                for (int k = 0; k < 8; k++) {
+                    pOutNormals[v + k] = glm::vec3(Nx[k], Ny[k], Nz[k]);
+                }
+            }
+        }
+
+        SkinSSE(pVertices, pBones, v, End, pPalette, pOutPositions, pOutNormals);
+    }
+
+    bool CpuHasAVX2()
+    {
+#ifdef _MSC_VER
+        int Info[4];
+        __cpuid(Info, 0);
+        if (Info[0] < 7) {
+            return false;
+        }
+        __cpuid(Info, 1);
+        const bool OsXSave = (Info[2] & (1 << 27)) != 0;
+        const bool Avx = (Info[2] & (1 << 28)) != 0;
+        const bool Fma = (Info[2] & (1 << 12)) != 0;
+        if (!OsXSave || !Avx || !Fma) {
+            return false;
+        }
+        // The OS must save the YMM registers
+        if ((_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+}
+
+Kernel GetBestKernel()
+{
+#ifdef CPU_SKINNING_X86
+    static const Kernel sBest = CpuHasAVX2() ? Kernel::AVX2 : Kernel::SSE;
+    return sBest;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const char* GetKernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return "Scalar";
+    case Kernel::SSE:
+        return "SSE";
+    case Kernel::AVX2:
+        return "AVX2";
+    }
+    return "Unknown";
+}
+
+void Skin(const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const aiMatrix4x4* pPalette, unsigned int NumBones, glm::vec3* pOutPositions, glm::vec3* pOutNormals)
+{
+    Skin(GetBestKernel(), pVertices, pBones, NumVertices, pPalette, NumBones, pOutPositions, pOutNormals);
+}
+
+void Skin(Kernel kernel, const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const aiMatrix4x4* pPalette, unsigned int NumBones, glm::vec3* pOutPositions, glm::vec3* pOutNormals)
+{
+    if (NumBones == 0) {
+        // Same as the shader: without bones the rest pose is drawn
+        for (unsigned int v = 0; v < NumVertices; v++) {
+            pOutPositions[v] = glm::vec3(pVertices[v].Pos.x, pVertices[v].Pos.y, pVertices[v].Pos.z);
+            if (pOutNormals) {
+                pOutNormals[v] = glm::vec3(pVertices[v].Normal.x, pVertices[v].Normal.y, pVertices[v].Normal.z);
+            }
+        }
+        return;
+    }
+
+#ifndef NDEBUG
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        for (unsigned int i = 0; i < MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX; i++) {
+            assert(pBones[v].IDs[i] < NumBones);
+        }
+    }
+#endif
+
+    if (kernel == Kernel::AVX2 && GetBestKernel() != Kernel::AVX2) {
+        kernel = GetBestKernel();
+    }
+
+    switch (kernel) {
+#ifdef CPU_SKINNING_X86
+    case Kernel::AVX2:
+        SkinAVX2(pVertices, pBones, 0, NumVertices, pPalette, pOutPositions, pOutNormals);
+        return;
+    case Kernel::SSE:
+        SkinSSE(pVertices, pBones, 0, NumVertices, pPalette, pOutPositions, pOutNormals);
+        return;
+#endif
+    default:
+        SkinScalar(pVertices, pBones, 0, NumVertices, pPalette, pOutPositions, pOutNormals);
+        return;
+    }
+}
+
+void CalcBounds(const glm::vec3* pPositions, unsigned int NumPositions, glm::vec3& Min, glm::vec3& Max)
+{
+    Min = glm::vec3(FLT_MAX);
+    Max = glm::vec3(-FLT_MAX);
+    for (unsigned int i = 0; i < NumPositions; i++) {
+        Min = glm::min(Min, pPositions[i]);
+        Max = glm::max(Max, pPositions[i]);
+    }
+}
+
+bool IntersectRay(const glm::vec3& Origin, const glm::vec3& Dir, const glm::vec3* pPositions, const unsigned int* pIndices,
+    unsigned int NumIndices, unsigned int BaseVertex, float& Distance)
+{
+    constexpr float Epsilon = 1e-7f;
+    bool Hit = false;
+
+    for (unsigned int i = 0; i + 2 < NumIndices; i += 3) {
+        const glm::vec3& v0 = pPositions[BaseVertex + pIndices[i + 0]];
+        const glm::vec3& v1 = pPositions[BaseVertex + pIndices[i + 1]];
+        const glm::vec3& v2 = pPositions[BaseVertex + pIndices[i + 2]];
+
+        const glm::vec3 e1 = v1 - v0;
+        const glm::vec3 e2 = v2 - v0;
+        const glm::vec3 p = glm::cross(Dir, e2);
+        const float det = glm::dot(e1, p);
+        if (std::abs(det) < Epsilon) {
+            continue;
+        }
+
+        const float invDet = 1.0f / det;
+        const glm::vec3 s = Origin - v0;
+        const float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) {
+            continue;
+        }
+
+        const glm::vec3 q = glm::cross(s, e1);
+        const float w = glm::dot(Dir, q) * invDet;
+        if (w < 0.0f || u + w > 1.0f) {
+            continue;
+        }
+
+        const float t = glm::dot(e2, q) * invDet;
+        if (t > 0.0f && (!Hit || t < Distance)) {
+            Distance = t;
+            Hit = true;
+        }
+    }
+
+    return Hit;
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <assimp/matrix4x4.h>
+
+#include "MeshCache.h"
+
+// Linear blend skinning on the CPU, matching shaders/skinned_mesh.vert.
+//
+// Takes the vertex and bone-weight streams of a mesh plus a bone palette as produced by
+// SkinnedMesh::BoneTransform and writes model-space positions and normals. Normals are not
+// renormalized, exactly like the vertex shader. Needs no GL context, so it also serves
+// bounds updates, picking on animated meshes and headless checks of animation output.
+namespace CpuSkinning {
+
+enum class Kernel {
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+// Best kernel supported by the CPU we run on
+[[nodiscard]] Kernel GetBestKernel();
+[[nodiscard]] const char* GetKernelName(Kernel kernel);
+
+// Skin NumVertices vertices. Palette holds NumBones row-major matrices (as uploaded with
+// transpose = GL_TRUE); with NumBones == 0 vertices are copied unchanged, like the shader.
+// pOutNormals may be nullptr.
+void Skin(const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const aiMatrix4x4* pPalette, unsigned int NumBones, glm::vec3* pOutPositions, glm::vec3* pOutNormals);
+
+// Same, with an explicit kernel. Falls back to the best supported one if the CPU lacks it.
+void Skin(Kernel kernel, const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const aiMatrix4x4* pPalette, unsigned int NumBones, glm::vec3* pOutPositions, glm::vec3* pOutNormals);
+
+void CalcBounds(const glm::vec3* pPositions, unsigned int NumPositions, glm::vec3& Min, glm::vec3& Max);
+
+// Closest hit of a ray with indexed triangles, Moller-Trumbore. Distance is in units of Dir.
+bool IntersectRay(const glm::vec3& Origin, const glm::vec3& Dir, const glm::vec3* pPositions, const unsigned int* pIndices,
+    unsigned int NumIndices, unsigned int BaseVertex, float& Distance);
+
+}
@@ -0,0 +1,61 @@
+#include "DrawBatch.h"
+
+#include <algorithm>
+
+namespace DrawBatch {
+
+void DrawList::Clear()
+{
+    Commands.clear();
+    Groups.clear();
+}
+
+size_t DrawList::GetNumIndices() const
+{
+    size_t NumIndices = 0;
+    for (const DrawElementsIndirectCommand& Command : Commands) {
+        NumIndices += Command.Count;
+    }
+    return NumIndices;
+}
+
+void Build(const DrawItem* pItems, size_t Count, DrawList& Out)
+{
+    Out.Clear();
+
+    // Material ids are small and dense: counting sort, which also keeps the input order
+    unsigned int NumMaterials = 0;
+    for (size_t i = 0; i < Count; i++) {
+        if (pItems[i].Count > 0) {
+            NumMaterials = std::max(NumMaterials, pItems[i].Material + 1);
+        }
+    }
+
+    std::vector<unsigned int> First(NumMaterials + 1, 0);
+    for (size_t i = 0; i < Count; i++) {
+        if (pItems[i].Count > 0) {
+            First[pItems[i].Material + 1]++;
+        }
+    }
+    for (unsigned int m = 0; m < NumMaterials; m++) {
+        First[m + 1] += First[m];
+    }
+
+    Out.Commands.resize(First[NumMaterials]);
+    std::vector<unsigned int> Next(First.begin(), First.end() - 1);
+    for (size_t i = 0; i < Count; i++) {
+        const DrawItem& Item = pItems[i];
+        if (Item.Count == 0) {
+            continue;
+        }
+        Out.Commands[Next[Item.Material]++] = { Item.Count, 1, Item.FirstIndex, Item.BaseVertex, Item.DrawId };
+    }
+
+    for (unsigned int m = 0; m < NumMaterials; m++) {
+        if (First[m + 1] > First[m]) {
+            Out.Groups.push_back({ m, First[m], First[m + 1] - First[m] });
+        }
+    }
+}
+
+}
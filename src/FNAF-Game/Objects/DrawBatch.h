@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draw lists for glMultiDrawElementsIndirect, built on the CPU.
+//
+// A mesh hands in one DrawItem per entry it wants drawn this frame; Build() sorts them by material
+// and emits the indirect commands of each material back to back, so the renderer binds each
+// material once and submits its commands with a single call. BaseInstance carries the item's
+// DrawId: with an instanced attribute (divisor 1) holding 0, 1, 2, ... the shader receives it and
+// looks up per-draw data. No GL calls here.
+namespace DrawBatch {
+
+// Layout fixed by the GL spec for GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    uint32_t Count;
+    uint32_t InstanceCount;
+    uint32_t FirstIndex;
+    int32_t BaseVertex;
+    uint32_t BaseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "tightly packed indirect command");
+
+struct DrawItem {
+    unsigned int Material = 0;
+    unsigned int Count = 0; // indices
+    unsigned int FirstIndex = 0;
+    int BaseVertex = 0;
+    unsigned int DrawId = 0;
+};
+
+// Commands [FirstCommand, FirstCommand + NumCommands) all use Material
+struct Group {
+    unsigned int Material = 0;
+    unsigned int FirstCommand = 0;
+    unsigned int NumCommands = 0;
+};
+
+struct DrawList {
+    std::vector<DrawElementsIndirectCommand> Commands;
+    std::vector<Group> Groups; // ascending material, no empty group
+
+    void Clear();
+    [[nodiscard]] size_t GetNumIndices() const;
+};
+
+// Items with Count == 0 are dropped. Within a material, items keep their input order.
+void Build(const DrawItem* pItems, size_t Count, DrawList& Out);
+
+}
@@ -0,0 +1,272 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Timer.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define FRUSTUM_CULLING_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace FrustumCulling {
+
+namespace {
+
+    Frustum sFrustum = Frustum::FromMatrix(glm::mat4(1.0f));
+    bool sStereo = false;
+    unsigned int sVersion = 0;
+
+    struct Stats {
+        size_t Tested = 0;
+        size_t Visible = 0;
+        size_t Triangles = 0;
+        double CullMs = 0.0;
+    } sStats;
+
+    // Corners of the frustum of PV, from the NDC cube
+    void GetCorners(const glm::mat4& PV, glm::vec3 (&Corners)[8])
+    {
+        const glm::mat4 Inv = glm::inverse(PV);
+        for (int i = 0; i < 8; i++) {
+            const glm::vec4 Ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+            const glm::vec4 p = Inv * Ndc;
+            Corners[i] = glm::vec3(p) / p.w;
+        }
+    }
+
+    bool Contains(const glm::vec4& Plane, const glm::vec3 (&Corners)[8])
+    {
+        // Plane is normalized, so the tolerance is a distance: a hair of slack for rounding
+        for (const glm::vec3& c : Corners) {
+            if (glm::dot(Plane, glm::vec4(c, 1.0f)) < -1e-4f * std::max(1.0f, glm::length(c))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& PV)
+{
+    // Gribb & Hartmann: combinations of the rows of the matrix
+    const glm::vec4 Row0(PV[0][0], PV[1][0], PV[2][0], PV[3][0]);
+    const glm::vec4 Row1(PV[0][1], PV[1][1], PV[2][1], PV[3][1]);
+    const glm::vec4 Row2(PV[0][2], PV[1][2], PV[2][2], PV[3][2]);
+    const glm::vec4 Row3(PV[0][3], PV[1][3], PV[2][3], PV[3][3]);
+
+    Frustum F;
+    F.Planes[0] = Row3 + Row0;
+    F.Planes[1] = Row3 - Row0;
+    F.Planes[2] = Row3 + Row1;
+    F.Planes[3] = Row3 - Row1;
+    F.Planes[4] = Row3 + Row2;
+    F.Planes[5] = Row3 - Row2;
+    for (glm::vec4& Plane : F.Planes) {
+        Plane /= glm::length(glm::vec3(Plane));
+    }
+    return F;
+}
+
+Frustum Frustum::FromStereo(const glm::mat4& LeftPV, const glm::mat4& RightPV)
+{
+    const Frustum Left = FromMatrix(LeftPV);
+    const Frustum Right = FromMatrix(RightPV);
+
+    glm::vec3 LeftCorners[8], RightCorners[8];
+    GetCorners(LeftPV, LeftCorners);
+    GetCorners(RightPV, RightCorners);
+
+    Frustum F;
+    for (int i = 0; i < 6; i++) {
+        if (Contains(Left.Planes[i], RightCorners)) {
+            F.Planes[i] = Left.Planes[i];
+        } else if (Contains(Right.Planes[i], LeftCorners)) {
+            F.Planes[i] = Right.Planes[i];
+        } else {
+            F.Planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // keeps everything
+        }
+    }
+    return F;
+}
+
+Frustum Frustum::Transformed(const glm::mat4& M) const
+{
+    // dot(Plane, M * p) = dot(transpose(M) * Plane, p)
+    const glm::mat4 Mt = glm::transpose(M);
+    Frustum F;
+    for (int i = 0; i < 6; i++) {
+        F.Planes[i] = Mt * Planes[i];
+    }
+    return F;
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& Center, float Radius) const
+{
+    for (const glm::vec4& Plane : Planes) {
+        // Planes aren't normalized, scale the radius by the normal's length instead
+        if (glm::dot(Plane, glm::vec4(Center, 1.0f)) < -Radius * glm::length(glm::vec3(Plane))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EntryBounds::Resize(size_t NewCount)
+{
+    Count = NewCount;
+    const size_t Padded = (NewCount + 3) & ~size_t(3);
+    for (std::vector<float>* pAxis : { &MinX, &MinY, &MinZ, &MaxX, &MaxY, &MaxZ }) {
+        pAxis->assign(Padded, 0.0f);
+    }
+}
+
+void EntryBounds::Set(size_t i, const glm::vec3& Min, const glm::vec3& Max)
+{
+    MinX[i] = Min.x;
+    MinY[i] = Min.y;
+    MinZ[i] = Min.z;
+    MaxX[i] = Max.x;
+    MaxY[i] = Max.y;
+    MaxZ[i] = Max.z;
+}
+
+void Build(const MeshCache::View& View, EntryBounds& Out)
+{
+    Out.Resize(View.Entries.Size);
+
+    for (size_t e = 0; e < View.Entries.Size; e++) {
+        const MeshCache::Entry& Entry = View.Entries[e];
+        glm::vec3 BbMin(0.0f), BbMax(0.0f);
+        if (Entry.NumIndices > 0) {
+            BbMin = glm::vec3(1e10f);
+            BbMax = glm::vec3(-1e10f);
+        }
+        for (unsigned int i = 0; i < Entry.NumIndices; i++) {
+            const aiVector3D& p = View.Vertices[Entry.BaseVertex + View.Indices[Entry.BaseIndex + i]].Pos;
+            BbMin = glm::min(BbMin, glm::vec3(p.x, p.y, p.z));
+            BbMax = glm::max(BbMax, glm::vec3(p.x, p.y, p.z));
+        }
+        Out.Set(e, BbMin, BbMax);
+    }
+}
+
+void Cull(const Frustum& F, const EntryBounds& Bounds, uint8_t* pVisible)
+{
+    // A box is outside once it is entirely behind one plane. Its corner furthest along the plane
+    // normal gives dot = sum over the axes of max(n * min, n * max) + w.
+#ifdef FRUSTUM_CULLING_SSE
+    for (size_t b = 0; b < Bounds.Count; b += 4) {
+        const __m128 MinX = _mm_loadu_ps(&Bounds.MinX[b]);
+        const __m128 MinY = _mm_loadu_ps(&Bounds.MinY[b]);
+        const __m128 MinZ = _mm_loadu_ps(&Bounds.MinZ[b]);
+        const __m128 MaxX = _mm_loadu_ps(&Bounds.MaxX[b]);
+        const __m128 MaxY = _mm_loadu_ps(&Bounds.MaxY[b]);
+        const __m128 MaxZ = _mm_loadu_ps(&Bounds.MaxZ[b]);
+
+        __m128 Inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& Plane : F.Planes) {
+            const __m128 nx = _mm_set1_ps(Plane.x);
+            const __m128 ny = _mm_set1_ps(Plane.y);
+            const __m128 nz = _mm_set1_ps(Plane.z);
+            __m128 d = _mm_max_ps(_mm_mul_ps(nx, MinX), _mm_mul_ps(nx, MaxX));
+            d = _mm_add_ps(d, _mm_max_ps(_mm_mul_ps(ny, MinY), _mm_mul_ps(ny, MaxY)));
+            d = _mm_add_ps(d, _mm_max_ps(_mm_mul_ps(nz, MinZ), _mm_mul_ps(nz, MaxZ)));
+            d = _mm_add_ps(d, _mm_set1_ps(Plane.w));
+            Inside = _mm_and_ps(Inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+
+        const int Mask = _mm_movemask_ps(Inside);
+        for (size_t l = 0; l < 4 && b + l < Bounds.Count; l++) {
+            pVisible[b + l] = static_cast<uint8_t>((Mask >> l) & 1);
+        }
+    }
+#else
+    CullScalar(F, Bounds, pVisible);
+#endif
+}
+
+void CullScalar(const Frustum& F, const EntryBounds& Bounds, uint8_t* pVisible)
+{
+    for (size_t i = 0; i < Bounds.Count; i++) {
+        bool Inside = true;
+        for (const glm::vec4& Plane : F.Planes) {
+            const float d = std::max(Plane.x * Bounds.MinX[i], Plane.x * Bounds.MaxX[i])
+                + std::max(Plane.y * Bounds.MinY[i], Plane.y * Bounds.MaxY[i])
+                + std::max(Plane.z * Bounds.MinZ[i], Plane.z * Bounds.MaxZ[i]) + Plane.w;
+            Inside = Inside && d >= 0.0f;
+        }
+        pVisible[i] = Inside ? 1 : 0;
+    }
+}
+
+void SetView(const glm::mat4& PV)
+{
+    sFrustum = Frustum::FromMatrix(PV);
+    sStereo = false;
+    sVersion++;
+}
+
+void SetStereoViews(const glm::mat4& LeftPV, const glm::mat4& RightPV)
+{
+    sFrustum = Frustum::FromStereo(LeftPV, RightPV);
+    sStereo = true;
+    sVersion++;
+}
+
+bool IsStereo()
+{
+    return sStereo;
+}
+
+const Frustum& GetFrustum()
+{
+    return sFrustum;
+}
+
+unsigned int GetVersion()
+{
+    return sVersion;
+}
+
+void CullEntries(const EntryBounds& Bounds, const glm::mat4& M, std::vector<uint8_t>& Visible, unsigned int& Version)
+{
+    if (Version == sVersion && Visible.size() == Bounds.Count) {
+        return;
+    }
+    Version = sVersion;
+    Visible.resize(Bounds.Count);
+
+    if (!sEnabled) {
+        std::fill(Visible.begin(), Visible.end(), uint8_t(1));
+        return;
+    }
+
+    const auto Start = std::chrono::high_resolution_clock::now();
+    Cull(sFrustum.Transformed(M), Bounds, Visible.data());
+    sStats.CullMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+    sStats.Tested += Bounds.Count;
+    sStats.Visible += static_cast<size_t>(std::count(Visible.begin(), Visible.end(), uint8_t(1)));
+}
+
+void AddDrawnTriangles(size_t NumTriangles)
+{
+    sStats.Triangles += NumTriangles;
+}
+
+void BeginFrame()
+{
+    TimerGui::SetCounter("Cull: entries tested", static_cast<double>(sStats.Tested));
+    TimerGui::SetCounter("Cull: entries visible", static_cast<double>(sStats.Visible));
+    TimerGui::SetCounter("Cull: entries culled", static_cast<double>(sStats.Tested - sStats.Visible));
+    TimerGui::SetCounter("Cull: time (ms)", sStats.CullMs);
+    TimerGui::SetCounter("Triangles drawn", static_cast<double>(sStats.Triangles));
+
+    sStats = Stats();
+    sStereo = false;
+}
+
+}
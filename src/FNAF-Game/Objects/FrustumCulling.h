@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+
+// View frustum culling of mesh entries on the CPU.
+//
+// Meshes keep the model space boxes of their entries in SoA order (EntryBounds), built at load.
+// The frustum of the frame is brought into model space once per mesh, by multiplying its planes
+// with the model matrix, and tested against four boxes per SSE iteration: no box is ever
+// transformed. Stereo renderers set both eyes before drawing either; entries are then culled once
+// against a frustum enclosing both views and the second eye reuses the result.
+namespace FrustumCulling {
+
+struct Frustum {
+    // Left, right, bottom, top, near, far. A point p is inside when dot(Plane, vec4(p, 1)) >= 0.
+    glm::vec4 Planes[6];
+
+    // Planes of an OpenGL clip space projection * view (* model) matrix
+    static Frustum FromMatrix(const glm::mat4& PV);
+    // Plane by plane, whichever of the two eyes' planes contains the other eye's frustum. Exact for
+    // parallel eyes, conservative otherwise (a plane neither keeps is dropped).
+    static Frustum FromStereo(const glm::mat4& LeftPV, const glm::mat4& RightPV);
+
+    // The same frustum in the space M maps from, e.g. model space for a model matrix
+    [[nodiscard]] Frustum Transformed(const glm::mat4& M) const;
+
+    // Conservative: true for some spheres just outside near the frustum's edges
+    [[nodiscard]] bool IntersectsSphere(const glm::vec3& Center, float Radius) const;
+};
+
+// Boxes of a mesh's entries, each axis padded to a multiple of four
+struct EntryBounds {
+    std::vector<float> MinX, MinY, MinZ;
+    std::vector<float> MaxX, MaxY, MaxZ;
+    size_t Count = 0;
+
+    void Resize(size_t NewCount);
+    void Set(size_t i, const glm::vec3& Min, const glm::vec3& Max);
+    [[nodiscard]] size_t GetMemoryBytes() const { return 6 * sizeof(float) * MinX.capacity(); }
+};
+
+// Model space box of every entry of a view, from the vertices its indices reference
+void Build(const MeshCache::View& View, EntryBounds& Out);
+
+// pVisible[i] = 1 if entry i's box touches the frustum (both in the same space), 0 otherwise
+void Cull(const Frustum& F, const EntryBounds& Bounds, uint8_t* pVisible);
+// Same, one box at a time: what Cull() does without SSE, and the reference for it
+void CullScalar(const Frustum& F, const EntryBounds& Bounds, uint8_t* pVisible);
+
+inline bool sEnabled = true;
+
+// Frustum of the frame, in world space. GameScene sets a single view every Render(); a stereo
+// renderer calls SetStereoViews() once per frame after BeginFrame() instead.
+void SetView(const glm::mat4& PV);
+void SetStereoViews(const glm::mat4& LeftPV, const glm::mat4& RightPV);
+[[nodiscard]] bool IsStereo();
+[[nodiscard]] const Frustum& GetFrustum();
+// Changes with every SetView() / SetStereoViews(): results culled against one version stay valid
+[[nodiscard]] unsigned int GetVersion();
+
+// Cull the entries of a mesh drawn with model matrix M against the frame frustum, unless Version
+// shows they already were. Updates Version and the statistics.
+void CullEntries(const EntryBounds& Bounds, const glm::mat4& M, std::vector<uint8_t>& Visible, unsigned int& Version);
+
+// Triangles actually submitted, for the statistics
+void AddDrawnTriangles(size_t NumTriangles);
+
+// Once per frame, before rendering: publish the last frame's statistics to the timer UI and
+// go back to single view frustums
+void BeginFrame();
+
+}
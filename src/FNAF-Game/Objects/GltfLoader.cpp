@@ -0,0 +1,866 @@
+#include "GltfLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "jsonLoader/json.hpp"
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace GltfLoader {
+
+namespace {
+
+    constexpr uint32_t GlbMagic = 0x46546C67; // "glTF"
+    constexpr uint32_t GlbJsonChunk = 0x4E4F534A; // "JSON"
+    constexpr uint32_t GlbBinChunk = 0x004E4942; // "BIN\0"
+    constexpr int TrianglesMode = 4;
+
+    enum ComponentType : int {
+        Int8 = 5120,
+        Uint8 = 5121,
+        Int16 = 5122,
+        Uint16 = 5123,
+        Uint32 = 5125,
+        Float32 = 5126,
+    };
+
+    // Required extensions that don't stop us from reading the file
+    const char* const SupportedExtensions[] = { "KHR_mesh_quantization", "EXT_meshopt_compression" };
+
+    template <typename T>
+    T Read(const unsigned char* p)
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    size_t ComponentSize(int type)
+    {
+        switch (type) {
+        case Int8:
+        case Uint8:
+            return 1;
+        case Int16:
+        case Uint16:
+            return 2;
+        case Uint32:
+        case Float32:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    unsigned int NumComponents(const std::string& type)
+    {
+        if (type == "SCALAR") {
+            return 1;
+        } else if (type == "VEC2") {
+            return 2;
+        } else if (type == "VEC3") {
+            return 3;
+        } else if (type == "VEC4" || type == "MAT2") {
+            return 4;
+        } else if (type == "MAT3") {
+            return 9;
+        } else if (type == "MAT4") {
+            return 16;
+        }
+        return 0;
+    }
+
+    struct Bytes {
+        const unsigned char* Data = nullptr;
+        size_t Size = 0;
+    };
+
+    struct Document {
+        json Root;
+        std::vector<MappedFile> Files; // the .glb or the external buffers, Buffers point into them
+        std::vector<Bytes> Buffers;
+    };
+
+    // Strided view of an accessor, bounds checked when it is made
+    struct Accessor {
+        const unsigned char* Data = nullptr;
+        size_t Count = 0;
+        size_t Stride = 0;
+        int Type = Float32;
+        unsigned int NumComponents = 0;
+        bool Normalized = false;
+
+        // Normalized integers map to [0, 1] or [-1, 1] as the spec says, others convert as is
+        [[nodiscard]] float GetFloat(size_t i, unsigned int c) const
+        {
+            const unsigned char* p = Data + i * Stride + c * ComponentSize(Type);
+            switch (Type) {
+            case Float32:
+                return Read<float>(p);
+            case Int8:
+                return Normalized ? std::max(Read<int8_t>(p) / 127.0f, -1.0f) : float(Read<int8_t>(p));
+            case Uint8:
+                return Normalized ? Read<uint8_t>(p) / 255.0f : float(Read<uint8_t>(p));
+            case Int16:
+                return Normalized ? std::max(Read<int16_t>(p) / 32767.0f, -1.0f) : float(Read<int16_t>(p));
+            case Uint16:
+                return Normalized ? Read<uint16_t>(p) / 65535.0f : float(Read<uint16_t>(p));
+            case Uint32:
+                return float(Read<uint32_t>(p));
+            default:
+                return 0.0f;
+            }
+        }
+
+        [[nodiscard]] uint32_t GetUint(size_t i, unsigned int c) const
+        {
+            const unsigned char* p = Data + i * Stride + c * ComponentSize(Type);
+            switch (Type) {
+            case Uint8:
+                return Read<uint8_t>(p);
+            case Uint16:
+                return Read<uint16_t>(p);
+            case Uint32:
+                return Read<uint32_t>(p);
+            default:
+                return 0;
+            }
+        }
+    };
+
+    bool GetAccessor(const Document& doc, size_t index, Accessor& out, std::string& error)
+    {
+        const json& a = doc.Root.at("accessors").at(index);
+        if (a.contains("sparse")) {
+            error = "sparse accessor";
+            return false;
+        }
+        if (!a.contains("bufferView")) {
+            error = "accessor without buffer view";
+            return false;
+        }
+
+        out.Type = a.at("componentType").get<int>();
+        out.NumComponents = NumComponents(a.at("type").get<std::string>());
+        out.Count = a.at("count").get<size_t>();
+        out.Normalized = a.value("normalized", false);
+        const size_t ElementSize = ComponentSize(out.Type) * out.NumComponents;
+        if (ElementSize == 0) {
+            error = "unknown accessor type";
+            return false;
+        }
+
+        const json& view = doc.Root.at("bufferViews").at(a.at("bufferView").get<size_t>());
+        const auto BufferIndex = view.at("buffer").get<size_t>();
+        if (BufferIndex >= doc.Buffers.size()) {
+            error = "buffer index out of range";
+            return false;
+        }
+        const Bytes& buffer = doc.Buffers[BufferIndex];
+        if (buffer.Data == nullptr) {
+            // Compressed views live in a buffer without data unless the file ships a fallback
+            error = view.contains("extensions") ? "compressed buffer view without fallback" : "buffer without data";
+            return false;
+        }
+
+        const auto ViewOffset = view.value("byteOffset", size_t(0));
+        const auto ViewLength = view.at("byteLength").get<size_t>();
+        const auto Offset = a.value("byteOffset", size_t(0));
+        out.Stride = view.value("byteStride", ElementSize);
+        if (ViewOffset > buffer.Size || ViewLength > buffer.Size - ViewOffset
+            || (out.Count > 0 && Offset + (out.Count - 1) * out.Stride + ElementSize > ViewLength)) {
+            error = "accessor out of buffer bounds";
+            return false;
+        }
+        out.Data = buffer.Data + ViewOffset + Offset;
+        return true;
+    }
+
+    bool Parse(const std::string& filename, Document& doc, std::string& error)
+    {
+        MappedFile file;
+        if (!file.Open(filename)) {
+            error = "couldn't open file";
+            return false;
+        }
+
+        Bytes JsonText { file.Data(), file.Size() };
+        Bytes BinChunk;
+        if (file.Size() >= 12 && Read<uint32_t>(file.Data()) == GlbMagic) {
+            // Binary container: 12 byte header, then length + type prefixed chunks, JSON first
+            size_t offset = 12;
+            while (offset + 8 <= file.Size()) {
+                const auto Length = Read<uint32_t>(file.Data() + offset);
+                const auto Type = Read<uint32_t>(file.Data() + offset + 4);
+                offset += 8;
+                if (Length > file.Size() - offset) {
+                    error = "truncated GLB chunk";
+                    return false;
+                }
+                if (Type == GlbJsonChunk) {
+                    JsonText = { file.Data() + offset, Length };
+                } else if (Type == GlbBinChunk && BinChunk.Data == nullptr) {
+                    BinChunk = { file.Data() + offset, Length };
+                }
+                offset += (Length + 3) & ~size_t(3);
+            }
+        }
+
+        doc.Root = json::parse(JsonText.Data, JsonText.Data + JsonText.Size, nullptr, false);
+        if (doc.Root.is_discarded() || !doc.Root.is_object()) {
+            error = "invalid JSON";
+            return false;
+        }
+        if (doc.Root.at("asset").value("version", std::string()).substr(0, 2) != "2.") {
+            error = "not glTF 2.0";
+            return false;
+        }
+        for (const json& ext : doc.Root.value("extensionsRequired", json::array())) {
+            if (std::find(std::begin(SupportedExtensions), std::end(SupportedExtensions), ext.get<std::string>()) == std::end(SupportedExtensions)) {
+                error = "required extension " + ext.get<std::string>();
+                return false;
+            }
+        }
+
+        const fs::path Dir = fs::path(filename).parent_path();
+        for (const json& buffer : doc.Root.value("buffers", json::array())) {
+            const bool Placeholder = buffer.contains("extensions") && buffer["extensions"].contains("EXT_meshopt_compression")
+                && buffer["extensions"]["EXT_meshopt_compression"].value("fallback", false);
+            if (Placeholder || !buffer.contains("uri")) {
+                // The GLB chunk, or the data-less buffer EXT_meshopt_compression views fall back to
+                doc.Buffers.push_back(!Placeholder && doc.Buffers.empty() ? BinChunk : Bytes());
+                continue;
+            }
+
+            const auto Uri = buffer.at("uri").get<std::string>();
+            if (Uri.compare(0, 5, "data:") == 0) {
+                error = "embedded data URI";
+                return false;
+            }
+            MappedFile bin;
+            if (!bin.Open((Dir / Uri).string()) || bin.Size() < buffer.value("byteLength", size_t(0))) {
+                error = "couldn't map buffer " + Uri;
+                return false;
+            }
+            doc.Buffers.push_back({ bin.Data(), bin.Size() });
+            doc.Files.push_back(std::move(bin));
+        }
+        doc.Files.push_back(std::move(file));
+        return true;
+    }
+
+    // Assimp's naming, so bone, node and channel names match the ones of an Assimp import
+    std::string NodeName(const Document& doc, size_t node)
+    {
+        const std::string Name = doc.Root.at("nodes").at(node).value("name", std::string());
+        return Name.empty() ? "nodes[" + std::to_string(node) + "]" : Name;
+    }
+
+    aiMatrix4x4 ToAi(const glm::mat4& m)
+    {
+        return aiMatrix4x4(m[0][0], m[1][0], m[2][0], m[3][0],
+            m[0][1], m[1][1], m[2][1], m[3][1],
+            m[0][2], m[1][2], m[2][2], m[3][2],
+            m[0][3], m[1][3], m[2][3], m[3][3]);
+    }
+
+    aiMatrix4x4 NodeTransform(const json& node)
+    {
+        if (node.contains("matrix")) {
+            const auto M = node.at("matrix").get<std::vector<float>>();
+            return M.size() == 16 ? ToAi(glm::make_mat4(M.data())) : aiMatrix4x4();
+        }
+
+        const auto T = node.value("translation", std::vector<float> { 0.0f, 0.0f, 0.0f });
+        const auto R = node.value("rotation", std::vector<float> { 0.0f, 0.0f, 0.0f, 1.0f });
+        const auto S = node.value("scale", std::vector<float> { 1.0f, 1.0f, 1.0f });
+        if (T.size() != 3 || R.size() != 4 || S.size() != 3) {
+            return aiMatrix4x4();
+        }
+        const glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(T[0], T[1], T[2]))
+            * glm::mat4_cast(glm::quat(R[3], R[0], R[1], R[2]))
+            * glm::scale(glm::mat4(1.0f), glm::vec3(S[0], S[1], S[2]));
+        return ToAi(M);
+    }
+
+    struct Primitive {
+        size_t Mesh = 0;
+        Accessor Positions, Normals, TexCoords, Indices;
+        bool HasNormals = false;
+        bool HasTexCoords = false;
+        bool HasIndices = false;
+        std::vector<Accessor> Joints, Weights; // JOINTS_n / WEIGHTS_n sets
+    };
+
+    struct SceneInfo {
+        std::vector<bool> MeshInScene;
+        std::vector<int> MeshSkin; // skin of the nodes drawing the mesh, -1 if none
+        std::vector<bool> Visited;
+    };
+
+    // Pre-order like MeshCache's AddNodes, so every parent is stored before its children
+    bool AddNodes(const Document& doc, size_t node, int32_t parent, SceneInfo& scene, MeshCache::Data& out, std::string& error)
+    {
+        const json& nodes = doc.Root.at("nodes");
+        if (node >= nodes.size() || scene.Visited[node]) {
+            error = "invalid node hierarchy";
+            return false;
+        }
+        scene.Visited[node] = true;
+
+        const json& n = nodes[node];
+        const auto index = static_cast<int32_t>(out.Nodes.size());
+        out.Nodes.push_back({ parent, out.AddString(NodeName(doc, node)), NodeTransform(n) });
+
+        if (n.contains("mesh")) {
+            const auto Mesh = n.at("mesh").get<size_t>();
+            if (Mesh >= scene.MeshInScene.size()) {
+                error = "mesh index out of range";
+                return false;
+            }
+            scene.MeshInScene[Mesh] = true;
+
+            const int Skin = n.value("skin", -1);
+            if (Skin >= 0) {
+                if (scene.MeshSkin[Mesh] >= 0 && scene.MeshSkin[Mesh] != Skin) {
+                    error = "mesh bound to several skins";
+                    return false;
+                }
+                scene.MeshSkin[Mesh] = Skin;
+            }
+        }
+
+        for (const json& child : n.value("children", json::array())) {
+            if (!AddNodes(doc, child.get<size_t>(), index, scene, out, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool LoadNodes(const Document& doc, SceneInfo& scene, MeshCache::Data& out, std::string& error)
+    {
+        const json& nodes = doc.Root.value("nodes", json::array());
+        scene.Visited.assign(nodes.size(), false);
+
+        std::vector<size_t> roots;
+        if (doc.Root.contains("scenes")) {
+            const json& s = doc.Root.at("scenes").at(doc.Root.value("scene", size_t(0)));
+            roots = s.value("nodes", std::vector<size_t>());
+        } else {
+            std::vector<bool> IsChild(nodes.size(), false);
+            for (const json& n : nodes) {
+                for (const json& child : n.value("children", json::array())) {
+                    if (child.get<size_t>() < IsChild.size()) {
+                        IsChild[child.get<size_t>()] = true;
+                    }
+                }
+            }
+            for (size_t i = 0; i < nodes.size(); i++) {
+                if (!IsChild[i]) {
+                    roots.push_back(i);
+                }
+            }
+        }
+
+        // A single root node becomes the root, several get a common parent, as Assimp does
+        if (roots.size() == 1) {
+            return AddNodes(doc, roots[0], -1, scene, out, error);
+        }
+        out.Nodes.push_back({ -1, out.AddString("ROOT"), aiMatrix4x4() });
+        for (size_t root : roots) {
+            if (!AddNodes(doc, root, 0, scene, out, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Diffuse texture of every material, plus the default material Assimp appends for
+    // primitives without one
+    void LoadMaterials(const Document& doc, MeshCache::Data& out)
+    {
+        const json& materials = doc.Root.value("materials", json::array());
+        out.Materials.assign(materials.size() + 1, { MeshCache::InvalidIndex });
+
+        for (size_t i = 0; i < materials.size(); i++) {
+            const json& m = materials[i];
+            const json* pTexture = nullptr;
+            if (m.contains("pbrMetallicRoughness") && m["pbrMetallicRoughness"].contains("baseColorTexture")) {
+                pTexture = &m["pbrMetallicRoughness"]["baseColorTexture"];
+            } else if (m.contains("extensions") && m["extensions"].contains("KHR_materials_pbrSpecularGlossiness")
+                && m["extensions"]["KHR_materials_pbrSpecularGlossiness"].contains("diffuseTexture")) {
+                pTexture = &m["extensions"]["KHR_materials_pbrSpecularGlossiness"]["diffuseTexture"];
+            }
+            if (pTexture == nullptr) {
+                continue;
+            }
+
+            const json& texture = doc.Root.at("textures").at(pTexture->at("index").get<size_t>());
+            if (!texture.contains("source")) {
+                continue;
+            }
+            const json& image = doc.Root.at("images").at(texture.at("source").get<size_t>());
+            std::string p = image.value("uri", std::string());
+            if (p.empty() || p.compare(0, 5, "data:") == 0) {
+                continue; // embedded images aren't loaded from the mesh directory
+            }
+
+            if (p.substr(0, 2) == ".\\") {
+                p = p.substr(2, p.size() - 2);
+            }
+            out.Materials[i].DiffusePath = out.AddString(p);
+        }
+    }
+
+    bool LoadPrimitives(const Document& doc, std::vector<Primitive>& prims, MeshCache::Data& out, std::string& error)
+    {
+        const json& meshes = doc.Root.value("meshes", json::array());
+        const auto DefaultMaterial = static_cast<uint32_t>(out.Materials.size() - 1);
+
+        uint32_t NumVertices = 0;
+        uint32_t NumIndices = 0;
+        for (size_t m = 0; m < meshes.size(); m++) {
+            for (const json& p : meshes[m].at("primitives")) {
+                if (p.value("mode", TrianglesMode) != TrianglesMode) {
+                    error = "non-triangle primitive";
+                    return false;
+                }
+
+                Primitive prim;
+                prim.Mesh = m;
+                const json& attributes = p.at("attributes");
+                if (!attributes.contains("POSITION") || !GetAccessor(doc, attributes["POSITION"].get<size_t>(), prim.Positions, error)) {
+                    error = error.empty() ? "primitive without positions" : error;
+                    return false;
+                }
+                prim.HasNormals = attributes.contains("NORMAL");
+                if (prim.HasNormals && !GetAccessor(doc, attributes["NORMAL"].get<size_t>(), prim.Normals, error)) {
+                    return false;
+                }
+                prim.HasTexCoords = attributes.contains("TEXCOORD_0");
+                if (prim.HasTexCoords && !GetAccessor(doc, attributes["TEXCOORD_0"].get<size_t>(), prim.TexCoords, error)) {
+                    return false;
+                }
+                prim.HasIndices = p.contains("indices");
+                if (prim.HasIndices && !GetAccessor(doc, p["indices"].get<size_t>(), prim.Indices, error)) {
+                    return false;
+                }
+                for (int set = 0; attributes.contains("JOINTS_" + std::to_string(set)) && attributes.contains("WEIGHTS_" + std::to_string(set)); set++) {
+                    Accessor joints, weights;
+                    if (!GetAccessor(doc, attributes["JOINTS_" + std::to_string(set)].get<size_t>(), joints, error)
+                        || !GetAccessor(doc, attributes["WEIGHTS_" + std::to_string(set)].get<size_t>(), weights, error)) {
+                        return false;
+                    }
+                    prim.Joints.push_back(joints);
+                    prim.Weights.push_back(weights);
+                }
+
+                const size_t Count = prim.Positions.Count;
+                const size_t IndexCount = prim.HasIndices ? prim.Indices.Count : Count;
+                if (prim.Positions.NumComponents != 3 || (prim.HasNormals && (prim.Normals.NumComponents != 3 || prim.Normals.Count < Count))
+                    || (prim.HasTexCoords && (prim.TexCoords.NumComponents != 2 || prim.TexCoords.Count < Count))
+                    || (prim.HasIndices && (prim.Indices.NumComponents != 1 || prim.Indices.Type == Int8 || prim.Indices.Type == Int16 || prim.Indices.Type == Float32))
+                    || IndexCount % 3 != 0) {
+                    error = "unexpected attribute layout";
+                    return false;
+                }
+                for (size_t set = 0; set < prim.Joints.size(); set++) {
+                    if (prim.Joints[set].NumComponents != 4 || prim.Weights[set].NumComponents != 4
+                        || prim.Joints[set].Count < Count || prim.Weights[set].Count < Count) {
+                        error = "unexpected skin attribute layout";
+                        return false;
+                    }
+                }
+
+                MeshCache::Entry entry {};
+                entry.MaterialIndex = p.contains("material") ? std::min(p["material"].get<uint32_t>(), DefaultMaterial) : DefaultMaterial;
+                entry.NumIndices = static_cast<uint32_t>(IndexCount);
+                entry.BaseVertex = NumVertices;
+                entry.BaseIndex = NumIndices;
+                out.Entries.push_back(entry);
+                prims.push_back(std::move(prim));
+
+                NumVertices += static_cast<uint32_t>(Count);
+                NumIndices += entry.NumIndices;
+            }
+        }
+
+        out.Vertices.resize(NumVertices);
+        out.Indices.resize(NumIndices);
+        return true;
+    }
+
+    // Bone index of every joint of every skin used by a mesh. Bones are numbered in first-use
+    // order over the entries, like MeshCache's LoadBones does for an Assimp scene.
+    bool LoadBones(const Document& doc, const std::vector<Primitive>& prims, const SceneInfo& scene,
+        std::map<int, std::vector<unsigned int>>& skinBones, MeshCache::Data& out, std::string& error)
+    {
+        std::map<std::string, unsigned int> boneMapping;
+        for (const Primitive& prim : prims) {
+            const int Skin = scene.MeshSkin[prim.Mesh];
+            if (Skin < 0 || skinBones.count(Skin) != 0) {
+                continue;
+            }
+
+            const json& skin = doc.Root.at("skins").at(Skin);
+            const auto Joints = skin.at("joints").get<std::vector<size_t>>();
+            Accessor inverseBind;
+            const bool HasInverseBind = skin.contains("inverseBindMatrices");
+            if (HasInverseBind && (!GetAccessor(doc, skin["inverseBindMatrices"].get<size_t>(), inverseBind, error)
+                || inverseBind.NumComponents != 16 || inverseBind.Type != Float32 || inverseBind.Count < Joints.size())) {
+                error = error.empty() ? "unexpected inverse bind matrices" : error;
+                return false;
+            }
+
+            std::vector<unsigned int>& bones = skinBones[Skin];
+            for (size_t j = 0; j < Joints.size(); j++) {
+                const std::string BoneName = NodeName(doc, Joints[j]);
+                auto iter = boneMapping.find(BoneName);
+                if (iter != boneMapping.end()) {
+                    bones.push_back(iter->second);
+                    continue;
+                }
+
+                aiMatrix4x4 Offset;
+                if (HasInverseBind) {
+                    float m[16];
+                    for (unsigned int c = 0; c < 16; c++) {
+                        m[c] = inverseBind.GetFloat(j, c);
+                    }
+                    Offset = ToAi(glm::make_mat4(m));
+                }
+                const auto BoneIndex = static_cast<unsigned int>(out.BoneOffsets.size());
+                out.BoneOffsets.push_back({ out.AddString(BoneName), Offset });
+                boneMapping[BoneName] = BoneIndex;
+                bones.push_back(BoneIndex);
+            }
+        }
+        return true;
+    }
+
+    // Area weighted smooth normals, in place of aiProcess_GenSmoothNormals
+    void GenerateNormals(MeshCache::Vertex* pVertices, size_t NumVertices, const unsigned int* pIndices, size_t NumIndices)
+    {
+        for (size_t i = 0; i < NumIndices; i += 3) {
+            const aiVector3D& a = pVertices[pIndices[i]].Pos;
+            const aiVector3D& b = pVertices[pIndices[i + 1]].Pos;
+            const aiVector3D& c = pVertices[pIndices[i + 2]].Pos;
+            const aiVector3D n = (b - a) ^ (c - a);
+            for (size_t k = 0; k < 3; k++) {
+                pVertices[pIndices[i + k]].Normal += n;
+            }
+        }
+        for (size_t v = 0; v < NumVertices; v++) {
+            pVertices[v].Normal.NormalizeSafe();
+        }
+    }
+
+    // Fills the entry's vertex and index ranges. Returns false on out of range indices.
+    bool DecodePrimitive(const Primitive& prim, const MeshCache::Entry& entry, const std::vector<unsigned int>* pBones, MeshCache::Data& out)
+    {
+        const size_t Count = prim.Positions.Count;
+        MeshCache::Vertex* pVertices = out.Vertices.data() + entry.BaseVertex;
+        for (size_t v = 0; v < Count; v++) {
+            MeshCache::Vertex& vertex = pVertices[v];
+            vertex.Pos = aiVector3D(prim.Positions.GetFloat(v, 0), prim.Positions.GetFloat(v, 1), prim.Positions.GetFloat(v, 2));
+            vertex.TexCoord = prim.HasTexCoords ? aiVector2D(prim.TexCoords.GetFloat(v, 0), prim.TexCoords.GetFloat(v, 1)) : aiVector2D(0.0f, 0.0f);
+            vertex.Normal = prim.HasNormals ? aiVector3D(prim.Normals.GetFloat(v, 0), prim.Normals.GetFloat(v, 1), prim.Normals.GetFloat(v, 2))
+                                            : aiVector3D(0.0f, 0.0f, 0.0f);
+        }
+
+        unsigned int* pIndices = out.Indices.data() + entry.BaseIndex;
+        for (size_t i = 0; i < entry.NumIndices; i++) {
+            pIndices[i] = prim.HasIndices ? prim.Indices.GetUint(i, 0) : static_cast<unsigned int>(i);
+            if (pIndices[i] >= Count) {
+                return false;
+            }
+        }
+
+        if (!prim.HasNormals) {
+            GenerateNormals(pVertices, Count, pIndices, entry.NumIndices);
+        }
+
+        if (pBones == nullptr) {
+            return true;
+        }
+
+        // Every influence of every set, the 4 largest kept and renormalized when there are more,
+        // like aiProcess_LimitBoneWeights
+        std::vector<std::pair<float, unsigned int>> influences;
+        for (size_t v = 0; v < Count; v++) {
+            influences.clear();
+            for (size_t set = 0; set < prim.Joints.size(); set++) {
+                for (unsigned int c = 0; c < 4; c++) {
+                    const float Weight = prim.Weights[set].GetFloat(v, c);
+                    const uint32_t Joint = prim.Joints[set].GetUint(v, c);
+                    if (Weight <= 0.0f) {
+                        continue;
+                    }
+                    if (Joint >= pBones->size()) {
+                        return false;
+                    }
+                    influences.push_back({ Weight, (*pBones)[Joint] });
+                }
+            }
+
+            const size_t MaxInfluences = MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX;
+            float Scale = 1.0f;
+            if (influences.size() > MaxInfluences) {
+                std::partial_sort(influences.begin(), influences.begin() + MaxInfluences, influences.end(),
+                    [](const auto& a, const auto& b) { return a.first > b.first; });
+                influences.resize(MaxInfluences);
+                float Sum = 0.0f;
+                for (const auto& influence : influences) {
+                    Sum += influence.first;
+                }
+                Scale = 1.0f / Sum;
+            }
+            for (const auto& influence : influences) {
+                out.Bones[entry.BaseVertex + v].AddBoneData(influence.second, influence.first * Scale);
+            }
+        }
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    bool ReadKeys(const Document& doc, const json& sampler, std::vector<Key>& keys, uint32_t& first, uint32_t& num, float& duration,
+        Value (*Get)(const Accessor&, size_t), std::string& error)
+    {
+        Accessor input, output;
+        if (!GetAccessor(doc, sampler.at("input").get<size_t>(), input, error)
+            || !GetAccessor(doc, sampler.at("output").get<size_t>(), output, error)) {
+            return false;
+        }
+
+        // Cubic splines store in-tangent, value, out-tangent per key, Assimp keeps the values
+        const bool Cubic = sampler.value("interpolation", std::string("LINEAR")) == "CUBICSPLINE";
+        const size_t Step = Cubic ? 3 : 1;
+        if (input.NumComponents != 1 || output.Count < input.Count * Step) {
+            error = "unexpected animation sampler layout";
+            return false;
+        }
+
+        first = static_cast<uint32_t>(keys.size());
+        num = static_cast<uint32_t>(input.Count);
+        for (size_t k = 0; k < input.Count; k++) {
+            const float Time = input.GetFloat(k, 0) * 1000.0f; // Assimp's glTF ticks are milliseconds
+            keys.push_back({ Time, Get(output, k * Step + (Cubic ? 1 : 0)) });
+            duration = std::max(duration, Time);
+        }
+        return true;
+    }
+
+    aiVector3D GetVector(const Accessor& a, size_t i)
+    {
+        return aiVector3D(a.GetFloat(i, 0), a.GetFloat(i, 1), a.GetFloat(i, 2));
+    }
+
+    aiQuaternion GetQuat(const Accessor& a, size_t i)
+    {
+        return aiQuaternion(a.GetFloat(i, 3), a.GetFloat(i, 0), a.GetFloat(i, 1), a.GetFloat(i, 2));
+    }
+
+    // Channels like Assimp's glTF importer makes them: one per animated node, with a single rest
+    // pose key for the paths the animation doesn't drive but the node sets
+    bool LoadAnimations(const Document& doc, MeshCache::Data& out, std::string& error)
+    {
+        const json& animations = doc.Root.value("animations", json::array());
+        for (size_t a = 0; a < animations.size(); a++) {
+            const json& anim = animations[a];
+            const json& samplers = anim.at("samplers");
+
+            struct NodeSamplers {
+                const json* Translation = nullptr;
+                const json* Rotation = nullptr;
+                const json* Scale = nullptr;
+            };
+            std::map<size_t, NodeSamplers> nodeSamplers;
+            for (const json& channel : anim.at("channels")) {
+                const json& target = channel.at("target");
+                if (!target.contains("node")) {
+                    continue;
+                }
+                NodeSamplers& s = nodeSamplers[target.at("node").get<size_t>()];
+                const json* pSampler = &samplers.at(channel.at("sampler").get<size_t>());
+                const std::string Path = target.at("path").get<std::string>();
+                if (Path == "translation") {
+                    s.Translation = pSampler;
+                } else if (Path == "rotation") {
+                    s.Rotation = pSampler;
+                } else if (Path == "scale") {
+                    s.Scale = pSampler;
+                }
+            }
+
+            const std::string Name = anim.value("name", std::string());
+            MeshCache::Animation animation {};
+            animation.Name = out.AddString(Name.empty() ? "animations[" + std::to_string(a) + "]" : Name);
+            animation.TicksPerSecond = 1000.0f;
+            animation.FirstChannel = static_cast<uint32_t>(out.Channels.size());
+            animation.NumChannels = static_cast<uint32_t>(nodeSamplers.size());
+
+            for (const auto& [Node, s] : nodeSamplers) {
+                const json& node = doc.Root.at("nodes").at(Node);
+                MeshCache::Channel channel {};
+                channel.NodeName = out.AddString(NodeName(doc, Node));
+
+                if (s.Translation != nullptr) {
+                    if (!ReadKeys(doc, *s.Translation, out.PositionKeys, channel.FirstPosition, channel.NumPositions, animation.Duration, GetVector, error)) {
+                        return false;
+                    }
+                } else if (node.contains("translation")) {
+                    const auto T = node.at("translation").get<std::vector<float>>();
+                    channel.FirstPosition = static_cast<uint32_t>(out.PositionKeys.size());
+                    channel.NumPositions = 1;
+                    out.PositionKeys.push_back({ 0.0f, aiVector3D(T.at(0), T.at(1), T.at(2)) });
+                }
+
+                if (s.Rotation != nullptr) {
+                    if (!ReadKeys(doc, *s.Rotation, out.RotationKeys, channel.FirstRotation, channel.NumRotations, animation.Duration, GetQuat, error)) {
+                        return false;
+                    }
+                } else if (node.contains("rotation")) {
+                    const auto R = node.at("rotation").get<std::vector<float>>();
+                    channel.FirstRotation = static_cast<uint32_t>(out.RotationKeys.size());
+                    channel.NumRotations = 1;
+                    out.RotationKeys.push_back({ 0.0f, aiQuaternion(R.at(3), R.at(0), R.at(1), R.at(2)) });
+                }
+
+                if (s.Scale != nullptr) {
+                    if (!ReadKeys(doc, *s.Scale, out.ScalingKeys, channel.FirstScaling, channel.NumScalings, animation.Duration, GetVector, error)) {
+                        return false;
+                    }
+                } else if (node.contains("scale")) {
+                    const auto S = node.at("scale").get<std::vector<float>>();
+                    channel.FirstScaling = static_cast<uint32_t>(out.ScalingKeys.size());
+                    channel.NumScalings = 1;
+                    out.ScalingKeys.push_back({ 0.0f, aiVector3D(S.at(0), S.at(1), S.at(2)) });
+                }
+
+                out.Channels.push_back(channel);
+            }
+            out.Animations.push_back(animation);
+        }
+        return true;
+    }
+
+    bool LoadDocument(const Document& doc, bool skinned, MeshCache::Data& out, std::string& error, ThreadPool* pPool)
+    {
+        SceneInfo scene;
+        const size_t NumMeshes = doc.Root.value("meshes", json::array()).size();
+        scene.MeshInScene.assign(NumMeshes, false);
+        scene.MeshSkin.assign(NumMeshes, -1);
+        if (!LoadNodes(doc, scene, out, error)) {
+            return false;
+        }
+
+        LoadMaterials(doc, out);
+
+        std::vector<Primitive> prims;
+        if (!LoadPrimitives(doc, prims, out, error)) {
+            return false;
+        }
+
+        std::map<int, std::vector<unsigned int>> skinBones;
+        if (skinned) {
+            out.Bones.resize(out.Vertices.size());
+            if (!LoadBones(doc, prims, scene, skinBones, out, error)) {
+                return false;
+            }
+        }
+
+        // Every primitive owns its own vertex, index and bone ranges, so they decode independently
+        std::atomic<bool> Valid = true;
+        auto Decode = [&](unsigned int p) {
+            const int Skin = scene.MeshSkin[prims[p].Mesh];
+            const std::vector<unsigned int>* pBones = skinned && Skin >= 0 ? &skinBones.at(Skin) : nullptr;
+            if (!DecodePrimitive(prims[p], out.Entries[p], pBones, out)) {
+                Valid = false;
+            }
+        };
+        if (pPool != nullptr) {
+            pPool->ParallelFor(0, static_cast<unsigned int>(prims.size()), 1, Decode);
+        } else {
+            for (unsigned int p = 0; p < prims.size(); p++) {
+                Decode(p);
+            }
+        }
+        if (!Valid) {
+            error = "vertex or joint index out of range";
+            return false;
+        }
+
+        // Bounds of the meshes the scene draws, in mesh space like CalcNodeBoundingBox
+        for (size_t p = 0; p < prims.size(); p++) {
+            if (!scene.MeshInScene[prims[p].Mesh]) {
+                continue;
+            }
+            const MeshCache::Vertex* pVertices = out.Vertices.data() + out.Entries[p].BaseVertex;
+            for (size_t v = 0; v < prims[p].Positions.Count; v++) {
+                const glm::vec3 Pos(pVertices[v].Pos.x, pVertices[v].Pos.y, pVertices[v].Pos.z);
+                out.BbMin = glm::min(out.BbMin, Pos);
+                out.BbMax = glm::max(out.BbMax, Pos);
+            }
+        }
+
+        return !skinned || LoadAnimations(doc, out, error);
+    }
+
+    // A meshopt compressed view whose own buffer is the data-less placeholder has no fallback
+    bool NeedsMeshoptDecoder(const Document& doc)
+    {
+        for (const json& view : doc.Root.value("bufferViews", json::array())) {
+            if (view.contains("extensions") && view["extensions"].contains("EXT_meshopt_compression")) {
+                const auto BufferIndex = view.at("buffer").get<size_t>();
+                if (BufferIndex >= doc.Buffers.size() || doc.Buffers[BufferIndex].Data == nullptr) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
+
+bool IsGltf(const std::string& filename)
+{
+    std::string ext = fs::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".gltf" || ext == ".glb";
+}
+
+Result Load(const std::string& filename, bool skinned, MeshCache::Data& out, std::string& error, ThreadPool* pPool)
+{
+    out = MeshCache::Data();
+    out.Flags = skinned ? MeshCache::Flags::Skinned : 0u;
+    error.clear();
+
+    Result result = Result::Unsupported;
+    try {
+        Document doc;
+        if (Parse(filename, doc, error)) {
+            if (NeedsMeshoptDecoder(doc)) {
+                error = "EXT_meshopt_compression without an uncompressed fallback, no meshopt decoder available";
+                result = Result::Invalid;
+            } else if (LoadDocument(doc, skinned, out, error, pPool)) {
+                return Result::Loaded;
+            }
+        }
+    } catch (const json::exception& e) {
+        error = e.what();
+    }
+    out = MeshCache::Data();
+    return result;
+}
+
+}
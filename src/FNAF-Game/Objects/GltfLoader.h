@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "MeshCache.h"
+
+class ThreadPool;
+
+// Native glTF 2.0 reader for the game's own asset format (.gltf with external buffers, or .glb).
+//
+// The JSON is parsed once, buffers are memory mapped and accessors are read straight into the
+// MeshCache::Data arrays, one job per primitive when a ThreadPool is given. The result matches
+// what MeshCache::BuildFromScene makes of an Assimp import with MeshBase::sImportFlags: one entry
+// per primitive, local indices, UVs as stored in the file (Assimp's flip and aiProcess_FlipUVs
+// cancel out), bones in first-use order with glTF inverse bind matrices as offsets, at most 4
+// weights per vertex, animation keys in milliseconds. Optimizer and LOD passes are left to the
+// caller, like for the Assimp path.
+//
+// KHR_mesh_quantization is supported. Buffer views compressed with EXT_meshopt_compression are
+// read from their uncompressed fallback when the file has one. Without a fallback the file is
+// Invalid: the meshopt codec is not part of this tree and Assimp can't decode it either. Anything
+// else only Assimp handles (non-triangle primitives, sparse accessors, data URIs, other required
+// extensions) makes Load return Unsupported, and the caller falls back to Assimp.
+namespace GltfLoader {
+
+enum class Result {
+    Loaded,
+    Unsupported, // try Assimp
+    Invalid, // no importer can read it
+};
+
+[[nodiscard]] bool IsGltf(const std::string& filename);
+
+// skinned == false skips bones and animations, as BuildFromScene does. Sets error unless Loaded.
+Result Load(const std::string& filename, bool skinned, MeshCache::Data& out, std::string& error, ThreadPool* pPool = nullptr);
+
+}
@@ -2,6 +2,7 @@
 #include <GL/glew.h>
 #include <fstream>
 #include <filesystem>
+#include "MeshImporter.h"
 
 namespace fs = std::filesystem;
 
@@ -23,10 +24,10 @@ void MeshBase::CalcMeshBoundingBox(const aiMesh* mesh, glm::vec3& min, glm::vec3
     }
 }
 
-void MeshBase::CalcNodeBoundingBox(const aiNode* nd, glm::vec3& min, glm::vec3& max)
+void MeshBase::CalcNodeBoundingBox(const aiScene* scene, const aiNode* nd, glm::vec3& min, glm::vec3& max)
 {
     for (unsigned int n = 0; n < nd->mNumMeshes; ++n) {
-        const aiMesh* mesh = mScene->mMeshes[nd->mMeshes[n]];
+        const aiMesh* mesh = scene->mMeshes[nd->mMeshes[n]];
         for (unsigned int t = 0; t < mesh->mNumVertices; ++t) {
 
             aiVector3D tmp = mesh->mVertices[t];
@@ -42,7 +43,7 @@ void MeshBase::CalcNodeBoundingBox(const aiNode* nd, glm::vec3& min, glm::vec3&
     }
 
     for (unsigned int n = 0; n < nd->mNumChildren; ++n) {
-        CalcNodeBoundingBox(nd->mChildren[n], min, max);
+        CalcNodeBoundingBox(scene, nd->mChildren[n], min, max);
     }
 }
 
@@ -57,9 +58,19 @@ bool MeshBase::ValidMeshFilename(const std::string& absolutePath)
         fin.close();
     }
 
-    static Assimp::Importer gImporter;
     std::string ext = fs::path(absolutePath).extension().string();
-    return gImporter.IsExtensionSupported(ext);
+    return MeshImporter::Get().IsExtensionSupported(ext);
+}
+
+void MeshBase::SetNormalFormat(const VertexPacking::Layout& Layout)
+{
+    glUniform1i(PackingUniformLoc::OctNormals, Layout.Normal == VertexPacking::NormalFormat::Oct16 ? 1 : 0);
+}
+
+void MeshBase::SetDequant(const VertexPacking::Dequant& Dequant)
+{
+    glUniform3fv(PackingUniformLoc::PosScale, 1, &Dequant.Scale.x);
+    glUniform3fv(PackingUniformLoc::PosOffset, 1, &Dequant.Offset.x);
 }
 
 glm::mat4 MeshBase::GetModelMatrix() const
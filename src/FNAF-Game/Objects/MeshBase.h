@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include <vector>
 #include <assimp/Importer.hpp>
@@ -9,13 +9,31 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "LoadMesh.h"
+#include "VertexPacking.h"
 
+// Meshes keep no Assimp importer or scene: imports are local to the load, and only the compact
+// data drawing and animation need (MeshCache, Skeleton, AnimationClip) outlives it.
 class MeshBase {
-protected:
-    Assimp::Importer mImporter;
-
 public:
-    const aiScene* mScene = nullptr;
+    // aiProcessPreset_TargetRealtime_Quality includes aiProcess_LimitBoneWeights which restricts bones per vertex to 4
+    static constexpr unsigned int sImportFlags = aiProcessPreset_TargetRealtime_Quality | aiProcess_FlipUVs;
+
+    // GPU vertex format of StaticMesh, SkinnedMesh and TitleMesh (Weights applies to skinned meshes,
+    // TitleMesh only keeps positions). Meshes loaded before a change keep their format.
+    // Positions stay full float: Half4 quantizes every submesh to its own bounds, so vertices shared
+    // along submesh seams can round apart and crack.
+    static inline VertexPacking::Layout sVertexLayout { VertexPacking::PositionFormat::Float3, VertexPacking::NormalFormat::Oct16,
+        VertexPacking::TexCoordFormat::Half2, VertexPacking::WeightFormat::Unorm8 };
+
+    // Shader uniforms of the packed formats, at the same location in every mesh shader
+    enum PackingUniformLoc : unsigned int {
+        PosScale = 10,
+        PosOffset = 11,
+        OctNormals = 12,
+    };
+
+    static void SetNormalFormat(const VertexPacking::Layout& Layout);
+    static void SetDequant(const VertexPacking::Dequant& Dequant);
 
     glm::vec3 mBbMin = glm::vec3(0.0f);
     glm::vec3 mBbMax = glm::vec3(0.0f);
@@ -31,15 +49,26 @@ public:
     virtual ~MeshBase() = default;
 
     virtual bool LoadMesh(const std::string& filename) = 0;
+    // Start loading on the AssetLoader threads and return immediately. The mesh draws nothing
+    // until IsLoaded(); mScale and the other transform fields are left to the caller.
+    // Meshes without a streaming path load synchronously.
+    virtual bool LoadMeshAsync(const std::string& filename) { return LoadMesh(filename); }
+    [[nodiscard]] bool IsLoaded() const { return mLoaded; }
 
     [[nodiscard]] glm::mat4 GetModelMatrix() const;
 
+    // Model matrix the next Render() draws with, used to pick LOD levels and cull entries
+    void SetWorldMatrix(const glm::mat4& M) { mWorldMatrix = M; }
+
     virtual void Render() = 0;
     virtual void Update(float deltaTime) = 0;
 
 protected:
+    bool mLoaded = false;
+    glm::mat4 mWorldMatrix = glm::mat4(1.0f);
+
     static void CalcMeshBoundingBox(const aiMesh* mesh, glm::vec3& min, glm::vec3& max);
-    void CalcNodeBoundingBox(const aiNode* nd, glm::vec3& min, glm::vec3& max);
+    static void CalcNodeBoundingBox(const aiScene* scene, const aiNode* nd, glm::vec3& min, glm::vec3& max);
 
 public:
     static bool ValidMeshFilename(const std::string& absolutePath);
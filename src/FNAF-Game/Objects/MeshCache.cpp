@@ -0,0 +1,696 @@
+#include "MeshCache.h"
+#include "ClipCompression.h"
+#include "GltfLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <assimp/postprocess.h>
+#include "MeshImporter.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace MeshCache {
+
+namespace {
+
+    constexpr uint64_t SectionAlignment = 16;
+
+    uint64_t AlignUp(uint64_t n)
+    {
+        return (n + SectionAlignment - 1) & ~(SectionAlignment - 1);
+    }
+
+    void CalcNodeBoundingBox(const aiScene* pScene, const aiNode* pNode, glm::vec3& min, glm::vec3& max)
+    {
+        for (unsigned int n = 0; n < pNode->mNumMeshes; ++n) {
+            const aiMesh* pMesh = pScene->mMeshes[pNode->mMeshes[n]];
+            for (unsigned int t = 0; t < pMesh->mNumVertices; ++t) {
+                const aiVector3D& v = pMesh->mVertices[t];
+                min = glm::min(min, glm::vec3(v.x, v.y, v.z));
+                max = glm::max(max, glm::vec3(v.x, v.y, v.z));
+            }
+        }
+
+        for (unsigned int n = 0; n < pNode->mNumChildren; ++n) {
+            CalcNodeBoundingBox(pScene, pNode->mChildren[n], min, max);
+        }
+    }
+
+    // Pre-order traversal, so every parent is stored before its children
+    void AddNodes(const aiNode* pNode, int32_t parent, Data& out)
+    {
+        const auto index = static_cast<int32_t>(out.Nodes.size());
+        out.Nodes.push_back({ parent, out.AddString(pNode->mName.data), pNode->mTransformation });
+
+        for (unsigned int i = 0; i < pNode->mNumChildren; i++) {
+            AddNodes(pNode->mChildren[i], index, out);
+        }
+    }
+
+    void LoadBones(const aiMesh* pMesh, unsigned int baseVertex, std::map<std::string, unsigned int>& boneMapping, Data& out)
+    {
+        for (unsigned int i = 0; i < pMesh->mNumBones; i++) {
+            const aiBone* pBone = pMesh->mBones[i];
+            std::string boneName(pBone->mName.data);
+
+            unsigned int boneIndex;
+            auto iter = boneMapping.find(boneName);
+            if (iter == boneMapping.end()) {
+                // Allocate an index for a new bone
+                boneIndex = static_cast<unsigned int>(out.BoneOffsets.size());
+                out.BoneOffsets.push_back({ out.AddString(boneName), pBone->mOffsetMatrix });
+                boneMapping[boneName] = boneIndex;
+            } else {
+                boneIndex = iter->second;
+            }
+
+            for (unsigned int j = 0; j < pBone->mNumWeights; j++) {
+                unsigned int vertexID = baseVertex + pBone->mWeights[j].mVertexId;
+                out.Bones[vertexID].AddBoneData(boneIndex, pBone->mWeights[j].mWeight);
+            }
+        }
+    }
+
+    void OptimizeGeometry(Data& out)
+    {
+        // Triangle and vertex order as the file had it is arbitrary, baking it well is free
+        const MeshOptimizer::Report report = MeshOptimizer::Optimize(out);
+        printf("Vertex cache (FIFO %u): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", MeshOptimizer::DefaultCacheSize,
+            report.Before.ACMR, report.After.ACMR, report.Before.ATVR, report.After.ATVR);
+
+        // After the optimizer, so the levels index the final vertex order
+        const MeshSimplifier::Report lods = MeshSimplifier::BuildLods(out);
+        printf("LOD triangles:");
+        for (size_t Triangles : lods.Triangles) {
+            printf(" %zu", Triangles);
+        }
+        printf("\n");
+    }
+
+    // Animations are compressed once here and stored as clips, loading them is a copy
+    void CompressClips(Data& out)
+    {
+        out.Clips.clear();
+        out.ClipTracks.clear();
+        out.ClipKeys.clear();
+        if (out.Animations.empty()) {
+            return;
+        }
+
+        // Appending clips leaves the spans Compress reads untouched
+        const View view = out.GetView();
+        ClipCompression::Stats stats;
+        ClipCompression::Clip clip;
+        for (const Animation& anim : out.Animations) {
+            ClipCompression::Compress(view, anim, {}, clip, &stats);
+
+            Clip baked {};
+            baked.TimeToKey = clip.TimeToKey;
+            baked.TranslationMin = clip.TranslationMin;
+            baked.TranslationStep = clip.TranslationStep;
+            baked.ScalingMin = clip.ScalingMin;
+            baked.ScalingStep = clip.ScalingStep;
+            baked.FirstTrack = static_cast<uint32_t>(out.ClipTracks.size());
+            baked.FirstKey = static_cast<uint32_t>(out.ClipKeys.size());
+            baked.NumKeys = static_cast<uint32_t>(clip.Keys.size());
+            out.Clips.push_back(baked);
+            out.ClipTracks.insert(out.ClipTracks.end(), clip.Tracks.begin(), clip.Tracks.end());
+            out.ClipKeys.insert(out.ClipKeys.end(), clip.Keys.begin(), clip.Keys.end());
+        }
+
+        printf("Animation clips: %zu keys -> %zu, %.1f KB -> %.1f KB\n", stats.SourceKeys, stats.Keys,
+            stats.SourceBytes / 1024.0, stats.Bytes / 1024.0);
+    }
+
+    template <typename T>
+    void SetSection(Header& header, SectionId id, const std::vector<T>& vec, uint64_t& offset)
+    {
+        header.Sections[id].Offset = offset;
+        header.Sections[id].Size = vec.size() * sizeof(T);
+        offset = AlignUp(offset + header.Sections[id].Size);
+    }
+
+    template <typename T>
+    void WriteSection(std::ofstream& out, const Header& header, SectionId id, const std::vector<T>& vec)
+    {
+        static const char padding[SectionAlignment] {};
+        const auto pos = static_cast<uint64_t>(out.tellp());
+        assert(pos <= header.Sections[id].Offset);
+        out.write(padding, static_cast<std::streamsize>(header.Sections[id].Offset - pos));
+        out.write(reinterpret_cast<const char*>(vec.data()), static_cast<std::streamsize>(header.Sections[id].Size));
+    }
+
+    template <typename T>
+    bool GetSection(const MappedFile& file, const Header& header, SectionId id, Span<T>& span)
+    {
+        const Section& s = header.Sections[id];
+        if (s.Offset > file.Size() || s.Size > file.Size() - s.Offset || s.Size % sizeof(T) != 0 || s.Offset % alignof(T) != 0) {
+            return false;
+        }
+        span.Data = reinterpret_cast<const T*>(file.Data() + s.Offset);
+        span.Size = s.Size / sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    Span<T> MakeSpan(const std::vector<T>& vec)
+    {
+        return { vec.data(), vec.size() };
+    }
+
+    bool InRange(uint64_t First, uint64_t Count, size_t Size)
+    {
+        return First <= Size && Count <= Size - First;
+    }
+
+    // Every index of [BaseIndex, BaseIndex + NumIndices) stays inside the NumVertices of its entry
+    bool IndicesInRange(const View& view, uint32_t BaseIndex, uint32_t NumIndices, uint32_t NumVertices)
+    {
+        if (!InRange(BaseIndex, NumIndices, view.Indices.Size)) {
+            return false;
+        }
+        const unsigned int* pIndices = view.Indices.Data + BaseIndex;
+        for (uint32_t i = 0; i < NumIndices; i++) {
+            if (pIndices[i] >= NumVertices) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Cross references of a mapped file: section sizes alone don't stop a damaged cache from
+    // sending reads (and GPU uploads) past the end of a section
+    bool Validate(const View& view)
+    {
+        if (!view.Strings.empty() && view.Strings[view.Strings.Size - 1] != '\0') {
+            return false;
+        }
+
+        std::vector<uint32_t> EntryVertices(view.Entries.Size);
+        for (size_t i = 0; i < view.Entries.Size; i++) {
+            const Entry& entry = view.Entries[i];
+            // Entries are back to back, each one runs up to the next BaseVertex
+            const uint64_t End = i + 1 < view.Entries.Size ? view.Entries[i + 1].BaseVertex : view.Vertices.Size;
+            if (entry.BaseVertex > End || End > view.Vertices.Size || entry.MaterialIndex >= view.Materials.Size) {
+                return false;
+            }
+            EntryVertices[i] = static_cast<uint32_t>(End - entry.BaseVertex);
+            if (!IndicesInRange(view, entry.BaseIndex, entry.NumIndices, EntryVertices[i])) {
+                return false;
+            }
+        }
+
+        for (const Lod& lod : view.Lods) {
+            if (lod.Entry >= view.Entries.Size || !IndicesInRange(view, lod.BaseIndex, lod.NumIndices, EntryVertices[lod.Entry])) {
+                return false;
+            }
+        }
+
+        if (!view.Bones.empty()) {
+            if (view.Bones.Size != view.Vertices.Size) {
+                return false;
+            }
+            for (const VertexBoneData& bone : view.Bones) {
+                for (int i = 0; i < VertexBoneData::NUM_BONES_PER_VERTEX; i++) {
+                    if (bone.Weights[i] != 0.0f && bone.IDs[i] >= view.BoneOffsets.Size) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < view.Nodes.Size; i++) {
+            if (view.Nodes[i].Parent < -1 || view.Nodes[i].Parent >= static_cast<int32_t>(i)) {
+                return false;
+            }
+        }
+
+        for (const Animation& anim : view.Animations) {
+            if (!InRange(anim.FirstChannel, anim.NumChannels, view.Channels.Size)) {
+                return false;
+            }
+        }
+        for (const Channel& channel : view.Channels) {
+            if (!InRange(channel.FirstPosition, channel.NumPositions, view.PositionKeys.Size)
+                || !InRange(channel.FirstRotation, channel.NumRotations, view.RotationKeys.Size)
+                || !InRange(channel.FirstScaling, channel.NumScalings, view.ScalingKeys.Size)) {
+                return false;
+            }
+        }
+
+        // One baked clip per animation, every track inside the keys of its clip
+        if (view.Clips.Size != view.Animations.Size) {
+            return false;
+        }
+        for (size_t i = 0; i < view.Clips.Size; i++) {
+            const Clip& clip = view.Clips[i];
+            const uint64_t NumTracks = uint64_t(view.Animations[i].NumChannels) * ClipCompression::NumTrackTypes;
+            if (!InRange(clip.FirstTrack, NumTracks, view.ClipTracks.Size) || !InRange(clip.FirstKey, clip.NumKeys, view.ClipKeys.Size)) {
+                return false;
+            }
+            for (uint64_t t = 0; t < NumTracks; t++) {
+                const ClipTrack& track = view.ClipTracks[clip.FirstTrack + t];
+                if (!InRange(track.FirstKey, track.NumKeys, clip.NumKeys)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Temporary file of one writer: concurrent bakes of the same source, from other threads or
+    // other processes, each rename their own complete file over the cache
+    std::string TempPath(const std::string& path)
+    {
+#ifdef _WIN32
+        const unsigned long processId = _getpid();
+#else
+        const unsigned long processId = getpid();
+#endif
+        const size_t threadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return path + "." + std::to_string(processId) + "." + std::to_string(threadId) + ".tmp";
+    }
+}
+
+void VertexBoneData::AddBoneData(unsigned int BoneID, float Weight)
+{
+    for (unsigned int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+        if (Weights[i] == 0.0) {
+            IDs[i] = BoneID;
+            Weights[i] = Weight;
+            return;
+        }
+    }
+
+    // should never get here - more bones than we have space for
+    printf("more bones than we have space for, %d, %p\n", BoneID, this);
+    assert(0);
+}
+
+uint32_t Data::AddString(const std::string& str)
+{
+    const auto offset = static_cast<uint32_t>(Strings.size());
+    Strings.insert(Strings.end(), str.begin(), str.end());
+    Strings.push_back('\0');
+    return offset;
+}
+
+View Data::GetView() const
+{
+    View view;
+    view.Flags = Flags;
+    view.BbMin = BbMin;
+    view.BbMax = BbMax;
+    view.Vertices = MakeSpan(Vertices);
+    view.Bones = MakeSpan(Bones);
+    view.Indices = MakeSpan(Indices);
+    view.Entries = MakeSpan(Entries);
+    view.Materials = MakeSpan(Materials);
+    view.Nodes = MakeSpan(Nodes);
+    view.BoneOffsets = MakeSpan(BoneOffsets);
+    view.Animations = MakeSpan(Animations);
+    view.Channels = MakeSpan(Channels);
+    view.PositionKeys = MakeSpan(PositionKeys);
+    view.RotationKeys = MakeSpan(RotationKeys);
+    view.ScalingKeys = MakeSpan(ScalingKeys);
+    view.Strings = MakeSpan(Strings);
+    view.Lods = MakeSpan(Lods);
+    view.Clips = MakeSpan(Clips);
+    view.ClipTracks = MakeSpan(ClipTracks);
+    view.ClipKeys = MakeSpan(ClipKeys);
+    return view;
+}
+
+bool SourceStamp(const std::string& sourceFilename, uint64_t& size, int64_t& time)
+{
+    std::error_code ec;
+    size = fs::file_size(sourceFilename, ec);
+    if (ec) {
+        return false;
+    }
+    time = static_cast<int64_t>(fs::last_write_time(sourceFilename, ec).time_since_epoch().count());
+    return !ec;
+}
+
+std::string CachePath(const std::string& sourceFilename)
+{
+    return sourceFilename + Extension;
+}
+
+void BuildFromScene(const aiScene* pScene, bool skinned, Data& out)
+{
+    out = Data();
+    out.Flags = skinned ? Flags::Skinned : 0u;
+    out.Entries.resize(pScene->mNumMeshes);
+
+    unsigned int NumVertices = 0;
+    unsigned int NumIndices = 0;
+
+    // Count the number of vertices and indices
+    for (unsigned int i = 0; i < pScene->mNumMeshes; i++) {
+        out.Entries[i].MaterialIndex = pScene->mMeshes[i]->mMaterialIndex;
+        out.Entries[i].NumIndices = pScene->mMeshes[i]->mNumFaces * 3;
+        out.Entries[i].BaseVertex = NumVertices;
+        out.Entries[i].BaseIndex = NumIndices;
+
+        NumVertices += pScene->mMeshes[i]->mNumVertices;
+        NumIndices += out.Entries[i].NumIndices;
+    }
+
+    out.Vertices.reserve(NumVertices);
+    out.Indices.reserve(NumIndices);
+    if (skinned) {
+        out.Bones.resize(NumVertices);
+    }
+
+    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    std::map<std::string, unsigned int> boneMapping;
+
+    for (unsigned int m = 0; m < pScene->mNumMeshes; m++) {
+        const aiMesh* pMesh = pScene->mMeshes[m];
+
+        // Populate the interleaved vertex stream
+        for (unsigned int i = 0; i < pMesh->mNumVertices; i++) {
+            const aiVector3D& Normal = pMesh->HasNormals() ? pMesh->mNormals[i] : Zero3D;
+            const aiVector3D& TexCoord = pMesh->HasTextureCoords(0) ? pMesh->mTextureCoords[0][i] : Zero3D;
+            out.Vertices.push_back({ pMesh->mVertices[i], aiVector2D(TexCoord.x, TexCoord.y), Normal });
+        }
+
+        if (skinned) {
+            LoadBones(pMesh, out.Entries[m].BaseVertex, boneMapping, out);
+        }
+
+        // Populate the index buffer
+        for (unsigned int i = 0; i < pMesh->mNumFaces; i++) {
+            const aiFace& Face = pMesh->mFaces[i];
+            assert(Face.mNumIndices == 3);
+            out.Indices.push_back(Face.mIndices[0]);
+            out.Indices.push_back(Face.mIndices[1]);
+            out.Indices.push_back(Face.mIndices[2]);
+        }
+    }
+
+    // Materials only carry the diffuse texture path, textures are loaded by the mesh
+    out.Materials.resize(pScene->mNumMaterials, { InvalidIndex });
+    for (unsigned int i = 0; i < pScene->mNumMaterials; i++) {
+        const aiMaterial* pMaterial = pScene->mMaterials[i];
+        aiString Path;
+
+        if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0
+            && pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &Path, nullptr, nullptr, nullptr, nullptr, nullptr) == AI_SUCCESS) {
+            std::string p(Path.data);
+
+            if (p.substr(0, 2) == ".\\") {
+                p = p.substr(2, p.size() - 2);
+            }
+            out.Materials[i].DiffusePath = out.AddString(p);
+        }
+    }
+
+    AddNodes(pScene->mRootNode, -1, out);
+    CalcNodeBoundingBox(pScene, pScene->mRootNode, out.BbMin, out.BbMax);
+
+    OptimizeGeometry(out);
+
+    if (!skinned) {
+        return;
+    }
+
+    for (unsigned int a = 0; a < pScene->mNumAnimations; a++) {
+        const aiAnimation* pAnimation = pScene->mAnimations[a];
+
+        Animation anim {};
+        anim.Name = out.AddString(pAnimation->mName.data);
+        anim.Duration = static_cast<float>(pAnimation->mDuration);
+        anim.TicksPerSecond = static_cast<float>(pAnimation->mTicksPerSecond);
+        anim.FirstChannel = static_cast<uint32_t>(out.Channels.size());
+        anim.NumChannels = pAnimation->mNumChannels;
+        out.Animations.push_back(anim);
+
+        for (unsigned int c = 0; c < pAnimation->mNumChannels; c++) {
+            const aiNodeAnim* pNodeAnim = pAnimation->mChannels[c];
+
+            Channel channel {};
+            channel.NodeName = out.AddString(pNodeAnim->mNodeName.data);
+            channel.FirstPosition = static_cast<uint32_t>(out.PositionKeys.size());
+            channel.NumPositions = pNodeAnim->mNumPositionKeys;
+            channel.FirstRotation = static_cast<uint32_t>(out.RotationKeys.size());
+            channel.NumRotations = pNodeAnim->mNumRotationKeys;
+            channel.FirstScaling = static_cast<uint32_t>(out.ScalingKeys.size());
+            channel.NumScalings = pNodeAnim->mNumScalingKeys;
+            out.Channels.push_back(channel);
+
+            for (unsigned int k = 0; k < pNodeAnim->mNumPositionKeys; k++) {
+                out.PositionKeys.push_back({ static_cast<float>(pNodeAnim->mPositionKeys[k].mTime), pNodeAnim->mPositionKeys[k].mValue });
+            }
+            for (unsigned int k = 0; k < pNodeAnim->mNumRotationKeys; k++) {
+                out.RotationKeys.push_back({ static_cast<float>(pNodeAnim->mRotationKeys[k].mTime), pNodeAnim->mRotationKeys[k].mValue });
+            }
+            for (unsigned int k = 0; k < pNodeAnim->mNumScalingKeys; k++) {
+                out.ScalingKeys.push_back({ static_cast<float>(pNodeAnim->mScalingKeys[k].mTime), pNodeAnim->mScalingKeys[k].mValue });
+            }
+        }
+    }
+
+    CompressClips(out);
+}
+
+bool Import(const std::string& sourceFilename, uint32_t importFlags, bool skinned, Data& out, ThreadPool* pPool)
+{
+    if (GltfLoader::IsGltf(sourceFilename)) {
+        std::string error;
+        const GltfLoader::Result result = GltfLoader::Load(sourceFilename, skinned, out, error, pPool);
+        if (result == GltfLoader::Result::Loaded) {
+            OptimizeGeometry(out);
+            CompressClips(out);
+            return true;
+        }
+        if (result == GltfLoader::Result::Invalid) {
+            printf("Error parsing '%s': '%s'\n", sourceFilename.c_str(), error.c_str());
+            return false;
+        }
+        printf("glTF loader can't read '%s' (%s), using Assimp\n", sourceFilename.c_str(), error.c_str());
+    }
+
+    const MeshImporter::Result Imported = MeshImporter::Get().Import(sourceFilename, importFlags);
+    if (!Imported.Valid()) {
+        printf("Error parsing '%s': '%s'\n", sourceFilename.c_str(), Imported.mError.c_str());
+        return false;
+    }
+    BuildFromScene(Imported.mScene.get(), skinned, out);
+    return true;
+}
+
+bool Write(const std::string& sourceFilename, uint32_t importFlags, const Data& data)
+{
+    Header header {};
+    header.Magic = Magic;
+    header.Version = Version;
+    header.Flags = data.Flags;
+    header.ImportFlags = importFlags;
+    if (!SourceStamp(sourceFilename, header.SourceSize, header.SourceTime)) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        header.BbMin[i] = data.BbMin[i];
+        header.BbMax[i] = data.BbMax[i];
+    }
+
+    uint64_t offset = AlignUp(sizeof(Header));
+    SetSection(header, VerticesSection, data.Vertices, offset);
+    SetSection(header, BonesSection, data.Bones, offset);
+    SetSection(header, IndicesSection, data.Indices, offset);
+    SetSection(header, EntriesSection, data.Entries, offset);
+    SetSection(header, MaterialsSection, data.Materials, offset);
+    SetSection(header, NodesSection, data.Nodes, offset);
+    SetSection(header, BoneOffsetsSection, data.BoneOffsets, offset);
+    SetSection(header, AnimationsSection, data.Animations, offset);
+    SetSection(header, ChannelsSection, data.Channels, offset);
+    SetSection(header, PositionKeysSection, data.PositionKeys, offset);
+    SetSection(header, RotationKeysSection, data.RotationKeys, offset);
+    SetSection(header, ScalingKeysSection, data.ScalingKeys, offset);
+    SetSection(header, StringsSection, data.Strings, offset);
+    SetSection(header, LodsSection, data.Lods, offset);
+    SetSection(header, ClipsSection, data.Clips, offset);
+    SetSection(header, ClipTracksSection, data.ClipTracks, offset);
+    SetSection(header, ClipKeysSection, data.ClipKeys, offset);
+
+    // Write to a temporary file first so a crash never leaves a truncated cache behind
+    const std::string path = CachePath(sourceFilename);
+    const std::string tmpPath = TempPath(path);
+    {
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) {
+            printf("Couldn't write mesh cache: %s\n", tmpPath.c_str());
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        WriteSection(out, header, VerticesSection, data.Vertices);
+        WriteSection(out, header, BonesSection, data.Bones);
+        WriteSection(out, header, IndicesSection, data.Indices);
+        WriteSection(out, header, EntriesSection, data.Entries);
+        WriteSection(out, header, MaterialsSection, data.Materials);
+        WriteSection(out, header, NodesSection, data.Nodes);
+        WriteSection(out, header, BoneOffsetsSection, data.BoneOffsets);
+        WriteSection(out, header, AnimationsSection, data.Animations);
+        WriteSection(out, header, ChannelsSection, data.Channels);
+        WriteSection(out, header, PositionKeysSection, data.PositionKeys);
+        WriteSection(out, header, RotationKeysSection, data.RotationKeys);
+        WriteSection(out, header, ScalingKeysSection, data.ScalingKeys);
+        WriteSection(out, header, StringsSection, data.Strings);
+        WriteSection(out, header, LodsSection, data.Lods);
+        WriteSection(out, header, ClipsSection, data.Clips);
+        WriteSection(out, header, ClipTracksSection, data.ClipTracks);
+        WriteSection(out, header, ClipKeysSection, data.ClipKeys);
+
+        if (!out) {
+            printf("Couldn't write mesh cache: %s\n", tmpPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool Bake(const std::string& sourceFilename, uint32_t importFlags, bool skinned, ThreadPool* pPool)
+{
+    Data data;
+    return Import(sourceFilename, importFlags, skinned, data, pPool) && Write(sourceFilename, importFlags, data);
+}
+
+void PackVertices(const View& view, VertexPacking::Layout layout, VertexPacking::PackedVertices& out)
+{
+    const bool skinned = layout.Weights != VertexPacking::WeightFormat::None && view.Bones.Size == view.Vertices.Size;
+    if (!skinned) {
+        layout.Weights = VertexPacking::WeightFormat::None;
+    }
+
+    if (view.Vertices.empty()) {
+        layout.Finalize();
+        out = VertexPacking::PackedVertices();
+        out.Format = layout;
+        return;
+    }
+
+    VertexPacking::Streams streams;
+    streams.Positions = { &view.Vertices.Data->Pos, sizeof(Vertex) };
+    streams.Normals = { &view.Vertices.Data->Normal, sizeof(Vertex) };
+    streams.TexCoords = { &view.Vertices.Data->TexCoord, sizeof(Vertex) };
+    if (skinned) {
+        streams.BoneIds = { view.Bones.Data->IDs, sizeof(VertexBoneData) };
+        streams.Weights = { view.Bones.Data->Weights, sizeof(VertexBoneData) };
+    }
+
+    std::vector<VertexPacking::Submesh> submeshes(view.Entries.Size);
+    for (size_t i = 0; i < view.Entries.Size; i++) {
+        // Entries are laid out back to back, each one runs up to the next BaseVertex
+        const uint32_t End = i + 1 < view.Entries.Size ? view.Entries[i + 1].BaseVertex : static_cast<uint32_t>(view.Vertices.Size);
+        submeshes[i] = { view.Entries[i].BaseVertex, End - view.Entries[i].BaseVertex };
+    }
+
+    VertexPacking::Pack(streams, view.Vertices.Size, submeshes, layout, out);
+}
+
+bool Source::Load(const std::string& sourceFilename, uint32_t importFlags, bool skinned, ThreadPool* pPool)
+{
+    mFile.Close();
+    mData = Data();
+    mView = View();
+
+    if (mFile.Open(sourceFilename, importFlags) && (!skinned || (mFile.GetView().Flags & Flags::Skinned))) {
+        printf("Loading mesh %s (cached)\n", sourceFilename.c_str());
+        mView = mFile.GetView();
+        return true;
+    }
+    mFile.Close();
+
+    printf("Loading mesh %s\n", sourceFilename.c_str());
+    if (!Import(sourceFilename, importFlags, skinned, mData, pPool)) {
+        return false;
+    }
+    Write(sourceFilename, importFlags, mData);
+    mView = mData.GetView();
+    return true;
+}
+
+bool File::Open(const std::string& sourceFilename, uint32_t importFlags)
+{
+    Close();
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SourceStamp(sourceFilename, sourceSize, sourceTime)) {
+        return false;
+    }
+
+    if (!mFile.Open(CachePath(sourceFilename))) {
+        return false;
+    }
+
+    if (mFile.Size() < sizeof(Header)) {
+        Close();
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const Header*>(mFile.Data());
+    if (header->Magic != Magic || header->Version != Version || header->ImportFlags != importFlags
+        || header->SourceSize != sourceSize || header->SourceTime != sourceTime) {
+        Close();
+        return false;
+    }
+
+    mView = View();
+    mView.Flags = header->Flags;
+    mView.BbMin = glm::vec3(header->BbMin[0], header->BbMin[1], header->BbMin[2]);
+    mView.BbMax = glm::vec3(header->BbMax[0], header->BbMax[1], header->BbMax[2]);
+
+    const bool valid = GetSection(mFile, *header, VerticesSection, mView.Vertices)
+        && GetSection(mFile, *header, BonesSection, mView.Bones)
+        && GetSection(mFile, *header, IndicesSection, mView.Indices)
+        && GetSection(mFile, *header, EntriesSection, mView.Entries)
+        && GetSection(mFile, *header, MaterialsSection, mView.Materials)
+        && GetSection(mFile, *header, NodesSection, mView.Nodes)
+        && GetSection(mFile, *header, BoneOffsetsSection, mView.BoneOffsets)
+        && GetSection(mFile, *header, AnimationsSection, mView.Animations)
+        && GetSection(mFile, *header, ChannelsSection, mView.Channels)
+        && GetSection(mFile, *header, PositionKeysSection, mView.PositionKeys)
+        && GetSection(mFile, *header, RotationKeysSection, mView.RotationKeys)
+        && GetSection(mFile, *header, ScalingKeysSection, mView.ScalingKeys)
+        && GetSection(mFile, *header, StringsSection, mView.Strings)
+        && GetSection(mFile, *header, LodsSection, mView.Lods)
+        && GetSection(mFile, *header, ClipsSection, mView.Clips)
+        && GetSection(mFile, *header, ClipTracksSection, mView.ClipTracks)
+        && GetSection(mFile, *header, ClipKeysSection, mView.ClipKeys)
+        && Validate(mView);
+
+    // Source::Load rebakes from the source asset
+    if (!valid) {
+        printf("Corrupt mesh cache: %s\n", CachePath(sourceFilename).c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+// Baked mesh cache.
+//
+// A versioned binary image of everything StaticMesh and SkinnedMesh pull out of a
+// glTF file (GltfLoader) or an Assimp scene: one interleaved vertex stream, the bone weight stream, indices, the
+// MeshEntry table, material texture paths, the node hierarchy (pre-order, parents
+// before children), bone offsets and animation channels. The file sits next to the
+// source asset ("Scene.gltf" -> "Scene.gltf.meshcache") and is memory mapped on load,
+// so a cache hit needs no parsing at all. It is rebuilt whenever the source size,
+// timestamp or import flags change. Triangles and vertices are stored in the order
+// MeshOptimizer picked for the vertex caches, followed by the coarser index lists of the
+// LOD levels MeshSimplifier built for every entry. Animations are stored both as imported
+// keys and as the clips ClipCompression reduced them to, so loading a clip is a copy.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+
+#include "MappedFile.h"
+#include "VertexPacking.h"
+
+class ThreadPool;
+
+namespace MeshCache {
+
+constexpr uint32_t Magic = 0x434D4E46; // "FNMC"
+constexpr uint32_t Version = 5; // 5: clips re-baked with exact rotation errors
+constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+const std::string Extension = ".meshcache";
+
+enum Flags : uint32_t {
+    Skinned = 1u << 0,
+};
+
+enum SectionId : uint32_t {
+    VerticesSection,
+    BonesSection,
+    IndicesSection,
+    EntriesSection,
+    MaterialsSection,
+    NodesSection,
+    BoneOffsetsSection,
+    AnimationsSection,
+    ChannelsSection,
+    PositionKeysSection,
+    RotationKeysSection,
+    ScalingKeysSection,
+    StringsSection,
+    LodsSection,
+    ClipsSection,
+    ClipTracksSection,
+    ClipKeysSection,
+    NumSections
+};
+
+struct Section {
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+struct Header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Flags;
+    uint32_t ImportFlags;
+    uint64_t SourceSize;
+    int64_t SourceTime;
+    float BbMin[3];
+    float BbMax[3];
+    Section Sections[NumSections];
+};
+
+// Interleaved vertex: position, texcoord, normal
+struct Vertex {
+    aiVector3D Pos;
+    aiVector2D TexCoord;
+    aiVector3D Normal;
+};
+
+struct VertexBoneData {
+    static const int NUM_BONES_PER_VERTEX = 4;
+
+    unsigned char IDs[NUM_BONES_PER_VERTEX] {};
+    float Weights[NUM_BONES_PER_VERTEX] {};
+
+    void AddBoneData(unsigned int BoneID, float Weight);
+};
+
+struct Entry {
+    uint32_t NumIndices;
+    uint32_t BaseVertex;
+    uint32_t BaseIndex;
+    uint32_t MaterialIndex;
+};
+
+// Coarser level of an entry: more indices over the entry's vertices, drawn with its BaseVertex.
+// Sorted by entry, then from finer to coarser.
+struct Lod {
+    uint32_t Entry;
+    uint32_t BaseIndex;
+    uint32_t NumIndices;
+    float Error; // object space distance from the full detail surface
+};
+
+// Diffuse texture path relative to the mesh directory, offset into the string table
+struct Material {
+    uint32_t DiffusePath;
+};
+
+struct Node {
+    int32_t Parent;
+    uint32_t Name;
+    aiMatrix4x4 Transformation;
+};
+
+struct BoneOffset {
+    uint32_t Name;
+    aiMatrix4x4 Offset;
+};
+
+struct Animation {
+    uint32_t Name;
+    float Duration;
+    float TicksPerSecond;
+    uint32_t FirstChannel;
+    uint32_t NumChannels;
+};
+
+struct Channel {
+    uint32_t NodeName;
+    uint32_t FirstPosition;
+    uint32_t NumPositions;
+    uint32_t FirstRotation;
+    uint32_t NumRotations;
+    uint32_t FirstScaling;
+    uint32_t NumScalings;
+};
+
+struct VectorKey {
+    float Time;
+    aiVector3D Value;
+};
+
+struct QuatKey {
+    float Time;
+    aiQuaternion Value;
+};
+
+// Compressed form of the animation with the same index, decoded by ClipCompression
+struct Clip {
+    float TimeToKey; // ticks to quantized key time
+    aiVector3D TranslationMin, TranslationStep;
+    aiVector3D ScalingMin, ScalingStep;
+    uint32_t FirstTrack; // ClipCompression::NumTrackTypes tracks per channel of the animation
+    uint32_t FirstKey;
+    uint32_t NumKeys;
+};
+
+// Keys of one track, FirstKey is relative to the clip's FirstKey. NumKeys 0: the clip doesn't
+// drive this part of the node.
+struct ClipTrack {
+    uint32_t FirstKey;
+    uint32_t NumKeys;
+};
+
+struct ClipKey {
+    uint16_t Time;
+    uint16_t Value[3];
+};
+
+template <typename T>
+struct Span {
+    const T* Data = nullptr;
+    size_t Size = 0;
+
+    [[nodiscard]] const T* begin() const { return Data; }
+    [[nodiscard]] const T* end() const { return Data + Size; }
+    [[nodiscard]] bool empty() const { return Size == 0; }
+    const T& operator[](size_t i) const { return Data[i]; }
+};
+
+// Read-only view of a mesh, backed either by a mapped cache file or by MeshCache::Data
+struct View {
+    uint32_t Flags = 0;
+    glm::vec3 BbMin = glm::vec3(0.0f);
+    glm::vec3 BbMax = glm::vec3(0.0f);
+
+    Span<Vertex> Vertices;
+    Span<VertexBoneData> Bones;
+    Span<unsigned int> Indices;
+    Span<Entry> Entries;
+    Span<Material> Materials;
+    Span<Node> Nodes;
+    Span<BoneOffset> BoneOffsets;
+    Span<Animation> Animations;
+    Span<Channel> Channels;
+    Span<VectorKey> PositionKeys;
+    Span<QuatKey> RotationKeys;
+    Span<VectorKey> ScalingKeys;
+    Span<char> Strings;
+    Span<Lod> Lods;
+    Span<Clip> Clips;
+    Span<ClipTrack> ClipTracks;
+    Span<ClipKey> ClipKeys;
+
+    [[nodiscard]] const char* String(uint32_t offset) const { return offset < Strings.Size ? Strings.Data + offset : ""; }
+};
+
+// CPU-side mesh data extracted from a source asset, ready to be written or uploaded
+struct Data {
+    uint32_t Flags = 0;
+    glm::vec3 BbMin = glm::vec3(1e10f);
+    glm::vec3 BbMax = glm::vec3(-1e10f);
+
+    std::vector<Vertex> Vertices;
+    std::vector<VertexBoneData> Bones;
+    std::vector<unsigned int> Indices;
+    std::vector<Entry> Entries;
+    std::vector<Material> Materials;
+    std::vector<Node> Nodes;
+    std::vector<BoneOffset> BoneOffsets;
+    std::vector<Animation> Animations;
+    std::vector<Channel> Channels;
+    std::vector<VectorKey> PositionKeys;
+    std::vector<QuatKey> RotationKeys;
+    std::vector<VectorKey> ScalingKeys;
+    std::vector<char> Strings;
+    std::vector<Lod> Lods;
+    std::vector<Clip> Clips;
+    std::vector<ClipTrack> ClipTracks;
+    std::vector<ClipKey> ClipKeys;
+
+    uint32_t AddString(const std::string& str);
+    [[nodiscard]] View GetView() const;
+};
+
+// Mapped cache file. The view stays valid while the file is open.
+class File {
+public:
+    bool Open(const std::string& sourceFilename, uint32_t importFlags);
+    void Close() { mFile.Close(); }
+
+    [[nodiscard]] bool IsOpen() const { return mFile.IsOpen(); }
+    [[nodiscard]] const View& GetView() const { return mView; }
+
+private:
+    MappedFile mFile;
+    View mView;
+};
+
+// Mesh data for a source asset from wherever it is cheapest: the mapped cache when it is
+// current, otherwise an import that also (re)writes the cache. Needs no GL context and
+// imports through MeshImporter, so loads can run on worker threads.
+class Source {
+public:
+    // skinned == true rejects caches baked without bones. pPool decodes glTF primitives in parallel.
+    bool Load(const std::string& sourceFilename, uint32_t importFlags, bool skinned, ThreadPool* pPool = nullptr);
+
+    [[nodiscard]] const View& GetView() const { return mView; }
+    [[nodiscard]] bool FromCache() const { return mFile.IsOpen(); }
+
+private:
+    File mFile;
+    Data mData;
+    View mView;
+};
+
+std::string CachePath(const std::string& sourceFilename);
+
+// Size and modification time of a source asset, kept by the files baked from it to detect changes
+bool SourceStamp(const std::string& sourceFilename, uint64_t& size, int64_t& time);
+
+// Extract geometry, materials, skeleton and animations from an imported scene
+void BuildFromScene(const aiScene* pScene, bool skinned, Data& out);
+
+// Read a source asset into optimized Data: glTF natively through GltfLoader, other formats and
+// glTF files it can't handle through Assimp with importFlags
+bool Import(const std::string& sourceFilename, uint32_t importFlags, bool skinned, Data& out, ThreadPool* pPool = nullptr);
+
+bool Write(const std::string& sourceFilename, uint32_t importFlags, const Data& data);
+
+// GPU vertex buffer for a view, one Dequant per entry. Bone ids and weights are packed when the
+// layout asks for them and the view has bones.
+void PackVertices(const View& view, VertexPacking::Layout layout, VertexPacking::PackedVertices& out);
+
+// Offline bake: import the source and write its cache. Returns false on import failure.
+bool Bake(const std::string& sourceFilename, uint32_t importFlags, bool skinned, ThreadPool* pPool = nullptr);
+
+}
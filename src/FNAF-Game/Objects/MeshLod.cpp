@@ -0,0 +1,102 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+
+namespace MeshLod {
+
+namespace {
+
+    glm::vec3 sEye = glm::vec3(0.0f);
+    float sPixelsPerUnit = 0.0f; // pixels covered by one world unit at distance one, 0 before SetCamera
+
+}
+
+void Build(const MeshCache::View& View, std::vector<Entry>& Out)
+{
+    Out.assign(View.Entries.Size, Entry());
+
+    for (size_t e = 0; e < View.Entries.Size; e++) {
+        const MeshCache::Entry& Source = View.Entries[e];
+        Entry& Lods = Out[e];
+        Lods.Levels.push_back({ Source.BaseIndex, Source.NumIndices, 0.0f });
+
+        if (Source.NumIndices == 0) {
+            continue;
+        }
+
+        glm::vec3 BbMin(1e10f), BbMax(-1e10f);
+        for (unsigned int i = 0; i < Source.NumIndices; i++) {
+            const aiVector3D& p = View.Vertices[Source.BaseVertex + View.Indices[Source.BaseIndex + i]].Pos;
+            BbMin = glm::min(BbMin, glm::vec3(p.x, p.y, p.z));
+            BbMax = glm::max(BbMax, glm::vec3(p.x, p.y, p.z));
+        }
+        Lods.Center = 0.5f * (BbMin + BbMax);
+        Lods.Radius = 0.5f * glm::length(BbMax - BbMin);
+    }
+
+    for (const MeshCache::Lod& Lod : View.Lods) {
+        if (Lod.Entry < Out.size()) {
+            Out[Lod.Entry].Levels.push_back({ Lod.BaseIndex, Lod.NumIndices, Lod.Error });
+        }
+    }
+}
+
+void SetCamera(const glm::mat4& P, const glm::vec3& Eye, int ViewportHeight)
+{
+    if (sHoldLevels) {
+        return;
+    }
+
+    // P[1][1] = 1 / tan(fovy / 2): half the viewport height covers 1 / P[1][1] units at distance one
+    sEye = Eye;
+    sPixelsPerUnit = 0.5f * static_cast<float>(ViewportHeight) * P[1][1];
+}
+
+unsigned int Select(const Entry& Lods, const glm::mat4& M, unsigned int Current)
+{
+    const auto NumLevels = static_cast<unsigned int>(Lods.Levels.size());
+    if (!sEnabled || NumLevels < 2 || sPixelsPerUnit <= 0.0f) {
+        return 0;
+    }
+    if (sHoldLevels) {
+        return std::min(Current, NumLevels - 1);
+    }
+
+    const glm::vec3 Center = glm::vec3(M * glm::vec4(Lods.Center, 1.0f));
+    const float Scale = std::max(glm::length(glm::vec3(M[0])), std::max(glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))));
+
+    // Nearest point of the bounding sphere, so large entries are judged by their closest part
+    const float Distance = std::max(glm::length(Center - sEye) - Lods.Radius * Scale, 1e-3f);
+    const float PixelsPerUnit = sPixelsPerUnit * Scale / Distance;
+
+    auto Fits = [&](unsigned int Level, float Threshold) {
+        return Lods.Levels[Level].Error * PixelsPerUnit <= Threshold;
+    };
+
+    Current = std::min(Current, NumLevels - 1);
+
+    unsigned int Target = 0;
+    while (Target + 1 < NumLevels && Fits(Target + 1, sMaxPixelError)) {
+        Target++;
+    }
+
+    if (Target > Current) {
+        unsigned int Level = Current;
+        while (Level + 1 < NumLevels && Fits(Level + 1, sMaxPixelError * (1.0f - sHysteresis))) {
+            Level++;
+        }
+        return Level;
+    }
+    if (Target < Current && !Fits(Current, sMaxPixelError * (1.0f + sHysteresis))) {
+        return Target;
+    }
+    return Current;
+}
+
+float ProjectedRadius(const glm::vec3& Center, float Radius)
+{
+    const float Distance = std::max(glm::length(Center - sEye) - Radius, 1e-3f);
+    return sPixelsPerUnit * Radius / Distance;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+
+// Runtime LOD selection for the levels MeshSimplifier baked into the mesh cache.
+//
+// A level is picked per entry from its projected size: the object space error of each level is
+// scaled to pixels at the entry's distance, and the coarsest level under MaxPixelError wins.
+// Hysteresis keeps entries near a threshold from switching level every frame: a coarser level is
+// only taken once it is comfortably under the threshold, a finer one once the current level is
+// clearly over it.
+namespace MeshLod {
+
+struct Level {
+    unsigned int BaseIndex = 0;
+    unsigned int NumIndices = 0;
+    float Error = 0.0f;
+};
+
+struct Entry {
+    glm::vec3 Center = glm::vec3(0.0f); // object space bounding sphere of the full detail entry
+    float Radius = 0.0f;
+    std::vector<Level> Levels; // Levels[0] is the entry itself
+};
+
+// Levels and bounds of every entry of a view. CPU only.
+void Build(const MeshCache::View& View, std::vector<Entry>& Out);
+
+// Camera of the frame: projection, eye position and viewport height in pixels
+void SetCamera(const glm::mat4& P, const glm::vec3& Eye, int ViewportHeight);
+
+inline bool sEnabled = true;
+inline float sMaxPixelError = 1.0f;
+inline float sHysteresis = 0.25f; // fraction of sMaxPixelError
+// Set while the frame is drawn a second time for another target (the VR mirror window): SetCamera
+// keeps the first camera and Select the current levels, so the two targets don't fight over them
+inline bool sHoldLevels = false;
+
+// Level to draw an entry with this frame, given its model matrix and last frame's level
+[[nodiscard]] unsigned int Select(const Entry& Lods, const glm::mat4& M, unsigned int Current);
+
+// Radius in pixels of a world space sphere seen from its nearest point, 0 before SetCamera
+[[nodiscard]] float ProjectedRadius(const glm::vec3& Center, float Radius);
+
+}
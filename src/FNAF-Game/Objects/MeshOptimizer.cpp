@@ -0,0 +1,391 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <glm/glm.hpp>
+
+namespace MeshOptimizer {
+
+namespace {
+
+    // Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006), with his suggested constants
+    constexpr int MaxCacheSize = 32;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+    constexpr unsigned int MaxValenceTable = 64;
+
+    struct ScoreTables {
+        float Cache[MaxCacheSize];
+        float Valence[MaxValenceTable];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < MaxCacheSize; i++) {
+                if (i < 3) {
+                    // The last triangle's vertices get a fixed score, so no strip direction is preferred
+                    Cache[i] = LastTriScore;
+                } else {
+                    const float Scaler = 1.0f / (MaxCacheSize - 3);
+                    Cache[i] = std::pow(1.0f - (i - 3) * Scaler, CacheDecayPower);
+                }
+            }
+            for (unsigned int i = 0; i < MaxValenceTable; i++) {
+                Valence[i] = i == 0 ? 0.0f : ValenceBoostScale * std::pow(static_cast<float>(i), -ValenceBoostPower);
+            }
+        }
+    };
+
+    float VertexScore(const ScoreTables& Tables, int CachePos, unsigned int Remaining)
+    {
+        if (Remaining == 0) {
+            return -1.0f;
+        }
+
+        float Score = CachePos >= 0 ? Tables.Cache[CachePos] : 0.0f;
+        Score += Remaining < MaxValenceTable ? Tables.Valence[Remaining]
+                                             : ValenceBoostScale * std::pow(static_cast<float>(Remaining), -ValenceBoostPower);
+        return Score;
+    }
+
+    // Misses of a FIFO cache over a triangle range, per triangle (Misses[t] in 0..3) if requested
+    size_t SimulateFifo(const unsigned int* pIndices, size_t NumIndices, size_t NumVertices, unsigned int CacheSize,
+        std::vector<unsigned char>* pMissesPerTriangle)
+    {
+        // Timestamp trick: a vertex is cached if it entered less than CacheSize misses ago
+        std::vector<size_t> Stamp(NumVertices, 0);
+        size_t Time = CacheSize + 1;
+        size_t Misses = 0;
+
+        if (pMissesPerTriangle) {
+            pMissesPerTriangle->assign(NumIndices / 3, 0);
+        }
+
+        for (size_t i = 0; i < NumIndices; i++) {
+            const unsigned int v = pIndices[i];
+            if (Time - Stamp[v] > CacheSize) {
+                Stamp[v] = Time++;
+                Misses++;
+                if (pMissesPerTriangle) {
+                    (*pMissesPerTriangle)[i / 3]++;
+                }
+            }
+        }
+        return Misses;
+    }
+}
+
+CacheStats AnalyzeVertexCache(const unsigned int* pIndices, size_t NumIndices, size_t NumVertices, unsigned int CacheSize)
+{
+    CacheStats Stats;
+    if (NumIndices < 3 || NumVertices == 0) {
+        return Stats;
+    }
+
+    const size_t Misses = SimulateFifo(pIndices, NumIndices, NumVertices, CacheSize, nullptr);
+
+    // ATVR is relative to the vertices actually used, unreferenced ones cost nothing
+    std::vector<bool> Used(NumVertices, false);
+    size_t NumUsed = 0;
+    for (size_t i = 0; i < NumIndices; i++) {
+        if (!Used[pIndices[i]]) {
+            Used[pIndices[i]] = true;
+            NumUsed++;
+        }
+    }
+
+    Stats.ACMR = static_cast<float>(Misses) / static_cast<float>(NumIndices / 3);
+    Stats.ATVR = static_cast<float>(Misses) / static_cast<float>(NumUsed);
+    return Stats;
+}
+
+void OptimizeVertexCache(unsigned int* pIndices, size_t NumIndices, size_t NumVertices)
+{
+    static const ScoreTables Tables;
+
+    const size_t NumTriangles = NumIndices / 3;
+    if (NumTriangles == 0) {
+        return;
+    }
+
+    // Triangles adjacent to each vertex, CSR layout. Remaining[v] is the live prefix of the list.
+    std::vector<unsigned int> Remaining(NumVertices, 0);
+    for (size_t i = 0; i < NumTriangles * 3; i++) {
+        Remaining[pIndices[i]]++;
+    }
+    std::vector<unsigned int> Offsets(NumVertices + 1, 0);
+    for (size_t v = 0; v < NumVertices; v++) {
+        Offsets[v + 1] = Offsets[v] + Remaining[v];
+    }
+    std::vector<unsigned int> Adjacency(Offsets[NumVertices]);
+    {
+        std::vector<unsigned int> Fill(Offsets.begin(), Offsets.end() - 1);
+        for (size_t t = 0; t < NumTriangles; t++) {
+            for (int k = 0; k < 3; k++) {
+                Adjacency[Fill[pIndices[3 * t + k]]++] = static_cast<unsigned int>(t);
+            }
+        }
+    }
+
+    std::vector<int> CachePos(NumVertices, -1);
+    std::vector<float> VScore(NumVertices);
+    for (size_t v = 0; v < NumVertices; v++) {
+        VScore[v] = VertexScore(Tables, -1, Remaining[v]);
+    }
+
+    std::vector<float> TScore(NumTriangles);
+    std::vector<bool> Emitted(NumTriangles, false);
+    size_t Best = 0;
+    for (size_t t = 0; t < NumTriangles; t++) {
+        TScore[t] = VScore[pIndices[3 * t]] + VScore[pIndices[3 * t + 1]] + VScore[pIndices[3 * t + 2]];
+        if (TScore[t] > TScore[Best]) {
+            Best = t;
+        }
+    }
+
+    std::vector<unsigned int> Output(NumTriangles * 3);
+    unsigned int Cache[MaxCacheSize + 3];
+    int CacheCount = 0;
+    size_t Cursor = 0;
+
+    for (size_t Out = 0; Out < NumTriangles; Out++) {
+        if (Best == SIZE_MAX) {
+            // Nothing adjacent to the cache is left: continue with the next unused triangle
+            while (Emitted[Cursor]) {
+                Cursor++;
+            }
+            Best = Cursor;
+        }
+
+        const unsigned int* Tri = pIndices + 3 * Best;
+        Output[3 * Out] = Tri[0];
+        Output[3 * Out + 1] = Tri[1];
+        Output[3 * Out + 2] = Tri[2];
+        Emitted[Best] = true;
+
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = Tri[k];
+            unsigned int* pList = Adjacency.data() + Offsets[v];
+            for (unsigned int i = 0; i < Remaining[v]; i++) {
+                if (pList[i] == Best) {
+                    std::swap(pList[i], pList[Remaining[v] - 1]);
+                    break;
+                }
+            }
+            Remaining[v]--;
+        }
+
+        // LRU update: the triangle's vertices go to the front, the rest shift back
+        unsigned int NewCache[MaxCacheSize + 3];
+        int NewCount = 0;
+        for (int k = 0; k < 3; k++) {
+            if (std::find(NewCache, NewCache + NewCount, Tri[k]) == NewCache + NewCount) {
+                NewCache[NewCount++] = Tri[k];
+            }
+        }
+        for (int i = 0; i < CacheCount; i++) {
+            if (Cache[i] != Tri[0] && Cache[i] != Tri[1] && Cache[i] != Tri[2]) {
+                NewCache[NewCount++] = Cache[i];
+            }
+        }
+
+        // Rescore everything that moved, evicted vertices included, then their live triangles
+        for (int i = 0; i < NewCount; i++) {
+            const unsigned int v = NewCache[i];
+            CachePos[v] = i < MaxCacheSize ? i : -1;
+            VScore[v] = VertexScore(Tables, CachePos[v], Remaining[v]);
+        }
+
+        Best = SIZE_MAX;
+        float BestScore = -1.0f;
+        for (int i = 0; i < NewCount; i++) {
+            const unsigned int v = NewCache[i];
+            const unsigned int* pList = Adjacency.data() + Offsets[v];
+            for (unsigned int j = 0; j < Remaining[v]; j++) {
+                const unsigned int t = pList[j];
+                TScore[t] = VScore[pIndices[3 * t]] + VScore[pIndices[3 * t + 1]] + VScore[pIndices[3 * t + 2]];
+                if (TScore[t] > BestScore) {
+                    BestScore = TScore[t];
+                    Best = t;
+                }
+            }
+        }
+
+        CacheCount = std::min(NewCount, MaxCacheSize);
+        std::copy(NewCache, NewCache + CacheCount, Cache);
+    }
+
+    std::copy(Output.begin(), Output.end(), pIndices);
+}
+
+void OptimizeOverdraw(unsigned int* pIndices, size_t NumIndices, const float* pPositions, size_t NumVertices,
+    size_t Stride, float Threshold)
+{
+    const size_t NumTriangles = NumIndices / 3;
+    if (NumTriangles < 2) {
+        return;
+    }
+
+    auto Position = [&](unsigned int v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(pPositions) + v * Stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Cluster boundaries (Tipsify's soft boundaries): each cluster is simulated from a cold cache and
+    // ends as soon as its ACMR is down to Lambda, so wherever the sort moves it, it costs about Lambda
+    // per triangle and the whole order stays within Threshold of the cache optimized one
+    const size_t BaseMisses = SimulateFifo(pIndices, NumIndices, NumVertices, DefaultCacheSize, nullptr);
+    const float Lambda = static_cast<float>(BaseMisses) / static_cast<float>(NumTriangles) * Threshold;
+
+    std::vector<size_t> ClusterStart;
+    std::vector<size_t> Stamp(NumVertices, 0);
+    size_t Time = DefaultCacheSize + 1;
+    size_t ClusterMisses = 0;
+    for (size_t t = 0; t < NumTriangles; t++) {
+        const size_t ClusterSize = ClusterStart.empty() ? 0 : t - ClusterStart.back();
+        if (t == 0 || static_cast<float>(ClusterMisses) <= Lambda * static_cast<float>(ClusterSize)) {
+            ClusterStart.push_back(t);
+            ClusterMisses = 0;
+            Time += DefaultCacheSize + 1; // flush
+        }
+        for (size_t i = 3 * t; i < 3 * t + 3; i++) {
+            if (Time - Stamp[pIndices[i]] > DefaultCacheSize) {
+                Stamp[pIndices[i]] = Time++;
+                ClusterMisses++;
+            }
+        }
+    }
+    const size_t NumClusters = ClusterStart.size();
+    if (NumClusters < 2) {
+        return;
+    }
+    ClusterStart.push_back(NumTriangles);
+
+    // Area weighted centroid and normal per cluster
+    glm::vec3 MeshCentroid(0.0f);
+    float MeshArea = 0.0f;
+    std::vector<glm::vec3> Centroids(NumClusters, glm::vec3(0.0f));
+    std::vector<glm::vec3> Normals(NumClusters, glm::vec3(0.0f));
+
+    for (size_t c = 0; c < NumClusters; c++) {
+        float Area = 0.0f;
+        for (size_t t = ClusterStart[c]; t < ClusterStart[c + 1]; t++) {
+            const glm::vec3 a = Position(pIndices[3 * t]);
+            const glm::vec3 b = Position(pIndices[3 * t + 1]);
+            const glm::vec3 d = Position(pIndices[3 * t + 2]);
+            const glm::vec3 n = glm::cross(b - a, d - a);
+            const float A = glm::length(n);
+            Centroids[c] += (a + b + d) * (A / 3.0f);
+            Normals[c] += n;
+            Area += A;
+        }
+        MeshCentroid += Centroids[c];
+        MeshArea += Area;
+        if (Area > 0.0f) {
+            Centroids[c] /= Area;
+        }
+    }
+    if (MeshArea > 0.0f) {
+        MeshCentroid /= MeshArea;
+    }
+
+    // Clusters facing away from the middle of the mesh are the ones usually seen in front
+    std::vector<float> SortKey(NumClusters);
+    for (size_t c = 0; c < NumClusters; c++) {
+        const float Len = glm::length(Normals[c]);
+        SortKey[c] = Len > 0.0f ? glm::dot(Centroids[c] - MeshCentroid, Normals[c] / Len) : 0.0f;
+    }
+
+    std::vector<size_t> Order(NumClusters);
+    std::iota(Order.begin(), Order.end(), size_t(0));
+    std::stable_sort(Order.begin(), Order.end(), [&](size_t a, size_t b) { return SortKey[a] > SortKey[b]; });
+
+    std::vector<unsigned int> Sorted;
+    Sorted.reserve(NumTriangles * 3);
+    for (size_t c : Order) {
+        Sorted.insert(Sorted.end(), pIndices + 3 * ClusterStart[c], pIndices + 3 * ClusterStart[c + 1]);
+    }
+
+    // Keep the new order only if the cache does not pay too much for it
+    const size_t SortedMisses = SimulateFifo(Sorted.data(), Sorted.size(), NumVertices, DefaultCacheSize, nullptr);
+    if (static_cast<float>(SortedMisses) <= static_cast<float>(BaseMisses) * Threshold) {
+        std::copy(Sorted.begin(), Sorted.end(), pIndices);
+    }
+}
+
+size_t BuildFetchRemap(unsigned int* pIndices, size_t NumIndices, size_t NumVertices, std::vector<unsigned int>& Remap)
+{
+    constexpr unsigned int Unused = 0xFFFFFFFF;
+    Remap.assign(NumVertices, Unused);
+
+    unsigned int Next = 0;
+    for (size_t i = 0; i < NumIndices; i++) {
+        unsigned int& r = Remap[pIndices[i]];
+        if (r == Unused) {
+            r = Next++;
+        }
+        pIndices[i] = r;
+    }
+
+    const size_t NumUsed = Next;
+    for (unsigned int& r : Remap) {
+        if (r == Unused) {
+            r = Next++;
+        }
+    }
+    return NumUsed;
+}
+
+Report Optimize(MeshCache::Data& Mesh)
+{
+    Report Result;
+    double Triangles = 0.0, Vertices = 0.0;
+    double MissesBefore = 0.0, MissesAfter = 0.0;
+
+    std::vector<unsigned int> Remap;
+
+    for (size_t e = 0; e < Mesh.Entries.size(); e++) {
+        const MeshCache::Entry& Entry = Mesh.Entries[e];
+        if (Entry.NumIndices < 3) {
+            continue;
+        }
+
+        // Entries index their own vertex range, which ends where the next one starts
+        const size_t VertexEnd = e + 1 < Mesh.Entries.size() ? Mesh.Entries[e + 1].BaseVertex : Mesh.Vertices.size();
+        const size_t NumVertices = VertexEnd - Entry.BaseVertex;
+        unsigned int* pIndices = Mesh.Indices.data() + Entry.BaseIndex;
+
+        const CacheStats Before = AnalyzeVertexCache(pIndices, Entry.NumIndices, NumVertices);
+
+        OptimizeVertexCache(pIndices, Entry.NumIndices, NumVertices);
+        OptimizeOverdraw(pIndices, Entry.NumIndices, &Mesh.Vertices[Entry.BaseVertex].Pos.x, NumVertices, sizeof(MeshCache::Vertex));
+
+        BuildFetchRemap(pIndices, Entry.NumIndices, NumVertices, Remap);
+        RemapVertices(Mesh.Vertices.data() + Entry.BaseVertex, Remap);
+        if (!Mesh.Bones.empty()) {
+            RemapVertices(Mesh.Bones.data() + Entry.BaseVertex, Remap);
+        }
+
+        const CacheStats After = AnalyzeVertexCache(pIndices, Entry.NumIndices, NumVertices);
+
+        // Back to raw counts so entries are weighted by their size
+        const double t = Entry.NumIndices / 3;
+        const double Used = Before.ATVR > 0.0f ? t * Before.ACMR / Before.ATVR : 0.0;
+        Triangles += t;
+        Vertices += Used;
+        MissesBefore += Before.ACMR * t;
+        MissesAfter += After.ACMR * t;
+    }
+
+    if (Triangles > 0.0 && Vertices > 0.0) {
+        Result.Before = { static_cast<float>(MissesBefore / Triangles), static_cast<float>(MissesBefore / Vertices) };
+        Result.After = { static_cast<float>(MissesAfter / Triangles), static_cast<float>(MissesAfter / Vertices) };
+    }
+    return Result;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "MeshCache.h"
+
+// Triangle and vertex order optimization for indexed triangle lists.
+//
+// Three passes, run in this order on every MeshEntry:
+//  - OptimizeVertexCache: Forsyth's greedy triangle order for post-transform cache hits
+//  - OptimizeOverdraw: Tipsify-style clustering of that order, clusters sorted outside-in so
+//    front surfaces tend to be drawn first, as long as the cache efficiency barely suffers
+//  - BuildFetchRemap: vertices renumbered in first-use order, for pre-transform fetch locality
+// Plain CPU code on index and position arrays, usable at bake or load time and in headless tests.
+namespace MeshOptimizer {
+
+// Simulated FIFO post-transform cache, the model used for reporting
+constexpr unsigned int DefaultCacheSize = 16;
+
+struct CacheStats {
+    float ACMR = 0.0f; // average cache miss ratio: transformed vertices per triangle (0.5 .. 3)
+    float ATVR = 0.0f; // average transform to vertex ratio: transformed vertices per vertex (1 ..)
+};
+
+[[nodiscard]] CacheStats AnalyzeVertexCache(const unsigned int* pIndices, size_t NumIndices, size_t NumVertices,
+    unsigned int CacheSize = DefaultCacheSize);
+
+// Reorder triangles in place. Indices must be < NumVertices.
+void OptimizeVertexCache(unsigned int* pIndices, size_t NumIndices, size_t NumVertices);
+
+// Reorder the triangles of a cache optimized list in place to reduce overdraw. Threshold bounds
+// the ACMR increase that is accepted (1.05 = 5% worse at most). Positions are Stride bytes apart.
+void OptimizeOverdraw(unsigned int* pIndices, size_t NumIndices, const float* pPositions, size_t NumVertices,
+    size_t Stride, float Threshold = 1.05f);
+
+// Remap[old] = new vertex index, in order of first use; unreferenced vertices go last.
+// Rewrites the indices and returns the number of referenced vertices.
+size_t BuildFetchRemap(unsigned int* pIndices, size_t NumIndices, size_t NumVertices, std::vector<unsigned int>& Remap);
+
+// Apply a remap from BuildFetchRemap to one vertex stream
+template <typename T>
+void RemapVertices(T* pVertices, const std::vector<unsigned int>& Remap)
+{
+    std::vector<T> Copy(pVertices, pVertices + Remap.size());
+    for (size_t i = 0; i < Remap.size(); i++) {
+        pVertices[Remap[i]] = Copy[i];
+    }
+}
+
+struct Report {
+    CacheStats Before;
+    CacheStats After;
+};
+
+// All three passes on every entry of a mesh, vertex and bone streams included
+Report Optimize(MeshCache::Data& Mesh);
+
+}
@@ -0,0 +1,585 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_set>
+#include <glm/glm.hpp>
+
+namespace MeshSimplifier {
+
+namespace {
+
+    constexpr unsigned int None = 0xFFFFFFFF;
+
+    // Border edges get a plane quadric through the edge, perpendicular to the face, weighted
+    // strongly so outlines keep their shape
+    constexpr double BorderWeight = 10.0;
+
+    // Collapses may not turn a face by more than ~75 degrees
+    constexpr float MinNormalDot = 0.25f;
+
+    enum class Kind : unsigned char {
+        Manifold, // free to collapse onto any neighbour
+        Border, // on one open boundary, slides along it
+        Seam, // two attribute copies, slides along the seam
+        Locked, // corners, non-manifold spots, complex seams
+    };
+
+    struct Quadric {
+        double A00 = 0, A01 = 0, A02 = 0, A11 = 0, A12 = 0, A22 = 0;
+        double B0 = 0, B1 = 0, B2 = 0;
+        double C = 0;
+        double W = 0;
+
+        // Squared distance to the plane n.p = d, times Weight
+        void AddPlane(const glm::dvec3& n, double d, double Weight)
+        {
+            A00 += Weight * n.x * n.x;
+            A01 += Weight * n.x * n.y;
+            A02 += Weight * n.x * n.z;
+            A11 += Weight * n.y * n.y;
+            A12 += Weight * n.y * n.z;
+            A22 += Weight * n.z * n.z;
+            B0 -= Weight * n.x * d;
+            B1 -= Weight * n.y * d;
+            B2 -= Weight * n.z * d;
+            C += Weight * d * d;
+            W += Weight;
+        }
+
+        void Add(const Quadric& q)
+        {
+            A00 += q.A00, A01 += q.A01, A02 += q.A02, A11 += q.A11, A12 += q.A12, A22 += q.A22;
+            B0 += q.B0, B1 += q.B1, B2 += q.B2;
+            C += q.C;
+            W += q.W;
+        }
+
+        // Mean squared distance of p to the accumulated planes
+        [[nodiscard]] double Error(const glm::dvec3& p) const
+        {
+            const double e = A00 * p.x * p.x + A11 * p.y * p.y + A22 * p.z * p.z
+                + 2.0 * (A01 * p.x * p.y + A02 * p.x * p.z + A12 * p.y * p.z)
+                + 2.0 * (B0 * p.x + B1 * p.y + B2 * p.z) + C;
+            return W > 0.0 ? std::max(e, 0.0) / W : 0.0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int From; // position id that disappears
+        unsigned int To; // position id it moves onto
+        unsigned int FromWedge; // an attribute copy of From with an edge to ToWedge
+        unsigned int ToWedge;
+        float Cost;
+
+        bool operator<(const Collapse& other) const
+        {
+            if (Cost != other.Cost) {
+                return Cost < other.Cost;
+            }
+            if (From != other.From) {
+                return From < other.From;
+            }
+            return To < other.To;
+        }
+    };
+
+    uint64_t EdgeKey(unsigned int a, unsigned int b)
+    {
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    glm::vec3 Position(const MeshCache::Vertex* pVertices, unsigned int v)
+    {
+        return glm::vec3(pVertices[v].Pos.x, pVertices[v].Pos.y, pVertices[v].Pos.z);
+    }
+
+    // Half the L1 distance of two skinning weight sets: 0 identical .. 1 disjoint
+    float BoneDistance(const MeshCache::VertexBoneData& a, const MeshCache::VertexBoneData& b)
+    {
+        constexpr int n = MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX;
+
+        // Signed weight per bone id, a positive and b negative; unused slots repeat id 0 with weight 0
+        unsigned char Ids[2 * n];
+        float Weights[2 * n];
+        int Count = 0;
+        auto Add = [&](unsigned char Id, float Weight) {
+            for (int k = 0; k < Count; k++) {
+                if (Ids[k] == Id) {
+                    Weights[k] += Weight;
+                    return;
+                }
+            }
+            Ids[Count] = Id;
+            Weights[Count++] = Weight;
+        };
+        for (int i = 0; i < n; i++) {
+            Add(a.IDs[i], a.Weights[i]);
+            Add(b.IDs[i], -b.Weights[i]);
+        }
+
+        float Sum = 0.0f;
+        for (int k = 0; k < Count; k++) {
+            Sum += std::abs(Weights[k]);
+        }
+        return std::min(0.5f * Sum, 1.0f);
+    }
+
+    struct State {
+        const MeshCache::Vertex* pVertices;
+        const MeshCache::VertexBoneData* pBones;
+        size_t NumVertices;
+
+        std::vector<unsigned int> Pos; // wedge -> position id (lowest wedge at that position)
+        std::vector<unsigned int> NextWedge; // cycle through the wedges of a position
+        std::vector<Kind> Kinds; // per position id
+        std::vector<unsigned int> BorderNext, BorderPrev; // per position id, along open edges
+        std::vector<unsigned int> SeamNext, SeamPrev; // per wedge, along seam edges
+        std::unordered_set<uint64_t> BorderEdges; // position id pairs, in face winding
+        std::vector<Quadric> Quadrics; // per position id
+
+        float UvScale = 0.0f;
+        float BoneScale = 0.0f;
+    };
+
+    // Group vertices sharing a position: sorted, so the grouping does not depend on hashing
+    void WeldPositions(State& s)
+    {
+        std::vector<unsigned int> Order(s.NumVertices);
+        std::iota(Order.begin(), Order.end(), 0u);
+        std::sort(Order.begin(), Order.end(), [&](unsigned int a, unsigned int b) {
+            const aiVector3D& pa = s.pVertices[a].Pos;
+            const aiVector3D& pb = s.pVertices[b].Pos;
+            if (pa.x != pb.x) {
+                return pa.x < pb.x;
+            }
+            if (pa.y != pb.y) {
+                return pa.y < pb.y;
+            }
+            if (pa.z != pb.z) {
+                return pa.z < pb.z;
+            }
+            return a < b;
+        });
+
+        s.Pos.assign(s.NumVertices, None);
+        s.NextWedge.assign(s.NumVertices, None);
+        for (size_t i = 0; i < Order.size();) {
+            size_t j = i + 1;
+            while (j < Order.size() && s.pVertices[Order[j]].Pos == s.pVertices[Order[i]].Pos) {
+                j++;
+            }
+            for (size_t k = i; k < j; k++) {
+                s.Pos[Order[k]] = Order[i];
+                s.NextWedge[Order[k]] = Order[k + 1 < j ? k + 1 : i];
+            }
+            i = j;
+        }
+    }
+
+    void Classify(State& s, const std::vector<unsigned int>& Indices)
+    {
+        const size_t n = s.NumVertices;
+
+        std::unordered_set<uint64_t> WedgeEdges, PosEdges;
+        for (size_t i = 0; i < Indices.size(); i += 3) {
+            for (int e = 0; e < 3; e++) {
+                const unsigned int a = Indices[i + e], b = Indices[i + (e + 1) % 3];
+                WedgeEdges.insert(EdgeKey(a, b));
+                PosEdges.insert(EdgeKey(s.Pos[a], s.Pos[b]));
+            }
+        }
+
+        std::vector<unsigned int> OpenOut(n, 0), OpenIn(n, 0), SeamOut(n, 0), SeamIn(n, 0);
+        s.BorderNext.assign(n, None);
+        s.BorderPrev.assign(n, None);
+        s.SeamNext.assign(n, None);
+        s.SeamPrev.assign(n, None);
+
+        for (size_t i = 0; i < Indices.size(); i += 3) {
+            for (int e = 0; e < 3; e++) {
+                const unsigned int a = Indices[i + e], b = Indices[i + (e + 1) % 3];
+                const unsigned int pa = s.Pos[a], pb = s.Pos[b];
+                if (pa == pb) {
+                    continue;
+                }
+                if (!PosEdges.count(EdgeKey(pb, pa))) {
+                    s.BorderEdges.insert(EdgeKey(pa, pb));
+                    OpenOut[pa]++;
+                    OpenIn[pb]++;
+                    s.BorderNext[pa] = pb;
+                    s.BorderPrev[pb] = pa;
+                } else if (!WedgeEdges.count(EdgeKey(b, a))) {
+                    SeamOut[a]++;
+                    SeamIn[b]++;
+                    s.SeamNext[a] = b;
+                    s.SeamPrev[b] = a;
+                }
+            }
+        }
+
+        s.Kinds.assign(n, Kind::Locked);
+        for (unsigned int v = 0; v < n; v++) {
+            if (s.Pos[v] != v) {
+                continue;
+            }
+
+            unsigned int Wedges = 0;
+            bool SeamsSimple = true;
+            unsigned int w = v;
+            do {
+                Wedges++;
+                SeamsSimple = SeamsSimple && SeamOut[w] == 1 && SeamIn[w] == 1;
+                w = s.NextWedge[w];
+            } while (w != v);
+
+            const bool OnBorder = OpenOut[v] != 0 || OpenIn[v] != 0;
+            if (Wedges == 1 && !OnBorder) {
+                s.Kinds[v] = Kind::Manifold;
+            } else if (Wedges == 1 && OpenOut[v] == 1 && OpenIn[v] == 1) {
+                s.Kinds[v] = Kind::Border;
+            } else if (Wedges == 2 && !OnBorder && SeamsSimple) {
+                s.Kinds[v] = Kind::Seam;
+            }
+        }
+    }
+
+    void BuildQuadrics(State& s, const std::vector<unsigned int>& Indices)
+    {
+        s.Quadrics.assign(s.NumVertices, Quadric());
+
+        for (size_t i = 0; i < Indices.size(); i += 3) {
+            const unsigned int p[3] = { s.Pos[Indices[i]], s.Pos[Indices[i + 1]], s.Pos[Indices[i + 2]] };
+            const glm::dvec3 v0(Position(s.pVertices, p[0]));
+            const glm::dvec3 v1(Position(s.pVertices, p[1]));
+            const glm::dvec3 v2(Position(s.pVertices, p[2]));
+
+            glm::dvec3 Normal = glm::cross(v1 - v0, v2 - v0);
+            const double Area = glm::length(Normal);
+            if (Area <= 0.0) {
+                continue;
+            }
+            Normal /= Area;
+
+            for (unsigned int k : p) {
+                s.Quadrics[k].AddPlane(Normal, glm::dot(Normal, v0), Area);
+            }
+
+            for (int e = 0; e < 3; e++) {
+                const unsigned int a = p[e], b = p[(e + 1) % 3];
+                if (!s.BorderEdges.count(EdgeKey(a, b))) {
+                    continue;
+                }
+                const glm::dvec3 pa(Position(s.pVertices, a));
+                const glm::dvec3 Edge = glm::dvec3(Position(s.pVertices, b)) - pa;
+                const double Length = glm::length(Edge);
+                if (Length <= 0.0) {
+                    continue;
+                }
+                const glm::dvec3 Side = glm::normalize(glm::cross(Edge, Normal));
+                const double Weight = BorderWeight * Length * Length;
+                s.Quadrics[a].AddPlane(Side, glm::dot(Side, pa), Weight);
+                s.Quadrics[b].AddPlane(Side, glm::dot(Side, pa), Weight);
+            }
+        }
+    }
+
+    // The wedge of To that FromWedge moves onto, None if From may not collapse onto To
+    unsigned int Partner(const State& s, unsigned int FromWedge, unsigned int To, unsigned int EdgeWedge)
+    {
+        const unsigned int From = s.Pos[FromWedge];
+        switch (s.Kinds[From]) {
+        case Kind::Manifold:
+            return EdgeWedge;
+        case Kind::Border:
+            return s.BorderNext[From] == To || s.BorderPrev[From] == To ? EdgeWedge : None;
+        case Kind::Seam:
+            if (s.SeamNext[FromWedge] != None && s.Pos[s.SeamNext[FromWedge]] == To) {
+                return s.SeamNext[FromWedge];
+            }
+            if (s.SeamPrev[FromWedge] != None && s.Pos[s.SeamPrev[FromWedge]] == To) {
+                return s.SeamPrev[FromWedge];
+            }
+            return None;
+        default:
+            return None;
+        }
+    }
+
+    // Attribute cost of moving every wedge of From onto its partner, None cost if one has none
+    bool AttributeCost(const State& s, unsigned int FromWedge, unsigned int To, unsigned int ToWedge, float& Cost)
+    {
+        Cost = 0.0f;
+        unsigned int w = FromWedge;
+        do {
+            const unsigned int t = w == FromWedge ? ToWedge : Partner(s, w, To, None);
+            if (t == None) {
+                return false;
+            }
+
+            const aiVector2D dUv = s.pVertices[w].TexCoord - s.pVertices[t].TexCoord;
+            const float Uv = s.UvScale * std::sqrt(dUv.x * dUv.x + dUv.y * dUv.y);
+            Cost += Uv * Uv;
+            if (s.pBones) {
+                const float Bone = s.BoneScale * BoneDistance(s.pBones[w], s.pBones[t]);
+                Cost += Bone * Bone;
+            }
+            w = s.NextWedge[w];
+        } while (w != FromWedge);
+        return true;
+    }
+
+    // Keep the border and seam chains through From pointing past it once it is gone
+    void Unlink(State& s, unsigned int FromWedge, unsigned int ToWedge)
+    {
+        const unsigned int From = s.Pos[FromWedge], To = s.Pos[ToWedge];
+        if (s.Kinds[From] == Kind::Border) {
+            if (s.BorderNext[From] == To) {
+                s.BorderNext[s.BorderPrev[From]] = To;
+                s.BorderPrev[To] = s.BorderPrev[From];
+            } else {
+                s.BorderPrev[s.BorderNext[From]] = To;
+                s.BorderNext[To] = s.BorderNext[From];
+            }
+        } else if (s.Kinds[From] == Kind::Seam) {
+            if (s.SeamNext[FromWedge] == ToWedge) {
+                s.SeamNext[s.SeamPrev[FromWedge]] = ToWedge;
+                s.SeamPrev[ToWedge] = s.SeamPrev[FromWedge];
+            } else {
+                s.SeamPrev[s.SeamNext[FromWedge]] = ToWedge;
+                s.SeamNext[ToWedge] = s.SeamNext[FromWedge];
+            }
+        }
+    }
+
+    // Would moving From onto To turn over one of the faces around From
+    bool Flips(const State& s, const std::vector<unsigned int>& Indices, const unsigned int* pFaces, size_t NumFaces,
+        unsigned int From, unsigned int To)
+    {
+        const glm::vec3 Target = Position(s.pVertices, To);
+        for (size_t f = 0; f < NumFaces; f++) {
+            const unsigned int* t = &Indices[pFaces[f] * 3];
+            const unsigned int p[3] = { s.Pos[t[0]], s.Pos[t[1]], s.Pos[t[2]] };
+            if (p[0] == To || p[1] == To || p[2] == To) {
+                continue; // collapses away
+            }
+
+            glm::vec3 Before[3], After[3];
+            for (int k = 0; k < 3; k++) {
+                Before[k] = Position(s.pVertices, p[k]);
+                After[k] = p[k] == From ? Target : Before[k];
+            }
+            const glm::vec3 n0 = glm::cross(Before[1] - Before[0], Before[2] - Before[0]);
+            const glm::vec3 n1 = glm::cross(After[1] - After[0], After[2] - After[0]);
+            if (glm::dot(n0, n1) < MinNormalDot * glm::length(n0) * glm::length(n1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+float Simplify(std::vector<unsigned int>& Out, const unsigned int* pIndices, size_t NumIndices,
+    const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, size_t NumVertices,
+    size_t TargetIndexCount, float MaxError, const Settings& Options)
+{
+    Out.assign(pIndices, pIndices + NumIndices);
+    if (NumIndices <= TargetIndexCount || NumVertices == 0) {
+        return 0.0f;
+    }
+
+    State s;
+    s.pVertices = pVertices;
+    s.pBones = pBones;
+    s.NumVertices = NumVertices;
+
+    glm::vec3 BbMin(Position(pVertices, pIndices[0])), BbMax(BbMin);
+    for (size_t i = 0; i < NumIndices; i++) {
+        BbMin = glm::min(BbMin, Position(pVertices, pIndices[i]));
+        BbMax = glm::max(BbMax, Position(pVertices, pIndices[i]));
+    }
+    const float Extent = glm::length(BbMax - BbMin);
+    s.UvScale = Options.UvWeight * Extent;
+    s.BoneScale = Options.BoneWeight * Extent;
+
+    WeldPositions(s);
+    Classify(s, Out);
+    BuildQuadrics(s, Out);
+
+    const float MaxCost = MaxError * MaxError;
+    float ResultCost = 0.0f;
+
+    std::vector<Collapse> Candidates;
+    std::vector<unsigned int> FaceStart, Faces;
+    std::vector<unsigned char> Touched;
+    std::vector<unsigned int> Remap(NumVertices);
+
+    while (Out.size() > TargetIndexCount) {
+        // Faces around every position, for the flip test
+        FaceStart.assign(NumVertices + 1, 0);
+        for (unsigned int v : Out) {
+            FaceStart[s.Pos[v] + 1]++;
+        }
+        std::partial_sum(FaceStart.begin(), FaceStart.end(), FaceStart.begin());
+        Faces.resize(Out.size());
+        {
+            std::vector<unsigned int> Fill(FaceStart.begin(), FaceStart.end() - 1);
+            for (size_t i = 0; i < Out.size(); i++) {
+                Faces[Fill[s.Pos[Out[i]]]++] = static_cast<unsigned int>(i / 3);
+            }
+        }
+
+        // Both directions of every edge that the vertex kinds allow
+        Candidates.clear();
+        for (size_t i = 0; i < Out.size(); i += 3) {
+            for (int e = 0; e < 3; e++) {
+                const unsigned int a = Out[i + e], b = Out[i + (e + 1) % 3];
+                for (int Dir = 0; Dir < 2; Dir++) {
+                    const unsigned int FromWedge = Dir ? b : a, ToWedge = Dir ? a : b;
+                    const unsigned int From = s.Pos[FromWedge], To = s.Pos[ToWedge];
+                    if (From == To) {
+                        continue;
+                    }
+                    const unsigned int Partnered = Partner(s, FromWedge, To, ToWedge);
+                    float Attributes;
+                    if (Partnered == None || !AttributeCost(s, FromWedge, To, Partnered, Attributes)) {
+                        continue;
+                    }
+                    const float Geometric = static_cast<float>(s.Quadrics[From].Error(glm::dvec3(Position(pVertices, To))));
+                    const float Cost = Geometric + Attributes;
+                    if (Cost <= MaxCost) {
+                        Candidates.push_back({ From, To, FromWedge, Partnered, Cost });
+                    }
+                }
+            }
+        }
+        if (Candidates.empty()) {
+            break;
+        }
+        std::sort(Candidates.begin(), Candidates.end());
+
+        // Cheapest first; a collapse freezes its whole neighbourhood for the rest of the pass,
+        // so every flip test sees up to date geometry
+        const size_t Triangles = Out.size() / 3;
+        const size_t Limit = std::max<size_t>((Triangles - TargetIndexCount / 3) / 2, 1);
+        size_t Collapsed = 0;
+
+        Touched.assign(NumVertices, 0);
+        std::iota(Remap.begin(), Remap.end(), 0u);
+
+        for (const Collapse& c : Candidates) {
+            if (Collapsed >= Limit) {
+                break;
+            }
+            if (Touched[c.From] || Touched[c.To]) {
+                continue;
+            }
+            const unsigned int* pFaces = &Faces[FaceStart[c.From]];
+            const size_t NumFaces = FaceStart[c.From + 1] - FaceStart[c.From];
+            if (Flips(s, Out, pFaces, NumFaces, c.From, c.To)) {
+                continue;
+            }
+
+            unsigned int w = c.FromWedge;
+            do {
+                Remap[w] = w == c.FromWedge ? c.ToWedge : Partner(s, w, c.To, None);
+                w = s.NextWedge[w];
+            } while (w != c.FromWedge);
+            do {
+                Unlink(s, w, Remap[w]);
+                w = s.NextWedge[w];
+            } while (w != c.FromWedge);
+
+            for (size_t f = 0; f < NumFaces; f++) {
+                for (int k = 0; k < 3; k++) {
+                    Touched[s.Pos[Out[pFaces[f] * 3 + k]]] = 1;
+                }
+            }
+            s.Quadrics[c.To].Add(s.Quadrics[c.From]);
+            ResultCost = std::max(ResultCost, c.Cost);
+            Collapsed++;
+        }
+
+        if (Collapsed == 0) {
+            break;
+        }
+
+        // Apply and drop the faces that lost an edge
+        size_t Write = 0;
+        for (size_t i = 0; i < Out.size(); i += 3) {
+            const unsigned int a = Remap[Out[i]], b = Remap[Out[i + 1]], c = Remap[Out[i + 2]];
+            if (s.Pos[a] == s.Pos[b] || s.Pos[b] == s.Pos[c] || s.Pos[c] == s.Pos[a]) {
+                continue;
+            }
+            Out[Write++] = a;
+            Out[Write++] = b;
+            Out[Write++] = c;
+        }
+        Out.resize(Write);
+    }
+
+    return std::sqrt(ResultCost);
+}
+
+Report BuildLods(MeshCache::Data& Mesh, const Settings& Options)
+{
+    Report Result;
+    const bool Skinned = !Mesh.Bones.empty() && Mesh.Bones.size() == Mesh.Vertices.size();
+
+    std::vector<unsigned int> Full, Lod;
+    for (size_t e = 0; e < Mesh.Entries.size(); e++) {
+        const MeshCache::Entry& Entry = Mesh.Entries[e];
+        Result.Triangles[0] += Entry.NumIndices / 3;
+        if (Entry.NumIndices < 3) {
+            continue;
+        }
+
+        const size_t VertexEnd = e + 1 < Mesh.Entries.size() ? Mesh.Entries[e + 1].BaseVertex : Mesh.Vertices.size();
+        const size_t NumVertices = VertexEnd - Entry.BaseVertex;
+        const MeshCache::Vertex* pVertices = Mesh.Vertices.data() + Entry.BaseVertex;
+        const MeshCache::VertexBoneData* pBones = Skinned ? Mesh.Bones.data() + Entry.BaseVertex : nullptr;
+
+        Full.assign(Mesh.Indices.begin() + Entry.BaseIndex, Mesh.Indices.begin() + Entry.BaseIndex + Entry.NumIndices);
+
+        glm::vec3 BbMin(Position(pVertices, Full[0])), BbMax(BbMin);
+        for (unsigned int v : Full) {
+            BbMin = glm::min(BbMin, Position(pVertices, v));
+            BbMax = glm::max(BbMax, Position(pVertices, v));
+        }
+        const float MaxError = MaxRelativeError * glm::length(BbMax - BbMin);
+
+        // Every level starts from full detail, so its error is measured against the real surface
+        size_t Previous = Full.size();
+        float Ratio = 1.0f;
+        for (unsigned int Level = 1; Level < MaxLods; Level++) {
+            Ratio *= LevelRatio;
+            const size_t Target = static_cast<size_t>(Full.size() / 3 * Ratio) * 3;
+            const float Error = Simplify(Lod, Full.data(), Full.size(), pVertices, pBones, NumVertices, Target, MaxError, Options);
+
+            // Not worth a level of its own
+            if (Lod.empty() || Lod.size() > Previous * 85 / 100) {
+                break;
+            }
+            Previous = Lod.size();
+
+            MeshOptimizer::OptimizeVertexCache(Lod.data(), Lod.size(), NumVertices);
+
+            MeshCache::Lod Record {};
+            Record.Entry = static_cast<uint32_t>(e);
+            Record.BaseIndex = static_cast<uint32_t>(Mesh.Indices.size());
+            Record.NumIndices = static_cast<uint32_t>(Lod.size());
+            Record.Error = Error;
+            Mesh.Lods.push_back(Record);
+            Mesh.Indices.insert(Mesh.Indices.end(), Lod.begin(), Lod.end());
+
+            Result.Triangles[Level] += Lod.size() / 3;
+        }
+    }
+    return Result;
+}
+
+}
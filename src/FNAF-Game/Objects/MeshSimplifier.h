@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "MeshCache.h"
+
+// Quadric error edge collapse simplification, and the LOD chains baked into the mesh cache.
+//
+// Vertices collapse onto a neighbouring vertex (Garland & Heckbert quadrics with half-edge
+// collapses), so no vertex is created or moved and every level is just another index list
+// over the entry's vertex range. Vertices on open borders only slide along the border, vertices
+// on UV or normal seams only along the seam, with both copies collapsing together; changes of
+// texture coordinates and bone weights add to a collapse's cost. Runs single threaded with every
+// tie broken by vertex index, so the same input always gives the same levels.
+namespace MeshSimplifier {
+
+struct Settings {
+    float UvWeight = 0.1f; // cost of a texture coordinate change of 1, as a fraction of the mesh extent
+    float BoneWeight = 0.5f; // cost of moving to entirely different skinning, as a fraction of the mesh extent
+};
+
+// Simplify a triangle list towards TargetIndexCount without exceeding MaxError (object space
+// distance). Indices address pVertices and pBones (nullptr for static meshes). Returns the error
+// of the result, which is written to Out.
+float Simplify(std::vector<unsigned int>& Out, const unsigned int* pIndices, size_t NumIndices,
+    const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, size_t NumVertices,
+    size_t TargetIndexCount, float MaxError, const Settings& Options = Settings());
+
+// Levels per entry, the full detail entry included. Each level aims for LevelRatio of the
+// triangles of the previous one, within MaxRelativeError of the entry's extent.
+constexpr unsigned int MaxLods = 4;
+constexpr float LevelRatio = 0.5f;
+constexpr float MaxRelativeError = 0.05f;
+
+struct Report {
+    size_t Triangles[MaxLods] {}; // summed over entries
+};
+
+// Append the coarser levels of every entry to Mesh.Indices and Mesh.Lods, in vertex cache order
+Report BuildLods(MeshCache::Data& Mesh, const Settings& Options = Settings());
+
+}
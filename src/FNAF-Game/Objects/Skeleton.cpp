@@ -0,0 +1,105 @@
+#include "Skeleton.h"
+
+#include <cassert>
+#include <unordered_map>
+
+namespace {
+
+// Translation * Rotation * Scaling, built directly instead of with two matrix products
+aiMatrix4x4 ComposeTransform(const aiVector3D& Scaling, const aiQuaternion& Rotation, const aiVector3D& Translation)
+{
+    const aiMatrix3x3 R = Rotation.GetMatrix();
+    return aiMatrix4x4(R.a1 * Scaling.x, R.a2 * Scaling.y, R.a3 * Scaling.z, Translation.x,
+        R.b1 * Scaling.x, R.b2 * Scaling.y, R.b3 * Scaling.z, Translation.y,
+        R.c1 * Scaling.x, R.c2 * Scaling.y, R.c3 * Scaling.z, Translation.z,
+        0.0f, 0.0f, 0.0f, 1.0f);
+}
+}
+
+void Skeleton::Init(const MeshCache::View& View)
+{
+    const auto NumNodes = static_cast<unsigned int>(View.Nodes.Size);
+
+    mParents.resize(NumNodes);
+    mBindTransforms.resize(NumNodes);
+    mNodeNames.resize(NumNodes);
+    mBoneIndices.assign(NumNodes, InvalidIndex);
+    mBindPose.Resize(NumNodes);
+
+    std::unordered_map<std::string, int> NodeIndex;
+    for (unsigned int i = 0; i < NumNodes; i++) {
+        // The cache stores nodes in pre-order, which is already a valid topological order
+        assert(View.Nodes[i].Parent < static_cast<int>(i));
+        mParents[i] = View.Nodes[i].Parent;
+        mBindTransforms[i] = View.Nodes[i].Transformation;
+        mBindTransforms[i].Decompose(mBindPose.Scalings[i], mBindPose.Rotations[i], mBindPose.Translations[i]);
+        mNodeNames[i] = View.String(View.Nodes[i].Name);
+        NodeIndex.emplace(mNodeNames[i], i);
+    }
+
+    mBoneOffsets.resize(View.BoneOffsets.Size);
+    for (unsigned int b = 0; b < View.BoneOffsets.Size; b++) {
+        mBoneOffsets[b] = View.BoneOffsets[b].Offset;
+
+        auto iter = NodeIndex.find(View.String(View.BoneOffsets[b].Name));
+        if (iter != NodeIndex.end()) {
+            mBoneIndices[iter->second] = static_cast<int>(b);
+        }
+    }
+
+    mGlobalInverseTransform = aiMatrix4x4();
+    if (NumNodes > 0) {
+        mGlobalInverseTransform = mBindTransforms[0];
+        mGlobalInverseTransform.Inverse();
+    }
+}
+
+int Skeleton::FindNode(const std::string& Name) const
+{
+    for (unsigned int i = 0; i < mNodeNames.size(); i++) {
+        if (mNodeNames[i] == Name) {
+            return static_cast<int>(i);
+        }
+    }
+    return InvalidIndex;
+}
+
+void Skeleton::BindClip(AnimationClip& Clip) const
+{
+    std::unordered_map<std::string, int> ChannelIndex;
+    for (unsigned int c = 0; c < Clip.GetNumChannels(); c++) {
+        // First channel wins, same as the old linear FindNodeAnim
+        ChannelIndex.emplace(Clip.ChannelNames[c], static_cast<int>(c));
+    }
+
+    Clip.NodeChannels.assign(mNodeNames.size(), InvalidIndex);
+    Clip.ChannelNodes.assign(Clip.GetNumChannels(), InvalidIndex);
+    for (unsigned int n = 0; n < mNodeNames.size(); n++) {
+        auto iter = ChannelIndex.find(mNodeNames[n]);
+        if (iter != ChannelIndex.end()) {
+            Clip.NodeChannels[n] = iter->second;
+            Clip.ChannelNodes[iter->second] = static_cast<int>(n);
+        }
+    }
+}
+
+void Skeleton::ComputePalette(const LocalPose& Pose, aiMatrix4x4* Globals, aiMatrix4x4* Palette) const
+{
+    assert(Pose.Rotations.size() == mParents.size());
+
+    const unsigned int NumNodes = GetNumNodes();
+    const int* pParents = mParents.data();
+    const int* pBoneIndices = mBoneIndices.data();
+
+    for (unsigned int n = 0; n < NumNodes; n++) {
+        const aiMatrix4x4 Local = ComposeTransform(Pose.Scalings[n], Pose.Rotations[n], Pose.Translations[n]);
+
+        const int Parent = pParents[n];
+        Globals[n] = Parent != InvalidIndex ? Globals[Parent] * Local : Local;
+
+        const int Bone = pBoneIndices[n];
+        if (Bone != InvalidIndex) {
+            Palette[Bone] = mGlobalInverseTransform * Globals[n] * mBoneOffsets[Bone];
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <assimp/matrix4x4.h>
+
+#include "Animation.h"
+#include "MeshCache.h"
+
+// Precompiled skeleton.
+//
+// Nodes are stored flat in topological order (every parent before its children) as
+// parallel arrays, with the bone each node drives resolved at load time. Evaluating a
+// pose is a single forward pass over the arrays: no recursion, no allocation, no
+// hashing and no string compares.
+class Skeleton {
+public:
+    static const int InvalidIndex = -1;
+
+    void Init(const MeshCache::View& View);
+
+    // Resolve which channel of the clip drives each node
+    void BindClip(AnimationClip& Clip) const;
+
+    [[nodiscard]] int FindNode(const std::string& Name) const;
+
+    // Concatenate a local pose down the hierarchy and write one skinning matrix per bone.
+    // Globals is caller-owned scratch space with room for GetNumNodes() matrices, so one
+    // skeleton can drive many instances.
+    void ComputePalette(const LocalPose& Pose, aiMatrix4x4* Globals, aiMatrix4x4* Palette) const;
+
+    [[nodiscard]] unsigned int GetNumNodes() const { return static_cast<unsigned int>(mParents.size()); }
+    [[nodiscard]] unsigned int GetNumBones() const { return static_cast<unsigned int>(mBoneOffsets.size()); }
+
+    [[nodiscard]] const std::vector<int>& GetParents() const { return mParents; }
+    [[nodiscard]] const std::vector<int>& GetBoneIndices() const { return mBoneIndices; }
+    [[nodiscard]] const std::vector<aiMatrix4x4>& GetBindTransforms() const { return mBindTransforms; }
+    [[nodiscard]] const LocalPose& GetBindPose() const { return mBindPose; }
+    [[nodiscard]] const std::vector<aiMatrix4x4>& GetBoneOffsets() const { return mBoneOffsets; }
+    [[nodiscard]] const aiMatrix4x4& GetGlobalInverseTransform() const { return mGlobalInverseTransform; }
+
+private:
+    std::vector<int> mParents;
+    std::vector<int> mBoneIndices;
+    std::vector<aiMatrix4x4> mBindTransforms;
+    LocalPose mBindPose; // mBindTransforms decomposed, the base every animation graph starts from
+    std::vector<aiMatrix4x4> mBoneOffsets;
+    aiMatrix4x4 mGlobalInverseTransform;
+
+    // Only needed to bind clips, never touched while evaluating
+    std::vector<std::string> mNodeNames;
+};
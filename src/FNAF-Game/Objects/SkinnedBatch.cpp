@@ -0,0 +1,246 @@
+#include "SkinnedBatch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "MemoryBudget.h"
+#include "Timer.h"
+
+#include "BonePalette.h"
+#include "SkinnedMesh.h"
+
+namespace SkinnedBatch {
+
+namespace {
+
+    // 4 MB: about 850 instances of 100 bones drawn with every entry, per frame in flight
+    constexpr uint32_t RingSlots = (4u << 20) / BonePalette::SlotBytes;
+    // Largest allocation of one instance group, so a few frames fit in flight
+    constexpr uint32_t MaxGroupSlots = RingSlots / 4;
+
+    GLuint sBuffer = 0;
+    BonePalette::Slot* sMapped = nullptr;
+    BonePalette::RingAllocator sRing;
+    std::deque<GLsync> sFences; // one per ended ring frame
+
+    std::vector<const SkinnedMesh*> sQueue;
+    std::vector<uint32_t> sPaletteOffsets;
+    std::vector<SkinnedMeshAsset::InstancedDraw> sDraws;
+    std::vector<std::pair<unsigned int, unsigned int>> sLevelInstances; // level, instance in group
+
+    unsigned int sStalls = 0;
+
+    bool InitRing()
+    {
+        if (sBuffer != 0) {
+            return sMapped != nullptr;
+        }
+
+        // Written by the CPU while the GPU reads earlier frames, never unmapped
+        const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr Bytes = GLsizeiptr(RingSlots) * BonePalette::SlotBytes;
+        glCreateBuffers(1, &sBuffer);
+        glNamedBufferStorage(sBuffer, Bytes, nullptr, Flags);
+        sMapped = static_cast<BonePalette::Slot*>(glMapNamedBufferRange(sBuffer, 0, Bytes, Flags));
+        if (sMapped == nullptr) {
+            printf("SkinnedBatch: could not map the bone palette ring, drawing without instancing\n");
+            return false;
+        }
+
+        sRing.Init(RingSlots);
+        MemoryBudget::TrackGlObject(GL_BUFFER, sBuffer, Bytes, "Animation");
+        return true;
+    }
+
+    void EndRingFrame()
+    {
+        sRing.EndFrame();
+        sFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+    // Retire the oldest frame, waiting for the GPU if it isn't done yet (Wait == false: never wait)
+    bool RetireOldest(bool Wait)
+    {
+        if (sFences.empty()) {
+            return false;
+        }
+
+        GLenum Result = glClientWaitSync(sFences.front(), 0, 0);
+        if (Result == GL_TIMEOUT_EXPIRED) {
+            if (!Wait) {
+                return false;
+            }
+            sStalls++;
+            do {
+                Result = glClientWaitSync(sFences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (Result == GL_TIMEOUT_EXPIRED);
+        }
+
+        glDeleteSync(sFences.front());
+        sFences.pop_front();
+        sRing.Retire();
+        return true;
+    }
+
+    // Offset of Count slots, waiting for older frames to drain when the ring is full. Everything
+    // allocated before must already be drawn: when this flush alone filled the ring, it is fenced
+    // and freed.
+    uint32_t AllocateSlots(uint32_t Count)
+    {
+        for (;;) {
+            const uint32_t Offset = sRing.Allocate(Count);
+            if (Offset != BonePalette::RingAllocator::InvalidOffset) {
+                return Offset;
+            }
+
+            if (sFences.empty()) {
+                if (sRing.GetUsed() == 0) {
+                    return Offset; // larger than the whole ring
+                }
+                // This flush alone filled the ring: fence what it drew so far and wait for that
+                EndRingFrame();
+            }
+            RetireOldest(true);
+        }
+    }
+
+    // Slots the instances [First, Last) of sQueue take: their palettes and a record per entry they draw
+    uint64_t CountSlots(size_t First, size_t Last, unsigned int NumEntries)
+    {
+        uint64_t Slots = 0;
+        for (size_t i = First; i < Last; i++) {
+            const SkinnedMesh& Mesh = *sQueue[i];
+            Slots += Mesh.GetPalette().size() * BonePalette::SlotsPerBone;
+            for (unsigned int e = 0; e < NumEntries; e++) {
+                Slots += Mesh.GetVisible()[e] ? BonePalette::SlotsPerInstance : 0;
+            }
+        }
+        return Slots;
+    }
+
+    // Palettes, instance records and draws of the instances [First, Last) of sQueue, which share an
+    // asset. They take one allocation, so making room for them never frees data of draws not issued
+    // yet; groups too large for their share of the ring are split.
+    void DrawAsset(size_t First, size_t Last)
+    {
+        const SkinnedMeshAsset& Asset = *sQueue[First]->GetAsset();
+        const auto NumInstances = static_cast<unsigned int>(Last - First);
+        const auto NumEntries = static_cast<unsigned int>(Asset.GetEntries().size());
+
+        const uint64_t Slots = CountSlots(First, Last, NumEntries);
+        if (Slots == 0) {
+            return;
+        }
+        uint32_t Offset = BonePalette::RingAllocator::InvalidOffset;
+        if (Slots <= MaxGroupSlots || (NumInstances == 1 && Slots <= RingSlots)) {
+            Offset = AllocateSlots(static_cast<uint32_t>(Slots));
+        }
+        if (Offset == BonePalette::RingAllocator::InvalidOffset) {
+            if (NumInstances > 1) {
+                const size_t Middle = First + NumInstances / 2;
+                DrawAsset(First, Middle);
+                DrawAsset(Middle, Last);
+            }
+            return;
+        }
+
+        uint32_t Next = Offset;
+        sPaletteOffsets.resize(NumInstances);
+        for (unsigned int i = 0; i < NumInstances; i++) {
+            const std::vector<aiMatrix4x4>& Palette = sQueue[First + i]->GetPalette();
+            const auto NumBones = static_cast<uint32_t>(Palette.size());
+            BonePalette::Pack(Palette.data(), NumBones, reinterpret_cast<BonePalette::Mat3x4*>(sMapped + Next));
+            sPaletteOffsets[i] = Next;
+            Next += NumBones * BonePalette::SlotsPerBone;
+        }
+
+        // Per entry, the instances that draw it grouped by LOD level, each group one instanced draw
+        sDraws.clear();
+        for (unsigned int e = 0; e < NumEntries; e++) {
+            sLevelInstances.clear();
+            for (unsigned int i = 0; i < NumInstances; i++) {
+                const SkinnedMesh& Mesh = *sQueue[First + i];
+                if (Mesh.GetVisible()[e]) {
+                    sLevelInstances.emplace_back(Mesh.GetLodLevels()[e], i);
+                }
+            }
+            std::sort(sLevelInstances.begin(), sLevelInstances.end());
+
+            for (size_t g = 0; g < sLevelInstances.size();) {
+                size_t End = g + 1;
+                while (End < sLevelInstances.size() && sLevelInstances[End].first == sLevelInstances[g].first) {
+                    End++;
+                }
+
+                const auto Count = static_cast<uint32_t>(End - g);
+                const uint32_t Records = Next;
+                Next += Count * BonePalette::SlotsPerInstance;
+                auto* pRecords = reinterpret_cast<BonePalette::InstanceRecord*>(sMapped + Records);
+                for (uint32_t r = 0; r < Count; r++) {
+                    const unsigned int i = sLevelInstances[g + r].second;
+                    const SkinnedMesh& Mesh = *sQueue[First + i];
+                    BonePalette::Pack(Mesh.GetWorldMatrix(), pRecords[r].Model);
+                    pRecords[r].PaletteOffset = sPaletteOffsets[i];
+                    pRecords[r].NumBones = static_cast<uint32_t>(Mesh.GetPalette().size());
+                }
+                sDraws.push_back({ e, sLevelInstances[g].first, Records, Count });
+                g = End;
+            }
+        }
+
+        Asset.DrawInstanced(sDraws.data(), sDraws.size());
+    }
+}
+
+void Add(const SkinnedMesh* pMesh)
+{
+    sQueue.push_back(pMesh);
+}
+
+void Flush()
+{
+    if (sQueue.empty()) {
+        return;
+    }
+
+    if (!InitRing()) {
+        // No ring: draw one by one as before
+        std::vector<const SkinnedMesh*> Queue;
+        Queue.swap(sQueue);
+        for (const SkinnedMesh* pMesh : Queue) {
+            pMesh->DrawImmediate();
+        }
+        return;
+    }
+
+    // Free what the GPU already finished without waiting for the rest
+    while (RetireOldest(false)) {
+    }
+
+    // Instances of one asset next to each other, in the order they were queued
+    std::stable_sort(sQueue.begin(), sQueue.end(),
+        [](const SkinnedMesh* a, const SkinnedMesh* b) { return a->GetAsset().get() < b->GetAsset().get(); });
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, StorageBinding, sBuffer);
+    glUniform1i(SkinnedMesh::UniformLoc::Instanced, 1);
+
+    for (size_t First = 0; First < sQueue.size();) {
+        size_t Last = First + 1;
+        while (Last < sQueue.size() && sQueue[Last]->GetAsset() == sQueue[First]->GetAsset()) {
+            Last++;
+        }
+        DrawAsset(First, Last);
+        First = Last;
+    }
+
+    glUniform1i(SkinnedMesh::UniformLoc::Instanced, 0);
+    EndRingFrame();
+
+    TimerGui::SetCounter("Skinned: instances", static_cast<double>(sQueue.size()));
+    TimerGui::SetCounter("Skinned: ring stalls", static_cast<double>(sStalls));
+    sQueue.clear();
+}
+
+}
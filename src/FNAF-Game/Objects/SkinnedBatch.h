@@ -0,0 +1,28 @@
+#pragma once
+
+#include <GL/glew.h>
+
+class SkinnedMesh;
+
+// Instanced drawing of skinned meshes.
+//
+// SkinnedMesh::Render() picks its LOD levels, culls its entries and queues itself here. Flush()
+// then writes every queued palette and one instance record per drawn entry to a persistently
+// mapped storage buffer used as a ring (see BonePalette), and draws each entry of a shared asset
+// with one instanced call per LOD level for all its instances. A fence per flush tells when the
+// GPU is done with that flush's part of the ring; the CPU only waits when the ring is full.
+namespace SkinnedBatch {
+
+// Storage buffer binding of the ring, vec4 ring[] in skinned_mesh.vert
+constexpr GLuint StorageBinding = 1;
+
+// Off: every SkinnedMesh draws immediately with its palette in uniforms, as before
+inline bool sEnabled = true;
+
+// Queue a loaded mesh for the next Flush(), with its current world matrix and draw lists
+void Add(const SkinnedMesh* pMesh);
+
+// Draw everything queued since the last flush with the bound skinned mesh shader
+void Flush();
+
+}
@@ -2,511 +2,308 @@
 // https://ogldev.org/www/tutorial38/tutorial38.html
 
 // Modifications
-//  Speed up FindAnimNode with std::map
+//  Evaluate poses with a flat precompiled Skeleton instead of recursing over the node tree
 //  Use aiProcess_LimitBoneWeights when importing, to limit bones per vertex to 4
 //  Use unsigned byte for bone IDs
 //  Use layout qualifiers for attribs and uniforms
 //  Eliminate SetBoneTransform() - send all matrices in one glUniform call
 //  Pass strings by reference
-
+//  Cache the last key segment per channel and precompute inverse key deltas
+//  Evaluate poses on the AnimationSystem worker threads into double-buffered palettes
+//  Evaluate clips in local space through an AnimationGraph (layers, cross-fades, additive)
+//  Load geometry, skeleton and animations from the baked MeshCache, Assimp only on a cache miss
+//  Share immutable data through SkinnedMeshAsset, instances only own their animation state
+//  CPU skinning of the current pose for bounds and picking
+//  Optional background loading, the instance starts animating once its asset is uploaded
+//  Per-instance LOD levels picked by MeshLod
+//  Cull entries against the frustum with bounds of the current pose
+//  Queue instances to SkinnedBatch: 3x4 palettes in a shared storage buffer ring, instanced draws
+//  Evaluate poses at a rate picked by AnimationLod, blending palettes in between
+
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 
-#include "LoadTexture.h"
 #include "Shader.h"
 
 #include "SkinnedMesh.h"
+#include "AnimationSystem.h"
+#include "CpuSkinning.h"
+#include "SkinnedBatch.h"
 
 Shader* SkinnedMesh::mShader = nullptr;
 
-void SkinnedMesh::VertexBoneData::AddBoneData(unsigned int BoneID, float Weight)
-{
-    for (unsigned int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
-        if (Weights[i] == 0.0) {
-            IDs[i] = BoneID;
-            Weights[i] = Weight;
-            return;
-        }
-    }
-
-    // should never get here - more bones than we have space for
-    printf("more bones than we have space for, %d, %p\n", BoneID, this);
-    assert(0);
-}
-
 SkinnedMesh::SkinnedMesh()
 {
     if (mShader == nullptr) {
         mShader = new Shader(anime_vertex_shader, anime_fragment_shader);
         mShader->Init();
     }
+
+    AnimationSystem::Register(this);
 }
 
 SkinnedMesh::~SkinnedMesh()
 {
-    Clear();
+    AnimationSystem::Unregister(this);
 }
 
-void SkinnedMesh::Clear()
+bool SkinnedMesh::LoadMesh(const std::string& filename)
 {
+    // Make sure no worker is still evaluating the previous mesh before replacing it
+    AnimationSystem::Sync();
 
-    for (unsigned int i = 0; i < m_Textures.size(); i++) {
-        if (m_Textures[i]) {
-            glDeleteTextures(1, &m_Textures[i]);
-        }
-    }
-
-    if (m_Buffers[0] != 0) {
-        glDeleteBuffers(NUM_VBs, m_Buffers);
-    }
-
-    if (m_VAO != 0) {
-        glDeleteVertexArrays(1, &m_VAO);
-        m_VAO = 0;
+    mLoaded = false;
+    mAsset = SkinnedMeshAsset::Load(filename);
+    if (!mAsset) {
+        return false;
     }
-}
 
-void SkinnedMesh::CalcBoundingBox()
-{
-    mBbMin.x = mBbMin.y = mBbMin.z = 1e10f;
-    mBbMax.x = mBbMax.y = mBbMax.z = -1e10f;
-    CalcNodeBoundingBox(mScene->mRootNode, mBbMin, mBbMax);
+    InitInstance();
+    mLoaded = true;
 
     glm::vec3 diff = mBbMax - mBbMin;
     float w = std::max(diff.x, std::max(diff.y, diff.z));
 
     mScale = glm::vec3(1.0f / w);
+    return true;
 }
 
-bool SkinnedMesh::LoadMesh(const std::string& filename)
+bool SkinnedMesh::LoadMeshAsync(const std::string& filename)
 {
-    // Release the previously loaded mesh (if it exists)
-    Clear();
-
-    // Create the VAO
-    glGenVertexArrays(1, &m_VAO);
-    glBindVertexArray(m_VAO);
-
-    // Create the buffers for the vertices attributes
-    glGenBuffers(NUM_VBs, m_Buffers);
-
-    bool ret = false;
-
-    std::string fullPath = filename;
-    std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
+    AnimationSystem::Sync();
 
-    // aiProcessPreset_TargetRealtime_Quality includes aiProcess_LimitBoneWeights which restricts bones per vertex to 4
-    mScene = mImporter.ReadFile(fullPath.c_str(), aiProcessPreset_TargetRealtime_Quality | aiProcess_FlipUVs);
-
-    if (mScene) {
-        m_GlobalInverseTransform = mScene->mRootNode->mTransformation;
-        m_GlobalInverseTransform.Inverse();
-        ret = InitFromScene(mScene, fullPath);
-        CalcBoundingBox();
-    } else {
-        printf("Error parsing '%s': '%s'\n", fullPath.c_str(), mImporter.GetErrorString());
-    }
-
-    // Make sure the VAO is not changed from the outside
-    glBindVertexArray(0);
-
-    return ret;
+    // Update() finishes the instance once the shared asset is ready. mScale is left to the
+    // caller, who usually sets the transform right after this call.
+    mLoaded = false;
+    mAsset = SkinnedMeshAsset::LoadAsync(filename);
+    return true;
 }
 
-void SkinnedMesh::Update(float deltaSeconds)
+void SkinnedMesh::InitInstance()
 {
-    BoneTransform(deltaSeconds, mTransforms);
+    mBbMin = mAsset->GetBbMin();
+    mBbMax = mAsset->GetBbMax();
+
+    const Skeleton& Skel = mAsset->GetSkeleton();
+    const unsigned int NumBones = Skel.GetNumBones();
+
+    // Sized once here so BoneTransform never allocates. Bones without a node keep a zero scale.
+    mGlobals.resize(Skel.GetNumNodes());
+    mPose.Resize(Skel.GetNumNodes());
+    mGraph.Init(&Skel, &mAsset->GetClips());
+    aiMatrix4x4 Zero;
+    aiMatrix4x4::Scaling(aiVector3D(0.0f), Zero);
+    for (std::vector<aiMatrix4x4>& Palette : mTransforms) {
+        Palette.assign(NumBones, Zero);
+        BoneTransform(0.0f, Palette);
+    }
+    mFromPalette.assign(NumBones, Zero);
+    mToPalette.assign(NumBones, Zero);
+    mAnimationTime = 0.0f;
+    mPoseTime = 0.0f;
+    mBackPoseWritten = false;
+    mPoseStep = AnimationLod::Step::Evaluate;
+    mFramesToEvaluate = 0;
 }
 
-void SkinnedMesh::Render()
+void SkinnedMesh::Update(float deltaSeconds)
 {
-    glUniform1i(UniformLoc::NumBones, m_NumBones);
-    glUniformMatrix4fv(UniformLoc::Bones, mTransforms.size(), GL_TRUE, &mTransforms[0].a1);
-
-    glBindVertexArray(m_VAO);
-
-    for (unsigned int i = 0; i < m_Entries.size(); i++) {
-        const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
-
-        assert(MaterialIndex < m_Textures.size());
-
-        if (m_Textures[MaterialIndex]) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_Textures[MaterialIndex]);
-        }
-
-        glDrawElementsBaseVertex(GL_TRIANGLES,
-            m_Entries[i].NumIndices,
-            GL_UNSIGNED_INT,
-            (void*)(sizeof(unsigned int) * m_Entries[i].BaseIndex),
-            m_Entries[i].BaseVertex);
+    if (!mLoaded && mAsset && mAsset->IsReady()) {
+        AnimationSystem::Sync();
+        InitInstance();
+        mLoaded = true;
     }
 
-    // Make sure the VAO is not changed from the outside
-    glBindVertexArray(0);
+    // Evaluated later by AnimationSystem::Dispatch
+    mClockTime = deltaSeconds;
 }
 
-bool SkinnedMesh::InitFromScene(const aiScene* pScene, const std::string& Filename)
+bool SkinnedMesh::PreparePose()
 {
-    m_Entries.resize(pScene->mNumMeshes);
-    m_Textures.resize(pScene->mNumMaterials);
-
-    std::vector<aiVector3D> Positions;
-    std::vector<aiVector3D> Normals;
-    std::vector<aiVector2D> TexCoords;
-    std::vector<VertexBoneData> Bones;
-    std::vector<unsigned int> Indices;
-
-    unsigned int NumVertices = 0;
-    unsigned int NumIndices = 0;
-
-    // Count the number of vertices and indices
-    for (unsigned int i = 0; i < m_Entries.size(); i++) {
-        m_Entries[i].MaterialIndex = pScene->mMeshes[i]->mMaterialIndex;
-        m_Entries[i].NumIndices = pScene->mMeshes[i]->mNumFaces * 3;
-        m_Entries[i].BaseVertex = NumVertices;
-        m_Entries[i].BaseIndex = NumIndices;
-
-        NumVertices += pScene->mMeshes[i]->mNumVertices;
-        NumIndices += m_Entries[i].NumIndices;
-    }
-
-    // Reserve space in the vectors for the vertex attributes and indices
-    Positions.reserve(NumVertices);
-    Normals.reserve(NumVertices);
-    TexCoords.reserve(NumVertices);
-    Bones.resize(NumVertices);
-    Indices.reserve(NumIndices);
-
-    // Initialize the meshes in the scene one by one
-    for (unsigned int i = 0; i < m_Entries.size(); i++) {
-        const aiMesh* pMesh = pScene->mMeshes[i];
-        InitMesh(i, pMesh, Positions, Normals, TexCoords, Bones, Indices);
-    }
-
-    if (!InitMaterials(pScene, Filename)) {
+    if (!mLoaded) {
         return false;
     }
 
-    // Generate and populate the buffers with vertex attributes and the indices
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), Positions.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::Pos);
-    glVertexAttribPointer(AttribLoc::Pos, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), TexCoords.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::TexCoord);
-    glVertexAttribPointer(AttribLoc::TexCoord, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), Normals.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::Normal);
-    glVertexAttribPointer(AttribLoc::Normal, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[BONE_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Bones[0]) * Bones.size(), Bones.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::BoneIds);
-    glVertexAttribIPointer(AttribLoc::BoneIds, 4, GL_UNSIGNED_BYTE, sizeof(VertexBoneData), (const GLvoid*)nullptr);
-    glEnableVertexAttribArray(AttribLoc::BoneWeights);
-    glVertexAttribPointer(AttribLoc::BoneWeights, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (const GLvoid*)(NUM_BONES_PER_VERTEX * sizeof(unsigned char)));
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), Indices.data(), GL_STATIC_DRAW);
-
-    return true;
-}
-
-void SkinnedMesh::InitMesh(unsigned int MeshIndex,
-    const aiMesh* pMesh,
-    std::vector<aiVector3D>& Positions,
-    std::vector<aiVector3D>& Normals,
-    std::vector<aiVector2D>& TexCoords,
-    std::vector<VertexBoneData>& Bones,
-    std::vector<unsigned int>& Indices)
-{
-    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
-
-    // Populate the vertex attribute vectors
-    for (unsigned int i = 0; i < pMesh->mNumVertices; i++) {
-        const aiVector3D* pPos = &(pMesh->mVertices[i]);
-        const aiVector3D* pNormal = &(pMesh->mNormals[i]);
-        const aiVector3D* pTexCoord = pMesh->HasTextureCoords(0) ? &(pMesh->mTextureCoords[0][i]) : &Zero3D;
-
-        Positions.push_back(*pPos);
-        Normals.push_back(*pNormal);
-        TexCoords.push_back(aiVector2D(pTexCoord->x, pTexCoord->y));
+    const float Time = mClockTime;
+    if (Time > mAnimationTime) {
+        mFrameSeconds = Time - mAnimationTime;
     }
-
-    LoadBones(MeshIndex, pMesh, Bones);
-
-    // Populate the index buffer
-    for (unsigned int i = 0; i < pMesh->mNumFaces; i++) {
-        const aiFace& Face = pMesh->mFaces[i];
-        assert(Face.mNumIndices == 3);
-        Indices.push_back(Face.mIndices[0]);
-        Indices.push_back(Face.mIndices[1]);
-        Indices.push_back(Face.mIndices[2]);
+    mAnimationTime = Time;
+
+    const unsigned int Interval = AnimationLod::SelectInterval(mBbMin, mBbMax, mWorldMatrix);
+    const bool Changed = Time != mPoseTime;
+
+    if (Interval == 0 || !Changed) {
+        // Start a fresh interval when it comes back
+        mPoseStep = AnimationLod::Step::Skip;
+        mFramesToEvaluate = 0;
+    } else if (Interval == 1) {
+        mPoseStep = AnimationLod::Step::Evaluate;
+        mFramesToEvaluate = 0;
+    } else if (mFramesToEvaluate == 0 || Time < mFromTime || Time >= mToTime) {
+        // The interval ends Interval - 1 frames from now, on its last blended frame
+        mPoseStep = AnimationLod::Step::EvaluateAhead;
+        mFromTime = mPoseTime;
+        mToTime = Time + static_cast<float>(Interval - 1) * mFrameSeconds;
+        mFramesToEvaluate = Interval - 1;
+    } else {
+        mPoseStep = AnimationLod::Step::Blend;
+        mFramesToEvaluate--;
     }
-}
-
-void SkinnedMesh::LoadBones(unsigned int MeshIndex, const aiMesh* pMesh, std::vector<VertexBoneData>& Bones)
-{
-    for (unsigned int i = 0; i < pMesh->mNumBones; i++) {
-        unsigned int BoneIndex = 0;
-        std::string BoneName(pMesh->mBones[i]->mName.data);
-
-        auto iter = m_BoneMapping.find(BoneName);
-        if (iter == m_BoneMapping.end()) {
-            // Allocate an index for a new bone
-            BoneIndex = m_NumBones;
-            m_NumBones++;
-            BoneInfo bi;
-            m_BoneInfo.push_back(bi);
-            m_BoneInfo[BoneIndex].BoneOffset = pMesh->mBones[i]->mOffsetMatrix;
-            m_BoneMapping[BoneName] = BoneIndex;
-        } else {
-            BoneIndex = iter->second;
-        }
 
-        for (unsigned int j = 0; j < pMesh->mBones[i]->mNumWeights; j++) {
-            unsigned int VertexID = m_Entries[MeshIndex].BaseVertex + pMesh->mBones[i]->mWeights[j].mVertexId;
-            float Weight = pMesh->mBones[i]->mWeights[j].mWeight;
-            Bones[VertexID].AddBoneData(BoneIndex, Weight);
-        }
-    }
+    AnimationLod::Count(mPoseStep);
+    return mPoseStep != AnimationLod::Step::Skip;
 }
 
-bool SkinnedMesh::InitMaterials(const aiScene* pScene, const std::string& Filename)
+void SkinnedMesh::EvaluatePose()
 {
-    // Extract the directory part from the file name
-    std::string::size_type SlashIndex = Filename.find_last_of('\\');
-    std::string Dir;
-
-    if (SlashIndex == std::string::npos) {
-        Dir = ".";
-    } else if (SlashIndex == 0) {
-        Dir = "\\";
-    } else {
-        Dir = Filename.substr(0, SlashIndex);
+    if (!mLoaded || mPoseStep == AnimationLod::Step::Skip) {
+        return;
     }
 
-    bool Ret = true;
-
-    // Initialize the materials
-    for (unsigned int i = 0; i < pScene->mNumMaterials; i++) {
-        const aiMaterial* pMaterial = pScene->mMaterials[i];
-
-        m_Textures[i] = NULL;
-
-        aiColor4D color(0.f, 0.f, 0.f, 0.0f);
-        aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_DIFFUSE, &color);
-
-        if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-            aiString Path;
-
-            if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
-                std::string p(Path.data);
-
-                if (p.substr(0, 2) == ".\\") {
-                    p = p.substr(2, p.size() - 2);
-                }
-
-                std::string FullPath = Dir + "/" + p;
+    std::vector<aiMatrix4x4>& Palette = mTransforms[mFrontPalette ^ 1];
+    if (mPoseStep == AnimationLod::Step::Evaluate) {
+        BoneTransform(mAnimationTime, Palette);
+    } else {
+        if (mPoseStep == AnimationLod::Step::EvaluateAhead) {
+            // Render() only reads the front palette meanwhile
+            mFromPalette = mTransforms[mFrontPalette];
+            BoneTransform(mToTime, mToPalette);
+        }
 
-                m_Textures[i] = LoadTexture(FullPath);
-                if (m_Textures[i] == -1) {
-                    Ret = false;
-                }
+        // Component-wise blend of the skinning matrices: exact at both ends, and the few frames in
+        // between are too short for the shrinking of large rotations to show
+        const float Span = mToTime - mFromTime;
+        const float t = Span > 0.0f ? std::clamp((mAnimationTime - mFromTime) / Span, 0.0f, 1.0f) : 1.0f;
+        Palette.resize(mToPalette.size());
+        for (size_t b = 0; b < Palette.size(); b++) {
+            const float* From = &mFromPalette[b].a1;
+            const float* To = &mToPalette[b].a1;
+            float* Out = &Palette[b].a1;
+            for (int i = 0; i < 12; i++) {
+                Out[i] = From[i] + t * (To[i] - From[i]);
             }
         }
     }
 
-    return Ret;
+    mBackPoseTime = mAnimationTime;
+    mBackPoseWritten = true;
 }
 
-unsigned int SkinnedMesh::FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void SkinnedMesh::SwapPalettes()
 {
-    for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++) {
-        if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime) {
-            return i;
-        }
+    // Skipped meshes keep showing their front palette
+    if (mBackPoseWritten) {
+        mFrontPalette ^= 1;
+        mPoseTime = mBackPoseTime;
+        mBackPoseWritten = false;
     }
-
-    assert(0);
-
-    return 0;
 }
 
-unsigned int SkinnedMesh::FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void SkinnedMesh::Render()
 {
-    assert(pNodeAnim->mNumRotationKeys > 0);
+    const std::vector<aiMatrix4x4>& Palette = mTransforms[mFrontPalette];
+    if (!mLoaded || Palette.empty()) {
+        return;
+    }
 
-    for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++) {
-        if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime) {
-            return i;
-        }
+    // Levels are chosen from the bind pose bounds, which the animations stay close to
+    const std::vector<MeshLod::Entry>& Lods = mAsset->GetLods();
+    mLodLevels.resize(Lods.size(), 0);
+    for (size_t i = 0; i < Lods.size(); i++) {
+        mLodLevels[i] = MeshLod::Select(Lods[i], mWorldMatrix, mLodLevels[i]);
     }
 
-    assert(0);
+    // Cull against the pose of the front palette, once per frustum
+    if (FrustumCulling::GetVersion() != mCullVersion || mPoseBounds.Count != Lods.size()) {
+        mAsset->CalcPoseBounds(Palette.data(), static_cast<unsigned int>(Palette.size()), mPoseBounds);
+    }
+    FrustumCulling::CullEntries(mPoseBounds, mWorldMatrix, mVisible, mCullVersion);
 
-    return 0;
+    if (SkinnedBatch::sEnabled) {
+        SkinnedBatch::Add(this);
+    } else {
+        DrawImmediate();
+    }
 }
 
-unsigned int SkinnedMesh::FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void SkinnedMesh::DrawImmediate() const
 {
-    assert(pNodeAnim->mNumScalingKeys > 0);
+    const std::vector<aiMatrix4x4>& Palette = mTransforms[mFrontPalette];
 
-    for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++) {
-        if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime) {
-            return i;
-        }
-    }
+    glUniformMatrix4fv(UniformLoc::M, 1, GL_FALSE, &mWorldMatrix[0][0]);
+    glUniform1i(UniformLoc::NumBones, static_cast<GLint>(Palette.size()));
+    glUniformMatrix4fv(UniformLoc::Bones, Palette.size(), GL_TRUE, &Palette[0].a1);
 
-    assert(0);
-
-    return 0;
+    mAsset->Draw(mLodLevels.data(), mVisible.data());
 }
 
-void SkinnedMesh::CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void SkinnedMesh::BoneTransform(float TimeInSeconds, std::vector<aiMatrix4x4>& Transforms)
 {
-    if (pNodeAnim->mNumPositionKeys == 1) {
-        Out = pNodeAnim->mPositionKeys[0].mValue;
+    if (!mAsset || mAsset->GetClips().empty() || mAsset->GetSkeleton().GetNumNodes() == 0) {
         return;
     }
 
-    const unsigned int PositionIndex = FindPosition(AnimationTime, pNodeAnim);
-    const unsigned int NextPositionIndex = (PositionIndex + 1);
-    assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
-    const float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime - pNodeAnim->mPositionKeys[PositionIndex].mTime);
-    const float Factor = (AnimationTime - (float)pNodeAnim->mPositionKeys[PositionIndex].mTime) / DeltaTime;
-    // assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiVector3D& Start = pNodeAnim->mPositionKeys[PositionIndex].mValue;
-    const aiVector3D& End = pNodeAnim->mPositionKeys[NextPositionIndex].mValue;
-    const aiVector3D Delta = End - Start;
-    Out = Start + Factor * Delta;
-}
+    mGraph.Evaluate(TimeInSeconds, mPose);
 
-void SkinnedMesh::CalcInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-    // we need at least two values to interpolate...
-    if (pNodeAnim->mNumRotationKeys == 1) {
-        Out = pNodeAnim->mRotationKeys[0].mValue;
-        return;
-    }
-
-    const unsigned int RotationIndex = FindRotation(AnimationTime, pNodeAnim);
-    const unsigned int NextRotationIndex = (RotationIndex + 1);
-    assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
-    const float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime - pNodeAnim->mRotationKeys[RotationIndex].mTime);
-    const float Factor = (AnimationTime - (float)pNodeAnim->mRotationKeys[RotationIndex].mTime) / DeltaTime;
-    // assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiQuaternion& StartRotationQ = pNodeAnim->mRotationKeys[RotationIndex].mValue;
-    const aiQuaternion& EndRotationQ = pNodeAnim->mRotationKeys[NextRotationIndex].mValue;
-    aiQuaternion::Interpolate(Out, StartRotationQ, EndRotationQ, Factor);
-    Out = Out.Normalize();
+    Transforms.resize(mAsset->GetNumBones());
+    mAsset->GetSkeleton().ComputePalette(mPose, mGlobals.data(), Transforms.data());
 }
 
-void SkinnedMesh::CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void SkinnedMesh::SkinVertices(std::vector<glm::vec3>& Positions, std::vector<glm::vec3>* pNormals) const
 {
-    if (pNodeAnim->mNumScalingKeys == 1) {
-        Out = pNodeAnim->mScalingKeys[0].mValue;
+    if (!mLoaded) {
+        Positions.clear();
         return;
     }
 
-    const unsigned int ScalingIndex = FindScaling(AnimationTime, pNodeAnim);
-    const unsigned int NextScalingIndex = (ScalingIndex + 1);
-    assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
-    const float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime - pNodeAnim->mScalingKeys[ScalingIndex].mTime);
-    const float Factor = (AnimationTime - (float)pNodeAnim->mScalingKeys[ScalingIndex].mTime) / DeltaTime;
-    // assert(Factor >= 0.0f && Factor <= 1.0f);
-    const aiVector3D& Start = pNodeAnim->mScalingKeys[ScalingIndex].mValue;
-    const aiVector3D& End = pNodeAnim->mScalingKeys[NextScalingIndex].mValue;
-    const aiVector3D Delta = End - Start;
-    Out = Start + Factor * Delta;
-}
-
-void SkinnedMesh::ReadNodeHierarchy(float AnimationTime, const aiNode* pNode, const aiMatrix4x4& ParentTransform)
-{
-    const std::string NodeName(pNode->mName.data);
-
-    const aiAnimation* pAnimation = mScene->mAnimations[0];
+    const auto& Vertices = mAsset->GetVertices();
+    const auto& Bones = mAsset->GetBoneData();
+    const std::vector<aiMatrix4x4>& Palette = mTransforms[mFrontPalette];
+    const auto NumVertices = static_cast<unsigned int>(Vertices.size());
 
-    aiMatrix4x4 NodeTransformation(pNode->mTransformation);
-
-    const aiNodeAnim* pNodeAnim = FindNodeAnim(pAnimation, NodeName);
-
-    if (pNodeAnim) {
-        // Interpolate scaling and generate scaling transformation matrix
-        aiVector3D Scaling;
-        CalcInterpolatedScaling(Scaling, AnimationTime, pNodeAnim);
-        aiMatrix4x4 ScalingM;
-        aiMatrix4x4::Scaling(Scaling, ScalingM);
-
-        // Interpolate rotation and generate rotation transformation matrix
-        aiQuaternion RotationQ;
-        CalcInterpolatedRotation(RotationQ, AnimationTime, pNodeAnim);
-        aiMatrix4x4 RotationM = aiMatrix4x4(RotationQ.GetMatrix());
-
-        // Interpolate translation and generate translation transformation matrix
-        aiVector3D Translation;
-        CalcInterpolatedPosition(Translation, AnimationTime, pNodeAnim);
-        aiMatrix4x4 TranslationM;
-        aiMatrix4x4::Translation(Translation, TranslationM);
-
-        // Combine the above transformations
-        NodeTransformation = TranslationM * RotationM * ScalingM;
+    Positions.resize(NumVertices);
+    if (pNormals) {
+        pNormals->resize(NumVertices);
     }
 
-    aiMatrix4x4 GlobalTransformation = ParentTransform * NodeTransformation;
-
-    auto iter = m_BoneMapping.find(NodeName);
-    if (iter != m_BoneMapping.end()) {
-        const unsigned int BoneIndex = iter->second;
-        m_BoneInfo[BoneIndex].FinalTransformation = m_GlobalInverseTransform * GlobalTransformation * m_BoneInfo[BoneIndex].BoneOffset;
-    }
-
-    for (unsigned int i = 0; i < pNode->mNumChildren; i++) {
-        ReadNodeHierarchy(AnimationTime, pNode->mChildren[i], GlobalTransformation);
-    }
+    CpuSkinning::Skin(Vertices.data(), Bones.data(), NumVertices, Palette.data(), static_cast<unsigned int>(Palette.size()),
+        Positions.data(), pNormals ? pNormals->data() : nullptr);
 }
 
-void SkinnedMesh::BoneTransform(float TimeInSeconds, std::vector<aiMatrix4x4>& Transforms)
+void SkinnedMesh::CalcSkinnedBounds(glm::vec3& Min, glm::vec3& Max) const
 {
-    aiMatrix4x4 Identity;
-
-    if (mScene->mNumAnimations == 0) {
-        return;
-    }
-
-    float TicksPerSecond = (float)(mScene->mAnimations[0]->mTicksPerSecond != 0 ? mScene->mAnimations[0]->mTicksPerSecond : 25.0f);
-    float TimeInTicks = TimeInSeconds * TicksPerSecond;
-    float AnimationTime = fmod(TimeInTicks, (float)mScene->mAnimations[0]->mDuration);
-
-    ReadNodeHierarchy(AnimationTime, mScene->mRootNode, Identity);
-
-    Transforms.resize(m_NumBones);
-
-    for (unsigned int i = 0; i < m_NumBones; i++) {
-        Transforms[i] = m_BoneInfo[i].FinalTransformation;
-    }
+    std::vector<glm::vec3> Positions;
+    SkinVertices(Positions);
+    CpuSkinning::CalcBounds(Positions.data(), static_cast<unsigned int>(Positions.size()), Min, Max);
 }
 
-const aiNodeAnim* SkinnedMesh::FindNodeAnim(const aiAnimation* pAnimation, const std::string& NodeName)
+bool SkinnedMesh::Pick(const glm::mat4& M, const glm::vec3& Origin, const glm::vec3& Dir, float& Distance) const
 {
-    auto it = mNodeMap.find(NodeName);
-    if (it != mNodeMap.end()) {
-        return it->second;
+    if (!mLoaded) {
+        return false;
     }
 
-    for (unsigned int i = 0; i < pAnimation->mNumChannels; i++) {
-        aiNodeAnim* pNodeAnim = pAnimation->mChannels[i];
-
-        if (std::string(pNodeAnim->mNodeName.data) == NodeName) {
-            // insert in map, so next Find will be fast
-            mNodeMap[NodeName] = pNodeAnim;
-            return pNodeAnim;
+    std::vector<glm::vec3> Positions;
+    SkinVertices(Positions);
+
+    // Intersect in model space, the ray parameter is the same in both spaces
+    const glm::mat4 InvM = glm::inverse(M);
+    const glm::vec3 ModelOrigin = glm::vec3(InvM * glm::vec4(Origin, 1.0f));
+    const glm::vec3 ModelDir = glm::vec3(InvM * glm::vec4(Dir, 0.0f));
+
+    bool Hit = false;
+    const std::vector<unsigned int>& Indices = mAsset->GetIndices();
+    for (const auto& Entry : mAsset->GetEntries()) {
+        float t = 0.0f;
+        if (CpuSkinning::IntersectRay(ModelOrigin, ModelDir, Positions.data(), Indices.data() + Entry.BaseIndex,
+                Entry.NumIndices, Entry.BaseVertex, t)
+            && (!Hit || t < Distance)) {
+            Distance = t;
+            Hit = true;
         }
     }
-    mNodeMap[NodeName] = nullptr;
-    return nullptr;
+
+    return Hit;
 }
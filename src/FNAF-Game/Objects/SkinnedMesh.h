@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <map>
+#include <memory>
 #include <vector>
 #include <cassert>
 #include <GL/glew.h>
@@ -12,6 +13,11 @@
 #include <assimp/matrix3x3.h>
 #include <assimp/matrix4x4.h>
 #include "MeshBase.h"
+#include "MeshCache.h"
+#include "Skeleton.h"
+#include "AnimationGraph.h"
+#include "AnimationLod.h"
+#include "SkinnedMeshAsset.h"
 
 // Shaders
 static const std::string anime_vertex_shader("skinned_mesh.vert");
@@ -33,6 +39,8 @@ public:
         DebugID = 5,
         EyeW = 6,
         Shininess = 7,
+        Instanced = 8, // model matrix and palette from SkinnedBatch's ring
+        InstanceBase = 9, // ring slot of the draw's first instance record
         Bones = 20, // array of 100 bones
     };
 
@@ -48,103 +56,78 @@ public:
     ~SkinnedMesh() override;
 
     bool LoadMesh(const std::string& filename) override;
+    bool LoadMeshAsync(const std::string& filename) override;
 
     void Update(float deltaSeconds) override;
     void Render() override;
 
     [[nodiscard]] static Shader* sShader() { return mShader; }
 
-    [[nodiscard]] unsigned int GetNumBones() const { return m_NumBones; }
+    [[nodiscard]] unsigned int GetNumBones() const { return mAsset ? mAsset->GetNumBones() : 0; }
+    [[nodiscard]] const std::shared_ptr<SkinnedMeshAsset>& GetAsset() const { return mAsset; }
 
     void BoneTransform(float TimeInSeconds, std::vector<aiMatrix4x4>& Transforms);
 
-private:
-    const static int NUM_BONES_PER_VERTEX = 4;
-
-    struct BoneInfo {
-        aiMatrix4x4 BoneOffset;
-        aiMatrix4x4 FinalTransformation;
-
-        BoneInfo()
-        {
-            aiMatrix4x4::Scaling(aiVector3D(0.0f), BoneOffset);
-            aiMatrix4x4::Scaling(aiVector3D(0.0f), FinalTransformation);
-        }
-    };
-
-    struct VertexBoneData {
-        unsigned char IDs[NUM_BONES_PER_VERTEX] {};
-        float Weights[NUM_BONES_PER_VERTEX] {};
-
-        VertexBoneData()
-        {
-            memset(IDs, 0, sizeof(IDs));
-            memset(Weights, 0, sizeof(Weights));
-        };
-
-        void AddBoneData(unsigned int BoneID, float Weight);
-    };
-
-    void CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    void CalcInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    void CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    unsigned int FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    unsigned int FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    unsigned int FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    const aiNodeAnim* FindNodeAnim(const aiAnimation* pAnimation, const std::string& NodeName);
-    void ReadNodeHierarchy(float AnimationTime, const aiNode* pNode, const aiMatrix4x4& ParentTransform);
-    bool InitFromScene(const aiScene* pScene, const std::string& Filename);
-    void InitMesh(unsigned int MeshIndex,
-        const aiMesh* paiMesh,
-        std::vector<aiVector3D>& Positions,
-        std::vector<aiVector3D>& Normals,
-        std::vector<aiVector2D>& TexCoords,
-        std::vector<VertexBoneData>& Bones,
-        std::vector<unsigned int>& Indices);
-    void LoadBones(unsigned int MeshIndex, const aiMesh* paiMesh, std::vector<VertexBoneData>& Bones);
-    bool InitMaterials(const aiScene* pScene, const std::string& Filename);
-    void Clear();
-
-#define INVALID_MATERIAL 0xFFFFFFFF
-
-    enum VB_TYPES : unsigned int {
-        INDEX_BUFFER,
-        POS_VB,
-        NORMAL_VB,
-        TEXCOORD_VB,
-        BONE_VB,
-        NUM_VBs
-    };
+    // Skin the asset's vertices on the CPU with the palette Render() currently uses (model space)
+    void SkinVertices(std::vector<glm::vec3>& Positions, std::vector<glm::vec3>* pNormals = nullptr) const;
+    // Model-space bounds of the current pose
+    void CalcSkinnedBounds(glm::vec3& Min, glm::vec3& Max) const;
+    // Closest hit of a world-space ray with the current pose, M is the model matrix used to draw it
+    bool Pick(const glm::mat4& M, const glm::vec3& Origin, const glm::vec3& Dir, float& Distance) const;
+
+    // Called by AnimationSystem: pick how the pose for the time recorded by Update() is made (on
+    // the main thread, false if it isn't), write it into the back palette (on a worker thread), then
+    // make that the palette Render() uses (on the main thread)
+    bool PreparePose();
+    void EvaluatePose();
+    void SwapPalettes();
+
+    // What Render() prepared for SkinnedBatch: palette, world matrix, LOD level and visibility per entry
+    [[nodiscard]] const std::vector<aiMatrix4x4>& GetPalette() const { return mTransforms[mFrontPalette]; }
+    [[nodiscard]] const glm::mat4& GetWorldMatrix() const { return mWorldMatrix; }
+    [[nodiscard]] const std::vector<unsigned int>& GetLodLevels() const { return mLodLevels; }
+    [[nodiscard]] const std::vector<uint8_t>& GetVisible() const { return mVisible; }
+
+    // Draw right away with the palette in uniforms, what Render() does with SkinnedBatch off
+    void DrawImmediate() const;
 
-    GLuint m_VAO = 0;
-    GLuint m_Buffers[NUM_VBs] { 0 };
-
-    struct MeshEntry {
-        MeshEntry()
-        {
-            NumIndices = 0;
-            BaseVertex = 0;
-            BaseIndex = 0;
-            MaterialIndex = INVALID_MATERIAL;
-        }
-
-        unsigned int NumIndices;
-        unsigned int BaseVertex;
-        unsigned int BaseIndex;
-        unsigned int MaterialIndex;
-    };
+private:
+    void InitInstance();
 
     static const unsigned int MAX_BONES = 100;
 
-    std::vector<MeshEntry> m_Entries;
-    std::vector<GLuint> m_Textures;
-
-    std::map<std::string, unsigned int> m_BoneMapping; // maps a bone name to its index
-    unsigned int m_NumBones = 0;
-    std::vector<BoneInfo> m_BoneInfo;
-    aiMatrix4x4 m_GlobalInverseTransform;
-    std::vector<aiMatrix4x4> mTransforms;
-    std::map<std::string, aiNodeAnim*> mNodeMap;
-
-    void CalcBoundingBox();
+    // Geometry, textures, skeleton and clips, shared by every instance of the same file
+    std::shared_ptr<SkinnedMeshAsset> mAsset;
+
+    // Per-instance animation state
+    AnimationGraph mGraph;
+    LocalPose mPose; // per-node scratch for AnimationGraph::Evaluate
+    std::vector<aiMatrix4x4> mGlobals; // per-node scratch for Skeleton::ComputePalette
+
+    // Double-buffered bone palettes: Render() reads the front one while a worker writes the back one
+    std::vector<aiMatrix4x4> mTransforms[2];
+    unsigned int mFrontPalette = 0;
+    float mClockTime = 0.0f; // set by Update()
+    float mAnimationTime = 0.0f; // the clock when the pose being written was prepared
+    float mFrameSeconds = 0.0f; // last clock step, to look ahead at reduced rates
+    float mPoseTime = 0.0f; // clock time of the front palette
+    float mBackPoseTime = 0.0f;
+    bool mBackPoseWritten = false;
+
+    // Animation LOD: at reduced rates the pose at the end of the interval is evaluated ahead, and
+    // the frames of the interval blend from the palette shown when it started towards it
+    AnimationLod::Step mPoseStep = AnimationLod::Step::Evaluate;
+    unsigned int mFramesToEvaluate = 0;
+    std::vector<aiMatrix4x4> mFromPalette;
+    std::vector<aiMatrix4x4> mToPalette;
+    float mFromTime = 0.0f;
+    float mToTime = 0.0f;
+
+    // LOD level drawn per entry of the asset, kept for MeshLod's hysteresis
+    std::vector<unsigned int> mLodLevels;
+
+    // Entry boxes of the pose last culled, and which entries the frame's frustum keeps
+    FrustumCulling::EntryBounds mPoseBounds;
+    std::vector<uint8_t> mVisible;
+    unsigned int mCullVersion = 0;
 };
@@ -0,0 +1,420 @@
+#include "SkinnedMeshAsset.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+#include "LoadTexture.h"
+#include "MemoryBudget.h"
+#include "UploadQueue.h"
+
+#include "SkinnedMesh.h"
+#include "AssetLoader.h"
+
+namespace {
+
+using AttribLoc = SkinnedMesh::AttribLoc;
+
+std::string NormalizePath(const std::string& filename)
+{
+    std::string fullPath = filename;
+    std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
+    return fullPath;
+}
+
+// Weak references only: the registry never keeps an asset alive by itself
+std::unordered_map<std::string, std::weak_ptr<SkinnedMeshAsset>>& Registry()
+{
+    static std::unordered_map<std::string, std::weak_ptr<SkinnedMeshAsset>> sRegistry;
+    return sRegistry;
+}
+}
+
+std::shared_ptr<SkinnedMeshAsset> SkinnedMeshAsset::Load(const std::string& filename)
+{
+    const std::string fullPath = NormalizePath(filename);
+
+    auto& registry = Registry();
+    auto iter = registry.find(fullPath);
+    if (iter != registry.end()) {
+        if (std::shared_ptr<SkinnedMeshAsset> asset = iter->second.lock()) {
+            // Still streaming in from LoadAsync(): this caller wants it now. If the loader job
+            // hasn't started, take its work over, otherwise help it through the upload queue.
+            if (!asset->IsReady() && !asset->mLoadFailed) {
+                if (!asset->mLoadClaimed.exchange(true)) {
+                    asset->mLoadFailed = !asset->LoadNow(fullPath);
+                } else {
+                    asset->JoinLoad();
+                }
+            }
+            return asset->IsReady() ? asset : nullptr;
+        }
+    }
+
+    std::shared_ptr<SkinnedMeshAsset> asset(new SkinnedMeshAsset());
+    asset->mLoadClaimed = true;
+    if (!asset->LoadNow(fullPath)) {
+        return nullptr;
+    }
+
+    registry[fullPath] = asset;
+    return asset;
+}
+
+bool SkinnedMeshAsset::LoadNow(const std::string& fullPath)
+{
+    std::vector<ImageData> Images;
+    if (!ReadCpu(fullPath, Images, AssetLoader::GetCpuStagePool(false))) {
+        for (ImageData& Image : Images) {
+            ReleaseImage(Image);
+        }
+        return false;
+    }
+
+    UploadGeometry();
+    for (unsigned int i = 0; i < Images.size(); i++) {
+        UploadTexture(i, Images[i]);
+        ReleaseImage(Images[i]);
+    }
+    mReady = true;
+    return true;
+}
+
+void SkinnedMeshAsset::JoinLoad()
+{
+    // The job ends by queueing an upload that sets mReady or mLoadFailed, so sleeping until
+    // something is queued can't miss it. Other loads' uploads run too, they'd be next anyway.
+    UploadQueue& queue = AssetLoader::GetUploadQueue();
+    while (!mReady && !mLoadFailed) {
+        queue.WaitForUploads();
+        AssetLoader::Update();
+    }
+}
+
+std::shared_ptr<SkinnedMeshAsset> SkinnedMeshAsset::LoadAsync(const std::string& filename)
+{
+    const std::string fullPath = NormalizePath(filename);
+
+    auto& registry = Registry();
+    auto iter = registry.find(fullPath);
+    if (iter != registry.end()) {
+        if (std::shared_ptr<SkinnedMeshAsset> asset = iter->second.lock()) {
+            return asset;
+        }
+    }
+
+    // Registered right away so instances spawned while it streams in share it
+    std::shared_ptr<SkinnedMeshAsset> asset(new SkinnedMeshAsset());
+    registry[fullPath] = asset;
+
+    // The jobs own a reference, the asset outlives its load even if every instance is gone
+    AssetLoader::Submit([asset, fullPath]() {
+        // A Load() of the same file got here first and loads it on the render thread
+        if (asset->mLoadClaimed.exchange(true)) {
+            return;
+        }
+
+        UploadQueue& queue = AssetLoader::GetUploadQueue();
+        auto Images = std::make_shared<std::vector<ImageData>>();
+        if (!asset->ReadCpu(fullPath, *Images, AssetLoader::GetCpuStagePool(true))) {
+            for (ImageData& Image : *Images) {
+                ReleaseImage(Image);
+            }
+            queue.Push(0, [asset]() { asset->mLoadFailed = true; });
+            return;
+        }
+
+        const size_t GeometryBytes = asset->mPacked.Data.size() + sizeof(unsigned int) * asset->mIndices.size();
+        queue.Push(GeometryBytes, [asset]() { asset->UploadGeometry(); });
+
+        for (unsigned int i = 0; i < Images->size(); i++) {
+            queue.Push(AssetLoader::GetImageBytes((*Images)[i]), [asset, Images, i]() {
+                asset->UploadTexture(i, (*Images)[i]);
+                ReleaseImage((*Images)[i]);
+            });
+        }
+
+        queue.Push(0, [asset]() { asset->mReady = true; });
+    });
+
+    return asset;
+}
+
+SkinnedMeshAsset::~SkinnedMeshAsset()
+{
+    for (unsigned int i = 0; i < m_Textures.size(); i++) {
+        DeleteTexture(m_Textures[i]);
+    }
+
+    if (m_Buffers[0] != 0) {
+        for (GLuint Buffer : m_Buffers) {
+            MemoryBudget::UntrackGlObject(GL_BUFFER, Buffer);
+        }
+        glDeleteBuffers(NUM_VBs, m_Buffers);
+    }
+
+    MemoryBudget::Add("Meshes", MemoryBudget::Cpu, -mMeshBytes);
+    MemoryBudget::Add("Animation", MemoryBudget::Cpu, -mAnimationBytes);
+
+    if (m_VAO != 0) {
+        glDeleteVertexArrays(1, &m_VAO);
+    }
+}
+
+bool SkinnedMeshAsset::ReadCpu(const std::string& fullPath, std::vector<ImageData>& Images, ThreadPool& Pool)
+{
+    MeshCache::Source source;
+    if (!source.Load(fullPath, MeshBase::sImportFlags, true, &Pool)) {
+        return false;
+    }
+
+    // Runs on a loader thread: CPU state only, GL objects are created by the upload stage
+    const MeshCache::View& View = source.GetView();
+
+    m_Entries.resize(View.Entries.Size);
+    m_Textures.assign(View.Materials.Size, 0);
+
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        m_Entries[i].MaterialIndex = View.Entries[i].MaterialIndex;
+        m_Entries[i].NumIndices = View.Entries[i].NumIndices;
+        m_Entries[i].BaseVertex = View.Entries[i].BaseVertex;
+        m_Entries[i].BaseIndex = View.Entries[i].BaseIndex;
+    }
+
+    mBbMin = View.BbMin;
+    mBbMax = View.BbMax;
+
+    mVertices.assign(View.Vertices.Data, View.Vertices.Data + View.Vertices.Size);
+    mBoneData.assign(View.Bones.Data, View.Bones.Data + View.Bones.Size);
+    mIndices.assign(View.Indices.Data, View.Indices.Data + View.Indices.Size);
+
+    MeshCache::PackVertices(View, MeshBase::sVertexLayout, mPacked);
+    MeshLod::Build(View, mLods);
+    FrustumCulling::Build(View, mBindBounds);
+    BuildBoneBoxes(View);
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        m_Entries[i].Dequant = mPacked.Submeshes[i];
+    }
+
+    mSkeleton.Init(View);
+    Animation::LoadClips(View, mAnimations);
+    for (AnimationClip& Clip : mAnimations) {
+        mSkeleton.BindClip(Clip);
+    }
+    UpdateMemoryUsage();
+
+    return AssetLoader::DecodeMaterialTextures(View, fullPath, "/", Images, Pool);
+}
+
+void SkinnedMeshAsset::UploadGeometry()
+{
+    // Create the VAO
+    glGenVertexArrays(1, &m_VAO);
+    glBindVertexArray(m_VAO);
+
+    // Create the buffers for the vertices attributes
+    glGenBuffers(NUM_VBs, m_Buffers);
+
+    // Upload the packed vertex stream (bone ids and weights included) and the indices
+    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VERTEX_VB]);
+    glBufferData(GL_ARRAY_BUFFER, mPacked.Data.size(), mPacked.Data.data(), GL_STATIC_DRAW);
+    VertexPacking::SetupAttributes(mPacked.Format, AttribLoc::Pos, AttribLoc::TexCoord, AttribLoc::Normal,
+        AttribLoc::BoneIds, AttribLoc::BoneWeights);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mIndices.size(), mIndices.data(), GL_STATIC_DRAW);
+
+    // Make sure the VAO is not changed from the outside
+    glBindVertexArray(0);
+
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[VERTEX_VB], mPacked.Data.size(), "Meshes");
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[INDEX_BUFFER], sizeof(unsigned int) * mIndices.size(), "Meshes");
+
+    // The GPU has its copy, only the format is needed from here on
+    std::vector<unsigned char>().swap(mPacked.Data);
+    UpdateMemoryUsage();
+}
+
+void SkinnedMeshAsset::UpdateMemoryUsage()
+{
+    int64_t MeshBytes = MemoryBudget::GetBytes(mVertices) + MemoryBudget::GetBytes(mBoneData) + MemoryBudget::GetBytes(mIndices)
+        + MemoryBudget::GetBytes(mPacked.Data) + MemoryBudget::GetBytes(mBoneBoxes) + MemoryBudget::GetBytes(mFirstBoneBox)
+        + static_cast<int64_t>(mBindBounds.GetMemoryBytes()) + MemoryBudget::GetBytes(m_Entries);
+    for (const MeshLod::Entry& Lod : mLods) {
+        MeshBytes += MemoryBudget::GetBytes(Lod.Levels);
+    }
+
+    int64_t AnimationBytes = MemoryBudget::GetBytes(mAnimations);
+    for (const AnimationClip& Clip : mAnimations) {
+        AnimationBytes += MemoryBudget::GetBytes(Clip.ChannelNames) + static_cast<int64_t>(Clip.Tracks.GetMemoryBytes())
+            + MemoryBudget::GetBytes(Clip.NodeChannels) + MemoryBudget::GetBytes(Clip.ChannelNodes);
+    }
+
+    MemoryBudget::Add("Meshes", MemoryBudget::Cpu, MeshBytes - mMeshBytes);
+    MemoryBudget::Add("Animation", MemoryBudget::Cpu, AnimationBytes - mAnimationBytes);
+    mMeshBytes = MeshBytes;
+    mAnimationBytes = AnimationBytes;
+}
+
+void SkinnedMeshAsset::UploadTexture(unsigned int Material, const ImageData& Image)
+{
+    if (Image.Valid()) {
+        m_Textures[Material] = CreateTexture2D(Image);
+    }
+}
+
+void SkinnedMeshAsset::BuildBoneBoxes(const MeshCache::View& View)
+{
+    // Bone ids are bytes, so a flat table per entry is enough
+    constexpr unsigned int MaxBoneIds = 256;
+    glm::vec3 Min[MaxBoneIds], Max[MaxBoneIds];
+    bool Used[MaxBoneIds];
+
+    mBoneBoxes.clear();
+    mFirstBoneBox.assign(1, 0);
+
+    for (const MeshEntry& Entry : m_Entries) {
+        std::fill(std::begin(Used), std::end(Used), false);
+
+        for (unsigned int i = 0; i < Entry.NumIndices; i++) {
+            const unsigned int v = Entry.BaseVertex + View.Indices[Entry.BaseIndex + i];
+            const glm::vec3 p(View.Vertices[v].Pos.x, View.Vertices[v].Pos.y, View.Vertices[v].Pos.z);
+            for (unsigned int k = 0; k < MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX; k++) {
+                if (View.Bones[v].Weights[k] <= 0.0f) {
+                    continue;
+                }
+                const unsigned int Bone = View.Bones[v].IDs[k];
+                Min[Bone] = Used[Bone] ? glm::min(Min[Bone], p) : p;
+                Max[Bone] = Used[Bone] ? glm::max(Max[Bone], p) : p;
+                Used[Bone] = true;
+            }
+        }
+
+        for (unsigned int Bone = 0; Bone < MaxBoneIds; Bone++) {
+            if (Used[Bone]) {
+                mBoneBoxes.push_back({ Bone, Min[Bone], Max[Bone] });
+            }
+        }
+        mFirstBoneBox.push_back(static_cast<unsigned int>(mBoneBoxes.size()));
+    }
+}
+
+void SkinnedMeshAsset::CalcPoseBounds(const aiMatrix4x4* pPalette, unsigned int NumBones, FrustumCulling::EntryBounds& Out) const
+{
+    Out.Resize(m_Entries.size());
+
+    for (size_t e = 0; e < m_Entries.size(); e++) {
+        glm::vec3 BbMin(mBindBounds.MinX[e], mBindBounds.MinY[e], mBindBounds.MinZ[e]);
+        glm::vec3 BbMax(mBindBounds.MaxX[e], mBindBounds.MaxY[e], mBindBounds.MaxZ[e]);
+
+        // Without a palette the shader draws the bind pose
+        if (NumBones > 0 && mFirstBoneBox[e] < mFirstBoneBox[e + 1]) {
+            BbMin = glm::vec3(FLT_MAX);
+            BbMax = glm::vec3(-FLT_MAX);
+
+            for (unsigned int b = mFirstBoneBox[e]; b < mFirstBoneBox[e + 1]; b++) {
+                const BoneBox& Box = mBoneBoxes[b];
+                if (Box.Bone >= NumBones) {
+                    continue;
+                }
+
+                // Center and half extent through the affine palette matrix (row-major)
+                const aiMatrix4x4& m = pPalette[Box.Bone];
+                const glm::vec3 c = 0.5f * (Box.Min + Box.Max);
+                const glm::vec3 h = 0.5f * (Box.Max - Box.Min);
+                const glm::vec3 Center(m.a1 * c.x + m.a2 * c.y + m.a3 * c.z + m.a4,
+                    m.b1 * c.x + m.b2 * c.y + m.b3 * c.z + m.b4,
+                    m.c1 * c.x + m.c2 * c.y + m.c3 * c.z + m.c4);
+                const glm::vec3 Half(std::abs(m.a1) * h.x + std::abs(m.a2) * h.y + std::abs(m.a3) * h.z,
+                    std::abs(m.b1) * h.x + std::abs(m.b2) * h.y + std::abs(m.b3) * h.z,
+                    std::abs(m.c1) * h.x + std::abs(m.c2) * h.y + std::abs(m.c3) * h.z);
+                BbMin = glm::min(BbMin, Center - Half);
+                BbMax = glm::max(BbMax, Center + Half);
+            }
+
+            // Quantized weights do not quite sum to one: leave a little slack
+            const glm::vec3 Slack = 0.01f * (BbMax - BbMin);
+            BbMin -= Slack;
+            BbMax += Slack;
+        }
+
+        Out.Set(e, BbMin, BbMax);
+    }
+}
+
+void SkinnedMeshAsset::Draw(const unsigned int* pLevels, const uint8_t* pVisible) const
+{
+    glBindVertexArray(m_VAO);
+    MeshBase::SetNormalFormat(mPacked.Format);
+
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        if (pVisible && !pVisible[i]) {
+            continue;
+        }
+
+        const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
+
+        assert(MaterialIndex < m_Textures.size());
+
+        if (m_Textures[MaterialIndex]) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, m_Textures[MaterialIndex]);
+        }
+
+        const MeshLod::Level& Level = mLods[i].Levels[pLevels ? pLevels[i] : 0];
+
+        MeshBase::SetDequant(m_Entries[i].Dequant);
+        FrustumCulling::AddDrawnTriangles(Level.NumIndices / 3);
+        glDrawElementsBaseVertex(GL_TRIANGLES,
+            Level.NumIndices,
+            GL_UNSIGNED_INT,
+            (void*)(sizeof(unsigned int) * Level.BaseIndex),
+            m_Entries[i].BaseVertex);
+    }
+
+    // Make sure the VAO is not changed from the outside
+    glBindVertexArray(0);
+}
+
+void SkinnedMeshAsset::DrawInstanced(const InstancedDraw* pDraws, size_t Count) const
+{
+    if (Count == 0) {
+        return;
+    }
+
+    glBindVertexArray(m_VAO);
+    MeshBase::SetNormalFormat(mPacked.Format);
+
+    unsigned int BoundEntry = ~0u;
+    for (size_t d = 0; d < Count; d++) {
+        const InstancedDraw& Draw = pDraws[d];
+        const MeshEntry& Entry = m_Entries[Draw.Entry];
+
+        // Draws come grouped by entry: texture and dequantization once per entry
+        if (Draw.Entry != BoundEntry) {
+            assert(Entry.MaterialIndex < m_Textures.size());
+            if (m_Textures[Entry.MaterialIndex]) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, m_Textures[Entry.MaterialIndex]);
+            }
+            MeshBase::SetDequant(Entry.Dequant);
+            BoundEntry = Draw.Entry;
+        }
+
+        const MeshLod::Level& Level = mLods[Draw.Entry].Levels[Draw.Level];
+
+        glUniform1i(SkinnedMesh::UniformLoc::InstanceBase, static_cast<GLint>(Draw.FirstRecord));
+        FrustumCulling::AddDrawnTriangles(size_t(Level.NumIndices / 3) * Draw.NumInstances);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+            Level.NumIndices,
+            GL_UNSIGNED_INT,
+            (void*)(sizeof(unsigned int) * Level.BaseIndex),
+            Draw.NumInstances,
+            Entry.BaseVertex);
+    }
+
+    // Make sure the VAO is not changed from the outside
+    glBindVertexArray(0);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "LoadTexture.h"
+#include "MeshCache.h"
+#include "FrustumCulling.h"
+#include "MeshLod.h"
+#include "VertexPacking.h"
+#include "Skeleton.h"
+#include "Animation.h"
+
+// Immutable data of a skinned mesh: GPU geometry, textures, skeleton and clips.
+//
+// Assets are reference counted and shared through Load(): every SkinnedMesh created from the
+// same file points at one asset, so spawning another instance does no I/O and no uploads.
+// The asset is released (GL objects included) when its last instance goes away.
+//
+// LoadAsync() returns the asset right away and streams it in through AssetLoader; nothing
+// but IsReady() may be used until it reports true.
+class SkinnedMeshAsset {
+public:
+#define INVALID_MATERIAL 0xFFFFFFFF
+
+    struct MeshEntry {
+        MeshEntry()
+        {
+            NumIndices = 0;
+            BaseVertex = 0;
+            BaseIndex = 0;
+            MaterialIndex = INVALID_MATERIAL;
+        }
+
+        unsigned int NumIndices;
+        unsigned int BaseVertex;
+        unsigned int BaseIndex;
+        unsigned int MaterialIndex;
+        VertexPacking::Dequant Dequant;
+    };
+
+    ~SkinnedMeshAsset();
+
+    SkinnedMeshAsset(const SkinnedMeshAsset&) = delete;
+    SkinnedMeshAsset& operator=(const SkinnedMeshAsset&) = delete;
+
+    // Shared asset for filename, loaded on first use. nullptr if loading fails.
+    // An asset still streaming in from LoadAsync() is finished right here.
+    static std::shared_ptr<SkinnedMeshAsset> Load(const std::string& filename);
+
+    // Shared asset for filename, read on the loader pool and uploaded by AssetLoader::Update().
+    // Never nullptr; an asset that fails to load simply never becomes ready.
+    static std::shared_ptr<SkinnedMeshAsset> LoadAsync(const std::string& filename);
+
+    [[nodiscard]] bool IsReady() const { return mReady; }
+
+    // Bind the VAO and draw every entry with its texture and position dequantization.
+    // pLevels holds one LOD level per entry (see GetLods), nullptr draws full detail.
+    // pVisible skips the entries set to 0, nullptr draws them all.
+    void Draw(const unsigned int* pLevels = nullptr, const uint8_t* pVisible = nullptr) const;
+
+    // One instanced draw of an entry at a LOD level, see SkinnedBatch
+    struct InstancedDraw {
+        unsigned int Entry;
+        unsigned int Level;
+        uint32_t FirstRecord; // ring slot of the first instance record
+        uint32_t NumInstances;
+    };
+
+    // Bind the VAO and issue the draws, with the skinned shader in instanced mode and the ring bound
+    void DrawInstanced(const InstancedDraw* pDraws, size_t Count) const;
+
+    // Conservative model space boxes of the entries in a pose. A skinned vertex is a weighted
+    // average of its bones' transforms applied to it, so it stays within the union of the boxes of
+    // the bind pose vertices of each of its bones, moved by those bones' palette matrices.
+    void CalcPoseBounds(const aiMatrix4x4* pPalette, unsigned int NumBones, FrustumCulling::EntryBounds& Out) const;
+
+    [[nodiscard]] unsigned int GetNumBones() const { return mSkeleton.GetNumBones(); }
+    [[nodiscard]] const Skeleton& GetSkeleton() const { return mSkeleton; }
+    [[nodiscard]] const std::vector<AnimationClip>& GetClips() const { return mAnimations; }
+    [[nodiscard]] const std::vector<MeshEntry>& GetEntries() const { return m_Entries; }
+    [[nodiscard]] const std::vector<MeshLod::Entry>& GetLods() const { return mLods; }
+    [[nodiscard]] const glm::vec3& GetBbMin() const { return mBbMin; }
+    [[nodiscard]] const glm::vec3& GetBbMax() const { return mBbMax; }
+
+    // Full precision CPU copies of the uploaded streams, for CpuSkinning (full detail levels only)
+    [[nodiscard]] const std::vector<MeshCache::Vertex>& GetVertices() const { return mVertices; }
+    [[nodiscard]] const std::vector<MeshCache::VertexBoneData>& GetBoneData() const { return mBoneData; }
+    [[nodiscard]] const std::vector<unsigned int>& GetIndices() const { return mIndices; }
+
+private:
+    SkinnedMeshAsset() = default;
+
+    // CPU stage, any thread: mesh data, skeleton, clips and decoded textures.
+    // Pool is AssetLoader::GetCpuStagePool().
+    bool ReadCpu(const std::string& fullPath, std::vector<ImageData>& Images, ThreadPool& Pool);
+    // Both stages on the render thread
+    bool LoadNow(const std::string& fullPath);
+    // Render thread: run uploads until the LoadAsync() job of this asset has finished
+    void JoinLoad();
+    // GL stages, render thread
+    void UploadGeometry();
+    void UploadTexture(unsigned int Material, const ImageData& Image);
+    // Per entry bone boxes for CalcPoseBounds
+    void BuildBoneBoxes(const MeshCache::View& View);
+    // Report the change in CPU bytes held to the MemoryBudget
+    void UpdateMemoryUsage();
+
+    enum VB_TYPES : unsigned int {
+        INDEX_BUFFER,
+        VERTEX_VB,
+        NUM_VBs
+    };
+
+    GLuint m_VAO = 0;
+    GLuint m_Buffers[NUM_VBs] { 0 };
+
+    std::vector<MeshEntry> m_Entries;
+    std::vector<MeshLod::Entry> mLods; // one per entry, bind pose bounds
+
+    // Per entry, the bind pose box of the vertices each bone influences
+    struct BoneBox {
+        unsigned int Bone;
+        glm::vec3 Min;
+        glm::vec3 Max;
+    };
+    std::vector<BoneBox> mBoneBoxes;
+    std::vector<unsigned int> mFirstBoneBox; // per entry, one past the end last
+    FrustumCulling::EntryBounds mBindBounds;
+
+    std::vector<GLuint> m_Textures;
+
+    std::vector<MeshCache::Vertex> mVertices;
+    std::vector<MeshCache::VertexBoneData> mBoneData;
+    std::vector<unsigned int> mIndices;
+
+    // GPU vertex buffer, built by ReadCpu and dropped once uploaded
+    VertexPacking::PackedVertices mPacked;
+
+    glm::vec3 mBbMin = glm::vec3(0.0f);
+    glm::vec3 mBbMax = glm::vec3(0.0f);
+
+    Skeleton mSkeleton;
+    std::vector<AnimationClip> mAnimations;
+
+    bool mReady = false;
+    // The LoadAsync() job and a Load() of the same file race for the load, whoever claims it runs it
+    std::atomic<bool> mLoadClaimed = false;
+    bool mLoadFailed = false; // render thread, set through the upload queue
+
+    // CPU bytes reported to the MemoryBudget: geometry copies and bounds, clips
+    int64_t mMeshBytes = 0;
+    int64_t mAnimationBytes = 0;
+};
@@ -8,13 +8,24 @@
 //  Use layout qualifiers for attribs and uniforms
 //  Eliminate SetBoneTransform() - send all matrices in one glUniform call
 //  Pass strings by reference
+//  Load geometry from the baked MeshCache, Assimp only on a cache miss
+//  Optional async loading: decode on the AssetLoader threads, upload through the UploadQueue
+//  Quantized, interleaved vertex buffer in MeshBase::sVertexLayout
+//  Draw each entry at the LOD level MeshLod picks from its projected size
+//  Triangle BVH for picking and line of sight queries
+//  Skip entries outside the view frustum
+//  Multi-draw-indirect batches of the visible entries, one per material
+//  No Assimp scene kept, CPU and GPU bytes reported to the MemoryBudget
 
 #include <cassert>
 
 #include "LoadTexture.h"
+#include "MemoryBudget.h"
 #include "Shader.h"
 
 #include "StaticMesh.h"
+#include "AssetLoader.h"
+#include "UploadQueue.h"
 
 Shader* StaticMesh::mShader = nullptr;
 
@@ -33,14 +44,28 @@ StaticMesh::~StaticMesh()
 
 void StaticMesh::Clear()
 {
+    // Drop uploads still queued by an async load of the previous mesh
+    mLoadToken.reset();
+    mLoaded = false;
+
     for (unsigned int& m_Texture : m_Textures) {
-        if (m_Texture) {
-            glDeleteTextures(1, &m_Texture);
-        }
+        DeleteTexture(m_Texture);
     }
+    m_Textures.clear();
+    m_Entries.clear();
+    mBvh.Clear();
+    mVisible.clear();
+    mDrawList.Clear();
+    mBatchValid = false;
+    MemoryBudget::Add("Meshes", MemoryBudget::Cpu, -mCpuBytes);
+    mCpuBytes = 0;
 
     if (m_Buffers[0] != 0) {
+        for (GLuint Buffer : m_Buffers) {
+            MemoryBudget::UntrackGlObject(GL_BUFFER, Buffer);
+        }
         glDeleteBuffers(NUM_VBs, m_Buffers);
+        std::fill(std::begin(m_Buffers), std::end(m_Buffers), 0);
     }
 
     if (m_VAO != 0) {
@@ -49,11 +74,10 @@ void StaticMesh::Clear()
     }
 }
 
-void StaticMesh::CalcBoundingBox()
+void StaticMesh::CalcBoundingBox(const MeshCache::View& View)
 {
-    mBbMin.x = mBbMin.y = mBbMin.z = 1e10f;
-    mBbMax.x = mBbMax.y = mBbMax.z = -1e10f;
-    CalcNodeBoundingBox(mScene->mRootNode, mBbMin, mBbMax);
+    mBbMin = View.BbMin;
+    mBbMax = View.BbMax;
 
     glm::vec3 diff = mBbMax - mBbMin;
     float w = std::max(diff.x, std::max(diff.y, diff.z));
@@ -61,185 +85,298 @@ void StaticMesh::CalcBoundingBox()
     mScale = glm::vec3(1.0f / w);
 }
 
-bool StaticMesh::LoadMesh(const std::string& filename)
+// Everything a load produces before it needs GL: owned by the load, shared with its upload jobs
+struct StaticMesh::Payload {
+    std::string Path;
+    MeshCache::Source Source;
+    VertexPacking::PackedVertices Packed;
+    std::vector<MeshLod::Entry> Lods;
+    TriangleBvh Bvh;
+    FrustumCulling::EntryBounds Bounds;
+    std::vector<ImageData> Images;
+};
+
+bool StaticMesh::ReadPayload(Payload& payload, ThreadPool& Pool)
 {
-    // Release the previously loaded mesh (if it exists)
-    Clear();
+    if (!payload.Source.Load(payload.Path, sImportFlags, false, &Pool)) {
+        return false;
+    }
 
-    // Create the VAO
-    glGenVertexArrays(1, &m_VAO);
-    glBindVertexArray(m_VAO);
+    VertexPacking::Layout Layout = sVertexLayout;
+    Layout.Weights = VertexPacking::WeightFormat::None;
+    MeshCache::PackVertices(payload.Source.GetView(), Layout, payload.Packed);
+    MeshLod::Build(payload.Source.GetView(), payload.Lods);
+    FrustumCulling::Build(payload.Source.GetView(), payload.Bounds);
+    payload.Bvh.Build(payload.Source.GetView(), glm::mat4(1.0f), &Pool);
 
-    // Create the buffers for the vertices attributes
-    glGenBuffers(NUM_VBs, m_Buffers);
+    return AssetLoader::DecodeMaterialTextures(payload.Source.GetView(), payload.Path, "\\", payload.Images, Pool);
+}
 
-    bool ret = false;
+bool StaticMesh::LoadMesh(const std::string& filename)
+{
+    // Release the previously loaded mesh (if it exists)
+    Clear();
 
     std::string fullPath = filename;
 
     std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
 
-    // aiProcessPreset_TargetRealtime_Quality includes aiProcess_LimitBoneWeights which restricts bones per vertex to 4
-    mScene = mImporter.ReadFile(fullPath.c_str(), aiProcessPreset_TargetRealtime_Quality | aiProcess_FlipUVs);
-
-    if (mScene) {
-        printf("Loading mesh %s\n", fullPath.c_str());
-        ret = InitFromScene(mScene, fullPath);
-        CalcBoundingBox();
-    } else {
-        printf("Error parsing '%s': '%s'\n", fullPath.c_str(), mImporter.GetErrorString());
+    Payload payload;
+    payload.Path = fullPath;
+    if (!ReadPayload(payload, AssetLoader::GetCpuStagePool(false))) {
+        return false;
     }
 
-    // Make sure the VAO is not changed from the outside
-    glBindVertexArray(0);
+    UploadGeometry(payload.Source.GetView(), payload.Packed);
+    for (unsigned int i = 0; i < payload.Images.size(); i++) {
+        UploadTexture(i, payload.Images[i]);
+        ReleaseImage(payload.Images[i]);
+    }
+    FinishLoad(payload);
+    CalcBoundingBox(payload.Source.GetView());
 
-    return ret;
+    return true;
 }
 
-bool StaticMesh::InitFromScene(const aiScene* pScene, const std::string& Filename)
+bool StaticMesh::LoadMeshAsync(const std::string& filename)
 {
-    m_Entries.resize(pScene->mNumMeshes);
-    m_Textures.resize(pScene->mNumMaterials);
+    Clear();
 
-    std::vector<aiVector3D> Positions;
-    std::vector<aiVector3D> Normals;
-    std::vector<aiVector2D> TexCoords;
-    std::vector<unsigned int> Indices;
+    auto payload = std::make_shared<Payload>();
+    payload->Path = filename;
+    std::replace(payload->Path.begin(), payload->Path.end(), '/', '\\');
 
-    unsigned int NumVertices = 0;
-    unsigned int NumIndices = 0;
+    // Upload jobs run on the render thread and check the token there, so a mesh that is
+    // cleared or destroyed before its load finishes just ignores the late uploads
+    mLoadToken = std::make_shared<int>(0);
+    std::weak_ptr<int> token = mLoadToken;
 
-    // Count the number of vertices and indices
-    for (unsigned int i = 0; i < m_Entries.size(); i++) {
-        m_Entries[i].MaterialIndex = pScene->mMeshes[i]->mMaterialIndex;
-        m_Entries[i].NumIndices = pScene->mMeshes[i]->mNumFaces * 3;
-        m_Entries[i].BaseVertex = NumVertices;
-        m_Entries[i].BaseIndex = NumIndices;
+    AssetLoader::Submit([this, payload, token]() {
+        // Loader thread: only the payload is touched here
+        if (!ReadPayload(*payload, AssetLoader::GetCpuStagePool(true))) {
+            return;
+        }
 
-        NumVertices += pScene->mMeshes[i]->mNumVertices;
-        NumIndices += m_Entries[i].NumIndices;
-    }
+        UploadQueue& queue = AssetLoader::GetUploadQueue();
+        const MeshCache::View& View = payload->Source.GetView();
 
-    // Reserve space in the vectors for the vertex attributes and indices
-    Positions.reserve(NumVertices);
-    Normals.reserve(NumVertices);
-    TexCoords.reserve(NumVertices);
-    Indices.reserve(NumIndices);
+        const size_t GeometryBytes = payload->Packed.Data.size() + sizeof(unsigned int) * View.Indices.Size;
+        queue.Push(GeometryBytes, [this, payload, token]() {
+            if (!token.expired()) {
+                UploadGeometry(payload->Source.GetView(), payload->Packed);
+            }
+        });
 
-    // Initialize the meshes in the scene one by one
-    for (unsigned int i = 0; i < m_Entries.size(); i++) {
-        const aiMesh* pMesh = pScene->mMeshes[i];
-        InitMesh(pMesh, Positions, Normals, TexCoords, Indices);
-    }
+        for (unsigned int i = 0; i < payload->Images.size(); i++) {
+            queue.Push(AssetLoader::GetImageBytes(payload->Images[i]), [this, payload, token, i]() {
+                if (!token.expired()) {
+                    UploadTexture(i, payload->Images[i]);
+                }
+                ReleaseImage(payload->Images[i]); // back to the staging pool right away
+            });
+        }
 
-    if (!InitMaterials(pScene, Filename)) {
-        return false;
-    }
+        queue.Push(0, [this, payload, token]() {
+            if (!token.expired()) {
+                FinishLoad(*payload);
+            }
+        });
+    });
 
-    // Generate and populate the buffers with vertex attributes and the indices
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::Pos);
-    glVertexAttribPointer(AttribLoc::Pos, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    return true;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::TexCoord);
-    glVertexAttribPointer(AttribLoc::TexCoord, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+void StaticMesh::UploadGeometry(const MeshCache::View& View, const VertexPacking::PackedVertices& Packed)
+{
+    // Create the VAO
+    glGenVertexArrays(1, &m_VAO);
+    glBindVertexArray(m_VAO);
+
+    // Create the buffers for the vertices attributes
+    glGenBuffers(NUM_VBs, m_Buffers);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::Normal);
-    glVertexAttribPointer(AttribLoc::Normal, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    // Upload the packed vertex stream, and the indices straight from the view
+    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VERTEX_VB]);
+    glBufferData(GL_ARRAY_BUFFER, Packed.Data.size(), Packed.Data.data(), GL_STATIC_DRAW);
+    VertexPacking::SetupAttributes(Packed.Format, AttribLoc::Pos, AttribLoc::TexCoord, AttribLoc::Normal);
+    mVertexLayout = Packed.Format;
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * View.Indices.Size, View.Indices.Data, GL_STATIC_DRAW);
+
+    // Entry i of an indirect draw has BaseInstance i: a divisor 1 attribute of 0, 1, 2, ...
+    // hands it to the shader, which looks its dequantization up in the storage buffer
+    std::vector<GLuint> DrawIds(View.Entries.Size);
+    std::vector<glm::vec4> DrawData(2 * View.Entries.Size);
+    for (unsigned int i = 0; i < View.Entries.Size; i++) {
+        DrawIds[i] = i;
+        DrawData[2 * i] = glm::vec4(Packed.Submeshes[i].Scale, 0.0f);
+        DrawData[2 * i + 1] = glm::vec4(Packed.Submeshes[i].Offset, 0.0f);
+    }
 
-    return true;
+    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[DRAW_ID_VB]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * DrawIds.size(), DrawIds.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(AttribLoc::DrawId);
+    glVertexAttribIPointer(AttribLoc::DrawId, 1, GL_UNSIGNED_INT, 0, nullptr);
+    glVertexAttribDivisor(AttribLoc::DrawId, 1);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffers[DRAW_DATA_SSBO]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * DrawData.size(), DrawData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[VERTEX_VB], Packed.Data.size(), "Meshes");
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[INDEX_BUFFER], sizeof(unsigned int) * View.Indices.Size, "Meshes");
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[DRAW_ID_VB], sizeof(GLuint) * DrawIds.size(), "Meshes");
+    MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[DRAW_DATA_SSBO], sizeof(glm::vec4) * DrawData.size(), "Meshes");
+
+    // Make sure the VAO is not changed from the outside
+    glBindVertexArray(0);
+
+    m_Textures.assign(View.Materials.Size, 0);
 }
 
-void StaticMesh::InitMesh(const aiMesh* pMesh,
-    std::vector<aiVector3D>& Positions,
-    std::vector<aiVector3D>& Normals,
-    std::vector<aiVector2D>& TexCoords,
-    std::vector<unsigned int>& Indices)
+void StaticMesh::UploadTexture(unsigned int Material, const ImageData& Image)
 {
-    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    if (Image.Valid()) {
+        m_Textures[Material] = CreateTexture2D(Image);
+    }
+}
 
-    // Populate the vertex attribute vectors
-    for (unsigned int i = 0; i < pMesh->mNumVertices; i++) {
-        const aiVector3D* pPos = &(pMesh->mVertices[i]);
-        const aiVector3D* pNormal = &(pMesh->mNormals[i]);
-        const aiVector3D* pTexCoord = pMesh->HasTextureCoords(0) ? &(pMesh->mTextureCoords[0][i]) : &Zero3D;
+void StaticMesh::FinishLoad(Payload& payload)
+{
+    const MeshCache::View& View = payload.Source.GetView();
 
-        Positions.push_back(*pPos);
-        Normals.push_back(*pNormal);
-        TexCoords.emplace_back(pTexCoord->x, pTexCoord->y);
+    // Entries are set last so nothing is drawn before every upload of the load has run
+    m_Entries.resize(View.Entries.Size);
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        m_Entries[i].MaterialIndex = View.Entries[i].MaterialIndex;
+        m_Entries[i].NumIndices = View.Entries[i].NumIndices;
+        m_Entries[i].BaseVertex = View.Entries[i].BaseVertex;
+        m_Entries[i].BaseIndex = View.Entries[i].BaseIndex;
+        m_Entries[i].Dequant = payload.Packed.Submeshes[i];
+        m_Entries[i].Lod = payload.Lods[i];
+        m_Entries[i].CurrentLod = 0;
     }
 
-    // Populate the index buffer
-    for (unsigned int i = 0; i < pMesh->mNumFaces; i++) {
-        const aiFace& Face = pMesh->mFaces[i];
-        assert(Face.mNumIndices == 3);
-        Indices.push_back(Face.mIndices[0]);
-        Indices.push_back(Face.mIndices[1]);
-        Indices.push_back(Face.mIndices[2]);
+    mBbMin = View.BbMin;
+    mBbMax = View.BbMax;
+    mBvh = std::move(payload.Bvh);
+    mBounds = std::move(payload.Bounds);
+    mLoaded = true;
+
+    // What stays on the CPU once the payload, and the source mesh with it, is gone
+    mCpuBytes = static_cast<int64_t>(mBvh.GetMemoryBytes() + mBounds.GetMemoryBytes()) + MemoryBudget::GetBytes(m_Entries);
+    for (const MeshEntry& Entry : m_Entries) {
+        mCpuBytes += MemoryBudget::GetBytes(Entry.Lod.Levels);
     }
+    MemoryBudget::Add("Meshes", MemoryBudget::Cpu, mCpuBytes);
 }
 
-bool StaticMesh::InitMaterials(const aiScene* pScene, const std::string& Filename)
+bool StaticMesh::Pick(const glm::mat4& M, const glm::vec3& Origin, const glm::vec3& Dir, float& Distance) const
 {
-    // Extract the directory part from the file name
-    std::string::size_type SlashIndex = Filename.find_last_of('\\');
-    std::string Dir;
-
-    if (SlashIndex == std::string::npos) {
-        Dir = ".";
-    } else if (SlashIndex == 0) {
-        Dir = "\\";
-    } else {
-        Dir = Filename.substr(0, SlashIndex);
+    // Intersect in model space, the ray parameter is the same in both spaces
+    const glm::mat4 InvM = glm::inverse(M);
+
+    TriangleBvh::Ray Ray;
+    Ray.Origin = glm::vec3(InvM * glm::vec4(Origin, 1.0f));
+    Ray.Dir = glm::vec3(InvM * glm::vec4(Dir, 0.0f));
+
+    TriangleBvh::Hit Hit;
+    if (!mBvh.Intersect(Ray, Hit)) {
+        return false;
     }
+    Distance = Hit.T;
+    return true;
+}
 
-    bool Ret = true;
+bool StaticMesh::IsOccluded(const glm::mat4& M, const glm::vec3& From, const glm::vec3& To) const
+{
+    const glm::mat4 InvM = glm::inverse(M);
+    return mBvh.Occluded({ glm::vec3(InvM * glm::vec4(From, 1.0f)), glm::vec3(InvM * glm::vec4(To, 1.0f)) });
+}
 
-    // Initialize the materials
-    for (unsigned int i = 0; i < pScene->mNumMaterials; i++) {
-        const aiMaterial* pMaterial = pScene->mMaterials[i];
+void StaticMesh::Render()
+{
+    // Once per frustum: both eyes of a stereo frame share the result
+    FrustumCulling::CullEntries(mBounds, mWorldMatrix, mVisible, mCullVersion);
 
-        m_Textures[i] = NULL;
+    // Entries are only set once every upload of a load has run
+    if (m_Entries.empty()) {
+        return;
+    }
 
-        aiColor4D color(0.f, 0.f, 0.f, 0.0f);
-        aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_DIFFUSE, &color);
+    if (sBatched) {
+        RenderBatched();
+    } else {
+        RenderEntries();
+    }
+}
 
-        if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-            aiString Path;
+void StaticMesh::RenderBatched()
+{
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Buffers[INDIRECT_BUFFER]);
+
+    // Commands and LOD levels follow the culling result, so the second eye reuses them too
+    if (!mBatchValid || mBatchVersion != mCullVersion) {
+        mDrawItems.clear();
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            if (!mVisible[i]) {
+                continue;
+            }
 
-            if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &Path, nullptr, nullptr, nullptr, nullptr, nullptr) == AI_SUCCESS) {
-                std::string p(Path.data);
+            MeshEntry& Entry = m_Entries[i];
+            assert(Entry.MaterialIndex < m_Textures.size());
 
-                if (p.substr(0, 2) == ".\\") {
-                    p = p.substr(2, p.size() - 2);
-                }
+            Entry.CurrentLod = MeshLod::Select(Entry.Lod, mWorldMatrix, Entry.CurrentLod);
+            const MeshLod::Level& Level = Entry.Lod.Levels[Entry.CurrentLod];
+            mDrawItems.push_back({ Entry.MaterialIndex, Level.NumIndices, Level.BaseIndex, static_cast<int>(Entry.BaseVertex), i });
+        }
+        DrawBatch::Build(mDrawItems.data(), mDrawItems.size(), mDrawList);
+
+        // Orphan last frame's commands rather than wait for the GPU to be done with them
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawBatch::DrawElementsIndirectCommand) * mDrawList.Commands.size(),
+            mDrawList.Commands.data(), GL_STREAM_DRAW);
+        MemoryBudget::TrackGlObject(GL_BUFFER, m_Buffers[INDIRECT_BUFFER], sizeof(DrawBatch::DrawElementsIndirectCommand) * mDrawList.Commands.size(), "Meshes");
+        mBatchVersion = mCullVersion;
+        mBatchValid = true;
+    }
 
-                std::string FullPath = Dir + "\\" + p;
+    SetNormalFormat(mVertexLayout);
+    glUniform1i(UniformLoc::PerDrawDequant, 1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, m_Buffers[DRAW_DATA_SSBO]);
 
-                m_Textures[i] = LoadTexture(FullPath);
-                if (m_Textures[i] == -1) {
-                    Ret = false;
-                }
-            }
+    for (const DrawBatch::Group& Group : mDrawList.Groups) {
+        if (m_Textures[Group.Material]) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, m_Textures[Group.Material]);
         }
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES,
+            GL_UNSIGNED_INT,
+            (void*)(sizeof(DrawBatch::DrawElementsIndirectCommand) * Group.FirstCommand),
+            Group.NumCommands,
+            0);
     }
+    FrustumCulling::AddDrawnTriangles(mDrawList.GetNumIndices() / 3);
+
+    glUniform1i(UniformLoc::PerDrawDequant, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 
-    return Ret;
+    // Make sure the VAO is not changed from the outside
+    glBindVertexArray(0);
 }
 
-void StaticMesh::Render()
+void StaticMesh::RenderEntries()
 {
     glBindVertexArray(m_VAO);
+    SetNormalFormat(mVertexLayout);
 
     for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        if (!mVisible[i]) {
+            continue;
+        }
+
         const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
 
         assert(MaterialIndex < m_Textures.size());
@@ -249,10 +386,16 @@ void StaticMesh::Render()
             glBindTexture(GL_TEXTURE_2D, m_Textures[MaterialIndex]);
         }
 
+        // Coarser levels index the same vertex range, only the index list changes
+        m_Entries[i].CurrentLod = MeshLod::Select(m_Entries[i].Lod, mWorldMatrix, m_Entries[i].CurrentLod);
+        const MeshLod::Level& Level = m_Entries[i].Lod.Levels[m_Entries[i].CurrentLod];
+
+        SetDequant(m_Entries[i].Dequant);
+        FrustumCulling::AddDrawnTriangles(Level.NumIndices / 3);
         glDrawElementsBaseVertex(GL_TRIANGLES,
-            m_Entries[i].NumIndices,
+            Level.NumIndices,
             GL_UNSIGNED_INT,
-            (void*)(sizeof(unsigned int) * m_Entries[i].BaseIndex),
+            (void*)(sizeof(unsigned int) * Level.BaseIndex),
             m_Entries[i].BaseVertex);
     }
 
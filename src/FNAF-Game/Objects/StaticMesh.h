@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <vector>
 #include <cassert>
 #include <GL/glew.h>
@@ -12,6 +13,12 @@
 #include <assimp/matrix3x3.h>
 #include <assimp/matrix4x4.h>
 #include "MeshBase.h"
+#include "MeshCache.h"
+#include "DrawBatch.h"
+#include "FrustumCulling.h"
+#include "MeshLod.h"
+#include "TriangleBvh.h"
+#include "LoadTexture.h"
 
 // Shaders
 static const std::string skinned_vertex_shader("static_mesh.vert");
@@ -29,41 +36,63 @@ public:
         M = 1,
         EyeW = 2,
         Shininess = 3,
+        PerDrawDequant = 4,
     };
 
     enum AttribLoc : unsigned int {
         Pos = 0,
         TexCoord = 1,
         Normal = 2,
+        DrawId = 3, // instanced, carries the BaseInstance of indirect draws
     };
 
+    // Storage buffer of the per-entry dequantization, read with DrawId
+    static constexpr GLuint DrawDataBinding = 0;
+
+    // Submit visible entries as one glMultiDrawElementsIndirect per material instead of one
+    // draw per entry
+    static inline bool sBatched = true;
+
     StaticMesh();
     ~StaticMesh();
 
     bool LoadMesh(const std::string& filename) override;
+    bool LoadMeshAsync(const std::string& filename) override;
 
     void Update(float deltaSeconds) override {};
     void Render() override;
 
     [[nodiscard]] static Shader* sShader() { return mShader; }
 
+    // Model space BVH over the full detail triangles, empty until loaded
+    [[nodiscard]] const TriangleBvh& GetBvh() const { return mBvh; }
+    // Closest hit of a world-space ray, M is the model matrix used to draw the mesh
+    bool Pick(const glm::mat4& M, const glm::vec3& Origin, const glm::vec3& Dir, float& Distance) const;
+    // Whether the mesh blocks the world-space segment between From and To
+    [[nodiscard]] bool IsOccluded(const glm::mat4& M, const glm::vec3& From, const glm::vec3& To) const;
+
 private:
-    bool InitFromScene(const aiScene* pScene, const std::string& Filename);
-    void InitMesh(const aiMesh* paiMesh,
-        std::vector<aiVector3D>& Positions,
-        std::vector<aiVector3D>& Normals,
-        std::vector<aiVector2D>& TexCoords,
-        std::vector<unsigned int>& Indices);
-    bool InitMaterials(const aiScene* pScene, const std::string& Filename);
+    struct Payload;
+
+    // CPU stage, safe on any thread. Pool is AssetLoader::GetCpuStagePool().
+    static bool ReadPayload(Payload& payload, ThreadPool& Pool);
+    // GL stages, render thread only
+    void UploadGeometry(const MeshCache::View& View, const VertexPacking::PackedVertices& Packed);
+    void UploadTexture(unsigned int Material, const ImageData& Image);
+    void FinishLoad(Payload& payload);
     void Clear();
 
+    void RenderBatched();
+    void RenderEntries();
+
 #define INVALID_MATERIAL 0xFFFFFFFF
 
     enum VB_TYPES : unsigned int {
         INDEX_BUFFER,
-        POS_VB,
-        NORMAL_VB,
-        TEXCOORD_VB,
+        VERTEX_VB,
+        DRAW_ID_VB,
+        DRAW_DATA_SSBO,
+        INDIRECT_BUFFER,
         NUM_VBs
     };
 
@@ -83,12 +112,34 @@ private:
         unsigned int BaseVertex;
         unsigned int BaseIndex;
         unsigned int MaterialIndex;
+        VertexPacking::Dequant Dequant;
+        MeshLod::Entry Lod;
+        unsigned int CurrentLod = 0;
     };
 
     std::vector<MeshEntry> m_Entries;
-    std::vector<GLuint> m_Textures { INVALID_MATERIAL };
+    std::vector<GLuint> m_Textures;
+    VertexPacking::Layout mVertexLayout;
+    TriangleBvh mBvh;
+
+    // Model space entry boxes, and which entries the frame's frustum keeps
+    FrustumCulling::EntryBounds mBounds;
+    std::vector<uint8_t> mVisible;
+    unsigned int mCullVersion = 0;
+
+    // Indirect commands of the visible entries, rebuilt when the culling result changes
+    std::vector<DrawBatch::DrawItem> mDrawItems;
+    DrawBatch::DrawList mDrawList;
+    unsigned int mBatchVersion = 0;
+    bool mBatchValid = false;
+
+    // CPU bytes reported to the MemoryBudget by FinishLoad
+    int64_t mCpuBytes = 0;
+
+    // Reset to orphan the uploads of an async load still in flight
+    std::shared_ptr<int> mLoadToken;
 
-    void CalcBoundingBox();
+    void CalcBoundingBox(const MeshCache::View& View);
 
 #undef INVALID_MATERIAL
 };
@@ -8,12 +8,17 @@
 //  Use layout qualifiers for attribs and uniforms
 //  Eliminate SetBoneTransform() - send all matrices in one glUniform call
 //  Pass strings by reference
+//  Positions only, quantized to MeshBase::sVertexLayout
+//  Free the Assimp scene once uploaded
+//  Import through MeshImporter, LoadImported uploads a scene imported elsewhere
+//  Read glTF files with GltfLoader, Assimp only for other formats
 
 #include <cassert>
 
 #include "Shader.h"
 
 #include "TitleMesh.h"
+#include "GltfLoader.h"
 
 Shader* TitleMesh::mShader = nullptr;
 
@@ -42,19 +47,55 @@ void TitleMesh::Clear()
     }
 }
 
-void TitleMesh::CalcBoundingBox()
+void TitleMesh::CalcBoundingBox(const aiScene* pScene)
 {
     mBbMin.x = mBbMin.y = mBbMin.z = 1e10f;
     mBbMax.x = mBbMax.y = mBbMax.z = -1e10f;
-    CalcNodeBoundingBox(mScene->mRootNode, mBbMin, mBbMax);
+    CalcNodeBoundingBox(pScene, pScene->mRootNode, mBbMin, mBbMax);
+    SetScaleFromBounds();
+}
 
+void TitleMesh::SetScaleFromBounds()
+{
     glm::vec3 diff = mBbMax - mBbMin;
     float w = std::max(diff.x, std::max(diff.y, diff.z));
 
     mScale = glm::vec3(1.0f / w);
 }
 
+std::string TitleMesh::GetImportPath(const std::string& filename)
+{
+    std::string fullPath = filename;
+    std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
+    return fullPath;
+}
+
+void TitleMesh::Import(const std::string& filename, ImportedMesh& out)
+{
+    const std::string fullPath = GetImportPath(filename);
+    if (GltfLoader::IsGltf(fullPath)) {
+        std::string error;
+        const GltfLoader::Result result = GltfLoader::Load(fullPath, false, out.Data, error);
+        if (result == GltfLoader::Result::Loaded) {
+            return;
+        }
+        if (result == GltfLoader::Result::Invalid) {
+            out.Scene.mError = error; // reported by LoadImported
+            return;
+        }
+        printf("glTF loader can't read '%s' (%s), using Assimp\n", fullPath.c_str(), error.c_str());
+    }
+    out.Scene = MeshImporter::Get().Import(fullPath, ImportFlags);
+}
+
 bool TitleMesh::LoadMesh(const std::string& filename)
+{
+    ImportedMesh Imported;
+    Import(filename, Imported);
+    return LoadImported(filename, Imported);
+}
+
+bool TitleMesh::LoadImported(const std::string& filename, const ImportedMesh& Imported)
 {
     // Release the previously loaded mesh (if it exists)
     Clear();
@@ -68,24 +109,24 @@ bool TitleMesh::LoadMesh(const std::string& filename)
 
     bool ret = false;
 
-    std::string fullPath = filename;
-
-    std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
+    std::string fullPath = GetImportPath(filename);
 
-    // aiProcessPreset_TargetRealtime_Quality includes aiProcess_LimitBoneWeights which restricts bones per vertex to 4
-    mScene = mImporter.ReadFile(fullPath.c_str(), aiProcessPreset_TargetRealtime_Quality | aiProcess_FlipUVs);
-
-    if (mScene) {
+    // The imported data is freed by the caller, only the GPU copy stays
+    if (Imported.Scene.Valid()) {
         printf("Loading mesh %s\n", fullPath.c_str());
-        ret = InitFromScene(mScene, fullPath);
-        CalcBoundingBox();
+        ret = InitFromScene(Imported.Scene.mScene.get(), fullPath);
+        CalcBoundingBox(Imported.Scene.mScene.get());
+    } else if (!Imported.Data.Entries.empty()) {
+        printf("Loading mesh %s (glTF)\n", fullPath.c_str());
+        ret = InitFromData(Imported.Data);
     } else {
-        printf("Error parsing '%s': '%s'\n", fullPath.c_str(), mImporter.GetErrorString());
+        printf("Error parsing '%s': '%s'\n", fullPath.c_str(), Imported.Scene.mError.c_str());
     }
 
     // Make sure the VAO is not changed from the outside
     glBindVertexArray(0);
 
+    mLoaded = ret;
     return ret;
 }
 
@@ -123,16 +164,69 @@ bool TitleMesh::InitFromScene(const aiScene* pScene, const std::string& Filename
         InitMesh(pMesh, Positions, Indices);
     }
 
+    std::vector<unsigned int> NumEntryVertices(m_Entries.size());
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        NumEntryVertices[i] = pScene->mMeshes[i]->mNumVertices;
+    }
+    Upload(Positions, Indices, NumEntryVertices);
+    return true;
+}
+
+bool TitleMesh::InitFromData(const MeshCache::Data& Data)
+{
+    m_Entries.resize(Data.Entries.size());
+
+    std::vector<aiVector3D> Positions(Data.Vertices.size());
+    for (size_t i = 0; i < Data.Vertices.size(); i++) {
+        Positions[i] = Data.Vertices[i].Pos;
+    }
+
+    std::vector<unsigned int> NumEntryVertices(m_Entries.size());
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        m_Entries[i].NumIndices = Data.Entries[i].NumIndices;
+        m_Entries[i].BaseVertex = Data.Entries[i].BaseVertex;
+        m_Entries[i].BaseIndex = Data.Entries[i].BaseIndex;
+
+        // Entries are laid out back to back, each one runs up to the next BaseVertex
+        const size_t End = i + 1 < m_Entries.size() ? Data.Entries[i + 1].BaseVertex : Data.Vertices.size();
+        NumEntryVertices[i] = static_cast<unsigned int>(End - Data.Entries[i].BaseVertex);
+    }
+    Upload(Positions, Data.Indices, NumEntryVertices);
+
+    mBbMin = Data.BbMin;
+    mBbMax = Data.BbMax;
+    SetScaleFromBounds();
+    return true;
+}
+
+void TitleMesh::Upload(const std::vector<aiVector3D>& Positions, const std::vector<unsigned int>& Indices,
+    const std::vector<unsigned int>& NumEntryVertices)
+{
+    VertexPacking::Layout Layout;
+    Layout.Position = sVertexLayout.Position;
+    Layout.Normal = VertexPacking::NormalFormat::None;
+    Layout.TexCoord = VertexPacking::TexCoordFormat::None;
+
+    std::vector<VertexPacking::Submesh> Submeshes(m_Entries.size());
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        Submeshes[i] = { m_Entries[i].BaseVertex, NumEntryVertices[i] };
+    }
+
+    VertexPacking::Streams Streams;
+    Streams.Positions = { Positions.data(), sizeof(aiVector3D) };
+    VertexPacking::PackedVertices Packed;
+    VertexPacking::Pack(Streams, Positions.size(), Submeshes, Layout, Packed);
+    for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        m_Entries[i].Dequant = Packed.Submeshes[i];
+    }
+
     // Generate and populate the buffers with vertex attributes and the indices
     glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(AttribLoc::Pos);
-    glVertexAttribPointer(AttribLoc::Pos, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBufferData(GL_ARRAY_BUFFER, Packed.Data.size(), Packed.Data.data(), GL_STATIC_DRAW);
+    VertexPacking::SetupAttributes(Packed.Format, AttribLoc::Pos);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
-
-    return true;
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), Indices.data(), GL_STATIC_DRAW);
 }
 
 void TitleMesh::InitMesh(const aiMesh* pMesh,
@@ -165,6 +259,7 @@ void TitleMesh::Render()
     glBindVertexArray(m_VAO);
 
     for (unsigned int i = 0; i < m_Entries.size(); i++) {
+        SetDequant(m_Entries[i].Dequant);
         glDrawElementsBaseVertex(GL_TRIANGLES,
             m_Entries[i].NumIndices,
             GL_UNSIGNED_INT,
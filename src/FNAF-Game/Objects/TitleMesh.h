@@ -12,6 +12,8 @@
 #include <assimp/matrix3x3.h>
 #include <assimp/matrix4x4.h>
 #include "MeshBase.h"
+#include "MeshCache.h"
+#include "MeshImporter.h"
 
 // Shaders
 static const std::string title_vertex_shader("title_mesh.vert");
@@ -37,7 +39,23 @@ public:
     TitleMesh();
     ~TitleMesh() override;
 
+    // aiProcessPreset_TargetRealtime_Quality includes aiProcess_LimitBoneWeights which restricts bones per vertex to 4
+    static constexpr unsigned int ImportFlags = aiProcessPreset_TargetRealtime_Quality | aiProcess_FlipUVs;
+
+    // CPU side of a load: glTF files are read natively into Data, other formats imported into Scene
+    struct ImportedMesh {
+        MeshCache::Data Data;
+        MeshImporter::Result Scene;
+    };
+
+    // Any thread, no GL
+    static void Import(const std::string& filename, ImportedMesh& out);
+
     bool LoadMesh(const std::string& filename) override;
+    // Uploads what Import(filename) produced, on the GL thread
+    bool LoadImported(const std::string& filename, const ImportedMesh& Imported);
+
+    [[nodiscard]] static std::string GetImportPath(const std::string& filename);
 
     void Update(float deltaSeconds) override {};
     void Render() override;
@@ -46,6 +64,9 @@ public:
 
 private:
     bool InitFromScene(const aiScene* pScene, const std::string& Filename);
+    bool InitFromData(const MeshCache::Data& Data);
+    void Upload(const std::vector<aiVector3D>& Positions, const std::vector<unsigned int>& Indices,
+        const std::vector<unsigned int>& NumEntryVertices);
     void InitMesh(const aiMesh* paiMesh,
         std::vector<aiVector3D>& Positions,
         std::vector<unsigned int>& Indices);
@@ -71,11 +92,13 @@ private:
         unsigned int NumIndices;
         unsigned int BaseVertex;
         unsigned int BaseIndex;
+        VertexPacking::Dequant Dequant;
     };
 
     std::vector<MeshEntry> m_Entries;
 
-    void CalcBoundingBox();
+    void CalcBoundingBox(const aiScene* pScene);
+    void SetScaleFromBounds();
 
 #undef INVALID_MATERIAL
 };
@@ -0,0 +1,768 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define TRIANGLE_BVH_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr unsigned int NumBins = 16;
+constexpr unsigned int MaxLeafTriangles = 8;
+// Below this depth SAH gives way to median splits, which bounds the depth and the traversal stacks
+constexpr unsigned int MaxSahDepth = 48;
+constexpr unsigned int ParallelMinTriangles = 8192;
+constexpr float TraversalCost = 1.0f; // relative to testing one pack of four triangles
+constexpr size_t BatchChunk = 64;
+constexpr unsigned int StackSize = 256;
+
+struct Bounds {
+    glm::vec3 Min = glm::vec3(FLT_MAX);
+    glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+    void Grow(const glm::vec3& p)
+    {
+        Min = glm::min(Min, p);
+        Max = glm::max(Max, p);
+    }
+
+    void Grow(const Bounds& b)
+    {
+        Min = glm::min(Min, b.Min);
+        Max = glm::max(Max, b.Max);
+    }
+
+    [[nodiscard]] float HalfArea() const
+    {
+        const glm::vec3 d = Max - Min;
+        return d.x < 0.0f ? 0.0f : d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+unsigned int NumPacks(unsigned int NumTriangles)
+{
+    return (NumTriangles + 3) / 4;
+}
+
+struct RayData {
+    glm::vec3 Origin;
+    glm::vec3 Dir;
+    glm::vec3 InvDir;
+
+    RayData(const glm::vec3& O, const glm::vec3& D) : Origin(O), Dir(D)
+    {
+        // Keep the slab distances finite for axis aligned rays
+        for (int a = 0; a < 3; a++) {
+            const float d = std::abs(D[a]) > 1e-20f ? D[a] : std::copysign(1e-20f, D[a]);
+            InvDir[a] = 1.0f / d;
+        }
+    }
+};
+
+glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& ab, const glm::vec3& ac)
+{
+    // Ericson, Real-Time Collision Detection 5.1.5
+    const glm::vec3 ap = p - a;
+    const float d1 = glm::dot(ab, ap);
+    const float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+
+    const glm::vec3 bp = ap - ab;
+    const float d3 = glm::dot(ab, bp);
+    const float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return a + ab;
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const glm::vec3 cp = ap - ac;
+    const float d5 = glm::dot(ab, cp);
+    const float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return a + ac;
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+}
+
+// Binned SAH builder over a binary tree, collapsed into 4-wide nodes afterwards
+struct TriangleBvh::Builder {
+    struct BinaryNode {
+        Bounds Box;
+        unsigned int Left = 0; // Right is Left + 1
+        unsigned int First = 0; // leaf range in Refs when Count > 0
+        unsigned int Count = 0;
+    };
+
+    std::vector<Bounds> TriangleBounds;
+    std::vector<glm::vec3> Centroids;
+    std::vector<unsigned int> Refs;
+    std::vector<BinaryNode> Nodes; // sized for the worst case, so threads never reallocate it
+    std::atomic<unsigned int> NumNodes = 0;
+
+    ThreadPool* pPool = nullptr;
+    TaskGroup Group;
+
+    unsigned int BinOf(float c, float Min, float Scale) const
+    {
+        return std::min(NumBins - 1, static_cast<unsigned int>((c - Min) * Scale));
+    }
+
+    void Split(unsigned int NodeIndex, unsigned int Begin, unsigned int End, unsigned int Depth)
+    {
+        BinaryNode& Current = Nodes[NodeIndex];
+        const unsigned int Count = End - Begin;
+
+        Bounds CentroidBox;
+        for (unsigned int i = Begin; i < End; i++) {
+            Current.Box.Grow(TriangleBounds[Refs[i]]);
+            CentroidBox.Grow(Centroids[Refs[i]]);
+        }
+
+        if (Count == 1) {
+            Current.First = Begin;
+            Current.Count = Count;
+            return;
+        }
+
+        const glm::vec3 Extent = CentroidBox.Max - CentroidBox.Min;
+        float BestCost = FLT_MAX;
+        int BestAxis = -1;
+        unsigned int BestBin = 0;
+
+        for (int Axis = 0; Axis < 3 && Depth < MaxSahDepth; Axis++) {
+            if (!(Extent[Axis] > 0.0f)) {
+                continue;
+            }
+
+            struct Bin {
+                Bounds Box;
+                unsigned int Count = 0;
+            } Bins[NumBins];
+
+            const float Scale = static_cast<float>(NumBins) / Extent[Axis];
+            for (unsigned int i = Begin; i < End; i++) {
+                Bin& b = Bins[BinOf(Centroids[Refs[i]][Axis], CentroidBox.Min[Axis], Scale)];
+                b.Box.Grow(TriangleBounds[Refs[i]]);
+                b.Count++;
+            }
+
+            // Sweep from the right for the right hand side of every split plane, then from the left
+            float RightArea[NumBins];
+            unsigned int RightCount[NumBins];
+            Bounds Side;
+            unsigned int SideCount = 0;
+            for (unsigned int b = NumBins - 1; b > 0; b--) {
+                Side.Grow(Bins[b].Box);
+                SideCount += Bins[b].Count;
+                RightArea[b] = Side.HalfArea();
+                RightCount[b] = SideCount;
+            }
+
+            Side = Bounds();
+            SideCount = 0;
+            for (unsigned int b = 0; b + 1 < NumBins; b++) {
+                Side.Grow(Bins[b].Box);
+                SideCount += Bins[b].Count;
+                if (SideCount == 0 || RightCount[b + 1] == 0) {
+                    continue;
+                }
+
+                const float Cost = Side.HalfArea() * NumPacks(SideCount) + RightArea[b + 1] * NumPacks(RightCount[b + 1]);
+                if (Cost < BestCost) {
+                    BestCost = Cost;
+                    BestAxis = Axis;
+                    BestBin = b + 1;
+                }
+            }
+        }
+
+        const float NodeArea = Current.Box.HalfArea();
+        const float LeafCost = NodeArea * NumPacks(Count);
+        if (Count <= MaxLeafTriangles && (BestAxis < 0 || NodeArea * TraversalCost + BestCost >= LeafCost)) {
+            Current.First = Begin;
+            Current.Count = Count;
+            return;
+        }
+
+        unsigned int Mid;
+        if (BestAxis >= 0) {
+            const float Min = CentroidBox.Min[BestAxis];
+            const float Scale = static_cast<float>(NumBins) / Extent[BestAxis];
+            Mid = static_cast<unsigned int>(std::partition(Refs.begin() + Begin, Refs.begin() + End, [&](unsigned int t) {
+                return BinOf(Centroids[t][BestAxis], Min, Scale) < BestBin;
+            }) - Refs.begin());
+        } else {
+            // Too deep for SAH, or every centroid in one place: halve along the widest axis
+            const int Axis = Extent.x >= Extent.y && Extent.x >= Extent.z ? 0 : (Extent.y >= Extent.z ? 1 : 2);
+            Mid = Begin + Count / 2;
+            std::nth_element(Refs.begin() + Begin, Refs.begin() + Mid, Refs.begin() + End, [&](unsigned int a, unsigned int b) {
+                return Centroids[a][Axis] < Centroids[b][Axis] || (Centroids[a][Axis] == Centroids[b][Axis] && a < b);
+            });
+        }
+
+        const unsigned int Left = NumNodes.fetch_add(2, std::memory_order_relaxed);
+        Current.Left = Left;
+
+        if (pPool && Count >= ParallelMinTriangles) {
+            pPool->Submit([this, Left, Begin, Mid, Depth]() { Split(Left, Begin, Mid, Depth + 1); }, &Group);
+        } else {
+            Split(Left, Begin, Mid, Depth + 1);
+        }
+        Split(Left + 1, Mid, End, Depth + 1);
+    }
+
+    // Emit the 4-wide node for binary node Index: open the largest inner children until four are collected
+    unsigned int Flatten(TriangleBvh& Bvh, const std::vector<glm::vec3>& Corners, unsigned int Index) const
+    {
+        unsigned int Children[4];
+        unsigned int NumChildren = 0;
+        if (Nodes[Index].Count > 0) {
+            Children[NumChildren++] = Index;
+        } else {
+            Children[NumChildren++] = Nodes[Index].Left;
+            Children[NumChildren++] = Nodes[Index].Left + 1;
+        }
+
+        while (NumChildren < 4) {
+            int Open = -1;
+            float OpenArea = -1.0f;
+            for (unsigned int i = 0; i < NumChildren; i++) {
+                const BinaryNode& Child = Nodes[Children[i]];
+                if (Child.Count == 0 && Child.Box.HalfArea() > OpenArea) {
+                    OpenArea = Child.Box.HalfArea();
+                    Open = static_cast<int>(i);
+                }
+            }
+            if (Open < 0) {
+                break;
+            }
+            const unsigned int Left = Nodes[Children[Open]].Left;
+            Children[Open] = Left;
+            Children[NumChildren++] = Left + 1;
+        }
+
+        const auto NodeIndex = static_cast<unsigned int>(Bvh.mNodes.size());
+        Bvh.mNodes.emplace_back();
+        {
+            Node& Out = Bvh.mNodes.back();
+            for (unsigned int i = 0; i < 4; i++) {
+                const Bounds& Box = i < NumChildren ? Nodes[Children[i]].Box : Bounds { glm::vec3(0.0f), glm::vec3(0.0f) };
+                Out.MinX[i] = Box.Min.x;
+                Out.MinY[i] = Box.Min.y;
+                Out.MinZ[i] = Box.Min.z;
+                Out.MaxX[i] = Box.Max.x;
+                Out.MaxY[i] = Box.Max.y;
+                Out.MaxZ[i] = Box.Max.z;
+                Out.Child[i] = InvalidNode;
+                Out.Count[i] = 0;
+            }
+        }
+
+        // mNodes grows while recursing, so the node is addressed by index from here on
+        for (unsigned int i = 0; i < NumChildren; i++) {
+            const BinaryNode& Child = Nodes[Children[i]];
+            if (Child.Count == 0) {
+                const unsigned int ChildIndex = Flatten(Bvh, Corners, Children[i]);
+                Bvh.mNodes[NodeIndex].Child[i] = ChildIndex;
+                continue;
+            }
+
+            Bvh.mNodes[NodeIndex].Child[i] = static_cast<uint32_t>(Bvh.mPacks.size());
+            Bvh.mNodes[NodeIndex].Count[i] = NumPacks(Child.Count);
+
+            for (unsigned int First = 0; First < Child.Count; First += 4) {
+                TrianglePack& Pack = Bvh.mPacks.emplace_back();
+                for (unsigned int Lane = 0; Lane < 4; Lane++) {
+                    glm::vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+                    uint32_t Id = InvalidTriangle;
+                    if (First + Lane < Child.Count) {
+                        Id = Refs[Child.First + First + Lane];
+                        v0 = Corners[3 * Id + 0];
+                        e1 = Corners[3 * Id + 1] - v0;
+                        e2 = Corners[3 * Id + 2] - v0;
+                    }
+                    Pack.V0X[Lane] = v0.x;
+                    Pack.V0Y[Lane] = v0.y;
+                    Pack.V0Z[Lane] = v0.z;
+                    Pack.E1X[Lane] = e1.x;
+                    Pack.E1Y[Lane] = e1.y;
+                    Pack.E1Z[Lane] = e1.z;
+                    Pack.E2X[Lane] = e2.x;
+                    Pack.E2Y[Lane] = e2.y;
+                    Pack.E2Z[Lane] = e2.z;
+                    Pack.Id[Lane] = Id;
+                }
+            }
+        }
+
+        return NodeIndex;
+    }
+};
+
+// Four-wide tests. Each returns a bit mask of the lanes that pass.
+struct TriangleBvh::Traversal {
+    // Slab test of the four child boxes against (0, MaxT), entry distances to pNear
+    static unsigned int IntersectBoxes(const Node& N, const RayData& R, float MaxT, float* pNear)
+    {
+#ifdef TRIANGLE_BVH_SSE
+        __m128 Near = _mm_setzero_ps();
+        __m128 Far = _mm_set1_ps(MaxT);
+
+        const float* pMin[3] = { N.MinX, N.MinY, N.MinZ };
+        const float* pMax[3] = { N.MaxX, N.MaxY, N.MaxZ };
+        for (int a = 0; a < 3; a++) {
+            const __m128 o = _mm_set1_ps(R.Origin[a]);
+            const __m128 inv = _mm_set1_ps(R.InvDir[a]);
+            const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(pMin[a]), o), inv);
+            const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(pMax[a]), o), inv);
+            Near = _mm_max_ps(Near, _mm_min_ps(t0, t1));
+            Far = _mm_min_ps(Far, _mm_max_ps(t0, t1));
+        }
+
+        _mm_storeu_ps(pNear, Near);
+        return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(Near, Far)));
+#else
+        unsigned int Mask = 0;
+        for (int i = 0; i < 4; i++) {
+            const float Min[3] = { N.MinX[i], N.MinY[i], N.MinZ[i] };
+            const float Max[3] = { N.MaxX[i], N.MaxY[i], N.MaxZ[i] };
+            float Near = 0.0f;
+            float Far = MaxT;
+            for (int a = 0; a < 3; a++) {
+                const float t0 = (Min[a] - R.Origin[a]) * R.InvDir[a];
+                const float t1 = (Max[a] - R.Origin[a]) * R.InvDir[a];
+                Near = std::max(Near, std::min(t0, t1));
+                Far = std::min(Far, std::max(t0, t1));
+            }
+            pNear[i] = Near;
+            Mask |= Near <= Far ? 1u << i : 0u;
+        }
+        return Mask;
+#endif
+    }
+
+    // Moller-Trumbore on four triangles, hits within (0, MaxT), two-sided
+    static unsigned int IntersectPack(const TrianglePack& P, const RayData& R, float MaxT, float* pT, float* pU, float* pV)
+    {
+#ifdef TRIANGLE_BVH_SSE
+        const __m128 dx = _mm_set1_ps(R.Dir.x);
+        const __m128 dy = _mm_set1_ps(R.Dir.y);
+        const __m128 dz = _mm_set1_ps(R.Dir.z);
+        const __m128 e1x = _mm_load_ps(P.E1X);
+        const __m128 e1y = _mm_load_ps(P.E1Y);
+        const __m128 e1z = _mm_load_ps(P.E1Z);
+        const __m128 e2x = _mm_load_ps(P.E2X);
+        const __m128 e2y = _mm_load_ps(P.E2Y);
+        const __m128 e2z = _mm_load_ps(P.E2Z);
+
+        // p = Dir x e2, det = e1 . p
+        const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        // s = Origin - v0, u = (s . p) / det
+        const __m128 sx = _mm_sub_ps(_mm_set1_ps(R.Origin.x), _mm_load_ps(P.V0X));
+        const __m128 sy = _mm_sub_ps(_mm_set1_ps(R.Origin.y), _mm_load_ps(P.V0Y));
+        const __m128 sz = _mm_sub_ps(_mm_set1_ps(R.Origin.z), _mm_load_ps(P.V0Z));
+        const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+        // q = s x e1, v = (Dir . q) / det, t = (e2 . q) / det
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+        const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+        // Degenerate lanes give det == 0 and NaN or infinite u, v, t, which every compare rejects
+        const __m128 Zero = _mm_setzero_ps();
+        __m128 Mask = _mm_cmpneq_ps(det, Zero);
+        Mask = _mm_and_ps(Mask, _mm_cmpge_ps(u, Zero));
+        Mask = _mm_and_ps(Mask, _mm_cmpge_ps(v, Zero));
+        Mask = _mm_and_ps(Mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+        Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(t, Zero));
+        Mask = _mm_and_ps(Mask, _mm_cmplt_ps(t, _mm_set1_ps(MaxT)));
+
+        _mm_storeu_ps(pT, t);
+        _mm_storeu_ps(pU, u);
+        _mm_storeu_ps(pV, v);
+        return static_cast<unsigned int>(_mm_movemask_ps(Mask));
+#else
+        unsigned int Mask = 0;
+        for (int i = 0; i < 4; i++) {
+            const glm::vec3 e1(P.E1X[i], P.E1Y[i], P.E1Z[i]);
+            const glm::vec3 e2(P.E2X[i], P.E2Y[i], P.E2Z[i]);
+            const glm::vec3 p = glm::cross(R.Dir, e2);
+            const float det = glm::dot(e1, p);
+            if (det == 0.0f) {
+                continue;
+            }
+
+            const float inv = 1.0f / det;
+            const glm::vec3 s = R.Origin - glm::vec3(P.V0X[i], P.V0Y[i], P.V0Z[i]);
+            const glm::vec3 q = glm::cross(s, e1);
+            pU[i] = glm::dot(s, p) * inv;
+            pV[i] = glm::dot(R.Dir, q) * inv;
+            pT[i] = glm::dot(e2, q) * inv;
+            if (pU[i] >= 0.0f && pV[i] >= 0.0f && pU[i] + pV[i] <= 1.0f && pT[i] > 0.0f && pT[i] < MaxT) {
+                Mask |= 1u << i;
+            }
+        }
+        return Mask;
+#endif
+    }
+
+    // Squared distance from the sphere center to each child box, compared with the squared radius
+    static unsigned int OverlapBoxes(const Node& N, const Sphere& S)
+    {
+#ifdef TRIANGLE_BVH_SSE
+        const float* pMin[3] = { N.MinX, N.MinY, N.MinZ };
+        const float* pMax[3] = { N.MaxX, N.MaxY, N.MaxZ };
+        __m128 Dist2 = _mm_setzero_ps();
+        for (int a = 0; a < 3; a++) {
+            const __m128 c = _mm_set1_ps(S.Center[a]);
+            const __m128 d = _mm_max_ps(_mm_setzero_ps(),
+                _mm_max_ps(_mm_sub_ps(_mm_load_ps(pMin[a]), c), _mm_sub_ps(c, _mm_load_ps(pMax[a]))));
+            Dist2 = _mm_add_ps(Dist2, _mm_mul_ps(d, d));
+        }
+        return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(Dist2, _mm_set1_ps(S.Radius * S.Radius))));
+#else
+        unsigned int Mask = 0;
+        for (int i = 0; i < 4; i++) {
+            const glm::vec3 Min(N.MinX[i], N.MinY[i], N.MinZ[i]);
+            const glm::vec3 Max(N.MaxX[i], N.MaxY[i], N.MaxZ[i]);
+            const glm::vec3 d = glm::max(glm::vec3(0.0f), glm::max(Min - S.Center, S.Center - Max));
+            Mask |= glm::dot(d, d) <= S.Radius * S.Radius ? 1u << i : 0u;
+        }
+        return Mask;
+#endif
+    }
+
+    static unsigned int OverlapPack(const TrianglePack& P, const Sphere& S)
+    {
+        unsigned int Mask = 0;
+        for (int i = 0; i < 4; i++) {
+            if (P.Id[i] == InvalidTriangle) {
+                continue;
+            }
+            const glm::vec3 v0(P.V0X[i], P.V0Y[i], P.V0Z[i]);
+            const glm::vec3 d = ClosestPointOnTriangle(S.Center, v0, glm::vec3(P.E1X[i], P.E1Y[i], P.E1Z[i]),
+                                    glm::vec3(P.E2X[i], P.E2Y[i], P.E2Z[i]))
+                - S.Center;
+            Mask |= glm::dot(d, d) <= S.Radius * S.Radius ? 1u << i : 0u;
+        }
+        return Mask;
+    }
+
+    // Depth-first walk of the nodes overlapping a sphere. Visit(Pack, LaneMask) returns false to stop.
+    template <typename Func>
+    static bool WalkSphere(const TriangleBvh& Bvh, const Sphere& S, Func&& Visit)
+    {
+        unsigned int Stack[StackSize];
+        unsigned int Top = 0;
+        Stack[Top++] = 0;
+
+        while (Top > 0) {
+            const Node& N = Bvh.mNodes[Stack[--Top]];
+            const unsigned int Mask = OverlapBoxes(N, S);
+            for (unsigned int i = 0; i < 4; i++) {
+                if (!(Mask & (1u << i)) || N.Child[i] == InvalidNode) {
+                    continue;
+                }
+                if (N.Count[i] == 0) {
+                    assert(Top < StackSize);
+                    Stack[Top++] = N.Child[i];
+                    continue;
+                }
+                for (uint32_t p = N.Child[i]; p < N.Child[i] + N.Count[i]; p++) {
+                    const unsigned int Lanes = OverlapPack(Bvh.mPacks[p], S);
+                    if (Lanes && !Visit(Bvh.mPacks[p], Lanes)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+void TriangleBvh::Clear()
+{
+    mNodes.clear();
+    mNodes.shrink_to_fit();
+    mPacks.clear();
+    mPacks.shrink_to_fit();
+    mNumTriangles = 0;
+    mBbMin = glm::vec3(0.0f);
+    mBbMax = glm::vec3(0.0f);
+}
+
+size_t TriangleBvh::GetMemoryBytes() const
+{
+    return mNodes.capacity() * sizeof(Node) + mPacks.capacity() * sizeof(TrianglePack);
+}
+
+void TriangleBvh::Build(const MeshCache::View& View, const glm::mat4& M, ThreadPool* pPool)
+{
+    std::vector<glm::vec3> Corners;
+    for (const MeshCache::Entry& Entry : View.Entries) {
+        for (unsigned int i = 0; i + 2 < Entry.NumIndices; i += 3) {
+            for (unsigned int c = 0; c < 3; c++) {
+                const aiVector3D& p = View.Vertices[Entry.BaseVertex + View.Indices[Entry.BaseIndex + i + c]].Pos;
+                Corners.push_back(glm::vec3(M * glm::vec4(p.x, p.y, p.z, 1.0f)));
+            }
+        }
+    }
+    BuildTriangles(Corners, pPool);
+}
+
+void TriangleBvh::Build(const glm::vec3* pPositions, const unsigned int* pIndices, size_t NumIndices, ThreadPool* pPool)
+{
+    std::vector<glm::vec3> Corners(NumIndices - NumIndices % 3);
+    for (size_t i = 0; i < Corners.size(); i++) {
+        Corners[i] = pPositions[pIndices[i]];
+    }
+    BuildTriangles(Corners, pPool);
+}
+
+void TriangleBvh::BuildTriangles(const std::vector<glm::vec3>& Corners, ThreadPool* pPool)
+{
+    Clear();
+
+    const auto NumTriangles = static_cast<unsigned int>(Corners.size() / 3);
+    if (NumTriangles == 0) {
+        return;
+    }
+
+    Builder B;
+    B.pPool = pPool;
+    B.TriangleBounds.resize(NumTriangles);
+    B.Centroids.resize(NumTriangles);
+    for (unsigned int t = 0; t < NumTriangles; t++) {
+        Bounds& Box = B.TriangleBounds[t];
+        Box.Grow(Corners[3 * t + 0]);
+        Box.Grow(Corners[3 * t + 1]);
+        Box.Grow(Corners[3 * t + 2]);
+        B.Centroids[t] = 0.5f * (Box.Min + Box.Max);
+    }
+    B.Refs.resize(NumTriangles);
+    std::iota(B.Refs.begin(), B.Refs.end(), 0u);
+
+    // A binary tree with one triangle per leaf has 2N - 1 nodes
+    B.Nodes.resize(2 * static_cast<size_t>(NumTriangles) - 1);
+    B.NumNodes = 1;
+    B.Split(0, 0, NumTriangles, 0);
+    if (pPool) {
+        pPool->Wait(B.Group);
+    }
+
+    mNodes.reserve(B.NumNodes / 3 + 1);
+    mPacks.reserve(NumTriangles / 2 + 1);
+    B.Flatten(*this, Corners, 0);
+    mNodes.shrink_to_fit();
+    mPacks.shrink_to_fit();
+
+    mNumTriangles = NumTriangles;
+    mBbMin = B.Nodes[0].Box.Min;
+    mBbMax = B.Nodes[0].Box.Max;
+}
+
+bool TriangleBvh::Intersect(const Ray& R, Hit& Out) const
+{
+    Out = Hit();
+    if (mNodes.empty()) {
+        return false;
+    }
+
+    const RayData Data(R.Origin, R.Dir);
+    float Best = R.MaxT;
+
+    struct Entry {
+        unsigned int Node;
+        float Near;
+    } Stack[StackSize];
+    unsigned int Top = 0;
+    Stack[Top++] = { 0, 0.0f };
+
+    while (Top > 0) {
+        const Entry Current = Stack[--Top];
+        if (Current.Near >= Best) {
+            continue;
+        }
+
+        const Node& N = mNodes[Current.Node];
+        alignas(16) float Near[4];
+        const unsigned int Mask = Traversal::IntersectBoxes(N, Data, Best, Near);
+
+        // Children hit, near to far
+        unsigned int Order[4];
+        unsigned int NumHit = 0;
+        for (unsigned int i = 0; i < 4; i++) {
+            if ((Mask & (1u << i)) && N.Child[i] != InvalidNode) {
+                unsigned int k = NumHit++;
+                for (; k > 0 && Near[Order[k - 1]] > Near[i]; k--) {
+                    Order[k] = Order[k - 1];
+                }
+                Order[k] = i;
+            }
+        }
+
+        // Leaves are tested right away, which shrinks Best before the inner nodes are pushed
+        for (unsigned int k = 0; k < NumHit; k++) {
+            const unsigned int i = Order[k];
+            if (N.Count[i] == 0 || Near[i] >= Best) {
+                continue;
+            }
+            for (uint32_t p = N.Child[i]; p < N.Child[i] + N.Count[i]; p++) {
+                alignas(16) float t[4], u[4], v[4];
+                unsigned int Lanes = Traversal::IntersectPack(mPacks[p], Data, Best, t, u, v);
+                for (unsigned int l = 0; Lanes; l++, Lanes >>= 1) {
+                    if ((Lanes & 1u) && t[l] < Best) {
+                        Best = t[l];
+                        Out.T = t[l];
+                        Out.U = u[l];
+                        Out.V = v[l];
+                        Out.Triangle = mPacks[p].Id[l];
+                    }
+                }
+            }
+        }
+
+        // Far to near, so the nearest inner node is popped first
+        for (unsigned int k = NumHit; k-- > 0;) {
+            const unsigned int i = Order[k];
+            if (N.Count[i] == 0 && Near[i] < Best) {
+                assert(Top < StackSize);
+                Stack[Top++] = { N.Child[i], Near[i] };
+            }
+        }
+    }
+
+    return Out.Valid();
+}
+
+bool TriangleBvh::Occluded(const Segment& S) const
+{
+    if (mNodes.empty()) {
+        return false;
+    }
+
+    const RayData Data(S.From, S.To - S.From);
+    constexpr float MaxT = 1.0f;
+
+    unsigned int Stack[StackSize];
+    unsigned int Top = 0;
+    Stack[Top++] = 0;
+
+    while (Top > 0) {
+        const Node& N = mNodes[Stack[--Top]];
+        alignas(16) float Near[4];
+        const unsigned int Mask = Traversal::IntersectBoxes(N, Data, MaxT, Near);
+
+        for (unsigned int i = 0; i < 4; i++) {
+            if (!(Mask & (1u << i)) || N.Child[i] == InvalidNode) {
+                continue;
+            }
+            if (N.Count[i] == 0) {
+                assert(Top < StackSize);
+                Stack[Top++] = N.Child[i];
+                continue;
+            }
+            for (uint32_t p = N.Child[i]; p < N.Child[i] + N.Count[i]; p++) {
+                alignas(16) float t[4], u[4], v[4];
+                if (Traversal::IntersectPack(mPacks[p], Data, MaxT, t, u, v)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool TriangleBvh::Overlaps(const Sphere& S) const
+{
+    if (mNodes.empty()) {
+        return false;
+    }
+    return Traversal::WalkSphere(*this, S, [](const TrianglePack&, unsigned int) { return false; });
+}
+
+void TriangleBvh::Query(const Sphere& S, std::vector<unsigned int>& Triangles) const
+{
+    if (mNodes.empty()) {
+        return;
+    }
+    Traversal::WalkSphere(*this, S, [&](const TrianglePack& Pack, unsigned int Lanes) {
+        for (unsigned int l = 0; Lanes; l++, Lanes >>= 1) {
+            if (Lanes & 1u) {
+                Triangles.push_back(Pack.Id[l]);
+            }
+        }
+        return true;
+    });
+}
+
+template <typename Func>
+void TriangleBvh::ForEachChunk(size_t Count, ThreadPool* pPool, Func&& Fn)
+{
+    const auto NumChunks = static_cast<unsigned int>((Count + BatchChunk - 1) / BatchChunk);
+    auto RunChunk = [&](unsigned int c) {
+        const size_t End = std::min(Count, (c + 1) * BatchChunk);
+        for (size_t i = c * BatchChunk; i < End; i++) {
+            Fn(i);
+        }
+    };
+
+    if (pPool && NumChunks > 1) {
+        pPool->ParallelFor(0, NumChunks, 1, RunChunk);
+    } else {
+        for (unsigned int c = 0; c < NumChunks; c++) {
+            RunChunk(c);
+        }
+    }
+}
+
+void TriangleBvh::Intersect(const Ray* pRays, Hit* pHits, size_t Count, ThreadPool* pPool) const
+{
+    ForEachChunk(Count, pPool, [&](size_t i) { Intersect(pRays[i], pHits[i]); });
+}
+
+void TriangleBvh::Occluded(const Segment* pSegments, uint8_t* pOccluded, size_t Count, ThreadPool* pPool) const
+{
+    ForEachChunk(Count, pPool, [&](size_t i) { pOccluded[i] = Occluded(pSegments[i]) ? 1 : 0; });
+}
+
+void TriangleBvh::Overlaps(const Sphere* pSpheres, uint8_t* pOverlaps, size_t Count, ThreadPool* pPool) const
+{
+    ForEachChunk(Count, pPool, [&](size_t i) { pOverlaps[i] = Overlaps(pSpheres[i]) ? 1 : 0; });
+}
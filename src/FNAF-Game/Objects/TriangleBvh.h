@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+
+class ThreadPool;
+
+// Bounding volume hierarchy over a triangle soup, for ray, segment and sphere queries on the CPU.
+//
+// Built top-down with binned SAH splits into a binary tree, then collapsed into a flat array of
+// 4-wide nodes: every node keeps the boxes of its four children side by side, so one SSE slab test
+// checks all of them. Leaf triangles are stored the same way, in packs of four, precomputed for
+// Moller-Trumbore. Large subtrees are built in parallel when a ThreadPool is given.
+//
+// Queries are const and may run on any number of threads at once. Triangle indices in results are
+// the positions of the triangles in the build input.
+class TriangleBvh {
+public:
+    static constexpr unsigned int InvalidTriangle = 0xFFFFFFFF;
+
+    struct Ray {
+        glm::vec3 Origin = glm::vec3(0.0f);
+        glm::vec3 Dir = glm::vec3(0.0f, 0.0f, -1.0f); // needs not be normalized, distances are in units of Dir
+        float MaxT = FLT_MAX;
+    };
+
+    struct Hit {
+        float T = FLT_MAX;
+        unsigned int Triangle = InvalidTriangle;
+        float U = 0.0f; // barycentrics of vertex 1 and 2
+        float V = 0.0f;
+
+        [[nodiscard]] bool Valid() const { return Triangle != InvalidTriangle; }
+    };
+
+    struct Segment {
+        glm::vec3 From = glm::vec3(0.0f);
+        glm::vec3 To = glm::vec3(0.0f);
+    };
+
+    struct Sphere {
+        glm::vec3 Center = glm::vec3(0.0f);
+        float Radius = 0.0f;
+    };
+
+    // Full detail triangles of every entry of a view, transformed by M. Triangles are numbered in
+    // entry order.
+    void Build(const MeshCache::View& View, const glm::mat4& M = glm::mat4(1.0f), ThreadPool* pPool = nullptr);
+    // Indexed triangle list
+    void Build(const glm::vec3* pPositions, const unsigned int* pIndices, size_t NumIndices, ThreadPool* pPool = nullptr);
+    void Clear();
+
+    [[nodiscard]] bool Empty() const { return mNodes.empty(); }
+    [[nodiscard]] size_t GetNumTriangles() const { return mNumTriangles; }
+    [[nodiscard]] size_t GetNumNodes() const { return mNodes.size(); }
+    [[nodiscard]] size_t GetMemoryBytes() const;
+    [[nodiscard]] const glm::vec3& GetBbMin() const { return mBbMin; }
+    [[nodiscard]] const glm::vec3& GetBbMax() const { return mBbMax; }
+
+    // Closest hit along the ray within (0, MaxT)
+    bool Intersect(const Ray& R, Hit& Out) const;
+    // Any hit strictly between From and To, i.e. no line of sight
+    [[nodiscard]] bool Occluded(const Segment& S) const;
+    // Any triangle touching the sphere
+    [[nodiscard]] bool Overlaps(const Sphere& S) const;
+    // Every triangle touching the sphere, appended to Triangles
+    void Query(const Sphere& S, std::vector<unsigned int>& Triangles) const;
+
+    // Batches, split over pPool in chunks when large enough to pay off. pOccluded and pOverlaps
+    // receive 1 or 0 per query.
+    void Intersect(const Ray* pRays, Hit* pHits, size_t Count, ThreadPool* pPool = nullptr) const;
+    void Occluded(const Segment* pSegments, uint8_t* pOccluded, size_t Count, ThreadPool* pPool = nullptr) const;
+    void Overlaps(const Sphere* pSpheres, uint8_t* pOverlaps, size_t Count, ThreadPool* pPool = nullptr) const;
+
+private:
+    static constexpr unsigned int InvalidNode = 0xFFFFFFFF;
+
+    // Four child boxes in SoA order. Count == 0: Child is an inner node; otherwise the child is a
+    // leaf of Count packs starting at pack Child. Unused lanes have Child == InvalidNode.
+    struct alignas(64) Node {
+        float MinX[4], MinY[4], MinZ[4];
+        float MaxX[4], MaxY[4], MaxZ[4];
+        uint32_t Child[4];
+        uint32_t Count[4];
+    };
+
+    // Four triangles as v0 and the edges to v1 and v2. Unused lanes are degenerate and never hit.
+    struct alignas(16) TrianglePack {
+        float V0X[4], V0Y[4], V0Z[4];
+        float E1X[4], E1Y[4], E1Z[4];
+        float E2X[4], E2Y[4], E2Z[4];
+        uint32_t Id[4];
+    };
+
+    struct Builder;
+    struct Traversal;
+
+    template <typename Func>
+    static void ForEachChunk(size_t Count, ThreadPool* pPool, Func&& Fn);
+
+    void BuildTriangles(const std::vector<glm::vec3>& Corners, ThreadPool* pPool);
+
+    std::vector<Node> mNodes; // root first
+    std::vector<TrianglePack> mPacks;
+    size_t mNumTriangles = 0;
+
+    glm::vec3 mBbMin = glm::vec3(0.0f);
+    glm::vec3 mBbMax = glm::vec3(0.0f);
+};
@@ -0,0 +1,120 @@
+#include "VertexAnimatedMesh.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "MemoryBudget.h"
+#include "Shader.h"
+
+#include "MeshLod.h"
+
+Shader* VertexAnimatedMesh::mShader = nullptr;
+
+VertexAnimatedMesh::VertexAnimatedMesh()
+{
+    if (mShader == nullptr) {
+        mShader = new Shader(vertex_animated_vertex_shader, vertex_animated_fragment_shader);
+        mShader->Init();
+    }
+}
+
+VertexAnimatedMesh::~VertexAnimatedMesh()
+{
+    FreeTexture();
+}
+
+void VertexAnimatedMesh::FreeTexture()
+{
+    if (mTexture != 0) {
+        MemoryBudget::UntrackGlObject(GL_TEXTURE, mTexture);
+        glDeleteTextures(1, &mTexture);
+        mTexture = 0;
+    }
+}
+
+bool VertexAnimatedMesh::LoadMesh(const std::string& filename)
+{
+    mLoaded = false;
+    mFilename = filename;
+    mAsset = SkinnedMeshAsset::Load(filename);
+    if (!mAsset || !SetClip(0)) {
+        return false;
+    }
+
+    glm::vec3 diff = mBbMax - mBbMin;
+    float w = std::max(diff.x, std::max(diff.y, diff.z));
+
+    mScale = glm::vec3(1.0f / w);
+    return true;
+}
+
+bool VertexAnimatedMesh::SetClip(unsigned int Clip)
+{
+    if (!mAsset || !mAsset->IsReady()) {
+        return false;
+    }
+
+    VertexAnimation::Data Bake;
+    if (!VertexAnimation::Read(mFilename, Clip, sSampleRate, Bake) || Bake.NumVertices != mAsset->GetVertices().size()) {
+        const auto& Vertices = mAsset->GetVertices();
+        if (!VertexAnimation::Bake(Vertices.data(), mAsset->GetBoneData().data(), static_cast<unsigned int>(Vertices.size()),
+            mAsset->GetSkeleton(), mAsset->GetClips(), Clip, sSampleRate, Bake)) {
+            return false;
+        }
+        VertexAnimation::Write(mFilename, Bake);
+    }
+
+    FreeTexture();
+    glCreateTextures(GL_TEXTURE_2D, 1, &mTexture);
+    glTextureStorage2D(mTexture, 1, GL_RGBA16UI, static_cast<GLsizei>(Bake.Width), static_cast<GLsizei>(Bake.GetHeight()));
+    glTextureSubImage2D(mTexture, 0, 0, 0, static_cast<GLsizei>(Bake.Width), static_cast<GLsizei>(Bake.GetHeight()),
+        GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, Bake.Texels.data());
+    // Integer textures are only ever fetched, but must not expect mipmaps to be complete
+    glTextureParameteri(mTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(mTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    MemoryBudget::TrackGlObject(GL_TEXTURE, mTexture, static_cast<int64_t>(Bake.Texels.size() * sizeof(VertexAnimation::Texel)), "Animation");
+
+    // The GPU has its copy, only the layout is needed from here on
+    std::vector<VertexAnimation::Texel>().swap(Bake.Texels);
+    mBake = std::move(Bake);
+
+    mBbMin = mBake.BbMin;
+    mBbMax = mBake.BbMax;
+    const size_t NumEntries = mAsset->GetEntries().size();
+    mBounds.Resize(NumEntries);
+    for (size_t i = 0; i < NumEntries; i++) {
+        mBounds.Set(i, mBbMin, mBbMax);
+    }
+    mCullVersion = 0;
+    mVisible.clear();
+
+    mLoaded = true;
+    return true;
+}
+
+void VertexAnimatedMesh::Render()
+{
+    if (!mLoaded) {
+        return;
+    }
+
+    const std::vector<MeshLod::Entry>& Lods = mAsset->GetLods();
+    mLodLevels.resize(Lods.size(), 0);
+    for (size_t i = 0; i < Lods.size(); i++) {
+        mLodLevels[i] = MeshLod::Select(Lods[i], mWorldMatrix, mLodLevels[i]);
+    }
+    FrustumCulling::CullEntries(mBounds, mWorldMatrix, mVisible, mCullVersion);
+
+    const glm::vec3 Extent = mBake.BbMax - mBake.BbMin;
+    glUniformMatrix4fv(UniformLoc::M, 1, GL_FALSE, &mWorldMatrix[0][0]);
+    // The shader draws the rest pose for Mode 0
+    glUniform1i(UniformLoc::Mode, 1);
+    glUniform1f(UniformLoc::Frame, mBake.GetFrame(mTime));
+    glUniform1i(UniformLoc::NumFrames, static_cast<GLint>(mBake.NumFrames));
+    glUniform2i(UniformLoc::TexelLayout, static_cast<GLint>(mBake.Width), static_cast<GLint>(mBake.RowsPerFrame));
+    glUniform3fv(UniformLoc::BbMin, 1, &mBake.BbMin.x);
+    glUniform3fv(UniformLoc::BbExtent, 1, &Extent.x);
+    glBindTextureUnit(TextureUnit, mTexture);
+
+    mAsset->Draw(mLodLevels.data(), mVisible.data());
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "MeshBase.h"
+#include "FrustumCulling.h"
+#include "SkinnedMeshAsset.h"
+#include "VertexAnimation.h"
+
+// Shaders
+static const std::string vertex_animated_vertex_shader("vertex_animated_mesh.vert");
+static const std::string vertex_animated_fragment_shader("skinned_mesh.frag");
+
+class Shader;
+
+// Plays one clip of a skinned mesh from a vertex animation texture, for background animatronics.
+//
+// Geometry and materials are the shared SkinnedMeshAsset; the clip is baked once by
+// VertexAnimation (or read back from its .vat file) and uploaded as an RGBA16UI texture. Update()
+// only records the time and the vertex shader fetches and blends the two frames around it, so an
+// instance costs no skeleton, graph or palette work on the CPU. The mesh isn't registered with
+// AnimationSystem.
+class VertexAnimatedMesh : public MeshBase {
+protected:
+    static Shader* mShader;
+
+public:
+    enum UniformLoc : unsigned int {
+        PV = 0,
+        M = 1,
+        Time = 2,
+        Mode = 4,
+        EyeW = 6,
+        Shininess = 7,
+        Frame = 13, // fractional frame to draw
+        NumFrames = 14,
+        TexelLayout = 15, // width, rows per frame
+        BbMin = 16, // position dequantization
+        BbExtent = 17,
+    };
+
+    static constexpr GLuint TextureUnit = 1;
+
+    // Frames per second of the bakes LoadMesh and SetClip make
+    static inline float sSampleRate = 30.0f;
+
+    VertexAnimatedMesh();
+    ~VertexAnimatedMesh() override;
+
+    // Loads the mesh and plays its first clip
+    bool LoadMesh(const std::string& filename) override;
+    // Clip to play from now on, baked on first use
+    bool SetClip(unsigned int Clip);
+
+    void Update(float TimeInSeconds) override { mTime = TimeInSeconds; }
+    void Render() override;
+
+    [[nodiscard]] static Shader* sShader() { return mShader; }
+
+    [[nodiscard]] const VertexAnimation::Data& GetBake() const { return mBake; }
+
+private:
+    void FreeTexture();
+
+    std::string mFilename;
+    std::shared_ptr<SkinnedMeshAsset> mAsset;
+
+    // Texels are dropped once uploaded, the rest describes the texture
+    VertexAnimation::Data mBake;
+    GLuint mTexture = 0;
+    float mTime = 0.0f;
+
+    std::vector<unsigned int> mLodLevels;
+    // Every entry gets the bounds of the whole bake
+    FrustumCulling::EntryBounds mBounds;
+    std::vector<uint8_t> mVisible;
+    unsigned int mCullVersion = 0;
+};
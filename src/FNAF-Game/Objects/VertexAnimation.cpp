@@ -0,0 +1,241 @@
+#include "VertexAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "VertexPacking.h"
+
+#include "AnimationGraph.h"
+#include "CpuSkinning.h"
+#include "Skeleton.h"
+
+namespace fs = std::filesystem;
+
+namespace VertexAnimation {
+
+namespace {
+
+    // Same stamp as the mesh cache, without linking all of it in
+    bool SourceStamp(const std::string& sourceFilename, uint64_t& size, int64_t& time)
+    {
+        std::error_code ec;
+        size = fs::file_size(sourceFilename, ec);
+        if (ec) {
+            return false;
+        }
+        time = static_cast<int64_t>(fs::last_write_time(sourceFilename, ec).time_since_epoch().count());
+        return !ec;
+    }
+
+    // Frames over Duration at no less than SampleRate, both ends included
+    uint32_t GetNumFrames(float Duration, float SampleRate)
+    {
+        return static_cast<uint32_t>(std::ceil(std::max(Duration, 0.0f) * SampleRate)) + 1;
+    }
+
+    uint16_t Quantize(float Value, float Min, float Extent)
+    {
+        const float t = Extent > 0.0f ? (Value - Min) / Extent : 0.0f;
+        return static_cast<uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    uint8_t QuantizeSnorm8(float Value)
+    {
+        return static_cast<uint8_t>(std::lround((std::clamp(Value, -1.0f, 1.0f) * 0.5f + 0.5f) * 255.0f));
+    }
+
+    float DequantizeSnorm8(uint32_t Value)
+    {
+        return static_cast<float>(Value) / 255.0f * 2.0f - 1.0f;
+    }
+}
+
+float Data::GetFrame(float TimeInSeconds, bool Loop) const
+{
+    if (NumFrames < 2 || Duration <= 0.0f) {
+        return 0.0f;
+    }
+
+    float t = TimeInSeconds;
+    if (Loop) {
+        t = std::fmod(t, Duration);
+        if (t < 0.0f) {
+            t += Duration;
+        }
+    }
+    return std::clamp(t * SampleRate, 0.0f, static_cast<float>(NumFrames - 1));
+}
+
+glm::vec3 Data::DecodePosition(const Texel& T) const
+{
+    const glm::vec3 Step = (BbMax - BbMin) / 65535.0f;
+    return BbMin + Step * glm::vec3(T.Position[0], T.Position[1], T.Position[2]);
+}
+
+glm::vec3 Data::DecodeNormal(const Texel& T)
+{
+    return VertexPacking::OctDecode(glm::vec2(DequantizeSnorm8(T.Normal & 0xFFu), DequantizeSnorm8(T.Normal >> 8)));
+}
+
+bool Bake(const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const Skeleton& Skel, const std::vector<AnimationClip>& Clips, unsigned int Clip, float SampleRate, Data& Out)
+{
+    Out = Data();
+
+    if (Clip >= Clips.size() || SampleRate <= 0.0f) {
+        printf("VertexAnimation: nothing to bake for clip %u\n", Clip);
+        return false;
+    }
+
+    const AnimationClip& Source = Clips[Clip];
+
+    Out.Clip = Clip;
+    Out.NumVertices = NumVertices;
+    Out.Duration = Source.Duration / Source.GetTicksPerSecond();
+    Out.NumFrames = GetNumFrames(Out.Duration, SampleRate);
+    Out.SampleRate = Out.NumFrames > 1 ? static_cast<float>(Out.NumFrames - 1) / Out.Duration : SampleRate;
+    Out.Width = std::max(std::min(Out.NumVertices, MaxWidth), 1u);
+    Out.RowsPerFrame = (Out.NumVertices + Out.Width - 1) / Out.Width;
+
+    if (Out.NumVertices == 0 || Out.GetHeight() > MaxHeight) {
+        printf("VertexAnimation: clip '%s' needs %u rows, more than %u, lower the sample rate\n", Source.Name.c_str(),
+            Out.GetHeight(), MaxHeight);
+        return false;
+    }
+
+    // The SkinnedMesh::BoneTransform path, on a graph of our own so no instance is disturbed
+    AnimationGraph Graph;
+    Graph.Init(&Skel, &Clips);
+    Graph.Play(0, static_cast<int>(Clip), 0.0f, 0.0f, 1.0f, false);
+
+    LocalPose Pose;
+    Pose.Resize(Skel.GetNumNodes());
+    std::vector<aiMatrix4x4> Globals(Skel.GetNumNodes());
+    std::vector<aiMatrix4x4> Palette(Skel.GetNumBones());
+
+    // Skin every frame first: the position range covers the whole bake
+    std::vector<glm::vec3> Positions(size_t(Out.NumFrames) * Out.NumVertices);
+    std::vector<glm::vec3> Normals(Positions.size());
+    for (uint32_t f = 0; f < Out.NumFrames; f++) {
+        Graph.Evaluate(static_cast<float>(f) / Out.SampleRate, Pose);
+        Skel.ComputePalette(Pose, Globals.data(), Palette.data());
+
+        const size_t First = size_t(f) * Out.NumVertices;
+        CpuSkinning::Skin(pVertices, pBones, Out.NumVertices, Palette.data(), static_cast<unsigned int>(Palette.size()),
+            Positions.data() + First, Normals.data() + First);
+    }
+    CpuSkinning::CalcBounds(Positions.data(), static_cast<unsigned int>(Positions.size()), Out.BbMin, Out.BbMax);
+
+    const glm::vec3 Extent = Out.BbMax - Out.BbMin;
+    Out.Texels.assign(size_t(Out.Width) * Out.GetHeight(), Texel {});
+    for (uint32_t f = 0; f < Out.NumFrames; f++) {
+        for (uint32_t v = 0; v < Out.NumVertices; v++) {
+            const size_t i = size_t(f) * Out.NumVertices + v;
+            Texel& T = Out.Texels[Out.GetTexelIndex(f, v)];
+            for (int c = 0; c < 3; c++) {
+                T.Position[c] = Quantize(Positions[i][c], Out.BbMin[c], Extent[c]);
+            }
+
+            const float Length = glm::length(Normals[i]);
+            const glm::vec2 Oct = VertexPacking::OctEncode(Length > 0.0f ? Normals[i] / Length : glm::vec3(0.0f, 0.0f, 1.0f));
+            T.Normal = static_cast<uint16_t>(QuantizeSnorm8(Oct.x) | (QuantizeSnorm8(Oct.y) << 8));
+        }
+    }
+
+    printf("VertexAnimation: baked clip '%s', %u frames of %u vertices, %.1f KB\n", Source.Name.c_str(), Out.NumFrames,
+        Out.NumVertices, Out.Texels.size() * sizeof(Texel) / 1024.0);
+    return true;
+}
+
+std::string CachePath(const std::string& sourceFilename, unsigned int Clip)
+{
+    return sourceFilename + "." + std::to_string(Clip) + Extension;
+}
+
+bool Write(const std::string& sourceFilename, const Data& Bake)
+{
+    Header header {};
+    header.Magic = Magic;
+    header.Version = Version;
+    if (!SourceStamp(sourceFilename, header.SourceSize, header.SourceTime)) {
+        return false;
+    }
+    header.Clip = Bake.Clip;
+    header.NumVertices = Bake.NumVertices;
+    header.NumFrames = Bake.NumFrames;
+    header.Width = Bake.Width;
+    header.RowsPerFrame = Bake.RowsPerFrame;
+    header.SampleRate = Bake.SampleRate;
+    header.Duration = Bake.Duration;
+    for (int c = 0; c < 3; c++) {
+        header.BbMin[c] = Bake.BbMin[c];
+        header.BbMax[c] = Bake.BbMax[c];
+    }
+
+    // Write to a temporary file first so a crash never leaves a truncated bake behind
+    const std::string path = CachePath(sourceFilename, Bake.Clip);
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(Bake.Texels.data()), std::streamsize(Bake.Texels.size() * sizeof(Texel)));
+        if (!out) {
+            printf("Couldn't write vertex animation: %s\n", tmpPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool Read(const std::string& sourceFilename, unsigned int Clip, float SampleRate, Data& Out)
+{
+    Out = Data();
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SourceStamp(sourceFilename, sourceSize, sourceTime)) {
+        return false;
+    }
+
+    std::ifstream in(CachePath(sourceFilename, Clip), std::ios::in | std::ios::binary);
+    Header header {};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header))) {
+        return false;
+    }
+
+    if (header.Magic != Magic || header.Version != Version || header.SourceSize != sourceSize || header.SourceTime != sourceTime
+        || header.Clip != Clip || header.NumFrames != GetNumFrames(header.Duration, SampleRate) || header.Width == 0
+        || header.RowsPerFrame != (header.NumVertices + header.Width - 1) / header.Width) {
+        return false;
+    }
+
+    Out.Clip = header.Clip;
+    Out.NumVertices = header.NumVertices;
+    Out.NumFrames = header.NumFrames;
+    Out.Width = header.Width;
+    Out.RowsPerFrame = header.RowsPerFrame;
+    Out.SampleRate = header.SampleRate;
+    Out.Duration = header.Duration;
+    Out.BbMin = glm::vec3(header.BbMin[0], header.BbMin[1], header.BbMin[2]);
+    Out.BbMax = glm::vec3(header.BbMax[0], header.BbMax[1], header.BbMax[2]);
+
+    Out.Texels.resize(size_t(Out.Width) * Out.GetHeight());
+    if (!in.read(reinterpret_cast<char*>(Out.Texels.data()), std::streamsize(Out.Texels.size() * sizeof(Texel)))) {
+        printf("Corrupt vertex animation: %s\n", CachePath(sourceFilename, Clip).c_str());
+        Out = Data();
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshCache.h"
+
+class Skeleton;
+struct AnimationClip;
+
+// Vertex animation textures: one clip of a skinned mesh, skinned offline into per-frame vertices.
+//
+// Bake() plays the clip through the same AnimationGraph, Skeleton and CpuSkinning path a
+// SkinnedMesh uses, at frames evenly spaced over the clip (both ends included, so looping playback
+// interpolates across the wrap). Each vertex of each frame becomes one 8 byte texel, ready for an
+// RGBA16UI texture: the position in 16 bits per component over the bounds of the whole bake, and
+// an octahedral normal in 8 + 8 bits. Frame f, vertex v sits at (v % Width, f * RowsPerFrame +
+// v / Width). Bakes take mesh cache vertices, a skeleton and clips rather than a loaded
+// SkinnedMeshAsset, and there are no GL calls here, so they can be made, written and compared headlessly.
+namespace VertexAnimation {
+
+constexpr uint32_t Magic = 0x54414E46; // "FNAT"
+constexpr uint32_t Version = 1;
+
+const std::string Extension = ".vat";
+
+// Texture width limit, rows are added instead
+constexpr uint32_t MaxWidth = 4096;
+// Bakes taller than this don't fit the texture size GL 4.5 guarantees
+constexpr uint32_t MaxHeight = 16384;
+
+struct Header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t SourceSize;
+    int64_t SourceTime;
+    uint32_t Clip;
+    uint32_t NumVertices;
+    uint32_t NumFrames;
+    uint32_t Width;
+    uint32_t RowsPerFrame;
+    float SampleRate; // frames per second of clip time, after spreading them evenly
+    float Duration; // seconds
+    float BbMin[3];
+    float BbMax[3];
+};
+
+struct Texel {
+    uint16_t Position[3];
+    uint16_t Normal; // octahedral, x in the low byte
+};
+static_assert(sizeof(Texel) == 8, "one RGBA16UI texel");
+
+struct Data {
+    uint32_t Clip = 0;
+    uint32_t NumVertices = 0;
+    uint32_t NumFrames = 0;
+    uint32_t Width = 0;
+    uint32_t RowsPerFrame = 0;
+    float SampleRate = 0.0f;
+    float Duration = 0.0f;
+    glm::vec3 BbMin = glm::vec3(0.0f);
+    glm::vec3 BbMax = glm::vec3(0.0f);
+    std::vector<Texel> Texels; // Width * GetHeight(), padding texels zero
+
+    [[nodiscard]] uint32_t GetHeight() const { return RowsPerFrame * NumFrames; }
+    [[nodiscard]] size_t GetTexelIndex(uint32_t Frame, uint32_t Vertex) const
+    {
+        return size_t(Frame * RowsPerFrame + Vertex / Width) * Width + Vertex % Width;
+    }
+    [[nodiscard]] const Texel& GetTexel(uint32_t Frame, uint32_t Vertex) const { return Texels[GetTexelIndex(Frame, Vertex)]; }
+
+    // Frame position (fractional) of a time in seconds, wrapping around the clip when Loop is set
+    [[nodiscard]] float GetFrame(float TimeInSeconds, bool Loop = true) const;
+
+    [[nodiscard]] glm::vec3 DecodePosition(const Texel& T) const;
+    [[nodiscard]] static glm::vec3 DecodeNormal(const Texel& T);
+};
+
+// Skin NumVertices vertices (full detail) through clip Clip of Clips, bound to Skel, at about
+// SampleRate frames per second. Fails if there is no such clip, no vertex or the bake exceeds MaxHeight.
+bool Bake(const MeshCache::Vertex* pVertices, const MeshCache::VertexBoneData* pBones, unsigned int NumVertices,
+    const Skeleton& Skel, const std::vector<AnimationClip>& Clips, unsigned int Clip, float SampleRate, Data& Out);
+
+// <source>.<clip>.vat next to the source asset
+std::string CachePath(const std::string& sourceFilename, unsigned int Clip);
+
+bool Write(const std::string& sourceFilename, const Data& Bake);
+// False if the file is missing, stale (source changed) or for a different clip or rate
+bool Read(const std::string& sourceFilename, unsigned int Clip, float SampleRate, Data& Out);
+
+}
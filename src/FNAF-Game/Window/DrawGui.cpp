@@ -1,10 +1,17 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include <implot.h>
 
 #include "DrawGui.h"
 #include <Game/GlobalObjects.h>
+#include "Objects/AnimationLod.h"
 #include "Objects/LightManager.h"
+#include "Objects/FrustumCulling.h"
+#include "Objects/MeshLod.h"
+#include "Objects/SkinnedBatch.h"
+#include "MemoryBudget.h"
+#include "Timer.h"
 #include "Game/JsonConfig.h"
 
 bool DrawGui::HideGui = false;
@@ -16,6 +23,7 @@ void Init()
     // Init ImGui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
+    ImPlot::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(GlfwWindow::window, true);
     ImGui_ImplOpenGL3_Init("#version 460");
 }
@@ -94,6 +102,8 @@ void Display(GLFWwindow* window)
             }
             ImGui::EndMenu();
         }
+
+        TimerGui::Menu();
         ImGui::EndMainMenuBar();
     }
 #pragma endregion
@@ -124,6 +134,34 @@ void Display(GLFWwindow* window)
 //            glUniform1i(SkinnedMesh::UniformLoc::Mode, mode);
             ImGui::Text("Rate: <%.2f>", Scene::rate);
 
+            if (Scene::gMapMesh && Scene::gMapMesh->IsLoaded()) {
+                const StaticMesh& Map = *Scene::gMapMesh;
+                const glm::mat4 M = Map.GetModelMatrix();
+                ImGui::Text("Map BVH: %zu triangles, %zu nodes, %.1f MB", Map.GetBvh().GetNumTriangles(), Map.GetBvh().GetNumNodes(),
+                    Map.GetBvh().GetMemoryBytes() / (1024.0f * 1024.0f));
+                // Line of sight from the camera to the center of each animatronic's bounds
+                auto pawn_center = [](const Pawn& pawn) {
+                    return glm::vec3(pawn.GetModelMatrix() * glm::vec4(0.5f * (pawn.mMesh->mBbMin + pawn.mMesh->mBbMax), 1.0f));
+                };
+                ImGui::Text("Freddy in sight: %s", Map.IsOccluded(M, cam_pos, pawn_center(Scene::gFreddy)) ? "no" : "yes");
+                ImGui::Text("Bunny in sight: %s", Map.IsOccluded(M, cam_pos, pawn_center(Scene::gBunny)) ? "no" : "yes");
+                float flash_distance = 0.0f;
+                if (Map.Pick(M, LightManager::spotLightData.position, glm::normalize(LightManager::spotLightData.direction), flash_distance)) {
+                    ImGui::Text("Flash light hits the map at %.2f", flash_distance);
+                }
+            }
+
+            ImGui::Checkbox("Frustum culling", &FrustumCulling::sEnabled);
+            ImGui::Checkbox("Mesh LOD", &MeshLod::sEnabled);
+            ImGui::Checkbox("Indirect draw batches", &StaticMesh::sBatched);
+            ImGui::Checkbox("Instanced skinned meshes", &SkinnedBatch::sEnabled);
+            ImGui::Checkbox("Animation LOD", &AnimationLod::sEnabled);
+            ImGui::SliderFloat("LOD pixel error", &MeshLod::sMaxPixelError, 0.25f, 8.0f);
+
+            if (ImGui::CollapsingHeader("Memory")) {
+                MemoryBudget::DrawGui();
+            }
+
             ImGui::End();
         }
     }
@@ -199,6 +237,8 @@ void Display(GLFWwindow* window)
         ImGui::ShowDemoWindow(&show_imgui_test);
     }
 
+    TimerGui::DrawGui();
+
     // End ImGui Frame
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -0,0 +1,286 @@
+#include "Objects/AnimationGraph.h"
+#include "Objects/Skeleton.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <assimp/matrix3x3.inl>
+#include <assimp/matrix4x4.inl>
+#include <assimp/quaternion.inl>
+#include <assimp/vector3.inl>
+
+#include "Check.h"
+
+namespace {
+
+// Quantization of the compressed clips, the tolerances of Settings are set far below it
+constexpr float RotationTolerance = 5e-4f;
+constexpr float TranslationTolerance = 1e-4f;
+
+constexpr float TicksPerSecond = 10.0f;
+constexpr float Duration = 10.0f; // ticks: one second
+
+const aiVector3D Axis = aiVector3D(0.2f, 0.3f, 1.0f).Normalize();
+
+// A root and a child one unit above it. Clips only drive the child: "A" and "B" hold a pose each,
+// "C" turns it and lifts it over the clip, for the additive layer.
+struct Rig {
+    std::vector<char> Strings;
+    std::vector<MeshCache::Node> Nodes;
+    std::vector<MeshCache::Channel> Channels;
+    std::vector<MeshCache::VectorKey> PositionKeys, ScalingKeys;
+    std::vector<MeshCache::QuatKey> RotationKeys;
+    std::vector<MeshCache::Animation> Anims;
+    MeshCache::View View;
+
+    Skeleton Skel;
+    std::vector<AnimationClip> Clips;
+};
+
+uint32_t AddString(std::vector<char>& Strings, const char* s)
+{
+    const auto Offset = static_cast<uint32_t>(Strings.size());
+    Strings.insert(Strings.end(), s, s + strlen(s) + 1);
+    return Offset;
+}
+
+aiVector3D PositionA() { return aiVector3D(0.0f, 1.0f, 0.0f); }
+aiVector3D PositionB() { return aiVector3D(0.5f, 1.0f, 0.0f); }
+aiQuaternion RotationA() { return aiQuaternion(Axis, 0.4f); }
+aiQuaternion RotationB() { return aiQuaternion(aiVector3D(1.0f, 0.0f, 0.0f), -0.7f); }
+aiVector3D PositionC(float t) { return aiVector3D(0.0f, 1.0f + 0.05f * t, 0.0f); }
+aiQuaternion RotationC(float t) { return aiQuaternion(Axis, 0.1f + 0.08f * t); }
+
+// Channel driving NodeName with keys at every tick, from the pose functions
+template <typename Position, typename Rotation>
+void AddChannel(Rig& r, uint32_t NodeName, Position&& P, Rotation&& R)
+{
+    r.Channels.push_back({ NodeName, static_cast<uint32_t>(r.PositionKeys.size()), 11, static_cast<uint32_t>(r.RotationKeys.size()), 11,
+        static_cast<uint32_t>(r.ScalingKeys.size()), 11 });
+    for (int k = 0; k <= 10; k++) {
+        const float t = float(k);
+        r.PositionKeys.push_back({ t, P(t) });
+        r.RotationKeys.push_back({ t, R(t) });
+        r.ScalingKeys.push_back({ t, aiVector3D(1.0f) });
+    }
+}
+
+void MakeRig(Rig& r)
+{
+    aiMatrix4x4 Up;
+    aiMatrix4x4::Translation(PositionA(), Up);
+    r.Nodes.push_back({ -1, AddString(r.Strings, "root"), aiMatrix4x4() });
+    r.Nodes.push_back({ 0, AddString(r.Strings, "child"), Up });
+    const uint32_t Child = r.Nodes[1].Name;
+
+    const char* Names[] = { "A", "B", "C" };
+    for (int a = 0; a < 3; a++) {
+        const auto FirstChannel = static_cast<uint32_t>(r.Channels.size());
+        if (a == 0) {
+            AddChannel(r, Child, [](float) { return PositionA(); }, [](float) { return RotationA(); });
+        } else if (a == 1) {
+            AddChannel(r, Child, [](float) { return PositionB(); }, [](float) { return RotationB(); });
+            // A node the skeleton doesn't have, skipped when evaluating
+            AddChannel(r, AddString(r.Strings, "missing"), PositionC, RotationC);
+        } else {
+            AddChannel(r, Child, PositionC, RotationC);
+        }
+        r.Anims.push_back({ AddString(r.Strings, Names[a]), Duration, TicksPerSecond, FirstChannel,
+            static_cast<uint32_t>(r.Channels.size()) - FirstChannel });
+    }
+
+    r.View.Strings = { r.Strings.data(), r.Strings.size() };
+    r.View.Nodes = { r.Nodes.data(), r.Nodes.size() };
+    r.View.Channels = { r.Channels.data(), r.Channels.size() };
+    r.View.Animations = { r.Anims.data(), r.Anims.size() };
+    r.View.PositionKeys = { r.PositionKeys.data(), r.PositionKeys.size() };
+    r.View.RotationKeys = { r.RotationKeys.data(), r.RotationKeys.size() };
+    r.View.ScalingKeys = { r.ScalingKeys.data(), r.ScalingKeys.size() };
+
+    r.Skel.Init(r.View);
+    ClipCompression::Settings Options;
+    Options.MaxTranslationError = Options.MaxRotationError = Options.MaxScalingError = Options.MaxJointError = 1e-6f;
+    for (unsigned int a = 0; a < r.Anims.size(); a++) {
+        AnimationClip Clip;
+        Clip.Name = r.View.String(r.Anims[a].Name);
+        Clip.Duration = Duration;
+        Clip.TicksPerSecond = TicksPerSecond;
+        for (unsigned int c = 0; c < r.Anims[a].NumChannels; c++) {
+            Clip.ChannelNames.push_back(r.View.String(r.Channels[r.Anims[a].FirstChannel + c].NodeName));
+        }
+        ClipCompression::Compress(r.View, r.Anims[a], Options, Clip.Tracks, nullptr);
+        r.Skel.BindClip(Clip);
+        r.Clips.push_back(std::move(Clip));
+    }
+}
+
+// Angle of conj(A) * B in double, see ClipCompressionTest
+float Angle(const aiQuaternion& A, const aiQuaternion& B)
+{
+    const double aw = A.w, ax = A.x, ay = A.y, az = A.z;
+    const double bw = B.w, bx = B.x, by = B.y, bz = B.z;
+    const double w = aw * bw + ax * bx + ay * by + az * bz;
+    const double x = aw * bx - bw * ax - (ay * bz - az * by);
+    const double y = aw * by - bw * ay - (az * bx - ax * bz);
+    const double z = aw * bz - bw * az - (ax * by - ay * bx);
+    return static_cast<float>(2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), std::abs(w)));
+}
+
+// Normalized lerp in double, the reference for the blends
+aiQuaternion Nlerp(const aiQuaternion& A, const aiQuaternion& B, double f)
+{
+    const double Sign = A.w * B.w + A.x * B.x + A.y * B.y + A.z * B.z < 0.0 ? -1.0 : 1.0;
+    const double w = A.w + (Sign * B.w - A.w) * f, x = A.x + (Sign * B.x - A.x) * f;
+    const double y = A.y + (Sign * B.y - A.y) * f, z = A.z + (Sign * B.z - A.z) * f;
+    const double Length = std::sqrt(w * w + x * x + y * y + z * z);
+    return aiQuaternion(float(w / Length), float(x / Length), float(y / Length), float(z / Length));
+}
+
+bool CheckChild(const LocalPose& Pose, const aiVector3D& Translation, const aiQuaternion& Rotation, const char* What)
+{
+    const float TranslationError = (Pose.Translations[1] - Translation).Length();
+    const float RotationError = Angle(Pose.Rotations[1], Rotation);
+    const bool Root = Pose.Translations[0] == aiVector3D() && Pose.Rotations[0] == aiQuaternion();
+    if (TranslationError > TranslationTolerance || RotationError > RotationTolerance || !Root) {
+        printf("%s: translation off by %.2e, rotation by %.2e rad%s\n", What, TranslationError, RotationError, Root ? "" : ", root moved");
+        return false;
+    }
+    return true;
+}
+
+void TestCrossFade(const Rig& r)
+{
+    AnimationGraph Graph;
+    Graph.Init(&r.Skel, &r.Clips);
+    const int A = Graph.FindClip("A"), B = Graph.FindClip("B");
+    CHECK(A == 0 && B == 1 && Graph.FindClip("none") == AnimationGraph::InvalidClip);
+
+    // Init plays the first clip on the base layer
+    LocalPose Pose;
+    Graph.Evaluate(0.5f, Pose);
+    CHECK(CheckChild(Pose, PositionA(), RotationA(), "A"));
+
+    // Over one second from t = 2, the incoming clip's weight is the time faded in
+    Graph.Play(0, B, 2.0f, 1.0f);
+    bool Fades = true;
+    float LastAngle = 0.0f;
+    for (int s = 0; s <= 12; s++) {
+        const float Time = 1.9f + 0.1f * s;
+        const float Weight = std::clamp(Time - 2.0f, 0.0f, 1.0f);
+        Graph.Evaluate(Time, Pose);
+        char What[32];
+        snprintf(What, sizeof(What), "Cross-fade at %.1f", Time);
+        Fades = CheckChild(Pose, PositionA() + (PositionB() - PositionA()) * Weight, Nlerp(RotationA(), RotationB(), Weight), What) && Fades;
+
+        // Moving away from A all the way
+        const float FromA = Angle(RotationA(), Pose.Rotations[1]);
+        Fades = Fades && FromA >= LastAngle - RotationTolerance;
+        LastAngle = FromA;
+    }
+    CHECK(Fades);
+
+    // A cut drops the outgoing clip right away
+    Graph.Play(0, A, 4.0f);
+    Graph.Evaluate(4.0f, Pose);
+    CHECK(CheckChild(Pose, PositionA(), RotationA(), "Cut"));
+
+    // Stopping the base layer fades back to the bind pose
+    Graph.Stop(0, 5.0f, 2.0f);
+    Graph.Evaluate(5.5f, Pose);
+    CHECK(CheckChild(Pose, PositionA(), Nlerp(aiQuaternion(), RotationA(), 0.75), "Stop"));
+    Graph.Evaluate(7.0f, Pose);
+    CHECK(CheckChild(Pose, PositionA(), aiQuaternion(), "Stopped"));
+}
+
+void TestAdditive(const Rig& r)
+{
+    AnimationGraph Graph;
+    Graph.Init(&r.Skel, &r.Clips);
+    Graph.Play(0, Graph.FindClip("B"), 0.0f);
+    const unsigned int Layer = Graph.AddLayer(AnimationGraph::BlendMode::Additive, 0.5f);
+    CHECK(Graph.GetNumLayers() == 2);
+
+    // C at its start adds nothing: its first frame is the reference
+    const int C = Graph.FindClip("C");
+    Graph.Play(Layer, C, 1.0f, 0.0f, 1.0f, false);
+    LocalPose Pose;
+    Graph.Evaluate(1.0f, Pose);
+    CHECK(CheckChild(Pose, PositionB(), RotationB(), "Additive start"));
+
+    // Half of C's motion over the clip, on top of B. Held at the end: the clip doesn't loop.
+    aiQuaternion InvFirst = RotationC(0.0f);
+    InvFirst.Conjugate();
+    const aiQuaternion Motion = InvFirst * RotationC(Duration);
+    const aiVector3D Lift = PositionC(Duration) - PositionC(0.0f);
+    for (const float Time : { 2.0f, 3.5f }) {
+        Graph.Evaluate(Time, Pose);
+        CHECK(CheckChild(Pose, PositionB() + Lift * 0.5f, RotationB() * Nlerp(aiQuaternion(), Motion, 0.5), "Additive end"));
+    }
+
+    // Halfway through C
+    Graph.Play(Layer, C, 4.0f, 0.0f, 1.0f, false);
+    Graph.Evaluate(4.5f, Pose);
+    const aiQuaternion HalfMotion = InvFirst * RotationC(0.5f * Duration);
+    CHECK(CheckChild(Pose, PositionB() + (PositionC(0.5f * Duration) - PositionC(0.0f)) * 0.5f,
+        RotationB() * Nlerp(aiQuaternion(), HalfMotion, 0.5), "Additive middle"));
+
+    // Full weight adds all of it, no weight nothing
+    Graph.SetLayerWeight(Layer, 1.0f);
+    Graph.Evaluate(6.0f, Pose);
+    CHECK(CheckChild(Pose, PositionB() + Lift, RotationB() * Motion, "Additive full"));
+    Graph.SetLayerWeight(Layer, 0.0f);
+    Graph.Evaluate(6.0f, Pose);
+    CHECK(CheckChild(Pose, PositionB(), RotationB(), "Additive off"));
+
+    // Fading the layer out over two seconds
+    Graph.SetLayerWeight(Layer, 1.0f);
+    Graph.Stop(Layer, 7.0f, 2.0f);
+    Graph.Evaluate(7.5f, Pose);
+    CHECK(CheckChild(Pose, PositionB() + Lift * 0.75f, RotationB() * Nlerp(aiQuaternion(), Motion, 0.75), "Additive fade out"));
+}
+
+void TestNlerp()
+{
+    std::mt19937 Random(8);
+    std::normal_distribution<float> Gauss;
+    std::uniform_real_distribution<float> Factor(0.0f, 1.0f);
+    float MaxDifference = 0.0f;
+    for (int i = 0; i < 10000; i++) {
+        aiQuaternion A(Gauss(Random), Gauss(Random), Gauss(Random), Gauss(Random));
+        aiQuaternion B(Gauss(Random), Gauss(Random), Gauss(Random), Gauss(Random));
+        A.Normalize();
+        B.Normalize();
+        // Both ends, and B on either side of A
+        const float f = i % 10 == 0 ? 0.0f : i % 10 == 1 ? 1.0f : Factor(Random);
+
+        aiQuaternion Simd, Scalar;
+        Animation::Nlerp(Simd, A, B, f);
+        Animation::NlerpScalar(Scalar, A, B, f);
+        MaxDifference = std::max(MaxDifference, std::max(std::max(std::abs(Simd.w - Scalar.w), std::abs(Simd.x - Scalar.x)),
+                                                    std::max(std::abs(Simd.y - Scalar.y), std::abs(Simd.z - Scalar.z))));
+        if (i < 100) {
+            CHECK(Angle(Scalar, Nlerp(A, B, f)) < 1e-3f);
+        }
+    }
+    printf("Nlerp: SSE and scalar differ by %.2e at most\n", MaxDifference);
+    CHECK(MaxDifference < 1e-6f);
+
+    // In place, as the blends call it
+    aiQuaternion Q = RotationA();
+    Animation::Nlerp(Q, Q, RotationB(), 0.3f);
+    CHECK(Angle(Q, Nlerp(RotationA(), RotationB(), 0.3)) < 1e-5f);
+}
+
+}
+
+int main()
+{
+    Rig r;
+    MakeRig(r);
+    TestCrossFade(r);
+    TestAdditive(r);
+    TestNlerp();
+    return Check::Result();
+}
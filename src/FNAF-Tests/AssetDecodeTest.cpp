@@ -0,0 +1,346 @@
+#include "Objects/AssetLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "StagingPool.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
+
+// The CPU stage of asset loading, without a GL context: mip chains, decode, the baked texture
+// cache, the material texture fan-out and the bounded upload queue.
+namespace {
+
+const std::string TestDir = "AssetDecodeData"; // next to the executable, removed at the end
+
+ImageData MakeImage(unsigned int Width, unsigned int Height, unsigned int Seed, bool Opaque)
+{
+    ImageData Image;
+    Image.Width = Width;
+    Image.Height = Height;
+    Image.Pitch = Width * 4;
+    Image.Levels = 1;
+    Image.Pixels = StagingPool::Get().Acquire(size_t(Width) * Height * 4);
+
+    std::mt19937 Random(Seed);
+    for (size_t i = 0; i < Image.Pixels.size(); i++) {
+        Image.Pixels[i] = Opaque && i % 4 == 3 ? 255 : static_cast<unsigned char>(Random());
+    }
+    return Image;
+}
+
+// 32 bit uncompressed BMP, rows bottom-up like ImageData
+void WriteBmp(const std::string& Filename, const ImageData& Image)
+{
+    const uint32_t PixelBytes = Image.Pitch * Image.Height;
+    unsigned char Header[54] = { 'B', 'M' };
+    auto Put32 = [&](unsigned int Offset, uint32_t Value) { memcpy(Header + Offset, &Value, 4); };
+    Put32(2, sizeof(Header) + PixelBytes);
+    Put32(10, sizeof(Header));
+    Put32(14, 40);
+    Put32(18, Image.Width);
+    Put32(22, Image.Height);
+    Header[26] = 1; // planes
+    Header[28] = 32; // bits per pixel
+    Put32(34, PixelBytes);
+
+    std::ofstream Out(Filename, std::ios::binary | std::ios::trunc);
+    Out.write(reinterpret_cast<const char*>(Header), sizeof(Header));
+    Out.write(reinterpret_cast<const char*>(Image.Pixels.data()), PixelBytes);
+}
+
+void TestMipMath()
+{
+    CHECK(GetMipLevels(1, 1) == 1);
+    CHECK(GetMipLevels(8, 4) == 4);
+    CHECK(GetMipLevels(5, 3) == 3);
+    CHECK(GetMipOffset(8, 4, 1) == 8 * 4 * 4);
+    CHECK(GetMipOffset(8, 4, 3) == (8 * 4 + 4 * 2 + 2 * 1) * 4);
+
+    ImageData Blocks;
+    Blocks.Width = 8;
+    Blocks.Height = 4;
+    Blocks.CompressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    CHECK(GetLevelSize(Blocks, 0) == 2 * 8);
+    CHECK(GetLevelSize(Blocks, 3) == 8); // 1x1 still takes a whole block
+    Blocks.CompressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    CHECK(GetLevelOffset(Blocks, 2) == 2 * 16 + 16);
+}
+
+// Odd sizes clamp at the edges, widths of 8 and more take the SSE2 path: both against a plain box filter
+void TestMipChain(unsigned int Width, unsigned int Height)
+{
+    ImageData Image = MakeImage(Width, Height, Width * 31 + Height, false);
+    const std::vector<unsigned char> Level0(Image.Pixels.begin(), Image.Pixels.end());
+    BuildMipChain(Image);
+
+    const unsigned int Levels = GetMipLevels(Width, Height);
+    CHECK(Image.Levels == Levels);
+    if (!CHECK(Image.Pixels.size() >= GetMipOffset(Width, Height, Levels))) {
+        return;
+    }
+    CHECK(memcmp(Image.Pixels.data(), Level0.data(), Level0.size()) == 0);
+
+    unsigned int Mismatches = 0;
+    for (unsigned int Level = 1; Level < Levels; Level++) {
+        const unsigned int SrcWidth = std::max(Width >> (Level - 1), 1u);
+        const unsigned int SrcHeight = std::max(Height >> (Level - 1), 1u);
+        const unsigned int DstWidth = std::max(Width >> Level, 1u);
+        const unsigned int DstHeight = std::max(Height >> Level, 1u);
+        const unsigned char* Src = Image.Pixels.data() + GetMipOffset(Width, Height, Level - 1);
+        const unsigned char* Dst = Image.Pixels.data() + GetMipOffset(Width, Height, Level);
+
+        for (unsigned int y = 0; y < DstHeight; y++) {
+            for (unsigned int x = 0; x < DstWidth; x++) {
+                const unsigned int x0 = std::min(2 * x, SrcWidth - 1), x1 = std::min(2 * x + 1, SrcWidth - 1);
+                const unsigned int y0 = std::min(2 * y, SrcHeight - 1), y1 = std::min(2 * y + 1, SrcHeight - 1);
+                for (unsigned int c = 0; c < 4; c++) {
+                    const unsigned int Sum = Src[(y0 * SrcWidth + x0) * 4 + c] + Src[(y0 * SrcWidth + x1) * 4 + c]
+                        + Src[(y1 * SrcWidth + x0) * 4 + c] + Src[(y1 * SrcWidth + x1) * 4 + c];
+                    Mismatches += Dst[(y * DstWidth + x) * 4 + c] == (Sum + 2) / 4 ? 0 : 1;
+                }
+            }
+        }
+    }
+    CHECK(Mismatches == 0);
+
+    // Blocks have no chain to build
+    Image.CompressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    Image.Levels = 1;
+    BuildMipChain(Image);
+    CHECK(Image.Levels == 1);
+    ReleaseImage(Image);
+    CHECK(!Image.Valid() && Image.Width == 0);
+}
+
+void TestDecode()
+{
+    const std::string Filename = TestDir + "/Decode.bmp";
+    ImageData Source = MakeImage(13, 6, 3, true);
+    WriteBmp(Filename, Source);
+
+    ImageData Image;
+    if (CHECK(DecodeImage(Filename, Image))) {
+        CHECK(Image.Width == 13 && Image.Height == 6 && Image.Pitch == 13 * 4 && Image.Levels == GetMipLevels(13, 6));
+        CHECK(Image.CompressedFormat == 0);
+        CHECK(memcmp(Image.Pixels.data(), Source.Pixels.data(), Source.Pixels.size()) == 0);
+    }
+    CHECK(DecodeImage(Filename, Image, false) && Image.Levels == 1);
+    CHECK(!DecodeImage(TestDir + "/Missing.bmp", Image));
+    CHECK(!Image.Valid());
+
+    ReleaseImage(Image);
+    ReleaseImage(Source);
+}
+
+void TestTextureCache()
+{
+    // Load() only looks at the size and time of the source, it needn't be a real image
+    const std::string Source = TestDir + "/Wall.png";
+    std::ofstream(Source, std::ios::binary | std::ios::trunc) << "not really a png";
+
+    for (const bool Opaque : { true, false }) {
+        std::filesystem::remove(TextureCache::CachePath(Source));
+        ImageData Image = MakeImage(16, 12, 7, Opaque);
+        BuildMipChain(Image);
+
+        ImageData Compressed;
+        if (!CHECK(TextureCache::Encode(Image, TextureCache::Format::Auto, Compressed))) {
+            continue;
+        }
+        CHECK(Compressed.CompressedFormat == (Opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT));
+        CHECK(Compressed.Levels == GetMipLevels(16, 12));
+        const size_t Bytes = GetLevelOffset(Compressed, Compressed.Levels);
+        CHECK(Compressed.Pixels.size() >= Bytes);
+
+        ImageData Loaded;
+        CHECK(!TextureCache::Load(Source, Loaded));
+        CHECK(TextureCache::Write(Source, Compressed));
+        if (CHECK(TextureCache::Load(Source, Loaded))) {
+            CHECK(Loaded.Width == 16 && Loaded.Height == 12 && Loaded.Levels == Compressed.Levels);
+            CHECK(Loaded.CompressedFormat == Compressed.CompressedFormat);
+            CHECK(Loaded.Pixels.size() == Bytes && memcmp(Loaded.Pixels.data(), Compressed.Pixels.data(), Bytes) == 0);
+        }
+
+        ReleaseImage(Loaded);
+        ReleaseImage(Compressed);
+        ReleaseImage(Image);
+    }
+
+    // A truncated cache is refused
+    const std::string CachePath = TextureCache::CachePath(Source);
+    std::filesystem::resize_file(CachePath, sizeof(TextureCache::Header) + 8);
+    ImageData Loaded;
+    CHECK(!TextureCache::Load(Source, Loaded));
+
+    // So is a cache of an older source
+    ImageData Image = MakeImage(8, 8, 9, true);
+    BuildMipChain(Image);
+    ImageData Compressed;
+    CHECK(TextureCache::Encode(Image, TextureCache::Format::BC1, Compressed) && TextureCache::Write(Source, Compressed));
+    CHECK(TextureCache::Load(Source, Loaded));
+    std::ofstream(Source, std::ios::binary | std::ios::app) << "edited";
+    CHECK(!TextureCache::Load(Source, Loaded));
+
+    ReleaseImage(Loaded);
+    ReleaseImage(Compressed);
+    ReleaseImage(Image);
+}
+
+void TestMaterialTextures()
+{
+    // Material 0 has a baked cache, 1 no texture, 2 a decodable image, 3 a missing file
+    const std::string Baked = TestDir + "/Baked.png";
+    std::ofstream(Baked, std::ios::binary | std::ios::trunc) << "source";
+    ImageData Image = MakeImage(8, 4, 11, true);
+    BuildMipChain(Image);
+    ImageData Compressed;
+    CHECK(TextureCache::Encode(Image, TextureCache::Format::BC1, Compressed) && TextureCache::Write(Baked, Compressed));
+    WriteBmp(TestDir + "/Plain.bmp", Image);
+
+    std::vector<char> Strings;
+    auto AddString = [&](const std::string& s) {
+        const uint32_t Offset = static_cast<uint32_t>(Strings.size());
+        Strings.insert(Strings.end(), s.begin(), s.end());
+        Strings.push_back('\0');
+        return Offset;
+    };
+    std::vector<MeshCache::Material> Materials = { { AddString(Baked) }, { MeshCache::InvalidIndex }, { AddString(TestDir + "/Plain.bmp") } };
+
+    MeshCache::View View;
+    View.Strings = { Strings.data(), Strings.size() };
+    View.Materials = { Materials.data(), Materials.size() };
+
+    // The mesh sits in the working directory, its texture paths are relative to it
+    for (const bool Async : { false, true }) {
+        std::vector<ImageData> Images;
+        CHECK(AssetLoader::DecodeMaterialTextures(View, "Mesh.fbx", "/", Images, AssetLoader::GetCpuStagePool(Async)));
+        if (!CHECK(Images.size() == Materials.size())) {
+            continue;
+        }
+        CHECK(Images[0].CompressedFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT && Images[0].Levels == Compressed.Levels);
+        CHECK(!Images[1].Valid());
+        CHECK(Images[2].CompressedFormat == 0 && Images[2].Levels == Image.Levels);
+        CHECK(Images[2].Valid() && memcmp(Images[2].Pixels.data(), Image.Pixels.data(), Image.Pitch * Image.Height) == 0);
+
+        // Reusing the vector releases the previous images first
+        Materials.push_back({ AddString(TestDir + "/Missing.png") });
+        View.Strings = { Strings.data(), Strings.size() };
+        View.Materials = { Materials.data(), Materials.size() };
+        CHECK(!AssetLoader::DecodeMaterialTextures(View, "Mesh.fbx", "/", Images, AssetLoader::GetCpuStagePool(Async)));
+        CHECK(Images.size() == Materials.size() && !Images[3].Valid() && Images[0].Valid());
+        Materials.pop_back();
+        View.Materials = { Materials.data(), Materials.size() };
+
+        for (ImageData& i : Images) {
+            ReleaseImage(i);
+        }
+    }
+
+    ReleaseImage(Compressed);
+    ReleaseImage(Image);
+}
+
+void TestUploadQueue()
+{
+    constexpr size_t Capacity = 100;
+    UploadQueue Queue(Capacity);
+    const size_t Sizes[] = { 60, 60, 30, 500, 10 };
+    constexpr unsigned int NumUploads = sizeof(Sizes) / sizeof(Sizes[0]);
+
+    std::vector<unsigned int> Order;
+    std::atomic<bool> OverCapacity = false;
+
+    // The producer blocks on the full queue until the consumer below drains it
+    std::thread Producer([&]() {
+        for (unsigned int i = 0; i < NumUploads; i++) {
+            Queue.Push(Sizes[i], [&Order, i]() { Order.push_back(i); });
+        }
+    });
+
+    while (Order.size() < NumUploads) {
+        Queue.WaitForUploads();
+        if (Queue.GetQueuedCount() > 1 && Queue.GetQueuedBytes() > Capacity) {
+            OverCapacity = true;
+        }
+        // A zero budget still runs one upload per call
+        const size_t Before = Order.size();
+        const size_t Uploaded = Queue.Drain(0);
+        CHECK(Order.size() == Before + 1 && Uploaded == Sizes[Order.back()]);
+    }
+    Producer.join();
+
+    CHECK(!OverCapacity);
+    CHECK((Order == std::vector<unsigned int> { 0, 1, 2, 3, 4 }));
+    CHECK(Queue.GetQueuedCount() == 0 && Queue.GetQueuedBytes() == 0);
+
+    // A budget runs uploads in order until the next one would exceed it
+    Order.clear();
+    for (unsigned int i = 0; i < 3; i++) {
+        Queue.Push(30, [&Order, i]() { Order.push_back(i); });
+    }
+    CHECK(Queue.Drain(70) == 60);
+    CHECK(Queue.Drain(1000) == 30);
+    CHECK(Queue.Drain(1000) == 0);
+    CHECK((Order == std::vector<unsigned int> { 0, 1, 2 }));
+}
+
+void TestParallelFor()
+{
+    ThreadPool Pool(3);
+    std::vector<std::atomic<int>> Hits(1000);
+    std::atomic<bool> NestedDone = true; // checks only run on the calling thread
+    Pool.ParallelFor(0, static_cast<unsigned int>(Hits.size()), 7, [&](unsigned int i) {
+        Hits[i]++;
+        // Nested loops wait by helping out, so a job can fan out on its own pool
+        if (i % 100 == 0) {
+            std::atomic<int> Inner = 0;
+            Pool.ParallelFor(0, 50, 1, [&](unsigned int) { Inner++; });
+            if (Inner != 50) {
+                NestedDone = false;
+            }
+        }
+    });
+    CHECK(NestedDone);
+
+    bool Once = true;
+    for (const std::atomic<int>& h : Hits) {
+        Once = Once && h == 1;
+    }
+    CHECK(Once);
+
+    unsigned int Calls = 0;
+    Pool.ParallelFor(5, 5, 1, [&](unsigned int) { Calls++; });
+    CHECK(Calls == 0);
+}
+
+}
+
+int main()
+{
+    std::filesystem::create_directories(TestDir);
+
+    TestMipMath();
+    TestMipChain(1, 1);
+    TestMipChain(5, 3);
+    TestMipChain(37, 20);
+    TestMipChain(64, 1);
+    TestDecode();
+    TestTextureCache();
+    TestMaterialTextures();
+    TestUploadQueue();
+    TestParallelFor();
+
+    std::filesystem::remove_all(TestDir);
+    return Check::Result();
+}
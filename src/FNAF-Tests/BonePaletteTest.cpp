@@ -0,0 +1,184 @@
+#include "Objects/BonePalette.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <assimp/matrix4x4.inl>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.h"
+
+namespace {
+
+void TestPackPalette()
+{
+    std::vector<aiMatrix4x4> Palette(3);
+    for (unsigned int m = 0; m < Palette.size(); m++) {
+        float* p = &Palette[m].a1;
+        for (int i = 0; i < 16; i++) {
+            p[i] = float(m * 100 + i);
+        }
+    }
+
+    std::vector<BonePalette::Mat3x4> Packed(Palette.size());
+    BonePalette::Pack(Palette.data(), static_cast<unsigned int>(Palette.size()), Packed.data());
+    for (unsigned int m = 0; m < Palette.size(); m++) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                CHECK(Packed[m].Rows[r][c] == Palette[m][r][c]);
+            }
+        }
+    }
+}
+
+void TestPackModel()
+{
+    glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+    M = glm::rotate(M, 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+    M = glm::scale(M, glm::vec3(2.0f));
+
+    BonePalette::Mat3x4 Packed;
+    BonePalette::Pack(M, Packed);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            CHECK(Packed.Rows[r][c] == M[c][r]);
+        }
+    }
+
+    // The shader transforms with dot(row, vec4(p, 1))
+    const glm::vec3 p(0.5f, -1.0f, 4.0f);
+    const glm::vec4 Expected = M * glm::vec4(p, 1.0f);
+    for (int r = 0; r < 3; r++) {
+        const float* Row = Packed.Rows[r];
+        CHECK_NEAR(Row[0] * p.x + Row[1] * p.y + Row[2] * p.z + Row[3], Expected[r], 1e-5);
+    }
+}
+
+void TestRingBasics()
+{
+    constexpr uint32_t Invalid = BonePalette::RingAllocator::InvalidOffset;
+    BonePalette::RingAllocator Ring;
+    Ring.Init(16);
+
+    CHECK(Ring.Allocate(0) == Invalid);
+    CHECK(Ring.Allocate(17) == Invalid);
+    CHECK(!Ring.Retire());
+
+    CHECK(Ring.Allocate(6) == 0);
+    CHECK(Ring.Allocate(6) == 6);
+    CHECK(Ring.Allocate(6) == Invalid); // 4 left at the end, none at the front
+    CHECK(Ring.GetUsed() == 12);
+    Ring.EndFrame();
+    CHECK(Ring.GetNumFramesInFlight() == 1);
+
+    CHECK(Ring.Retire());
+    CHECK(Ring.GetUsed() == 0);
+    CHECK(Ring.Allocate(16) == 0); // an empty ring starts over at the front
+    Ring.EndFrame();
+    CHECK(Ring.Retire());
+
+    // Empty frames are retired like any other
+    Ring.EndFrame();
+    CHECK(Ring.GetNumFramesInFlight() == 1);
+    CHECK(Ring.Retire());
+    CHECK(Ring.GetUsed() == 0);
+}
+
+void TestRingWrap()
+{
+    constexpr uint32_t Invalid = BonePalette::RingAllocator::InvalidOffset;
+    BonePalette::RingAllocator Ring;
+    Ring.Init(16);
+
+    CHECK(Ring.Allocate(10) == 0);
+    Ring.EndFrame();
+    CHECK(Ring.Allocate(4) == 10);
+    Ring.EndFrame();
+    CHECK(Ring.Retire()); // [0, 10) free again, [10, 14) in flight
+
+    // 2 slots left at the end: skipped, the allocation starts over at the front
+    CHECK(Ring.Allocate(6) == 0);
+    CHECK(Ring.GetUsed() == 4 + 2 + 6);
+    CHECK(Ring.Allocate(5) == Invalid);
+    CHECK(Ring.Allocate(4) == 6);
+    CHECK(Ring.GetUsed() == 16);
+    CHECK(Ring.Allocate(1) == Invalid);
+    Ring.EndFrame();
+
+    CHECK(Ring.Retire());
+    CHECK(Ring.GetUsed() == 12); // the padding stays held by the frame that skipped it
+    CHECK(Ring.Allocate(4) == 10);
+    CHECK(Ring.Allocate(1) == Invalid);
+    Ring.EndFrame();
+    CHECK(Ring.Retire());
+    CHECK(Ring.GetUsed() == 4);
+    CHECK(Ring.Retire());
+    CHECK(Ring.GetUsed() == 0);
+    CHECK(Ring.GetNumFramesInFlight() == 0);
+}
+
+// Random allocations and retirements: live ranges never overlap and the bookkeeping adds up
+void TestRingRandom()
+{
+    constexpr uint32_t Capacity = 64;
+    constexpr uint32_t Invalid = BonePalette::RingAllocator::InvalidOffset;
+    BonePalette::RingAllocator Ring;
+    Ring.Init(Capacity);
+
+    std::vector<int> Owner(Capacity, -1); // frame whose allocation holds each slot
+    int OpenFrame = 0;
+    int OldestFrame = 0;
+    std::mt19937 Random(1234);
+
+    for (int Step = 0; Step < 20000; Step++) {
+        const unsigned int Action = Random() % 10;
+        if (Action < 6) {
+            const uint32_t Count = 1 + Random() % 12;
+            const uint32_t Offset = Ring.Allocate(Count);
+            if (Offset != Invalid) {
+                if (!CHECK(Offset + Count <= Capacity)) {
+                    return;
+                }
+                for (uint32_t s = Offset; s < Offset + Count; s++) {
+                    if (!CHECK(Owner[s] < 0)) {
+                        return;
+                    }
+                    Owner[s] = OpenFrame;
+                }
+            } else if (Ring.GetNumFramesInFlight() == 0 && Ring.GetUsed() == 0) {
+                CHECK(Count > Capacity); // an empty ring fits everything up to its capacity
+            }
+        } else if (Action < 8 || Ring.GetNumFramesInFlight() == 0) {
+            Ring.EndFrame();
+            OpenFrame++;
+        } else {
+            CHECK(Ring.Retire());
+            for (int& o : Owner) {
+                if (o == OldestFrame) {
+                    o = -1;
+                }
+            }
+            OldestFrame++;
+        }
+
+        uint32_t Live = 0;
+        for (int o : Owner) {
+            Live += o >= 0 ? 1 : 0;
+        }
+        if (!CHECK(Live <= Ring.GetUsed() && Ring.GetUsed() <= Capacity)) {
+            return;
+        }
+    }
+}
+
+}
+
+int main()
+{
+    TestPackPalette();
+    TestPackModel();
+    TestRingBasics();
+    TestRingWrap();
+    TestRingRandom();
+    return Check::Result();
+}
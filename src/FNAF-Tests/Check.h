@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the test executables: every failed check is printed with its location and
+// main returns Check::Result(), so ctest reports the executable as failed.
+namespace Check {
+
+inline int sFailures = 0;
+
+inline bool Report(bool Passed, const char* pExpression, const char* pFile, int Line)
+{
+    if (!Passed) {
+        printf("%s:%d: check failed: %s\n", pFile, Line, pExpression);
+        sFailures++;
+    }
+    return Passed;
+}
+
+inline bool Near(double A, double B, double Tolerance)
+{
+    return std::abs(A - B) <= Tolerance;
+}
+
+// Per component, for anything with x, y and z (glm::vec3, aiVector3D, ...)
+template <typename Vec3>
+bool Near3(const Vec3& A, const Vec3& B, double Tolerance)
+{
+    return Near(A.x, B.x, Tolerance) && Near(A.y, B.y, Tolerance) && Near(A.z, B.z, Tolerance);
+}
+
+inline int Result()
+{
+    if (sFailures > 0) {
+        printf("%d check(s) failed\n", sFailures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+
+}
+
+#define CHECK(Expression) Check::Report(static_cast<bool>(Expression), #Expression, __FILE__, __LINE__)
+#define CHECK_NEAR(A, B, Tolerance) \
+    Check::Report(Check::Near((A), (B), (Tolerance)), #A " ~= " #B, __FILE__, __LINE__)
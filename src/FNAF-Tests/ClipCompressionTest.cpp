@@ -0,0 +1,223 @@
+#include "Objects/Animation.h"
+#include "Objects/ClipCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <assimp/matrix4x4.inl>
+#include <assimp/quaternion.inl>
+#include <assimp/vector3.inl>
+
+#include "Check.h"
+
+namespace {
+
+constexpr unsigned int NumKeys = 301;
+constexpr float Duration = 300.0f; // ticks, one key per tick
+// Smallest-three: each stored component is off by at most half a step of 2/sqrt(2)/32767, the rebuilt
+// largest one by up to sqrt(3) times that, and the angle is twice the quaternion error
+constexpr float RotationQuantization = 2.0f * (1.0f + 1.7320508f) * 1.7320508f * 0.70710678f / 32767.0f;
+
+// Root, a child one unit above it and a tip one unit above that: bind pose reaches 2, 1 and 0
+struct Rig {
+    std::vector<char> Strings;
+    std::vector<MeshCache::Node> Nodes;
+    std::vector<MeshCache::Channel> Channels;
+    std::vector<MeshCache::VectorKey> PositionKeys, ScalingKeys;
+    std::vector<MeshCache::QuatKey> RotationKeys;
+    MeshCache::Animation Anim {};
+    MeshCache::View View;
+};
+
+uint32_t AddString(std::vector<char>& Strings, const char* s)
+{
+    const auto Offset = static_cast<uint32_t>(Strings.size());
+    Strings.insert(Strings.end(), s, s + strlen(s) + 1);
+    return Offset;
+}
+
+void MakeRig(Rig& r)
+{
+    const char* Names[] = { "root", "child", "tip" };
+    for (int n = 0; n < 3; n++) {
+        aiMatrix4x4 Transformation;
+        if (n > 0) {
+            aiMatrix4x4::Translation(aiVector3D(0.0f, 1.0f, 0.0f), Transformation);
+        }
+        r.Nodes.push_back({ n - 1, AddString(r.Strings, Names[n]), Transformation });
+    }
+
+    // Every node rotates, the root also walks and the child breathes, the tip has constant tracks
+    for (unsigned int n = 0; n < 3; n++) {
+        MeshCache::Channel Channel { r.Nodes[n].Name, static_cast<uint32_t>(r.PositionKeys.size()), NumKeys,
+            static_cast<uint32_t>(r.RotationKeys.size()), NumKeys, static_cast<uint32_t>(r.ScalingKeys.size()), NumKeys };
+        for (unsigned int k = 0; k < NumKeys; k++) {
+            const float t = float(k);
+            const aiVector3D Position = n == 0 ? aiVector3D(0.01f * t, 0.2f * std::sin(t * 0.05f), 0.0f) : aiVector3D(0.0f, 1.0f, 0.0f);
+            const aiVector3D Scaling = n == 1 ? aiVector3D(1.0f + 0.1f * std::sin(t * 0.03f)) : aiVector3D(1.0f);
+            const float Angle = n == 2 ? 0.3f : 0.8f * std::sin(t * (0.02f + 0.01f * n)) + 0.05f * std::sin(t * 0.4f);
+            r.PositionKeys.push_back({ t, Position });
+            r.RotationKeys.push_back({ t, aiQuaternion(aiVector3D(0.3f, 1.0f, float(n)).Normalize(), Angle) });
+            r.ScalingKeys.push_back({ t, Scaling });
+        }
+        r.Channels.push_back(Channel);
+    }
+    r.Anim = { AddString(r.Strings, "walk"), Duration, 30.0f, 0, static_cast<uint32_t>(r.Channels.size()) };
+
+    r.View.Strings = { r.Strings.data(), r.Strings.size() };
+    r.View.Nodes = { r.Nodes.data(), r.Nodes.size() };
+    r.View.Channels = { r.Channels.data(), r.Channels.size() };
+    r.View.Animations = { &r.Anim, 1 };
+    r.View.PositionKeys = { r.PositionKeys.data(), r.PositionKeys.size() };
+    r.View.RotationKeys = { r.RotationKeys.data(), r.RotationKeys.size() };
+    r.View.ScalingKeys = { r.ScalingKeys.data(), r.ScalingKeys.size() };
+}
+
+// The uncompressed tracks, sampled the way Animation did before compression
+template <typename Key, typename Value, typename Lerp>
+Value SampleSource(const Key* pKeys, float Time, Lerp&& Interpolate)
+{
+    const unsigned int i = std::min(static_cast<unsigned int>(Time), NumKeys - 2);
+    return Interpolate(pKeys[i].Value, pKeys[i + 1].Value, std::clamp(Time - pKeys[i].Time, 0.0f, 1.0f));
+}
+
+// Angle of the relative rotation conj(A) * B, in double. Not the acos of the dot product: float
+// quaternions are only unit length to about 1e-7, which alone reads as 1e-3 radians that way.
+float Angle(const aiQuaternion& A, const aiQuaternion& B)
+{
+    const double aw = A.w, ax = A.x, ay = A.y, az = A.z;
+    const double bw = B.w, bx = B.x, by = B.y, bz = B.z;
+    const double w = aw * bw + ax * bx + ay * by + az * bz;
+    const double x = aw * bx - bw * ax - (ay * bz - az * by);
+    const double y = aw * by - bw * ay - (az * bx - ax * bz);
+    const double z = aw * bz - bw * az - (ax * by - ay * bx);
+    return static_cast<float>(2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), std::abs(w)));
+}
+
+// Largest change per tick of a track, for the error the 16 bit key times add
+template <typename Key, typename Distance>
+float MaxSpeed(const Key* pKeys, Distance&& Dist)
+{
+    float Speed = 0.0f;
+    for (unsigned int k = 0; k + 1 < NumKeys; k++) {
+        Speed = std::max(Speed, Dist(pKeys[k].Value, pKeys[k + 1].Value) / (pKeys[k + 1].Time - pKeys[k].Time));
+    }
+    return Speed;
+}
+
+void TestRotationEncoding()
+{
+    std::mt19937 Random(3);
+    std::normal_distribution<float> Gauss;
+    float MaxError = 0.0f;
+    for (int i = 0; i < 10000; i++) {
+        aiQuaternion Q(Gauss(Random), Gauss(Random), Gauss(Random), Gauss(Random));
+        Q.Normalize();
+        uint16_t Encoded[3];
+        ClipCompression::EncodeRotation(Q, Encoded);
+        MaxError = std::max(MaxError, Angle(ClipCompression::DecodeRotation(Encoded), Q));
+    }
+    printf("Smallest-three rotations: %.2e rad worst error\n", MaxError);
+    CHECK(MaxError <= RotationQuantization);
+}
+
+void TestCompress()
+{
+    Rig r;
+    MakeRig(r);
+
+    const ClipCompression::Settings Options;
+    ClipCompression::Clip Clip;
+    ClipCompression::Stats Stats;
+    ClipCompression::Compress(r.View, r.Anim, Options, Clip, &Stats);
+    printf("Clip: %zu of %zu keys kept, %zu of %zu bytes\n", Stats.Keys, Stats.SourceKeys, Stats.Bytes, Stats.SourceBytes);
+    if (!CHECK(Clip.GetNumChannels() == 3)) {
+        return;
+    }
+    CHECK(Stats.SourceKeys == 9 * NumKeys);
+    CHECK(Stats.Keys < Stats.SourceKeys / 2);
+    CHECK(Stats.Bytes < Stats.SourceBytes / 4);
+
+    // Constant tracks keep a single key
+    CHECK(Clip.Tracks[2 * ClipCompression::NumTrackTypes + ClipCompression::Translation].NumKeys == 1);
+    CHECK(Clip.Tracks[2 * ClipCompression::NumTrackTypes + ClipCompression::Rotation].NumKeys == 1);
+    CHECK(Clip.Tracks[0 * ClipCompression::NumTrackTypes + ClipCompression::Scaling].NumKeys == 1);
+
+    // The error budget of Settings, plus half a quantization step and the motion within half a key time step.
+    // Translations: a fraction of the largest extent. Rotations and scalings: the bone's own limit, or
+    // whatever keeps the joints below it within MaxJointError of the skeleton size (2 units).
+    const float TimeSlack = 0.5f / Clip.TimeToKey;
+    const aiVector3D Extent = Clip.TranslationStep * 65535.0f;
+    const float TranslationBudget = Options.MaxTranslationError * std::max(Extent.x, std::max(Extent.y, Extent.z))
+        + 0.5f * Clip.TranslationStep.Length();
+    const float ScalingQuantization = 0.5f * Clip.ScalingStep.Length();
+    const float Reach[] = { 2.0f, 1.0f, 0.0f };
+    const float JointTolerance = Options.MaxJointError * 2.0f;
+    auto BoneBudget = [&](float MaxError, unsigned int n) { return Reach[n] > 0.0f ? std::min(MaxError, JointTolerance / Reach[n]) : MaxError; };
+
+    auto Lerp = [](const aiVector3D& A, const aiVector3D& B, float f) { return A + (B - A) * f; };
+    auto Nlerp = [](const aiQuaternion& A, const aiQuaternion& B, float f) {
+        aiQuaternion Out;
+        Animation::Nlerp(Out, A, B, f);
+        return Out;
+    };
+    auto Distance = [](const aiVector3D& A, const aiVector3D& B) { return (A - B).Length(); };
+
+    for (unsigned int n = 0; n < 3; n++) {
+        const MeshCache::Channel& Channel = r.Channels[n];
+        const MeshCache::VectorKey* pPositions = r.PositionKeys.data() + Channel.FirstPosition;
+        const MeshCache::QuatKey* pRotations = r.RotationKeys.data() + Channel.FirstRotation;
+        const MeshCache::VectorKey* pScalings = r.ScalingKeys.data() + Channel.FirstScaling;
+
+        const float TranslationLimit = TranslationBudget + MaxSpeed(pPositions, Distance) * TimeSlack;
+        const float RotationLimit = BoneBudget(Options.MaxRotationError, n) + RotationQuantization + MaxSpeed(pRotations, Angle) * TimeSlack;
+        const float ScalingLimit = BoneBudget(Options.MaxScalingError, n) + ScalingQuantization + MaxSpeed(pScalings, Distance) * TimeSlack;
+
+        // Every source key and the middle of every source segment, in playback order so the cursors move
+        float TranslationError = 0.0f, RotationError = 0.0f, ScalingError = 0.0f;
+        KeyCursor Cursor;
+        for (unsigned int s = 0; s < 2 * (NumKeys - 1) + 1; s++) {
+            const float t = 0.5f * s;
+            aiVector3D T, S;
+            aiQuaternion R;
+            ClipCompression::SampleTranslation(Clip, n, t, Cursor.Position, T);
+            ClipCompression::SampleRotation(Clip, n, t, Cursor.Rotation, R);
+            ClipCompression::SampleScaling(Clip, n, t, Cursor.Scaling, S);
+            TranslationError = std::max(TranslationError, Distance(T, SampleSource<MeshCache::VectorKey, aiVector3D>(pPositions, t, Lerp)));
+            RotationError = std::max(RotationError, Angle(R, SampleSource<MeshCache::QuatKey, aiQuaternion>(pRotations, t, Nlerp)));
+            ScalingError = std::max(ScalingError, Distance(S, SampleSource<MeshCache::VectorKey, aiVector3D>(pScalings, t, Lerp)));
+        }
+        printf("%-5s translation %.2e (limit %.2e), rotation %.2e (%.2e), scaling %.2e (%.2e)\n", r.View.String(Channel.NodeName),
+            TranslationError, TranslationLimit, RotationError, RotationLimit, ScalingError, ScalingLimit);
+        CHECK(TranslationError <= TranslationLimit);
+        CHECK(RotationError <= RotationLimit);
+        CHECK(ScalingError <= ScalingLimit);
+    }
+
+    // Random seeks through a cursor left anywhere decode the same as playback
+    std::mt19937 Random(11);
+    std::uniform_real_distribution<float> Seek(0.0f, Duration);
+    unsigned int Cursor = 0;
+    bool Same = true;
+    for (int i = 0; i < 1000; i++) {
+        const float t = Seek(Random);
+        unsigned int Fresh = 0;
+        aiQuaternion A, B;
+        ClipCompression::SampleRotation(Clip, 0, t, Cursor, A);
+        ClipCompression::SampleRotation(Clip, 0, t, Fresh, B);
+        Same = Same && A == B;
+    }
+    CHECK(Same);
+}
+
+}
+
+int main()
+{
+    TestRotationEncoding();
+    TestCompress();
+    return Check::Result();
+}
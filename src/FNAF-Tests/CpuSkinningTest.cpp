@@ -0,0 +1,109 @@
+#include "Objects/CpuSkinning.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <assimp/matrix4x4.inl>
+
+#include "Check.h"
+
+namespace {
+
+constexpr unsigned int NumBones = 12;
+constexpr unsigned int NumVertices = 1003; // not a multiple of any kernel's width, so tails run too
+constexpr double Tolerance = 1e-4;
+
+// Fixed palette: rotation, non-uniform scale and translation differing per bone
+std::vector<aiMatrix4x4> MakePalette()
+{
+    std::vector<aiMatrix4x4> Palette(NumBones);
+    for (unsigned int b = 0; b < NumBones; b++) {
+        aiMatrix4x4 Rotation, Scaling, Translation;
+        aiMatrix4x4::Rotation(0.3f * b, aiVector3D(1.0f, float(b % 3), 0.5f).Normalize(), Rotation);
+        aiMatrix4x4::Scaling(aiVector3D(1.0f + 0.1f * b, 1.0f, 0.8f), Scaling);
+        aiMatrix4x4::Translation(aiVector3D(float(b), -0.5f * b, 2.0f), Translation);
+        Palette[b] = Translation * Rotation * Scaling;
+    }
+    return Palette;
+}
+
+void MakeMesh(std::vector<MeshCache::Vertex>& Vertices, std::vector<MeshCache::VertexBoneData>& Bones)
+{
+    std::mt19937 Random(99);
+    std::uniform_real_distribution<float> Coord(-2.0f, 2.0f);
+    Vertices.resize(NumVertices);
+    Bones.resize(NumVertices);
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        Vertices[v].Pos = aiVector3D(Coord(Random), Coord(Random), Coord(Random));
+        Vertices[v].Normal = aiVector3D(Coord(Random), Coord(Random), Coord(Random)).Normalize();
+
+        // 1 to 4 influences, unused slots keep weight 0 like AddBoneData leaves them
+        const unsigned int NumInfluences = 1 + v % MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX;
+        float Sum = 0.0f;
+        for (unsigned int i = 0; i < NumInfluences; i++) {
+            Bones[v].IDs[i] = static_cast<unsigned char>(Random() % NumBones);
+            Bones[v].Weights[i] = 0.1f + (Random() % 100) / 100.0f;
+            Sum += Bones[v].Weights[i];
+        }
+        for (unsigned int i = 0; i < NumInfluences; i++) {
+            Bones[v].Weights[i] /= Sum;
+        }
+    }
+}
+
+}
+
+int main()
+{
+    const std::vector<aiMatrix4x4> Palette = MakePalette();
+    std::vector<MeshCache::Vertex> Vertices;
+    std::vector<MeshCache::VertexBoneData> Bones;
+    MakeMesh(Vertices, Bones);
+
+    // Reference: the weighted sum of the bone transforms, as skinned_mesh.vert computes it
+    std::vector<glm::vec3> RefPositions(NumVertices), RefNormals(NumVertices);
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        aiVector3D Position(0.0f), Normal(0.0f);
+        for (unsigned int i = 0; i < MeshCache::VertexBoneData::NUM_BONES_PER_VERTEX; i++) {
+            const aiMatrix4x4& M = Palette[Bones[v].IDs[i]];
+            const float w = Bones[v].Weights[i];
+            Position += (M * Vertices[v].Pos) * w;
+            Normal += (aiMatrix3x3(M) * Vertices[v].Normal) * w;
+        }
+        RefPositions[v] = glm::vec3(Position.x, Position.y, Position.z);
+        RefNormals[v] = glm::vec3(Normal.x, Normal.y, Normal.z);
+    }
+
+    const CpuSkinning::Kernel Best = CpuSkinning::GetBestKernel();
+    for (const CpuSkinning::Kernel Kernel : { CpuSkinning::Kernel::Scalar, CpuSkinning::Kernel::SSE, CpuSkinning::Kernel::AVX2 }) {
+        if ((Kernel != CpuSkinning::Kernel::Scalar && Best == CpuSkinning::Kernel::Scalar)
+            || (Kernel == CpuSkinning::Kernel::AVX2 && Best != CpuSkinning::Kernel::AVX2)) {
+            printf("%s kernel not supported here, skipped\n", CpuSkinning::GetKernelName(Kernel));
+            continue;
+        }
+
+        std::vector<glm::vec3> Positions(NumVertices), Normals(NumVertices);
+        CpuSkinning::Skin(Kernel, Vertices.data(), Bones.data(), NumVertices, Palette.data(), NumBones, Positions.data(),
+            Normals.data());
+
+        unsigned int Mismatches = 0;
+        for (unsigned int v = 0; v < NumVertices; v++) {
+            Mismatches += Check::Near3(Positions[v], RefPositions[v], Tolerance) && Check::Near3(Normals[v], RefNormals[v], Tolerance) ? 0 : 1;
+        }
+        printf("%s kernel: %u of %u vertices differ from the reference\n", CpuSkinning::GetKernelName(Kernel), Mismatches,
+            NumVertices);
+        CHECK(Mismatches == 0);
+
+        // Positions only
+        std::vector<glm::vec3> PositionsOnly(NumVertices);
+        CpuSkinning::Skin(Kernel, Vertices.data(), Bones.data(), NumVertices, Palette.data(), NumBones, PositionsOnly.data(), nullptr);
+        CHECK(PositionsOnly == Positions);
+    }
+
+    // Without bones the rest pose is copied
+    std::vector<glm::vec3> Rest(NumVertices);
+    CpuSkinning::Skin(Vertices.data(), Bones.data(), NumVertices, Palette.data(), 0, Rest.data(), nullptr);
+    CHECK(Rest[5] == glm::vec3(Vertices[5].Pos.x, Vertices[5].Pos.y, Vertices[5].Pos.z));
+
+    return Check::Result();
+}
@@ -0,0 +1,91 @@
+#include "Objects/DrawBatch.h"
+
+#include <random>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+void TestGrouping()
+{
+    // Materials out of order, one empty item, one material used once
+    const std::vector<DrawBatch::DrawItem> Items = {
+        { 2, 30, 0, 0, 0 },
+        { 0, 6, 30, 100, 1 },
+        { 2, 12, 36, 200, 2 },
+        { 1, 0, 48, 0, 3 }, // nothing to draw
+        { 0, 9, 48, 300, 4 },
+        { 5, 3, 57, 400, 5 },
+    };
+
+    DrawBatch::DrawList List;
+    DrawBatch::Build(Items.data(), Items.size(), List);
+
+    CHECK(List.Commands.size() == 5);
+    CHECK(List.GetNumIndices() == 30 + 6 + 12 + 9 + 3);
+    if (!CHECK(List.Groups.size() == 3)) {
+        return;
+    }
+
+    CHECK(List.Groups[0].Material == 0 && List.Groups[0].FirstCommand == 0 && List.Groups[0].NumCommands == 2);
+    CHECK(List.Groups[1].Material == 2 && List.Groups[1].FirstCommand == 2 && List.Groups[1].NumCommands == 2);
+    CHECK(List.Groups[2].Material == 5 && List.Groups[2].FirstCommand == 4 && List.Groups[2].NumCommands == 1);
+
+    // Input order kept within a material, every field carried over
+    const DrawBatch::DrawElementsIndirectCommand& c = List.Commands[1];
+    CHECK(c.Count == 9 && c.InstanceCount == 1 && c.FirstIndex == 48 && c.BaseVertex == 300 && c.BaseInstance == 4);
+    CHECK(List.Commands[0].BaseInstance == 1);
+    CHECK(List.Commands[2].BaseInstance == 0);
+    CHECK(List.Commands[3].BaseInstance == 2);
+
+    // Rebuilding replaces the previous list
+    DrawBatch::Build(Items.data(), 1, List);
+    CHECK(List.Commands.size() == 1 && List.Groups.size() == 1);
+    DrawBatch::Build(nullptr, 0, List);
+    CHECK(List.Commands.empty() && List.Groups.empty());
+}
+
+// Many random items: the groups tile the commands in ascending material order and nothing is lost
+void TestRandom()
+{
+    std::mt19937 Random(5);
+    std::vector<DrawBatch::DrawItem> Items(2000);
+    size_t Expected = 0;
+    for (unsigned int i = 0; i < Items.size(); i++) {
+        Items[i] = { static_cast<unsigned int>(Random() % 37), static_cast<unsigned int>(Random() % 4) * 3, i * 10, 0, i };
+        Expected += Items[i].Count;
+    }
+
+    DrawBatch::DrawList List;
+    DrawBatch::Build(Items.data(), Items.size(), List);
+    CHECK(List.GetNumIndices() == Expected);
+
+    unsigned int Next = 0;
+    bool Tiled = true;
+    bool Ascending = true;
+    bool Matching = true;
+    for (size_t g = 0; g < List.Groups.size(); g++) {
+        const DrawBatch::Group& Group = List.Groups[g];
+        Tiled = Tiled && Group.FirstCommand == Next && Group.NumCommands > 0;
+        Ascending = Ascending && (g == 0 || List.Groups[g - 1].Material < Group.Material);
+        for (unsigned int c = Group.FirstCommand; c < Group.FirstCommand + Group.NumCommands; c++) {
+            const DrawBatch::DrawItem& Item = Items[List.Commands[c].BaseInstance];
+            Matching = Matching && Item.Material == Group.Material && Item.Count == List.Commands[c].Count
+                && (c == Group.FirstCommand || List.Commands[c - 1].BaseInstance < List.Commands[c].BaseInstance);
+        }
+        Next = Group.FirstCommand + Group.NumCommands;
+    }
+    CHECK(Tiled && Next == List.Commands.size());
+    CHECK(Ascending);
+    CHECK(Matching);
+}
+
+}
+
+int main()
+{
+    TestGrouping();
+    TestRandom();
+    return Check::Result();
+}
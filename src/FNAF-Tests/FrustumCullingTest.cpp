@@ -0,0 +1,183 @@
+#include "Objects/FrustumCulling.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.h"
+#include "Timer.h"
+
+// FrustumCulling publishes its statistics to the timer UI, which needs ImGui and a GL context
+void TimerGui::SetCounter(const std::string&, double) { }
+
+namespace {
+
+const char* PlaneNames[] = { "left", "right", "bottom", "top", "near", "far" };
+
+struct Box {
+    glm::vec3 Min, Max;
+    uint8_t Expected;
+};
+
+glm::vec3 Unproject(const glm::mat4& PV, const glm::vec3& Ndc)
+{
+    const glm::vec4 p = glm::inverse(PV) * glm::vec4(Ndc, 1.0f);
+    return glm::vec3(p) / p.w;
+}
+
+// Culls with both paths, checks they agree on every box and with the expected result where there is one
+unsigned int CullBoth(const FrustumCulling::Frustum& F, const std::vector<Box>& Boxes, bool CheckExpected, std::vector<uint8_t>& Visible)
+{
+    FrustumCulling::EntryBounds Bounds;
+    Bounds.Resize(Boxes.size());
+    for (size_t i = 0; i < Boxes.size(); i++) {
+        Bounds.Set(i, Boxes[i].Min, Boxes[i].Max);
+    }
+
+    // One past the end, to see the padding lanes aren't written
+    Visible.assign(Boxes.size() + 1, 2);
+    std::vector<uint8_t> Scalar(Boxes.size() + 1, 2);
+    FrustumCulling::Cull(F, Bounds, Visible.data());
+    FrustumCulling::CullScalar(F, Bounds, Scalar.data());
+    CHECK(Visible.back() == 2 && Scalar.back() == 2);
+    Visible.pop_back();
+    Scalar.pop_back();
+
+    unsigned int Mismatches = 0;
+    for (size_t i = 0; i < Boxes.size(); i++) {
+        const bool Wrong = Visible[i] != Scalar[i] || (CheckExpected && Visible[i] != Boxes[i].Expected);
+        if (Wrong && Mismatches++ < 5) {
+            printf("Box %zu (%s): batch %d, scalar %d, expected %d\n", i, PlaneNames[(i / 3) % 6], Visible[i], Scalar[i],
+                Boxes[i].Expected);
+        }
+    }
+    return Mismatches;
+}
+
+// For every plane a box well inside the frustum, one just behind the plane and one across it, all
+// near the middle of the frustum's face on that plane. Boxes are in the space of PV's inputs.
+std::vector<Box> MakePlaneBoxes(const glm::mat4& PV, float HalfSize)
+{
+    const FrustumCulling::Frustum F = FrustumCulling::Frustum::FromMatrix(PV);
+    const glm::vec3 Center = Unproject(PV, glm::vec3(0.0f));
+
+    std::vector<Box> Boxes;
+    const glm::vec3 Half(HalfSize);
+    const float Gap = HalfSize * 1.8f; // more than the half diagonal
+    for (int p = 0; p < 6; p++) {
+        glm::vec3 Ndc(0.0f);
+        Ndc[p / 2] = p % 2 ? 1.0f : -1.0f;
+        const glm::vec3 OnFace = Unproject(PV, Ndc);
+        const glm::vec3 Normal = glm::vec3(F.Planes[p]); // normalized, pointing inside
+
+        const glm::vec3 Inside = OnFace + (Center - OnFace) * 0.5f;
+        const glm::vec3 Outside = OnFace - Normal * Gap;
+        Boxes.push_back({ Inside - Half, Inside + Half, 1 });
+        Boxes.push_back({ Outside - Half, Outside + Half, 0 });
+        Boxes.push_back({ OnFace - Half, OnFace + Half, 1 });
+    }
+    return Boxes;
+}
+
+void TestPlanes()
+{
+    const glm::mat4 Projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.5f, 40.0f);
+    const glm::mat4 View = glm::lookAt(glm::vec3(3.0f, 2.0f, 5.0f), glm::vec3(-1.0f, 0.5f, -4.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 PV = Projection * View;
+    const FrustumCulling::Frustum F = FrustumCulling::Frustum::FromMatrix(PV);
+
+    std::vector<uint8_t> Visible;
+    const std::vector<Box> Boxes = MakePlaneBoxes(PV, 0.05f);
+    CHECK(CullBoth(F, Boxes, true, Visible) == 0);
+
+    // The same boxes in model space, culled against the frustum brought into it. Translation and
+    // uniform scale keep the boxes axis aligned.
+    const glm::mat4 Model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, -3.0f, 2.0f)), glm::vec3(2.0f));
+    const glm::mat4 ToModel = glm::inverse(Model);
+    std::vector<Box> ModelBoxes;
+    for (const Box& b : Boxes) {
+        ModelBoxes.push_back({ glm::vec3(ToModel * glm::vec4(b.Min, 1.0f)), glm::vec3(ToModel * glm::vec4(b.Max, 1.0f)), b.Expected });
+    }
+    CHECK(CullBoth(F.Transformed(Model), ModelBoxes, true, Visible) == 0);
+
+    // Empty boxes and points, as Build() leaves for entries without indices
+    const glm::vec3 Inside = Unproject(PV, glm::vec3(0.0f));
+    CHECK(CullBoth(F, { { Inside, Inside, 1 }, { glm::vec3(1e3f), glm::vec3(1e3f), 0 } }, true, Visible) == 0);
+
+    // Stereo: the combined frustum keeps every box either eye sees
+    const glm::mat4 Left = Projection * glm::lookAt(glm::vec3(-0.03f, 0.0f, 0.0f), glm::vec3(-0.03f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 Right = Projection * glm::lookAt(glm::vec3(0.03f, 0.0f, 0.0f), glm::vec3(0.03f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const FrustumCulling::Frustum Both = FrustumCulling::Frustum::FromStereo(Left, Right);
+    std::vector<Box> StereoBoxes = MakePlaneBoxes(Left, 0.01f);
+    for (Box& b : MakePlaneBoxes(Right, 0.01f)) {
+        StereoBoxes.push_back(b);
+    }
+    CullBoth(Both, StereoBoxes, false, Visible);
+    for (size_t i = 0; i < StereoBoxes.size(); i++) {
+        if (StereoBoxes[i].Expected) {
+            CHECK(Visible[i] == 1);
+        }
+    }
+}
+
+void TestRandom()
+{
+    // Boxes of every size all around the frustum, a count that leaves a partial last batch
+    std::mt19937 Random(5);
+    std::uniform_real_distribution<float> Coord(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> Size(0.0f, 4.0f);
+    std::vector<Box> Boxes;
+    for (int i = 0; i < 4003; i++) {
+        const glm::vec3 Min(Coord(Random), Coord(Random), Coord(Random));
+        Boxes.push_back({ Min, Min + glm::vec3(Size(Random), Size(Random), Size(Random)), 0 });
+    }
+
+    const glm::mat4 PV = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 25.0f)
+        * glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<uint8_t> Visible;
+    CHECK(CullBoth(FrustumCulling::Frustum::FromMatrix(PV), Boxes, false, Visible) == 0);
+
+    size_t NumVisible = 0;
+    for (uint8_t v : Visible) {
+        NumVisible += v;
+    }
+    printf("Random boxes: %zu of %zu visible\n", NumVisible, Boxes.size());
+    CHECK(NumVisible > 0 && NumVisible < Boxes.size() / 2);
+}
+
+void TestCullEntries()
+{
+    FrustumCulling::EntryBounds Bounds;
+    Bounds.Resize(2);
+    Bounds.Set(0, glm::vec3(-0.1f, -0.1f, -5.1f), glm::vec3(0.1f, 0.1f, -4.9f));
+    Bounds.Set(1, glm::vec3(-0.1f, -0.1f, 4.9f), glm::vec3(0.1f, 0.1f, 5.1f));
+
+    FrustumCulling::SetView(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f));
+    std::vector<uint8_t> Visible;
+    unsigned int Version = ~0u;
+    FrustumCulling::CullEntries(Bounds, glm::mat4(1.0f), Visible, Version);
+    CHECK(Version == FrustumCulling::GetVersion());
+    CHECK(Visible == std::vector<uint8_t>({ 1, 0 }));
+
+    // Culled already for this view, even though the model matrix turned the boxes around
+    const glm::mat4 Turned = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    FrustumCulling::CullEntries(Bounds, Turned, Visible, Version);
+    CHECK(Visible == std::vector<uint8_t>({ 1, 0 }));
+
+    FrustumCulling::BeginFrame();
+    FrustumCulling::SetView(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f));
+    FrustumCulling::CullEntries(Bounds, Turned, Visible, Version);
+    CHECK(Visible == std::vector<uint8_t>({ 0, 1 }));
+}
+
+}
+
+int main()
+{
+    TestPlanes();
+    TestRandom();
+    TestCullEntries();
+    return Check::Result();
+}
@@ -0,0 +1,130 @@
+#include "Objects/Animation.h"
+#include "Objects/ClipCompression.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <assimp/quaternion.inl>
+#include <assimp/vector3.inl>
+
+// Key sampling before and after the cursor based lookup: the original linear scan from the first
+// key with a divide per sample, against the compressed clips with per-instance cursors and
+// precomputed inverse spans, on one channel of 10k translation and 10k rotation keys.
+namespace {
+
+constexpr unsigned int NumKeys = 10000;
+constexpr float Duration = 10000.0f; // ticks
+constexpr float TicksPerSecond = 30.0f;
+constexpr int NumSamples = 200000;
+
+// As Animation.cpp sampled before: scan from key 0, divide by the segment length
+template <typename Key>
+unsigned int ScanKey(float AnimationTime, const std::vector<Key>& Keys)
+{
+    for (unsigned int i = 0; i < Keys.size() - 1; i++) {
+        if (AnimationTime < Keys[i + 1].Time) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void ScanTranslation(aiVector3D& Out, float AnimationTime, const std::vector<MeshCache::VectorKey>& Keys)
+{
+    const unsigned int Index = ScanKey(AnimationTime, Keys);
+    const float DeltaTime = Keys[Index + 1].Time - Keys[Index].Time;
+    const float Factor = (AnimationTime - Keys[Index].Time) / DeltaTime;
+    Out = Keys[Index].Value + (Keys[Index + 1].Value - Keys[Index].Value) * Factor;
+}
+
+void ScanRotation(aiQuaternion& Out, float AnimationTime, const std::vector<MeshCache::QuatKey>& Keys)
+{
+    const unsigned int Index = ScanKey(AnimationTime, Keys);
+    const float DeltaTime = Keys[Index + 1].Time - Keys[Index].Time;
+    const float Factor = (AnimationTime - Keys[Index].Time) / DeltaTime;
+    aiQuaternion::Interpolate(Out, Keys[Index].Value, Keys[Index + 1].Value, Factor);
+    Out = Out.Normalize();
+}
+
+// Sample times: 60 fps playback looping over the clip, or random seeks
+std::vector<float> MakeTimes(bool Playback)
+{
+    std::vector<float> Times(NumSamples);
+    std::mt19937 Random(7);
+    std::uniform_real_distribution<float> Seek(0.0f, Duration);
+    for (int i = 0; i < NumSamples; i++) {
+        Times[i] = Playback ? std::fmod(i * (TicksPerSecond / 60.0f), Duration) : Seek(Random);
+    }
+    return Times;
+}
+
+template <typename Sample>
+double Measure(const std::vector<float>& Times, Sample&& Fn)
+{
+    const auto Start = std::chrono::steady_clock::now();
+    for (float t : Times) {
+        Fn(t);
+    }
+    const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+    return Elapsed.count() / Times.size();
+}
+
+}
+
+int main()
+{
+    // One channel with jittered key times and a motion that never lets keys be dropped entirely
+    std::vector<MeshCache::VectorKey> Positions(NumKeys);
+    std::vector<MeshCache::QuatKey> Rotations(NumKeys);
+    std::mt19937 Random(42);
+    std::uniform_real_distribution<float> Jitter(-0.3f, 0.3f);
+    for (unsigned int k = 0; k < NumKeys; k++) {
+        const float t = k == 0 || k + 1 == NumKeys ? k * Duration / (NumKeys - 1) : (k + Jitter(Random)) * Duration / (NumKeys - 1);
+        Positions[k] = { t, aiVector3D(std::sin(t * 0.01f), std::cos(t * 0.013f), 0.1f * std::sin(t * 0.1f)) };
+        Rotations[k] = { t, aiQuaternion(aiVector3D(0.0f, 1.0f, 0.0f), std::sin(t * 0.02f) + 0.2f * std::sin(t * 0.3f)) };
+    }
+
+    std::vector<char> Strings = { 'b', 'o', 'n', 'e', '\0' };
+    MeshCache::Channel Channel { 0, 0, NumKeys, 0, NumKeys, 0, 0 };
+    MeshCache::Animation Anim { 0, Duration, TicksPerSecond, 0, 1 };
+    MeshCache::View View;
+    View.Strings = { Strings.data(), Strings.size() };
+    View.Channels = { &Channel, 1 };
+    View.Animations = { &Anim, 1 };
+    View.PositionKeys = { Positions.data(), Positions.size() };
+    View.RotationKeys = { Rotations.data(), Rotations.size() };
+
+    ClipCompression::Clip Clip;
+    ClipCompression::Stats Stats;
+    ClipCompression::Compress(View, Anim, {}, Clip, &Stats);
+    printf("Channel: %u translation + %u rotation keys, %zu kept after compression\n", NumKeys, NumKeys, Stats.Keys);
+
+    double Checksum = 0.0;
+    for (const bool Playback : { true, false }) {
+        const std::vector<float> Times = MakeTimes(Playback);
+
+        const double Scan = Measure(Times, [&](float t) {
+            aiVector3D T;
+            aiQuaternion R;
+            ScanTranslation(T, t, Positions);
+            ScanRotation(R, t, Rotations);
+            Checksum += T.x + R.w;
+        });
+
+        KeyCursor Cursor;
+        const double Cursored = Measure(Times, [&](float t) {
+            aiVector3D T;
+            aiQuaternion R;
+            ClipCompression::SampleTranslation(Clip, 0, t, Cursor.Position, T);
+            ClipCompression::SampleRotation(Clip, 0, t, Cursor.Rotation, R);
+            Checksum += T.x + R.w;
+        });
+
+        printf("%-9s linear scan + divide: %9.1f ns/sample   cursor + inverse span: %7.1f ns/sample   %.0fx\n",
+            Playback ? "Playback" : "Seeks", Scan, Cursored, Scan / Cursored);
+    }
+    printf("(checksum %g)\n", Checksum);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "MeshInstances.h"
+
+#include <memory>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.h"
+
+namespace {
+
+// A unit quad: 4 vertices, 2 triangles. aiMesh frees its arrays with delete[].
+std::unique_ptr<aiMesh> MakeQuad(unsigned int Material = 0, bool Normals = true)
+{
+    auto Mesh = std::make_unique<aiMesh>();
+    Mesh->mMaterialIndex = Material;
+    Mesh->mNumVertices = 4;
+    Mesh->mVertices = new aiVector3D[4] { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    if (Normals) {
+        Mesh->mNormals = new aiVector3D[4] { { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 } };
+    }
+    Mesh->mTextureCoords[0] = new aiVector3D[4] { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    Mesh->mNumUVComponents[0] = 2;
+
+    const unsigned int Indices[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+    Mesh->mNumFaces = 2;
+    Mesh->mFaces = new aiFace[2];
+    for (int f = 0; f < 2; f++) {
+        Mesh->mFaces[f].mNumIndices = 3;
+        Mesh->mFaces[f].mIndices = new unsigned int[3] { Indices[f][0], Indices[f][1], Indices[f][2] };
+    }
+    return Mesh;
+}
+
+// Quads that are copies of each other or differ in one thing each
+std::vector<std::unique_ptr<aiMesh>> MakeMeshes()
+{
+    std::vector<std::unique_ptr<aiMesh>> Meshes;
+    Meshes.push_back(MakeQuad()); // 0
+    Meshes.push_back(MakeQuad()); // 1: copy of 0
+    Meshes.push_back(MakeQuad(1)); // 2: other material
+    Meshes.push_back(MakeQuad()); // 3: one vertex moved
+    Meshes[3]->mVertices[2].x += 1e-6f;
+    Meshes.push_back(MakeQuad()); // 4: same triangles, other winding
+    std::swap(Meshes[4]->mFaces[1].mIndices[1], Meshes[4]->mFaces[1].mIndices[2]);
+    Meshes.push_back(MakeQuad(0, false)); // 5: no normals
+    Meshes.push_back(MakeQuad()); // 6: copy of 3
+    Meshes[6]->mVertices[2].x += 1e-6f;
+    Meshes.push_back(MakeQuad()); // 7: other texture coordinates
+    Meshes[7]->mTextureCoords[0][3].y = 0.5f;
+    return Meshes;
+}
+
+std::vector<const aiMesh*> Pointers(const std::vector<std::unique_ptr<aiMesh>>& Meshes)
+{
+    std::vector<const aiMesh*> Out;
+    for (const auto& Mesh : Meshes) {
+        Out.push_back(Mesh.get());
+    }
+    return Out;
+}
+
+void TestFindDuplicates()
+{
+    const auto Meshes = MakeMeshes();
+    const std::vector<const aiMesh*> p = Pointers(Meshes);
+    const std::vector<unsigned int> First = MeshInstances::FindDuplicates(p.data(), unsigned(p.size()));
+    CHECK(First == std::vector<unsigned int>({ 0, 0, 2, 3, 4, 5, 3, 7 }));
+
+    CHECK(MeshInstances::FindDuplicates(p.data(), 0).empty());
+}
+
+void TestGather()
+{
+    const auto Meshes = MakeMeshes();
+    const std::vector<const aiMesh*> p = Pointers(Meshes);
+
+    auto Move = [](float x) { return glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, 0.0f)); };
+    // Meshes 4, 5 and 7 aren't referenced, 1 is referenced twice and copies 0
+    const std::vector<MeshInstances::Reference> Refs = {
+        { 1, Move(1.0f) },
+        { 0, Move(2.0f) },
+        { 3, Move(3.0f) },
+        { 6, Move(4.0f) },
+        { 1, Move(5.0f) },
+        { 2, Move(6.0f) },
+    };
+
+    MeshInstances::Instances Out;
+    Out.SourceMeshes = { 9 }; // replaced, not appended to
+    MeshInstances::Gather(p.data(), unsigned(p.size()), Refs, Out);
+
+    // Grouped by the first copy, in the order first referenced, transforms in reference order
+    CHECK(Out.SourceMeshes == std::vector<unsigned int>({ 0, 3, 2 }));
+    CHECK(Out.FirstXform == std::vector<unsigned int>({ 0, 3, 5 }));
+    CHECK(Out.NumXforms == std::vector<unsigned int>({ 3, 2, 1 }));
+    const float Expected[] = { 1.0f, 2.0f, 5.0f, 3.0f, 4.0f, 6.0f };
+    if (CHECK(Out.Xforms.size() == 6)) {
+        for (int i = 0; i < 6; i++) {
+            CHECK(Out.Xforms[i] == Move(Expected[i]));
+        }
+    }
+
+    // Every reference as its own copy
+    CHECK(Out.NumFlatVerts == 6 * 4);
+    CHECK(Out.NumFlatIndices == 6 * 6);
+
+    MeshInstances::Gather(p.data(), unsigned(p.size()), {}, Out);
+    CHECK(Out.SourceMeshes.empty() && Out.Xforms.empty() && Out.NumFlatVerts == 0);
+}
+
+}
+
+int main()
+{
+    TestFindDuplicates();
+    TestGather();
+    return Check::Result();
+}
@@ -0,0 +1,132 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+const std::string TestDir = "ProgramCacheData"; // next to the executable, removed at the end
+
+constexpr uint64_t EntryBytes = sizeof(ProgramCache::Header) + 100;
+
+void TestHasher()
+{
+    ProgramCache::Hasher a, b, c;
+    a.Add(std::string("ab"));
+    a.Add(std::string("c"));
+    b.Add(std::string("a"));
+    b.Add(std::string("bc"));
+    c.Add(std::string("ab"));
+    c.Add(std::string("c"));
+    CHECK(a.Value != b.Value);
+    CHECK(a.Value == c.Value);
+
+    ProgramCache::Hasher Stage;
+    Stage.Add(0x8B31u); // stage type in front of the source
+    Stage.Add(std::string("ab"));
+    CHECK(Stage.Value != ProgramCache::Hasher().Value);
+}
+
+void TestStoreAndEvict()
+{
+    const std::vector<char> Binary(100, 'x');
+    std::vector<char> Out;
+    uint32_t Format = 0;
+
+    {
+        ProgramCache::Cache Cache;
+        if (!CHECK(Cache.Open(TestDir, 3 * EntryBytes))) {
+            return;
+        }
+        CHECK(!Cache.Load(1, Format, Out));
+
+        CHECK(Cache.Store(1, 7, Binary));
+        CHECK(Cache.Store(2, 7, Binary));
+        CHECK(Cache.Store(3, 7, Binary));
+        CHECK(!Cache.IsIndexDirty()); // stores write the index right away
+        CHECK(Cache.GetTotalBytes() == 3 * EntryBytes);
+
+        CHECK(Cache.Load(1, Format, Out) && Format == 7 && Out == Binary);
+        CHECK(Cache.IsIndexDirty()); // hits only mark it
+        CHECK(Cache.Flush() && !Cache.IsIndexDirty());
+        CHECK(!Cache.Flush());
+
+        // 2 is now the least recently used
+        CHECK(Cache.Store(4, 7, Binary));
+        CHECK(Cache.GetNumEntries() == 3 && !Cache.Load(2, Format, Out));
+        CHECK(!std::filesystem::exists(Cache.GetPath(2)));
+
+        // Only written on destruction
+        CHECK(Cache.Load(3, Format, Out));
+    }
+
+    // A smaller budget on the next run drops the oldest use of the last one: 1, then 3 and 4 were hit later
+    ProgramCache::Cache Cache;
+    CHECK(Cache.Open(TestDir, 2 * EntryBytes));
+    CHECK(Cache.GetNumEntries() == 2 && Cache.GetTotalBytes() == 2 * EntryBytes);
+    CHECK(!Cache.Load(1, Format, Out));
+    CHECK(Cache.Load(3, Format, Out) && Cache.Load(4, Format, Out));
+
+    // Replacing a binary updates the size, and a binary over the whole budget still stays
+    const std::vector<char> Large(3 * EntryBytes, 'y');
+    CHECK(Cache.Store(4, 9, Large));
+    CHECK(Cache.GetNumEntries() == 1 && Cache.GetTotalBytes() == sizeof(ProgramCache::Header) + Large.size());
+    CHECK(Cache.Load(4, Format, Out) && Format == 9 && Out == Large);
+
+    CHECK(!Cache.Store(5, 7, {}));
+    Cache.Remove(4);
+    CHECK(Cache.GetNumEntries() == 0 && Cache.GetTotalBytes() == 0);
+    CHECK(!std::filesystem::exists(Cache.GetPath(4)));
+}
+
+void TestDamaged()
+{
+    const std::vector<char> Binary(100, 'z');
+    std::vector<char> Out;
+    uint32_t Format = 0;
+
+    ProgramCache::Cache Cache;
+    CHECK(Cache.Open(TestDir, 4 * EntryBytes));
+    CHECK(Cache.Store(10, 1, Binary) && Cache.Store(11, 1, Binary));
+
+    // Bad magic, and a binary cut short
+    FILE* File = fopen(Cache.GetPath(10).c_str(), "r+b");
+    if (CHECK(File != nullptr)) {
+        fputc(0, File);
+        fclose(File);
+    }
+    std::filesystem::resize_file(Cache.GetPath(11), EntryBytes - 10);
+
+    CHECK(!Cache.Load(10, Format, Out) && Out.empty());
+    CHECK(!Cache.Load(11, Format, Out));
+    CHECK(Cache.GetNumEntries() == 0);
+    CHECK(!std::filesystem::exists(Cache.GetPath(10)) && !std::filesystem::exists(Cache.GetPath(11)));
+}
+
+void TestUnusableDir()
+{
+    // A file where the directory should be
+    ProgramCache::Cache Cache;
+    CHECK(!Cache.Open(TestDir + "/" + ProgramCache::IndexFilename, EntryBytes));
+    CHECK(!Cache.IsOpen());
+    CHECK(!Cache.Store(1, 7, std::vector<char>(10, 'x')));
+}
+
+}
+
+int main()
+{
+    std::filesystem::remove_all(TestDir);
+
+    TestHasher();
+    TestStoreAndEvict();
+    TestDamaged();
+    TestUnusableDir();
+
+    std::filesystem::remove_all(TestDir);
+    return Check::Result();
+}
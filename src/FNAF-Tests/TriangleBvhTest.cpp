@@ -0,0 +1,287 @@
+#include "Objects/TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "ThreadPool.h"
+
+// The four-wide traversal against brute force over every triangle, in double precision. Queries
+// that graze an edge, or whose two nearest hits are almost as near, can go either way in float
+// and are left out of the comparison.
+namespace {
+
+constexpr double Margin = 1e-4;
+
+struct Mesh {
+    std::vector<glm::vec3> Positions;
+    std::vector<unsigned int> Indices;
+};
+
+// Random triangles in a box, an axis aligned floor below it and a wall beside it
+Mesh MakeMesh(std::mt19937& Random)
+{
+    Mesh m;
+    std::uniform_real_distribution<float> Coord(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> Offset(-1.5f, 1.5f);
+    for (int t = 0; t < 1500; t++) {
+        const glm::vec3 Center(Coord(Random), Coord(Random), Coord(Random));
+        for (int c = 0; c < 3; c++) {
+            m.Indices.push_back(static_cast<unsigned int>(m.Positions.size()));
+            m.Positions.push_back(Center + glm::vec3(Offset(Random), Offset(Random), Offset(Random)));
+        }
+    }
+
+    auto AddQuad = [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+        const auto Base = static_cast<unsigned int>(m.Positions.size());
+        m.Positions.insert(m.Positions.end(), { a, b, c, d });
+        m.Indices.insert(m.Indices.end(), { Base, Base + 1, Base + 2, Base, Base + 2, Base + 3 });
+    };
+    for (int x = -10; x < 10; x++) {
+        for (int z = -10; z < 10; z++) {
+            AddQuad(glm::vec3(x, -12, z), glm::vec3(x + 1, -12, z), glm::vec3(x + 1, -12, z + 1), glm::vec3(x, -12, z + 1));
+        }
+    }
+    AddQuad(glm::vec3(12, -12, -10), glm::vec3(12, 10, -10), glm::vec3(12, 10, 10), glm::vec3(12, -12, 10));
+    return m;
+}
+
+struct Reference {
+    bool Valid = false;
+    unsigned int Triangle = TriangleBvh::InvalidTriangle;
+    double T = 0.0, U = 0.0, V = 0.0;
+    bool Ambiguous = false;
+};
+
+// Moller-Trumbore on every triangle, hits within (0, MaxT)
+Reference BruteIntersect(const Mesh& m, const glm::vec3& Origin, const glm::vec3& Dir, double MaxT)
+{
+    Reference Best;
+    Best.T = MaxT;
+    std::vector<double> Hits, Grazing; // t of every hit, and of hits or near misses on an edge or at either end
+    const glm::dvec3 o(Origin), d(Dir);
+    for (unsigned int t = 0; t < m.Indices.size() / 3; t++) {
+        const glm::dvec3 v0(m.Positions[m.Indices[3 * t]]);
+        const glm::dvec3 e1 = glm::dvec3(m.Positions[m.Indices[3 * t + 1]]) - v0;
+        const glm::dvec3 e2 = glm::dvec3(m.Positions[m.Indices[3 * t + 2]]) - v0;
+        const glm::dvec3 p = glm::cross(d, e2);
+        const double det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-12) {
+            continue;
+        }
+        const glm::dvec3 s = o - v0;
+        const glm::dvec3 q = glm::cross(s, e1);
+        const double u = glm::dot(s, p) / det;
+        const double v = glm::dot(d, q) / det;
+        const double tHit = glm::dot(e2, q) / det;
+        const double Inside = std::min(std::min(u, v), 1.0 - u - v);
+        if (Inside < -Margin || tHit < -Margin || tHit > MaxT + Margin) {
+            continue;
+        }
+        if (Inside < Margin || tHit < Margin || tHit > MaxT - Margin) {
+            Grazing.push_back(tHit);
+        } else {
+            Hits.push_back(tHit);
+        }
+        if (Inside >= 0.0 && tHit > 0.0 && tHit < Best.T) {
+            Best.Valid = true;
+            Best.Triangle = t;
+            Best.T = tHit;
+            Best.U = u;
+            Best.V = v;
+        }
+    }
+    // A grazing triangle in front of the nearest hit, or a second hit about as near, could go either way
+    const double Slack = Margin * (1.0 + (Best.Valid ? Best.T : 0.0));
+    for (double t : Grazing) {
+        Best.Ambiguous = Best.Ambiguous || !Best.Valid || t <= Best.T + Slack;
+    }
+    for (double t : Hits) {
+        Best.Ambiguous = Best.Ambiguous || (t != Best.T && std::abs(t - Best.T) < Slack);
+    }
+    return Best;
+}
+
+glm::dvec3 ClosestPoint(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+{
+    // Ericson, Real-Time Collision Detection 5.1.5
+    const glm::dvec3 ab = b - a, ac = c - a, ap = p - a;
+    const double d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0) {
+        return a;
+    }
+    const glm::dvec3 bp = p - b;
+    const double d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3) {
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const glm::dvec3 cp = p - c;
+    const double d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6) {
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+double Distance(const Mesh& m, unsigned int t, const glm::vec3& p)
+{
+    const glm::dvec3 q(p);
+    return glm::length(ClosestPoint(q, glm::dvec3(m.Positions[m.Indices[3 * t]]), glm::dvec3(m.Positions[m.Indices[3 * t + 1]]),
+                           glm::dvec3(m.Positions[m.Indices[3 * t + 2]]))
+        - q);
+}
+
+void TestRays(const Mesh& m, const TriangleBvh& Bvh, std::mt19937& Random)
+{
+    std::uniform_real_distribution<float> Coord(-15.0f, 15.0f);
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> Length(0.1f, 5.0f);
+
+    std::vector<TriangleBvh::Ray> Rays;
+    // Anywhere, any way, with a length that isn't 1
+    for (int i = 0; i < 1500; i++) {
+        glm::vec3 Dir(Unit(Random), Unit(Random), Unit(Random));
+        Rays.push_back({ glm::vec3(Coord(Random), Coord(Random), Coord(Random)), glm::normalize(Dir) * Length(Random),
+            i % 3 == 0 ? 3.0f : FLT_MAX });
+    }
+    // Parallel to an axis: zero direction components, and rays in the plane of the floor
+    for (int i = 0; i < 600; i++) {
+        glm::vec3 Dir(0.0f);
+        Dir[i % 3] = (i / 3) % 2 ? Length(Random) : -Length(Random);
+        glm::vec3 Origin(Coord(Random), Coord(Random), Coord(Random));
+        if (i % 5 == 0 && i % 3 != 1) {
+            Origin.y = -12.0f;
+        }
+        Rays.push_back({ Origin, Dir, FLT_MAX });
+    }
+    // Outside the mesh and pointing away from it
+    for (int i = 0; i < 200; i++) {
+        const glm::vec3 Away = glm::normalize(glm::vec3(Unit(Random), Unit(Random), Unit(Random)));
+        Rays.push_back({ Away * 40.0f, Away + 0.2f * glm::vec3(Unit(Random), Unit(Random), Unit(Random)), FLT_MAX });
+    }
+
+    std::vector<TriangleBvh::Hit> Hits(Rays.size());
+    ThreadPool Pool(3);
+    Bvh.Intersect(Rays.data(), Hits.data(), Rays.size(), &Pool);
+
+    unsigned int Compared = 0, Skipped = 0, Mismatches = 0, NumHits = 0, BatchMismatches = 0, OccludedMismatches = 0;
+    for (size_t i = 0; i < Rays.size(); i++) {
+        const TriangleBvh::Ray& R = Rays[i];
+        TriangleBvh::Hit Hit;
+        const bool Valid = Bvh.Intersect(R, Hit);
+        BatchMismatches += Hit.Triangle == Hits[i].Triangle && Hit.T == Hits[i].T ? 0 : 1;
+
+        const Reference Ref = BruteIntersect(m, R.Origin, R.Dir, R.MaxT);
+        if (Ref.Ambiguous) {
+            Skipped++;
+            continue;
+        }
+        Compared++;
+        NumHits += Ref.Valid ? 1 : 0;
+        const bool Same = Valid == Ref.Valid
+            && (!Valid
+                || (Hit.Triangle == Ref.Triangle && std::abs(Hit.T - Ref.T) <= Margin * (1.0 + Ref.T) && std::abs(Hit.U - Ref.U) <= 1e-3
+                    && std::abs(Hit.V - Ref.V) <= 1e-3));
+        if (!Same && Mismatches++ < 5) {
+            printf("Ray %zu: BVH %s triangle %u at %g, brute force %s triangle %u at %g\n", i, Valid ? "hits" : "misses", Hit.Triangle,
+                Hit.T, Ref.Valid ? "hits" : "misses", Ref.Triangle, Ref.T);
+        }
+
+        // The same ray as a segment up to a point before, or past, the nearest hit
+        if (Ref.Valid && Ref.T > 2.0 * Margin) {
+            const float End = static_cast<float>(i % 2 ? Ref.T * 0.5 : Ref.T * 1.5);
+            const bool Blocked = Bvh.Occluded({ R.Origin, R.Origin + R.Dir * End });
+            const Reference SegmentRef = BruteIntersect(m, R.Origin, R.Dir * End, 1.0);
+            if (!SegmentRef.Ambiguous) {
+                OccludedMismatches += Blocked == SegmentRef.Valid ? 0 : 1;
+            }
+        }
+    }
+    printf("Rays: %u compared (%u hit), %u grazing skipped, %u mismatches\n", Compared, NumHits, Skipped, Mismatches);
+    CHECK(Mismatches == 0);
+    CHECK(BatchMismatches == 0);
+    CHECK(OccludedMismatches == 0);
+    CHECK(Skipped * 20 < Rays.size());
+    CHECK(NumHits > Compared / 4 && NumHits < Compared); // both hits and misses were tested
+
+    // Nothing to hit
+    TriangleBvh Empty;
+    TriangleBvh::Hit Hit;
+    CHECK(!Empty.Intersect(Rays[0], Hit) && !Hit.Valid());
+    CHECK(!Empty.Occluded({ glm::vec3(-20.0f), glm::vec3(20.0f) }));
+}
+
+void TestSpheres(const Mesh& m, const TriangleBvh& Bvh, std::mt19937& Random)
+{
+    std::uniform_real_distribution<float> Coord(-14.0f, 14.0f);
+    std::uniform_real_distribution<float> Radius(0.01f, 2.0f);
+    const auto NumTriangles = static_cast<unsigned int>(m.Indices.size() / 3);
+
+    unsigned int QueryMismatches = 0, OverlapMismatches = 0, Empty = 0, Found = 0;
+    std::vector<unsigned int> Triangles;
+    for (int i = 0; i < 300; i++) {
+        const TriangleBvh::Sphere S { glm::vec3(Coord(Random), Coord(Random), Coord(Random)), Radius(Random) };
+
+        std::vector<unsigned int> Inside;
+        bool Ambiguous = false;
+        for (unsigned int t = 0; t < NumTriangles; t++) {
+            const double d = Distance(m, t, S.Center);
+            Ambiguous = Ambiguous || std::abs(d - S.Radius) < Margin;
+            if (d <= S.Radius) {
+                Inside.push_back(t);
+            }
+        }
+        if (Ambiguous) {
+            continue;
+        }
+
+        Triangles.clear();
+        Bvh.Query(S, Triangles);
+        std::sort(Triangles.begin(), Triangles.end());
+        QueryMismatches += Triangles == Inside ? 0 : 1;
+        OverlapMismatches += Bvh.Overlaps(S) == !Inside.empty() ? 0 : 1;
+        Empty += Inside.empty() ? 1 : 0;
+        Found += static_cast<unsigned int>(Inside.size());
+    }
+    printf("Spheres: %u empty, %u triangles found\n", Empty, Found);
+    CHECK(QueryMismatches == 0);
+    CHECK(OverlapMismatches == 0);
+    CHECK(Empty > 0 && Found > 0);
+}
+
+}
+
+int main()
+{
+    std::mt19937 Random(2024);
+    const Mesh m = MakeMesh(Random);
+
+    // Built in parallel and not, the trees answer the same
+    ThreadPool Pool(3);
+    TriangleBvh Bvh, SerialBvh;
+    Bvh.Build(m.Positions.data(), m.Indices.data(), m.Indices.size(), &Pool);
+    SerialBvh.Build(m.Positions.data(), m.Indices.data(), m.Indices.size());
+    CHECK(Bvh.GetNumTriangles() == m.Indices.size() / 3);
+    CHECK(Bvh.GetNumNodes() == SerialBvh.GetNumNodes());
+    CHECK(Bvh.GetBbMin().y == -12.0f && Bvh.GetBbMax().x == 12.0f);
+
+    TestRays(m, Bvh, Random);
+    TestSpheres(m, SerialBvh, Random);
+    return Check::Result();
+}
@@ -0,0 +1,268 @@
+#include "Objects/VertexAnimation.h"
+#include "Objects/AnimationGraph.h"
+#include "Objects/CpuSkinning.h"
+#include "Objects/Skeleton.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <assimp/matrix3x3.inl>
+#include <assimp/matrix4x4.inl>
+#include <assimp/quaternion.inl>
+#include <assimp/vector3.inl>
+
+#include "Check.h"
+
+// VertexPacking's SetupAttributes() goes through GLEW's function pointers, which nothing here calls
+PFNGLENABLEVERTEXATTRIBARRAYPROC __glewEnableVertexAttribArray = nullptr;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC __glewDisableVertexAttribArray = nullptr;
+PFNGLVERTEXATTRIBPOINTERPROC __glewVertexAttribPointer = nullptr;
+PFNGLVERTEXATTRIBIPOINTERPROC __glewVertexAttribIPointer = nullptr;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr float TicksPerSecond = 10.0f;
+constexpr float Duration = 10.0f; // ticks: one second
+constexpr float SampleRate = 30.0f;
+
+// More than one texture row per frame
+constexpr unsigned int NumVertices = VertexAnimation::MaxWidth + 7;
+
+const aiVector3D Axis = aiVector3D(0.2f, 0.3f, 1.0f).Normalize();
+
+// A root bone and a child bone one unit above it. Clip "Rest" holds the bind pose, "Wave" turns
+// the child and lifts it over the clip.
+struct Rig {
+    std::vector<char> Strings;
+    std::vector<MeshCache::Node> Nodes;
+    std::vector<MeshCache::BoneOffset> BoneOffsets;
+    std::vector<MeshCache::Channel> Channels;
+    std::vector<MeshCache::VectorKey> PositionKeys, ScalingKeys;
+    std::vector<MeshCache::QuatKey> RotationKeys;
+    std::vector<MeshCache::Animation> Anims;
+    MeshCache::View View;
+
+    Skeleton Skel;
+    std::vector<AnimationClip> Clips;
+
+    // A column of vertices from the root to above the child, blending between the two bones
+    std::vector<MeshCache::Vertex> Vertices;
+    std::vector<MeshCache::VertexBoneData> Bones;
+};
+
+uint32_t AddString(std::vector<char>& Strings, const char* s)
+{
+    const auto Offset = static_cast<uint32_t>(Strings.size());
+    Strings.insert(Strings.end(), s, s + strlen(s) + 1);
+    return Offset;
+}
+
+void MakeRig(Rig& r)
+{
+    aiMatrix4x4 Up;
+    aiMatrix4x4::Translation(aiVector3D(0.0f, 1.0f, 0.0f), Up);
+    aiMatrix4x4 Down = Up;
+    Down.Inverse();
+    r.Nodes.push_back({ -1, AddString(r.Strings, "root"), aiMatrix4x4() });
+    r.Nodes.push_back({ 0, AddString(r.Strings, "child"), Up });
+    r.BoneOffsets.push_back({ r.Nodes[0].Name, aiMatrix4x4() });
+    r.BoneOffsets.push_back({ r.Nodes[1].Name, Down });
+
+    const char* Names[] = { "Rest", "Wave" };
+    for (int a = 0; a < 2; a++) {
+        const auto FirstChannel = static_cast<uint32_t>(r.Channels.size());
+        r.Channels.push_back({ r.Nodes[1].Name, static_cast<uint32_t>(r.PositionKeys.size()), 11,
+            static_cast<uint32_t>(r.RotationKeys.size()), 11, static_cast<uint32_t>(r.ScalingKeys.size()), 11 });
+        for (int k = 0; k <= 10; k++) {
+            const float t = a == 0 ? 0.0f : float(k);
+            r.PositionKeys.push_back({ float(k), aiVector3D(0.0f, 1.0f + 0.05f * t, 0.0f) });
+            r.RotationKeys.push_back({ float(k), aiQuaternion(Axis, 0.15f * t) });
+            r.ScalingKeys.push_back({ float(k), aiVector3D(1.0f) });
+        }
+        r.Anims.push_back({ AddString(r.Strings, Names[a]), Duration, TicksPerSecond, FirstChannel, 1 });
+    }
+
+    r.View.Strings = { r.Strings.data(), r.Strings.size() };
+    r.View.Nodes = { r.Nodes.data(), r.Nodes.size() };
+    r.View.BoneOffsets = { r.BoneOffsets.data(), r.BoneOffsets.size() };
+    r.View.Channels = { r.Channels.data(), r.Channels.size() };
+    r.View.Animations = { r.Anims.data(), r.Anims.size() };
+    r.View.PositionKeys = { r.PositionKeys.data(), r.PositionKeys.size() };
+    r.View.RotationKeys = { r.RotationKeys.data(), r.RotationKeys.size() };
+    r.View.ScalingKeys = { r.ScalingKeys.data(), r.ScalingKeys.size() };
+
+    r.Skel.Init(r.View);
+    for (const MeshCache::Animation& Anim : r.Anims) {
+        AnimationClip Clip;
+        Clip.Name = r.View.String(Anim.Name);
+        Clip.Duration = Duration;
+        Clip.TicksPerSecond = TicksPerSecond;
+        Clip.ChannelNames.push_back(r.View.String(r.Channels[Anim.FirstChannel].NodeName));
+        ClipCompression::Compress(r.View, Anim, {}, Clip.Tracks, nullptr);
+        r.Skel.BindClip(Clip);
+        r.Clips.push_back(std::move(Clip));
+    }
+
+    std::mt19937 Random(24);
+    std::uniform_real_distribution<float> Side(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> Height(0.0f, 2.0f);
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    r.Vertices.resize(NumVertices);
+    r.Bones.resize(NumVertices);
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        const float y = Height(Random);
+        r.Vertices[v].Pos = aiVector3D(Side(Random), y, Side(Random));
+        r.Vertices[v].Normal = aiVector3D(Unit(Random), Unit(Random), Unit(Random) + 0.01f).Normalize();
+        const float ChildWeight = std::clamp(y - 0.5f, 0.0f, 1.0f);
+        r.Bones[v].IDs[1] = 1;
+        r.Bones[v].Weights[0] = 1.0f - ChildWeight;
+        r.Bones[v].Weights[1] = ChildWeight;
+    }
+}
+
+// Reference: the clip played through its own graph and skinned, at every frame of the bake
+void SkinFrames(const Rig& r, unsigned int Clip, const VertexAnimation::Data& Bake, std::vector<glm::vec3>& Positions,
+    std::vector<glm::vec3>& Normals)
+{
+    AnimationGraph Graph;
+    Graph.Init(&r.Skel, &r.Clips);
+    Graph.Play(0, static_cast<int>(Clip), 0.0f, 0.0f, 1.0f, false);
+
+    LocalPose Pose;
+    Pose.Resize(r.Skel.GetNumNodes());
+    std::vector<aiMatrix4x4> Globals(r.Skel.GetNumNodes());
+    std::vector<aiMatrix4x4> Palette(r.Skel.GetNumBones());
+    Positions.resize(size_t(Bake.NumFrames) * NumVertices);
+    Normals.resize(Positions.size());
+    for (uint32_t f = 0; f < Bake.NumFrames; f++) {
+        Graph.Evaluate(static_cast<float>(f) / Bake.SampleRate, Pose);
+        r.Skel.ComputePalette(Pose, Globals.data(), Palette.data());
+        CpuSkinning::Skin(r.Vertices.data(), r.Bones.data(), NumVertices, Palette.data(), r.Skel.GetNumBones(),
+            Positions.data() + size_t(f) * NumVertices, Normals.data() + size_t(f) * NumVertices);
+    }
+}
+
+// Angle in double between two directions of any length
+double Angle(const glm::vec3& A, const glm::vec3& B)
+{
+    const glm::dvec3 a = glm::normalize(glm::dvec3(A)), b = glm::normalize(glm::dvec3(B));
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
+
+// Every decoded texel within the quantization of the skinned reference
+void CheckTexels(const Rig& r, const VertexAnimation::Data& Bake)
+{
+    std::vector<glm::vec3> Positions, Normals;
+    SkinFrames(r, 1, Bake, Positions, Normals);
+
+    glm::vec3 BbMin, BbMax;
+    CpuSkinning::CalcBounds(Positions.data(), static_cast<unsigned int>(Positions.size()), BbMin, BbMax);
+    CHECK(Bake.BbMin == BbMin && Bake.BbMax == BbMax);
+
+    // Half a 16 bit step of the bake bounds, an 8 bit octahedral normal is off by up to about 2 sqrt(6) half steps
+    const glm::vec3 PositionTolerance = (Bake.BbMax - Bake.BbMin) * (0.5f / 65535.0f) + glm::vec3(1e-6f);
+    const double NormalTolerance = 2.0 * std::sqrt(6.0) / 255.0;
+
+    glm::vec3 MaxPositionError(0.0f);
+    double MaxNormalError = 0.0;
+    for (uint32_t f = 0; f < Bake.NumFrames; f++) {
+        for (uint32_t v = 0; v < NumVertices; v++) {
+            const size_t i = size_t(f) * NumVertices + v;
+            const VertexAnimation::Texel& T = Bake.GetTexel(f, v);
+            MaxPositionError = glm::max(MaxPositionError, glm::abs(Bake.DecodePosition(T) - Positions[i]));
+            MaxNormalError = std::max(MaxNormalError, Angle(VertexAnimation::Data::DecodeNormal(T), Normals[i]));
+        }
+    }
+    if (!CHECK(glm::all(glm::lessThanEqual(MaxPositionError, PositionTolerance)) && MaxNormalError <= NormalTolerance)) {
+        printf("Position off by %.2e %.2e %.2e, normal by %.2e rad\n", MaxPositionError.x, MaxPositionError.y,
+            MaxPositionError.z, MaxNormalError);
+    }
+
+    // The clip moves the mesh: frames differ
+    CHECK(std::memcmp(&Bake.GetTexel(0, NumVertices - 1), &Bake.GetTexel(Bake.NumFrames - 1, NumVertices - 1),
+              sizeof(VertexAnimation::Texel))
+        != 0);
+}
+
+void TestBake(const Rig& r)
+{
+    VertexAnimation::Data Bake;
+    if (!CHECK(VertexAnimation::Bake(r.Vertices.data(), r.Bones.data(), NumVertices, r.Skel, r.Clips, 1, SampleRate, Bake))) {
+        return;
+    }
+
+    // Both ends of the one second clip, two rows a frame
+    CHECK(Bake.Clip == 1 && Bake.NumVertices == NumVertices);
+    CHECK(Bake.NumFrames == 31 && Bake.SampleRate == SampleRate && Bake.Duration == 1.0f);
+    CHECK(Bake.Width == VertexAnimation::MaxWidth && Bake.RowsPerFrame == 2 && Bake.GetHeight() == 62);
+    CHECK(Bake.Texels.size() == size_t(Bake.Width) * Bake.GetHeight());
+    CHECK(Bake.GetTexelIndex(1, VertexAnimation::MaxWidth + 1) == size_t(3) * Bake.Width + 1);
+    CheckTexels(r, Bake);
+
+    CHECK_NEAR(Bake.GetFrame(0.5f), 15.0, 1e-4);
+    CHECK_NEAR(Bake.GetFrame(1.25f), 7.5, 1e-4);
+    CHECK_NEAR(Bake.GetFrame(1.25f, false), 30.0, 1e-4);
+
+    // No such clip, and more rows than a texture has
+    VertexAnimation::Data Failed;
+    CHECK(!VertexAnimation::Bake(r.Vertices.data(), r.Bones.data(), NumVertices, r.Skel, r.Clips, 2, SampleRate, Failed));
+    CHECK(!VertexAnimation::Bake(r.Vertices.data(), r.Bones.data(), NumVertices, r.Skel, r.Clips, 1, 10000.0f, Failed));
+    CHECK(Failed.Texels.empty());
+}
+
+void TestWriteRead(const Rig& r)
+{
+    const std::string Source = "vat_source.bin";
+    {
+        std::ofstream Out(Source, std::ios::binary | std::ios::trunc);
+        Out << "source asset";
+    }
+
+    VertexAnimation::Data Bake;
+    CHECK(VertexAnimation::Bake(r.Vertices.data(), r.Bones.data(), NumVertices, r.Skel, r.Clips, 1, SampleRate, Bake));
+    CHECK(VertexAnimation::Write(Source, Bake));
+
+    VertexAnimation::Data Loaded;
+    if (CHECK(VertexAnimation::Read(Source, 1, SampleRate, Loaded))) {
+        CHECK(Loaded.Clip == Bake.Clip && Loaded.NumVertices == Bake.NumVertices && Loaded.NumFrames == Bake.NumFrames);
+        CHECK(Loaded.Width == Bake.Width && Loaded.RowsPerFrame == Bake.RowsPerFrame);
+        CHECK(Loaded.SampleRate == Bake.SampleRate && Loaded.Duration == Bake.Duration);
+        CHECK(Loaded.BbMin == Bake.BbMin && Loaded.BbMax == Bake.BbMax);
+        CHECK(Loaded.Texels.size() == Bake.Texels.size()
+            && std::memcmp(Loaded.Texels.data(), Bake.Texels.data(), Bake.Texels.size() * sizeof(VertexAnimation::Texel)) == 0);
+        CheckTexels(r, Loaded);
+    }
+
+    // Another clip or rate isn't this bake
+    CHECK(!VertexAnimation::Read(Source, 0, SampleRate, Loaded));
+    CHECK(!VertexAnimation::Read(Source, 1, 15.0f, Loaded));
+    CHECK(Loaded.Texels.empty());
+
+    // Nor is a bake of an older source
+    {
+        std::ofstream Out(Source, std::ios::binary | std::ios::app);
+        Out << ", changed";
+    }
+    CHECK(!VertexAnimation::Read(Source, 1, SampleRate, Loaded));
+
+    std::error_code ec;
+    fs::remove(VertexAnimation::CachePath(Source, 1), ec);
+    fs::remove(Source, ec);
+}
+
+}
+
+int main()
+{
+    Rig r;
+    MakeRig(r);
+    TestBake(r);
+    TestWriteRead(r);
+    return Check::Result();
+}
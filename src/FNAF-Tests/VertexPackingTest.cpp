@@ -0,0 +1,208 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+
+// SetupAttributes() goes through GLEW's function pointers, which nothing here calls
+PFNGLENABLEVERTEXATTRIBARRAYPROC __glewEnableVertexAttribArray = nullptr;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC __glewDisableVertexAttribArray = nullptr;
+PFNGLVERTEXATTRIBPOINTERPROC __glewVertexAttribPointer = nullptr;
+PFNGLVERTEXATTRIBIPOINTERPROC __glewVertexAttribIPointer = nullptr;
+
+namespace {
+
+using namespace VertexPacking;
+
+struct Vertex {
+    glm::vec3 Pos;
+    glm::vec3 Normal;
+    glm::vec2 TexCoord;
+    unsigned char BoneIds[4];
+    glm::vec4 Weights;
+};
+
+struct Mesh {
+    std::vector<Vertex> Vertices;
+    std::vector<Submesh> Submeshes;
+
+    [[nodiscard]] Streams GetStreams() const
+    {
+        Streams In;
+        In.Positions = { &Vertices.data()->Pos, sizeof(Vertex) };
+        In.Normals = { &Vertices.data()->Normal, sizeof(Vertex) };
+        In.TexCoords = { &Vertices.data()->TexCoord, sizeof(Vertex) };
+        In.BoneIds = { Vertices.data()->BoneIds, sizeof(Vertex) };
+        In.Weights = { &Vertices.data()->Weights, sizeof(Vertex) };
+        return In;
+    }
+};
+
+// Submeshes of different sizes and places, with one flat along y. Tex coords span [-UvRange, UvRange]
+// (or [0, 1] if UvRange is 0), weights are multiples of 1/256 so they sum to exactly 1.
+Mesh MakeMesh(std::mt19937& Rng, float UvRange)
+{
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> Uv(UvRange > 0.0f ? -UvRange : 0.0f, UvRange > 0.0f ? UvRange : 1.0f);
+    std::uniform_int_distribution<int> Bone(0, 255);
+
+    const glm::vec3 Centers[] = { { 0.0f, 0.0f, 0.0f }, { 3.0f, -1.0f, 2.0f }, { -0.25f, 0.5f, 0.0f } };
+    const glm::vec3 Extents[] = { { 0.5f, 0.25f, 0.1f }, { 0.2f, 0.0f, 0.2f }, { 0.01f, 0.02f, 0.005f } };
+    const unsigned int Counts[] = { 500, 300, 200 };
+
+    Mesh Out;
+    for (int s = 0; s < 3; s++) {
+        Out.Submeshes.push_back({ static_cast<unsigned int>(Out.Vertices.size()), Counts[s] });
+        for (unsigned int i = 0; i < Counts[s]; i++) {
+            Vertex V {};
+            V.Pos = Centers[s] + Extents[s] * glm::vec3(Unit(Rng), Unit(Rng), Unit(Rng));
+            do {
+                V.Normal = glm::vec3(Unit(Rng), Unit(Rng), Unit(Rng));
+            } while (glm::length(V.Normal) < 0.1f);
+            V.Normal = glm::normalize(V.Normal);
+            V.TexCoord = glm::vec2(Uv(Rng), Uv(Rng));
+            int Left = 256;
+            for (int w = 0; w < 4; w++) {
+                V.BoneIds[w] = static_cast<unsigned char>(Bone(Rng));
+                const int Part = w < 3 ? std::uniform_int_distribution<int>(0, Left)(Rng) : Left;
+                V.Weights[w] = static_cast<float>(Part) / 256.0f;
+                Left -= Part;
+            }
+            Out.Vertices.push_back(V);
+        }
+    }
+    return Out;
+}
+
+// Largest bound over the submeshes, for the format Pack() actually used
+ErrorBounds GetMeshBounds(const Mesh& In, const Layout& Format)
+{
+    ErrorBounds Out;
+    for (const Submesh& S : In.Submeshes) {
+        glm::vec3 BbMin = In.Vertices[S.BaseVertex].Pos;
+        glm::vec3 BbMax = BbMin;
+        float MaxTexCoord = 0.0f;
+        for (unsigned int i = S.BaseVertex; i < S.BaseVertex + S.NumVertices; i++) {
+            const Vertex& V = In.Vertices[i];
+            BbMin = glm::min(BbMin, V.Pos);
+            BbMax = glm::max(BbMax, V.Pos);
+            MaxTexCoord = std::max(MaxTexCoord, std::max(std::abs(V.TexCoord.x), std::abs(V.TexCoord.y)));
+        }
+        const ErrorBounds Bounds = GetErrorBounds(Format, 0.5f * (BbMax - BbMin), MaxTexCoord);
+        Out.Position = std::max(Out.Position, Bounds.Position);
+        Out.NormalDegrees = std::max(Out.NormalDegrees, Bounds.NormalDegrees);
+        Out.TexCoord = std::max(Out.TexCoord, Bounds.TexCoord);
+        Out.Weight = std::max(Out.Weight, Bounds.Weight);
+    }
+    return Out;
+}
+
+// Every combination of formats stays within its worst case bound
+void TestErrorBounds()
+{
+    std::mt19937 Rng(12);
+    const Mesh Unit = MakeMesh(Rng, 0.0f);
+    const Mesh Tiled = MakeMesh(Rng, 0.9f);
+
+    const PositionFormat Positions[] = { PositionFormat::Float3, PositionFormat::Half4 };
+    const NormalFormat Normals[] = { NormalFormat::None, NormalFormat::Float3, NormalFormat::Snorm10, NormalFormat::Oct16 };
+    const TexCoordFormat TexCoords[] = { TexCoordFormat::None, TexCoordFormat::Float2, TexCoordFormat::Half2, TexCoordFormat::Unorm16 };
+    const WeightFormat Weights[] = { WeightFormat::None, WeightFormat::Float4, WeightFormat::Unorm8 };
+
+    for (const Mesh* pMesh : { &Unit, &Tiled }) {
+        const Streams In = pMesh->GetStreams();
+        for (PositionFormat P : Positions) {
+            for (NormalFormat N : Normals) {
+                for (TexCoordFormat T : TexCoords) {
+                    for (WeightFormat W : Weights) {
+                        Layout Requested;
+                        Requested.Position = P;
+                        Requested.Normal = N;
+                        Requested.TexCoord = T;
+                        Requested.Weights = W;
+
+                        PackedVertices Packed;
+                        Pack(In, pMesh->Vertices.size(), pMesh->Submeshes, Requested, Packed);
+                        // All of these fit the default tolerances, apart from Unorm16 for negative uvs
+                        const bool UvFallback = T == TexCoordFormat::Unorm16 && pMesh == &Tiled;
+                        CHECK(Packed.Format.Position == P && Packed.Format.Normal == N && Packed.Format.Weights == W);
+                        CHECK(Packed.Format.TexCoord == (UvFallback ? TexCoordFormat::Half2 : T));
+                        CHECK(Packed.Format.Stride * pMesh->Vertices.size() == Packed.Data.size());
+
+                        const ErrorBounds Bounds = GetMeshBounds(*pMesh, Packed.Format);
+                        const ErrorBounds Error = MeasureError(In, pMesh->Submeshes, Packed);
+                        if (!CHECK(Error.Position <= Bounds.Position && Error.NormalDegrees <= Bounds.NormalDegrees &&
+                                Error.TexCoord <= Bounds.TexCoord && Error.Weight <= Bounds.Weight)) {
+                            printf("  formats %u %u %u %u: position %g / %g, normal %g / %g, uv %g / %g, weight %g / %g\n",
+                                unsigned(P), unsigned(N), unsigned(T), unsigned(W), Error.Position, Bounds.Position,
+                                Error.NormalDegrees, Bounds.NormalDegrees, Error.TexCoord, Bounds.TexCoord,
+                                Error.Weight, Bounds.Weight);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Half formats give way to floats where their error would exceed the layout's tolerances
+void TestFallback()
+{
+    std::mt19937 Rng(34);
+    Layout Requested;
+    Requested.Position = PositionFormat::Half4;
+    Requested.TexCoord = TexCoordFormat::Half2;
+
+    Mesh M = MakeMesh(Rng, 1.0f);
+    PackedVertices Packed;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.Position == PositionFormat::Half4);
+    CHECK(Packed.Format.TexCoord == TexCoordFormat::Half2);
+
+    // Tiled tex coords
+    M.Vertices[700].TexCoord.y = -4.0f;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.TexCoord == TexCoordFormat::Float2);
+    CHECK(MeasureError(M.GetStreams(), M.Submeshes, Packed).TexCoord == 0.0f);
+
+    // Unorm16 goes through Half2 to Float2
+    Requested.TexCoord = TexCoordFormat::Unorm16;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.TexCoord == TexCoordFormat::Float2);
+
+    // Unless the tolerance allows for it
+    Requested.TexCoord = TexCoordFormat::Half2;
+    Requested.MaxTexCoordError = 4.0f / 2048.0f;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.TexCoord == TexCoordFormat::Half2);
+
+    // One submesh too large for Half4 takes the whole buffer to Float3
+    M.Vertices[0].Pos.x = 10.0f;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.Position == PositionFormat::Float3);
+    CHECK(Packed.Format.Stride == 12 + 4 + 4);
+    CHECK(MeasureError(M.GetStreams(), M.Submeshes, Packed).Position == 0.0f);
+
+    Requested.MaxPositionError = 1.0f;
+    Pack(M.GetStreams(), M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.Position == PositionFormat::Half4);
+
+    // No tex coords: nothing to fall back for
+    Streams NoUv = M.GetStreams();
+    NoUv.TexCoords = {};
+    Requested.TexCoord = TexCoordFormat::Unorm16;
+    Pack(NoUv, M.Vertices.size(), M.Submeshes, Requested, Packed);
+    CHECK(Packed.Format.TexCoord == TexCoordFormat::Unorm16);
+}
+
+}
+
+int main()
+{
+    TestErrorBounds();
+    TestFallback();
+    return Check::Result();
+}
@@ -3,6 +3,8 @@
 
 #include "Camera.h"
 #include "Game/GameScene.h"
+#include "Objects/FrustumCulling.h"
+#include "Objects/MeshLod.h"
 #include "Window/DrawGui.h"
 
 void Scene::Display(GLFWwindow* window)
@@ -10,7 +12,7 @@ void Scene::Display(GLFWwindow* window)
     int w, h;
     glfwGetWindowSize(window, &w, &h);
     glViewport(0, 0, w, h);
-
+    SceneData.Viewport = glm::ivec4(0, 0, w, h);
 
     if (bClearDefaultFb) {
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -18,7 +20,11 @@ void Scene::Display(GLFWwindow* window)
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
 
+    // Only called to mirror the eye just rendered: draw it with the levels picked for the eye
+    // render target, not re-picked for the window height
+    MeshLod::sHoldLevels = true;
     GameScene::Render();
+    MeshLod::sHoldLevels = false;
 
     DrawGui::Display(window);
 
@@ -26,11 +32,12 @@ void Scene::Display(GLFWwindow* window)
     glfwSwapBuffers(window);
 }
 
-void Scene::DisplayVr(const glm::mat4& P, const glm::mat4& V)
+void Scene::DisplayVr(const glm::mat4& P, const glm::mat4& V, const glm::ivec4& Viewport)
 {
     // No clear in this function
 
     SceneData.P = P;
+    SceneData.Viewport = Viewport;
     
     auto* pCamera = dynamic_cast<Camera*>(camera.get());
     if (pCamera) {
@@ -46,6 +53,22 @@ void Scene::DisplayVr(const glm::mat4& P, const glm::mat4& V)
     // No swap buffers in this function
 }
 
+void Scene::SetStereoViews(const glm::mat4& P0, const glm::mat4& V0, const glm::mat4& P1, const glm::mat4& V1)
+{
+    auto* pCamera = dynamic_cast<Camera*>(camera.get());
+    if (!pCamera) {
+        return;
+    }
+
+    // Same world space views as DisplayVr() builds
+    pCamera->Update(V0);
+    const glm::mat4 PV0 = P0 * pCamera->GetViewMatrix();
+    pCamera->Update(V1);
+    const glm::mat4 PV1 = P1 * pCamera->GetViewMatrix();
+
+    FrustumCulling::SetStereoViews(PV0, PV1);
+}
+
 void Scene::Init()
 {
     camera = std::make_unique<Camera>();
@@ -29,7 +29,11 @@ inline glm::mat4 Mcontroller[2];
 inline float Trigger[2] { 0.0f, 0.0f };
 
 void Display(GLFWwindow* window);
-void DisplayVr(const glm::mat4& P, const glm::mat4& V);
+// Viewport is the eye's rectangle of the swapchain image (x, y, width, height)
+void DisplayVr(const glm::mat4& P, const glm::mat4& V, const glm::ivec4& Viewport);
+// Projection and head-relative view of both eyes, before the first DisplayVr() of the frame, so
+// meshes are frustum culled once for the two of them
+void SetStereoViews(const glm::mat4& P0, const glm::mat4& V0, const glm::mat4& P1, const glm::mat4& V1);
 void Init();
 void Idle();
 
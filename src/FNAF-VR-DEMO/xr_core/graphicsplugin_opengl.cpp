@@ -358,7 +358,9 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
         XrMatrix4x4f_Multiply(&vp, &proj, &view);
 
 
-        Scene::DisplayVr(glm::make_mat4(proj.m), glm::make_mat4(view.m));
+        const XrRect2Di& rect = layerView.subImage.imageRect;
+        Scene::DisplayVr(glm::make_mat4(proj.m), glm::make_mat4(view.m),
+                         glm::ivec4(rect.offset.x, rect.offset.y, rect.extent.width, rect.extent.height));
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
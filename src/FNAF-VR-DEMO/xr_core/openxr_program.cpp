@@ -1286,6 +1286,24 @@ struct OpenXrProgram : IOpenXrProgram {
          glfwPollEvents();
          Scene::Idle();
 
+        // Both eyes' frustums up front: meshes are culled once for the pair
+        if (viewCountOutput == 2) {
+            glm::mat4 P[2], V[2];
+            for (uint32_t i = 0; i < 2; i++) {
+                // As graphicsplugin_opengl's RenderView() builds them
+                XrMatrix4x4f proj;
+                XrMatrix4x4f_CreateProjectionFov(&proj, GRAPHICS_OPENGL, m_views[i].fov, 0.1f, 10000.0f);
+                XrMatrix4x4f toView;
+                XrVector3f scale{1.f, 1.f, 1.f};
+                XrMatrix4x4f_CreateTranslationRotationScale(&toView, &m_views[i].pose.position, &m_views[i].pose.orientation, &scale);
+                XrMatrix4x4f view;
+                XrMatrix4x4f_InvertRigidBody(&view, &toView);
+                P[i] = glm::make_mat4(proj.m);
+                V[i] = glm::make_mat4(view.m);
+            }
+            Scene::SetStereoViews(P[0], V[0], P[1], V[1]);
+        }
+
         // Render view to the appropriate part of the swapchain image.
         for (uint32_t i = 0; i < viewCountOutput; i++) {
             // Each view has a separate swapchain which is acquired, rendered to, and released.